@@ -15,15 +15,22 @@
 #include "skull_audio_animator.h"
 #include "audio_player.h"
 #include "config_manager.h"
+#include "esp32_platform.h"
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_bt_device.h"
 #include <esp_coexist.h>
 #include "nvs_flash.h"
 #include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
 #include "driver/adc.h"
 #include "esp_adc_cal.h"
 #include "skit_selector.h"
+#include "skit_start_protocol.h"
+#include "skit_catalog.h"
+#include "playback_drift_corrector.h"
 
 const int LEFT_EYE_PIN = 32;  // GPIO pin for left eye LED
 const int RIGHT_EYE_PIN = 33; // GPIO pin for right eye LED
@@ -31,16 +38,18 @@ LightController lightController(LEFT_EYE_PIN, RIGHT_EYE_PIN);
 
 const int VOLUME_DIVISOR = 1; // FOR DEBUGGING: divide volume by this amount to set volume lower
 
-// GPIO trigger constants and variables
+// GPIO trigger constants
 const int MATTER_TRIGGER_PIN = 2;  // GPIO 2 for Matter controller trigger
-volatile bool matterTriggerDetected = false;  // Flag for interrupt handler
+
+// The SD card, clock and tasks the audio path runs on
+SdFileSystem sdFileSystem;
+Esp32Clock esp32Clock;
+FreeRtosTasks freeRtosTasks;
 
 SDCardManager *sdCardManager = nullptr;
 SDCardContent sdCardContent;
 
 bool isPrimary = false; // Determines if this skull is the primary or secondary unit
-bool isDonePlayingInitializationAudio = false;
-bool isBleInitializationStarted = false;
 ServoController servoController;
 bluetooth_controller bluetoothController;
 AudioPlayer *audioPlayer = nullptr;
@@ -73,16 +82,96 @@ const int SERVO_PIN = 15; // Servo control pin
 esp_adc_cal_characteristics_t adc_chars;
 
 SkitSelector *skitSelector = nullptr;
+SkitCatalog skitCatalog; // Skit IDs for the start commands; both skulls must build the same one
 
 // Declare these variables outside the loop
 static unsigned long lastTimeAudioPlayed = 0;
 static const unsigned long AUDIO_COOLDOWN_TIME = 10000; // 10 seconds cooldown after audio ends
 
+// Synchronized skit start: the Primary schedules each skit this far ahead, so the command reaches the Secondary
+// and both skulls buffer the audio before the first sample is due
+const unsigned long SKIT_START_LEAD_MS = 500;
+const unsigned long SKIT_START_REPORT_TIMEOUT = 5000; // Give up on logging the start skew this long after the start
+
+// The skit this skull scheduled with playAt(), until its start has been reported (Secondary) or logged (Primary)
+struct SkitStartSync
+{
+  uint32_t trackId = AudioPlayer::NO_TRACK;
+  unsigned long startAtMillis = 0;    // Local start time
+  int64_t startMicros = 0;             // Local start time the first sample was scheduled for
+  unsigned long skitStartAtMillis = 0; // Start time on the shared clock
+  uint16_t sequence = 0;               // Secondary only: sequence number of the start command, for the started report
+  bool isClockSynchronized = false;    // Started on the shared clock (otherwise on the estimated link delay)
+  int64_t linkDelayMicros = 0;         // Primary only: estimated one-way BLE delay the start was shifted by, if not synchronized
+  bool hasLocalLateness = false;
+  int32_t localLateMicros = 0;
+};
+SkitStartSync skitStartSync;
+uint32_t skitCommandRequestId = bluetooth_controller::NO_REQUEST; // Primary only: skit start command awaiting the Secondary's reply
+volatile bool secondaryStartReported = false; // Primary only: set from the BLE task
+volatile int32_t secondaryLateMicros = 0;
+volatile int32_t secondaryClockUncertaintyMicros = -1; // Of secondaryLateMicros: -1 if it isn't on the shared clock
+
+// Playback drift correction: while a skit started on the shared clock plays, the Primary reports its playback position
+// this often and the Secondary inserts or drops frames to stay aligned with it
+const unsigned long PLAYBACK_POSITION_REPORT_INTERVAL = 1000;
+
+// The skit whose playback the skulls keep aligned, until it ends
+struct PlaybackDriftSync
+{
+  uint32_t trackId = AudioPlayer::NO_TRACK;
+  unsigned long skitStartAtMillis = 0; // Start time on the shared clock: identifies the skit to both skulls
+  unsigned long startAtMillis = 0;     // Local start time
+  bool hasStarted = false;
+  unsigned long lastReportMillis = 0;     // Primary only
+  int64_t lastReportedPositionMicros = 0; // Primary only: atMicros of the last position reported
+};
+PlaybackDriftSync playbackDriftSync;
+PlaybackDriftCorrector playbackDriftCorrector(AudioPlayer::AUDIO_SAMPLE_RATE); // Secondary only
+
+// Tasks. The SD card audio producer (AudioPlayer), the animation and band energy analysis (SkullAudioAnimator) and the
+// servo motion (ServoController) run on core 1, away from the Bluetooth stack on core 0. The A2DP callback only copies
+// frames out of the audio buffer and queues them for the animation task. The BLE control task runs bluetooth_controller
+// on core 0 beside the stack, so its blocking scans and connects only hold up BLE. The skit task runs the show on core 1
+// below the audio producer, and loop() is left with the housekeeping.
+const uint32_t BLE_TASK_STACK_SIZE = 8192;
+const UBaseType_t BLE_TASK_PRIORITY = 2;
+const BaseType_t BLE_TASK_CORE = 0;
+const unsigned long BLE_TASK_INTERVAL_MS = 10; // update() paces the clock sync and times out commands
+const uint32_t SKIT_TASK_STACK_SIZE = 8192;
+const UBaseType_t SKIT_TASK_PRIORITY = 2;
+const BaseType_t SKIT_TASK_CORE = 1;
+const unsigned long SKIT_TASK_INTERVAL_MS = 10; // Longest the skit task waits for an event before checking on the skit
+const unsigned long HOUSEKEEPING_INTERVAL_MS = 100;
+
+// Events for the skit task, from the GPIO interrupt and the Bluetooth tasks
+struct SkitEvent
+{
+  enum Type : uint8_t
+  {
+    MATTER_TRIGGER, // The Matter controller triggered a skit
+    COMMAND_DONE,   // Primary: the Secondary answered the skit start command, or didn't in time
+    START_COMMAND,  // Secondary: the Primary's skit start command, accepted
+    PLAYBACK_ENDED, // A skit's audio finished playing
+  } type;
+  bool isAccepted;          // COMMAND_DONE
+  SkitStartCommand command; // COMMAND_DONE and START_COMMAND
+  int64_t micros;           // COMMAND_DONE: when the command was sent. START_COMMAND: when it arrived.
+  size_t skitIndex;         // PLAYBACK_ENDED: the skit in sdCardContent.skits
+};
+const UBaseType_t SKIT_EVENT_QUEUE_LENGTH = 8;
+QueueHandle_t skitEventQueue = nullptr;
+
+// Events the tasks wait on
+EventGroupHandle_t systemEvents = nullptr;
+const EventBits_t INITIALIZATION_AUDIO_DONE = 1 << 0; // BLE starts once the skull has announced itself
+
 // Add these variables near the top of the file, with other global variables
 unsigned long lastJawMovementTime = 0;
 const unsigned long BREATHING_INTERVAL = 7000; // 7 seconds in milliseconds
 const int BREATHING_JAW_ANGLE = 30;            // 30 degrees opening
 const int BREATHING_MOVEMENT_DURATION = 2000;  // 2 seconds for the movement
+const int BREATHING_PAUSE_DURATION = 100;      // Pause at the open position
 
 // Custom crash handler to provide debug information and restart the device
 void custom_crash_handler()
@@ -110,9 +199,25 @@ void custom_crash_handler()
   esp_restart();
 }
 
-// GPIO interrupt handler for Matter controller trigger
+// GPIO interrupt handler for Matter controller trigger: wake the skit task
 void IRAM_ATTR matterTriggerInterrupt() {
-  matterTriggerDetected = true;
+  SkitEvent event = {};
+  event.type = SkitEvent::MATTER_TRIGGER;
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  xQueueSendFromISR(skitEventQueue, &event, &higherPriorityTaskWoken); // Dropped if the queue is full
+  if (higherPriorityTaskWoken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+// Queue an event for the skit task
+void postSkitEvent(const SkitEvent &event)
+{
+  if (xQueueSend(skitEventQueue, &event, 0) != pdTRUE)
+  {
+    Serial.printf("MAIN: Skit event queue full; dropped event %d\n", static_cast<int>(event.type));
+  }
 }
 
 // Secondary (server) only: Handle connection state changes
@@ -129,16 +234,166 @@ void onConnectionStateChange(ConnectionState newState)
   }
 }
 
-// Secondary (server) only: Handle characteristic changes
+// Primary (client) only: the Secondary accepted the skit start command, so schedule the skit here too
+void startAcceptedSkit(const SkitStartCommand &command, int64_t sentMicros)
+{
+  const std::string *filePath = skitCatalog.audioFileOf(command.skitId);
+  if (filePath == nullptr)
+  {
+    return; // Sent from the catalog, so it's there
+  }
+
+  skitStartSync = SkitStartSync();
+  skitStartSync.isClockSynchronized = (command.flags & SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0;
+  skitStartSync.skitStartAtMillis = command.startAtMillis;
+  int64_t startMicros = bluetoothController.localMicrosAtSyncedMillis(command.startAtMillis);
+  if (!skitStartSync.isClockSynchronized)
+  {
+    // The Secondary starts one BLE delay late on our clock (see startCommandedSkit()).
+    // Estimate that delay as half the command's round trip and start that much later too.
+    skitStartSync.linkDelayMicros = (bluetoothController.getLastIndicationMicros() - sentMicros) / 2;
+    startMicros += skitStartSync.linkDelayMicros;
+  }
+  Serial.printf("MAIN: Secondary accepted skit %s, starting in %ld ms\n", filePath->c_str(),
+                static_cast<long>((startMicros - esp_timer_get_time()) / 1000));
+  skitStartSync.startAtMillis = static_cast<unsigned long>(startMicros / 1000);
+  skitStartSync.startMicros = startMicros;
+  skitStartSync.trackId = audioPlayer->playAt(filePath->c_str(), startMicros);
+  if (skitStartSync.isClockSynchronized)
+  {
+    beginPlaybackDriftSync(skitStartSync.trackId, command.startAtMillis, skitStartSync.startAtMillis);
+  }
+  lastTimeAudioPlayed = millis(); // Update the time immediately when we start playing
+}
+
+// Keep the playback of a skit started on the shared clock aligned between the skulls
+void beginPlaybackDriftSync(uint32_t trackId, unsigned long skitStartAtMillis, unsigned long startAtMillis)
+{
+  playbackDriftSync = PlaybackDriftSync();
+  playbackDriftSync.skitStartAtMillis = skitStartAtMillis;
+  playbackDriftSync.startAtMillis = startAtMillis;
+  playbackDriftSync.trackId = trackId;
+}
+
+// How far this skull's playback of the skit is ahead of the skit's schedule on the shared clock
+int64_t playbackLeadMicros(const AudioPlayer::PlaybackPosition &position)
+{
+  return position.positionMicros - bluetoothController.syncedMicrosSince(playbackDriftSync.skitStartAtMillis, position.atMicros);
+}
+
+// While the skit plays, the Primary reports how far its playback is ahead of schedule and the Secondary corrects
+// the difference from its own
+void updatePlaybackDriftSync(unsigned long currentMillis)
+{
+  if (playbackDriftSync.trackId == AudioPlayer::NO_TRACK)
+  {
+    return;
+  }
+
+  uint32_t playingTrackId = audioPlayer->getCurrentlyPlayingTrackId();
+  if (!playbackDriftSync.hasStarted)
+  {
+    if (playingTrackId == playbackDriftSync.trackId)
+    {
+      playbackDriftSync.hasStarted = true;
+      playbackDriftCorrector.reset();
+    }
+    else if (static_cast<long>(currentMillis - playbackDriftSync.startAtMillis) > static_cast<long>(SKIT_START_REPORT_TIMEOUT))
+    {
+      playbackDriftSync.trackId = AudioPlayer::NO_TRACK;
+    }
+    return;
+  }
+
+  if (playingTrackId != playbackDriftSync.trackId)
+  {
+    if (!isPrimary && playbackDriftCorrector.measurementCount() > 0)
+    {
+      AudioPlayer::DriftCorrectionStats correctionStats = audioPlayer->getDriftCorrectionStats();
+      Serial.printf("MAIN: Skit playback drift: %.1f +/- %.1f ppm, corrected %.1f ppm, final gap %ld us (%u frames inserted, %u dropped since start)\n",
+                    playbackDriftCorrector.driftPpm(), playbackDriftCorrector.driftUncertaintyPpm(), playbackDriftCorrector.correctionPpm(),
+                    static_cast<long>(playbackDriftCorrector.gapMicros()), correctionStats.insertedFrames, correctionStats.droppedFrames);
+    }
+    playbackDriftSync.trackId = AudioPlayer::NO_TRACK;
+    return;
+  }
+
+  AudioPlayer::PlaybackPosition position;
+  if (isPrimary)
+  {
+    if (currentMillis - playbackDriftSync.lastReportMillis >= PLAYBACK_POSITION_REPORT_INTERVAL &&
+        audioPlayer->getPlaybackPosition(position) && position.trackId == playbackDriftSync.trackId &&
+        position.atMicros != playbackDriftSync.lastReportedPositionMicros)
+    {
+      bluetoothController.sendPlaybackPosition(playbackDriftSync.skitStartAtMillis, static_cast<int32_t>(playbackLeadMicros(position)));
+      playbackDriftSync.lastReportMillis = currentMillis;
+      playbackDriftSync.lastReportedPositionMicros = position.atMicros;
+    }
+    return;
+  }
+
+  unsigned long reportSkitStartMillis;
+  int32_t primaryLeadMicros;
+  if (bluetoothController.takePeerPlaybackPosition(reportSkitStartMillis, primaryLeadMicros) &&
+      reportSkitStartMillis == playbackDriftSync.skitStartAtMillis && bluetoothController.isClockSynchronized() &&
+      audioPlayer->getPlaybackPosition(position) && position.trackId == playbackDriftSync.trackId)
+  {
+    int64_t gapMicros = playbackLeadMicros(position) - primaryLeadMicros;
+    int64_t elapsedMicros = bluetoothController.syncedMicrosSince(playbackDriftSync.skitStartAtMillis, position.atMicros);
+    audioPlayer->setDriftCorrection(playbackDriftCorrector.update(elapsedMicros, gapMicros, position.correctionFrames));
+  }
+}
+
+// Secondary (server) only: Handle characteristic changes. Runs on the BLE stack's task, so the skit task starts the skit.
 void onCharacteristicChange(const std::string &newValue)
 {
-  Serial.printf("Characteristic changed. New value: %s\n", newValue.c_str());
+  SkitEvent event = {};
+  event.type = SkitEvent::START_COMMAND;
+  event.micros = bluetoothController.getLastWriteReceivedMicros();
+  if (SkitStartProtocol::decodeCommand(newValue, event.command)) // Checked by onCharacteristicChangeRequest()
+  {
+    postSkitEvent(event);
+  }
+}
+
+// Secondary (server) only: start the skit the Primary commanded; receivedMicros is when the command arrived
+void startCommandedSkit(const SkitStartCommand &command, int64_t receivedMicros)
+{
+  const std::string *audioFile = skitCatalog.audioFileOf(command.skitId);
+  if (audioFile == nullptr)
+  {
+    return; // Checked by onCharacteristicChangeRequest()
+  }
 
-  // Attempt to play the audio file specified by the new characteristic value
+  // Attempt to play the audio file at the Primary's start time
   if (bluetoothController.isA2dpConnected() && !audioPlayer->isAudioPlaying())
   {
-    audioPlayer->playNext(newValue.c_str());
-    Serial.printf("Attempting to play audio file: %s\n", newValue.c_str());
+    skitStartSync = SkitStartSync();
+    skitStartSync.sequence = command.sequence;
+    skitStartSync.skitStartAtMillis = command.startAtMillis;
+    // Follow the Primary's choice: it shifts its own start by the link delay unless it sent the command on the shared clock
+    skitStartSync.isClockSynchronized = (command.flags & SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0;
+    int64_t startMicros;
+    if (skitStartSync.isClockSynchronized)
+    {
+      startMicros = bluetoothController.localMicrosAtSyncedMillis(command.startAtMillis);
+    }
+    else
+    {
+      // No shared clock yet: the command left the Primary at sentAtMillis on its clock and arrived at
+      // receivedMicros on ours. That maps the start time onto our clock, one BLE delay late;
+      // the Primary shifts its own start to match.
+      startMicros = receivedMicros +
+                    static_cast<int64_t>(static_cast<long>(command.startAtMillis - command.sentAtMillis)) * 1000;
+    }
+    skitStartSync.startAtMillis = static_cast<unsigned long>(startMicros / 1000);
+    skitStartSync.startMicros = startMicros;
+    skitStartSync.trackId = audioPlayer->playAt(audioFile->c_str(), startMicros);
+    if (skitStartSync.isClockSynchronized)
+    {
+      beginPlaybackDriftSync(skitStartSync.trackId, command.startAtMillis, skitStartSync.startAtMillis);
+    }
+    Serial.printf("Attempting to play skit %u: %s\n", command.skitId, audioFile->c_str());
   }
   else
   {
@@ -146,6 +401,98 @@ void onCharacteristicChange(const std::string &newValue)
   }
 }
 
+// Primary (client) only: Handle indications from the Secondary
+void onIndication(const std::string &value)
+{
+  int32_t lateMicros;
+  int32_t clockUncertaintyMicros;
+  if (SkitStartProtocol::decodeStartedReport(value, lateMicros, clockUncertaintyMicros))
+  {
+    secondaryLateMicros = lateMicros;
+    secondaryClockUncertaintyMicros = clockUncertaintyMicros;
+    secondaryStartReported = true;
+  }
+}
+
+// How late this skull's first sample of the scheduled skit played on the shared clock, from its local lateness
+int32_t sharedStartLateMicros()
+{
+  int64_t firstSampleMicros = skitStartSync.startMicros + skitStartSync.localLateMicros;
+  int64_t lateMicros = bluetoothController.syncedMicrosSince(skitStartSync.skitStartAtMillis, firstSampleMicros);
+  return static_cast<int32_t>(std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, lateMicros)));
+}
+
+// Once the scheduled skit has started, the Secondary reports how late its first sample was and the Primary logs
+// the start skew between the two skulls
+void updateSkitStartSync(unsigned long currentMillis)
+{
+  if (skitStartSync.trackId == AudioPlayer::NO_TRACK)
+  {
+    return;
+  }
+
+  if (!skitStartSync.hasLocalLateness && audioPlayer->getStartLateness(skitStartSync.trackId, skitStartSync.localLateMicros))
+  {
+    skitStartSync.hasLocalLateness = true;
+    Serial.printf("MAIN: Skit started %ld us after its scheduled time\n", static_cast<long>(skitStartSync.localLateMicros));
+    if (!isPrimary)
+    {
+      // On the shared clock, measured through the clock sync as it is now rather than when the start was mapped
+      int32_t lateMicros = skitStartSync.localLateMicros;
+      int32_t clockUncertaintyMicros = skitStartSync.isClockSynchronized ? bluetoothController.getClockUncertaintyMicros() : -1;
+      if (clockUncertaintyMicros >= 0)
+      {
+        lateMicros = sharedStartLateMicros();
+      }
+      bluetoothController.indicateCharacteristicValue(SkitStartProtocol::encodeStartedReport(skitStartSync.sequence, lateMicros, clockUncertaintyMicros));
+      skitStartSync.trackId = AudioPlayer::NO_TRACK;
+      return;
+    }
+  }
+
+  if (isPrimary && skitStartSync.hasLocalLateness && secondaryStartReported)
+  {
+    long secondaryLate = secondaryLateMicros;
+    long clockUncertainty = secondaryClockUncertaintyMicros;
+    if (clockUncertainty >= 0)
+    {
+      // Both first samples on the shared clock (ours). What the Secondary's clock sync got wrong is unseen, but
+      // bounded by its uncertainty: a skew outside that is a start that went wrong, not clock error.
+      long primaryLate = sharedStartLateMicros();
+      long skewMicros = secondaryLate - primaryLate;
+      Serial.printf("MAIN: Skit start skew: %ld us +/- %ld us on the shared clock (Secondary late %ld us, Primary late %ld us)\n",
+                    skewMicros, clockUncertainty, secondaryLate, primaryLate);
+      if (labs(skewMicros) > clockUncertainty)
+      {
+        Serial.printf("MAIN: WARNING: Skit start skew %ld us is outside the clock uncertainty of %ld us\n", skewMicros, clockUncertainty);
+      }
+    }
+    else
+    {
+      // Each skull's lateness against its own schedule, which the link delay estimate (or a lost clock sync) put out
+      // by an unknown amount
+      long skewMicros = secondaryLate - skitStartSync.localLateMicros;
+      Serial.printf("MAIN: Skit start skew: %ld us (Secondary late %ld us, Primary late %ld us", skewMicros, secondaryLate,
+                    static_cast<long>(skitStartSync.localLateMicros));
+      if (skitStartSync.isClockSynchronized)
+      {
+        Serial.printf(", Secondary lost the clock sync)\n");
+      }
+      else
+      {
+        Serial.printf(", clocks not synchronized, link delay estimate %ld us)\n", static_cast<long>(skitStartSync.linkDelayMicros));
+      }
+    }
+    skitStartSync.trackId = AudioPlayer::NO_TRACK;
+  }
+  else if (static_cast<long>(currentMillis - skitStartSync.startAtMillis) > static_cast<long>(SKIT_START_REPORT_TIMEOUT))
+  {
+    Serial.printf("MAIN: No skit start %s within %lu ms\n", skitStartSync.hasLocalLateness ? "report from the Secondary" : "timing",
+                  SKIT_START_REPORT_TIMEOUT);
+    skitStartSync.trackId = AudioPlayer::NO_TRACK;
+  }
+}
+
 // This is called whenever SkullAudioAnimator determines this skull is speaking or not speaking.
 // If it's not speaking we want to mute the audio. That way, although both skulls are playing the same audio
 // in sync, they'll only be speaking their individual parts.
@@ -157,39 +504,277 @@ void onSpeakingStateChange(bool isSpeaking)
   }
 }
 
-bool onCharacteristicChangeRequest(const std::string &value)
+// Secondary (server) only: accept or reject a skit start command; reply is what the Primary gets back
+bool onCharacteristicChangeRequest(const std::string &value, std::string &reply)
 {
-  // Check if we can play the audio file
-  if (audioPlayer->isAudioPlaying())
+  SkitStartCommand command;
+  if (!SkitStartProtocol::decodeCommand(value, command))
   {
-    Serial.println("Cannot play new audio: Already playing");
+    Serial.printf("Cannot play new audio: Not a skit start command: %s\n", SkitStartProtocol::describe(value).c_str());
+    SkitMessageHeader header;
+    reply = SkitStartProtocol::encodeReject(SkitStartProtocol::decodeHeader(value, header) ? header.sequence : 0,
+                                            SkitRejectReason::BAD_MESSAGE, skitCatalog.hash());
+    return false;
+  }
+
+  // A skit ID only means the same skit on both skulls if their catalogs match
+  if (command.catalogHash != skitCatalog.hash())
+  {
+    Serial.printf("Cannot play new audio: Skit catalog %08lx differs from the Primary's %08lx\n",
+                  static_cast<unsigned long>(skitCatalog.hash()), static_cast<unsigned long>(command.catalogHash));
+    reply = SkitStartProtocol::encodeReject(command.sequence, SkitRejectReason::CATALOG_MISMATCH, skitCatalog.hash());
     return false;
   }
 
-  if (!sdCardManager->fileExists(value.c_str()))
+  const std::string *audioFile = skitCatalog.audioFileOf(command.skitId);
+  if (audioFile == nullptr || !sdCardManager->fileExists(audioFile->c_str()))
   {
-    Serial.printf("Cannot play new audio: File not found: %s\n", value.c_str());
+    Serial.printf("Cannot play new audio: Skit %u not found: %s\n", command.skitId, audioFile != nullptr ? audioFile->c_str() : "no such ID");
+    reply = SkitStartProtocol::encodeReject(command.sequence, SkitRejectReason::UNKNOWN_SKIT, skitCatalog.hash());
     return false;
   }
 
-  // Add any other necessary checks here
-  // For example, you might want to check if the file is a valid audio format,
-  // or if there's enough free memory to play the file, etc.
+  // Check if we can play the audio file
+  if (audioPlayer->isAudioPlaying())
+  {
+    Serial.println("Cannot play new audio: Already playing");
+    reply = SkitStartProtocol::encodeReject(command.sequence, SkitRejectReason::BUSY, skitCatalog.hash());
+    return false;
+  }
 
+  reply = SkitStartProtocol::encodeAccept(command.sequence);
   return true;
 }
 
-// Update the breathing jaw movement function
+// Number the skits for the start commands (tools/sd_card_checker computes the same catalog hash from a copy of the card)
+void buildSkitCatalog()
+{
+  skitCatalog.clear();
+  for (const ParsedSkit &skit : sdCardContent.skits)
+  {
+    std::unique_ptr<PlatformFile> audioFile = sdCardManager->openFile(skit.audioFile.c_str());
+    uint32_t audioFileSize = audioFile ? audioFile->size() : 0;
+
+    skitCatalog.add(skit.audioFile.c_str(), SkitCatalog::fingerprint(audioFileSize, skit.lines));
+  }
+  skitCatalog.finalize();
+  Serial.printf("MAIN: Skit catalog: %u skits, hash %08lx\n", static_cast<unsigned>(skitCatalog.size()),
+                static_cast<unsigned long>(skitCatalog.hash()));
+}
+
+// Blinks play in the background; retry loops wait for them so each error code's blinks can be counted
+void waitForBlinks()
+{
+  while (lightController.isBlinking())
+  {
+    delay(10);
+  }
+}
+
+// Update the breathing jaw movement function.
+// Queues the moves and returns right away; the servo's motion task runs them, and audio preempts them.
 void breathingJawMovement()
 {
-  if (!audioPlayer->isAudioPlaying())
+  if (!audioPlayer->isAudioPlaying() && !servoController.isMoving())
   {
     servoController.smoothMove(BREATHING_JAW_ANGLE, BREATHING_MOVEMENT_DURATION);
-    delay(100); // Short pause at the open position
+    servoController.holdPosition(BREATHING_PAUSE_DURATION); // Short pause at the open position
     servoController.smoothMove(0, BREATHING_MOVEMENT_DURATION);
   }
 }
 
+// Primary (client) only: the Matter controller has been triggered. If connected to the bluetooth speaker and the
+// other skull, play a random skit.
+void onMatterTrigger(unsigned long currentMillis)
+{
+  if (!isPrimary)
+  {
+    return;
+  }
+
+  Serial.printf("MAIN: Matter trigger detected on pin %d\n", MATTER_TRIGGER_PIN);
+  if (!bluetoothController.clientIsConnectedToServer() ||
+      !bluetoothController.isA2dpConnected() ||
+      audioPlayer->isAudioPlaying() ||
+      skitCommandRequestId != bluetooth_controller::NO_REQUEST ||
+      millis() - lastTimeAudioPlayed <= AUDIO_COOLDOWN_TIME)
+  {
+    return;
+  }
+
+  Serial.printf("MAIN: Matter trigger detected (currentMillis: %lu, lastTimeAudioPlayed: %lu). Playing random skit...\n",
+                currentMillis, lastTimeAudioPlayed);
+  lightController.blinkEyes(1);
+  String filePath = skitSelector->selectNextSkit(millis(), esp_random()).c_str();
+
+  // Ask the Secondary to start the skit a little in the future; both skulls buffer it meanwhile and
+  // start together
+  SkitStartCommand command = {};
+  command.skitId = skitCatalog.idOf(filePath.c_str());
+  command.catalogHash = skitCatalog.hash();
+  if (bluetoothController.isClockSynchronized())
+  {
+    command.flags |= SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED;
+  }
+  int64_t sentMicros = esp_timer_get_time();
+  command.sentAtMillis = bluetoothController.syncedMillis();
+  command.startAtMillis = command.sentAtMillis + SKIT_START_LEAD_MS;
+  secondaryStartReported = false;
+
+  if (command.skitId == SkitCatalog::NO_SKIT)
+  {
+    Serial.printf("MAIN: Skit isn't in the skit catalog: %s\n", filePath.c_str());
+    return;
+  }
+
+  // The Secondary's reply comes back through update() on the BLE control task, which hands it to the skit task;
+  // the skit starts once the Secondary has accepted
+  skitCommandRequestId = bluetoothController.sendCommand(
+      SkitStartProtocol::encodeCommand(command),
+      [filePath, command, sentMicros](uint32_t requestId, bluetooth_controller::CommandResult result, const std::string &reply)
+      {
+        SkitRejectReason reason;
+        uint32_t secondaryCatalogHash;
+        if (result == bluetooth_controller::CommandResult::REJECTED &&
+            SkitStartProtocol::decodeReject(reply, reason, secondaryCatalogHash))
+        {
+          Serial.printf("MAIN: Secondary rejected skit %s: %s", filePath.c_str(), SkitStartProtocol::rejectReasonToString(reason));
+          if (reason == SkitRejectReason::CATALOG_MISMATCH)
+          {
+            Serial.printf(" (Secondary's catalog %08lx, ours %08lx)", static_cast<unsigned long>(secondaryCatalogHash),
+                          static_cast<unsigned long>(command.catalogHash));
+          }
+          Serial.printf("\n");
+        }
+        else if (result != bluetooth_controller::CommandResult::ACCEPTED)
+        {
+          Serial.printf("MAIN: Secondary didn't accept skit %s (%s)\n", filePath.c_str(),
+                        bluetooth_controller::commandResultToString(result));
+        }
+
+        // The skit task owns the skit state, so it starts the skit
+        SkitEvent event = {};
+        event.type = SkitEvent::COMMAND_DONE;
+        event.isAccepted = result == bluetooth_controller::CommandResult::ACCEPTED;
+        event.command = command;
+        event.micros = sentMicros;
+        postSkitEvent(event);
+      });
+  if (skitCommandRequestId == bluetooth_controller::NO_REQUEST)
+  {
+    Serial.printf("MAIN: Failed to send skit start command for: %s\n", filePath.c_str());
+  }
+}
+
+// Act on an event from the GPIO interrupt or the Bluetooth tasks
+void handleSkitEvent(const SkitEvent &event, unsigned long currentMillis)
+{
+  switch (event.type)
+  {
+  case SkitEvent::MATTER_TRIGGER:
+    onMatterTrigger(currentMillis);
+    break;
+
+  case SkitEvent::COMMAND_DONE:
+    skitCommandRequestId = bluetooth_controller::NO_REQUEST;
+    if (event.isAccepted)
+    {
+      startAcceptedSkit(event.command, event.micros);
+    }
+    break;
+
+  case SkitEvent::START_COMMAND:
+    startCommandedSkit(event.command, event.micros);
+    break;
+
+  case SkitEvent::PLAYBACK_ENDED:
+    skitSelector->updateSkitPlayCount(sdCardContent.skits[event.skitIndex].audioFile.c_str(), currentMillis);
+    break;
+  }
+}
+
+// Skit task: triggers, skit start and playback sync, and the idle animations. Owns the skit state, so the other
+// tasks hand it their events through skitEventQueue.
+void skitTask(void *param)
+{
+  unsigned long lastScanLogMillis = 0;
+  while (true)
+  {
+    SkitEvent event;
+    bool hasEvent = xQueueReceive(skitEventQueue, &event, pdMS_TO_TICKS(SKIT_TASK_INTERVAL_MS)) == pdTRUE;
+    unsigned long currentMillis = millis();
+
+    bool isAudioPlaying = audioPlayer->isAudioPlaying();
+    if (isAudioPlaying)
+    {
+      lastTimeAudioPlayed = currentMillis; // Set the last time audio played
+    }
+
+    if (hasEvent)
+    {
+      handleSkitEvent(event, currentMillis);
+    }
+
+    // Priamry Only: Play "Marco!" ever 5 seconds when scanning for the BLE server (Secondary skull)
+    if (isPrimary && bluetoothController.getConnectionState() == ConnectionState::SCANNING)
+    {
+      if (currentMillis - lastScanLogMillis >= 5000)
+      {
+        if (bluetoothController.isA2dpConnected() && !audioPlayer->isAudioPlaying())
+        {
+          audioPlayer->playNext("/audio/Marco.wav");
+        }
+        lastScanLogMillis = currentMillis;
+      }
+    }
+    else
+    {
+      // Reset the timer if we're not scanning
+      lastScanLogMillis = currentMillis;
+    }
+
+    // Report (Secondary) or log (Primary) how closely the skulls started the last skit
+    updateSkitStartSync(currentMillis);
+
+    // Keep the skit's playback aligned between the skulls as it plays
+    updatePlaybackDriftSync(currentMillis);
+
+    // Check if it's time to move the jaw for breathing
+    if (currentMillis - lastJawMovementTime >= BREATHING_INTERVAL && !isAudioPlaying)
+    {
+      breathingJawMovement();
+      lastJawMovementTime = currentMillis;
+    }
+  }
+}
+
+// BLE control task: brings up BLE once the initialization audio has played, then keeps the connection, the clock
+// sync and the skit commands going
+void bleTask(void *param)
+{
+  xEventGroupWaitBits(systemEvents, INITIALIZATION_AUDIO_DONE, pdFALSE, pdTRUE, portMAX_DELAY);
+  bluetoothController.initializeBLE(isPrimary);
+
+  while (true)
+  {
+    bluetoothController.update();
+    vTaskDelay(pdMS_TO_TICKS(BLE_TASK_INTERVAL_MS));
+  }
+}
+
+// Start the skit and BLE control tasks, once everything they use is set up
+void startTasks()
+{
+  if (xTaskCreatePinnedToCore(skitTask, "Skit", SKIT_TASK_STACK_SIZE, nullptr, SKIT_TASK_PRIORITY, nullptr, SKIT_TASK_CORE) != pdPASS)
+  {
+    Serial.println("MAIN: Failed to create skit task");
+  }
+  if (xTaskCreatePinnedToCore(bleTask, "BleControl", BLE_TASK_STACK_SIZE, nullptr, BLE_TASK_PRIORITY, nullptr, BLE_TASK_CORE) != pdPASS)
+  {
+    Serial.println("MAIN: Failed to create BLE control task");
+  }
+}
+
 // Main setup function
 void setup()
 {
@@ -200,17 +785,22 @@ void setup()
 
   Serial.println("\n\n\n\n\n\nStarting setup 20250723 ... ");
 
+  // Before anything that can post to them: the GPIO interrupt and the playback callbacks
+  skitEventQueue = xQueueCreate(SKIT_EVENT_QUEUE_LENGTH, sizeof(SkitEvent));
+  systemEvents = xEventGroupCreate();
+
   // Initialize light controller first for blinking
   lightController.begin();
 
   // Initialize SD Card Manager
-  sdCardManager = new SDCardManager();
+  sdCardManager = new SDCardManager(sdFileSystem);
 
   // Attempt to initialize the SD card until successful
   while (!sdCardManager->begin())
   {
     Serial.println("MAIN: SD Card: Mount Failed! Retrying...");
     lightController.blinkEyes(3); // 3 blinks for SD card failure
+    waitForBlinks();
     delay(500);
   }
 
@@ -220,6 +810,7 @@ void setup()
   {
     Serial.println("MAIN: No skits found on SD card.");
   }
+  buildSkitCatalog();
 
   // Now that SD card is initialized, load configuration
   ConfigManager &config = ConfigManager::getInstance();
@@ -227,11 +818,12 @@ void setup()
 
   while (!configLoaded)
   {
-    configLoaded = config.loadConfig();
+    configLoaded = config.loadConfig(sdFileSystem);
     if (!configLoaded)
     {
       Serial.println("MAIN: Failed to load configuration. Retrying...");
       lightController.blinkEyes(5); // 5 blinks for config file failure
+      waitForBlinks();
       delay(500);
     }
   }
@@ -244,10 +836,16 @@ void setup()
   int servoMaxDegrees = config.getServoMaxDegrees();
 
   // Initialize SkitSelector with parsed skits
-  skitSelector = new SkitSelector(sdCardContent.skits);
+  std::vector<std::string> skitAudioFiles;
+  for (const ParsedSkit &skit : sdCardContent.skits)
+  {
+    skitAudioFiles.push_back(skit.audioFile.c_str());
+  }
+  skitSelector = new SkitSelector(skitAudioFiles);
 
   // Initialize servo
   servoController.initialize(SERVO_PIN, servoMinDegrees, servoMaxDegrees);
+  servoController.setMotionLimits(config.getJawMaxVelocity(), config.getJawMaxAcceleration());
 
   // Determine role based on settings.txt
   if (role.equals("primary"))
@@ -272,7 +870,9 @@ void setup()
   // Initialize AudioPlayer
   esp_coex_preference_set(ESP_COEX_PREFER_WIFI);
 
-  audioPlayer = new AudioPlayer(*sdCardManager);
+  audioPlayer = new AudioPlayer(*sdCardManager, esp32Clock, freeRtosTasks, config.getAudioBufferSize(), config.getAudioBufferUsePsram());
+  audioPlayer->setAnalysisLookahead(config.getJawLookaheadMs()); // Sync the jaw to the speaker, not to the A2DP callback
+  audioPlayer->begin(); // Start the SD card producer task before A2DP starts pulling frames
 
   // Initialize Bluetooth A2DP only
   bluetoothController.initializeA2DP(bluetoothSpeakerName, [](Frame *frame, int32_t frame_count)
@@ -302,6 +902,9 @@ void setup()
   // provideAudioFrames method to get more audio data when the bluetooth speaker needs it.
   bluetoothController.set_volume(speakerVolume);
 
+  // Primary: the Secondary's BLE address, to connect to it without scanning until it has connected once and cached it
+  bluetoothController.setPeerAddressHint(config.getSecondaryMacAddress());
+
   // Set the initial state of the eyes to dim
   lightController.setEyeBrightness(LightController::BRIGHTNESS_DIM);
 
@@ -310,31 +913,48 @@ void setup()
   adc1_config_channel_atten(ADC1_CHANNEL_0, ADC_ATTEN_DB_11);
   esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &adc_chars);
 
-  audioPlayer->setPlaybackStartCallback([](const String &filePath)
-                                        { Serial.printf("MAIN: Started playing audio: %s\n", filePath.c_str()); });
-
-  audioPlayer->setPlaybackEndCallback([](const String &filePath)
+  audioPlayer->setPlaybackStartCallback([](uint32_t trackId, const String &filePath)
+                                        {
+                                          Serial.print("MAIN: Started playing audio: "); // Not printf(): a path this long would go on the heap
+                                          Serial.println(filePath);
+                                          if (skullAudioAnimator != nullptr)
+                                          {
+                                            skullAudioAnimator->queuePlaybackStarted(trackId, filePath);
+                                          } });
+
+  audioPlayer->setPlaybackEndCallback([](uint32_t trackId, const String &filePath)
                                       { 
                                         lastTimeAudioPlayed = millis(); // Set the last time audio played
-                                        Serial.printf("MAIN: Finished playing audio: %s at time %lu\n", filePath.c_str(), lastTimeAudioPlayed);
-                                        if (filePath.endsWith("/audio/Initialized - Primary.wav") || filePath.endsWith("/audio/Initialized - Secondary.wav"))
+                                        Serial.print("MAIN: Finished playing audio: ");
+                                        Serial.print(filePath);
+                                        Serial.printf(" at time %lu\n", lastTimeAudioPlayed);
+                                        if (filePath == sdCardContent.primaryInitAudio || filePath == sdCardContent.secondaryInitAudio) // No String temporaries
                                         {
-                                          isDonePlayingInitializationAudio = true;
+                                          xEventGroupSetBits(systemEvents, INITIALIZATION_AUDIO_DONE);
                                         } 
                                         if (skullAudioAnimator != nullptr)
                                         {
-                                          skullAudioAnimator->setPlaybackEnded(filePath);
+                                          skullAudioAnimator->queuePlaybackEnded(trackId);
                                         }
-                                        if (skitSelector != nullptr) {
-                                            skitSelector->updateSkitPlayCount(filePath);
+                                        // The skit task owns the skit selector, so it counts the play
+                                        for (size_t i = 0; i < sdCardContent.skits.size(); i++)
+                                        {
+                                          if (sdCardContent.skits[i].audioFile == filePath)
+                                          {
+                                            SkitEvent event = {};
+                                            event.type = SkitEvent::PLAYBACK_ENDED;
+                                            event.skitIndex = i;
+                                            postSkitEvent(event);
+                                            break;
+                                          }
                                         } });
 
-  audioPlayer->setAudioFramesProvidedCallback([](const String &filePath, const Frame *frames, int32_t frameCount)
+  audioPlayer->setAudioFramesProvidedCallback([](uint32_t trackId, const Frame *frames, int32_t frameCount)
                                               {
                                                 if (skullAudioAnimator != nullptr)
                                                 {
                                                     unsigned long playbackTime = audioPlayer->getPlaybackTime();
-                                                    skullAudioAnimator->processAudioFrames(frames, frameCount, filePath, playbackTime);
+                                                    skullAudioAnimator->queueAudioFrames(frames, frameCount, trackId, playbackTime);
                                                 } });
 
   // Set the connection state change callback
@@ -343,16 +963,24 @@ void setup()
   // Set the characteristic change callback
   bluetoothController.setCharacteristicChangeCallback(onCharacteristicChange);
 
-  // Initialize SkullAudioAnimator
-  skullAudioAnimator = new SkullAudioAnimator(isPrimary, servoController, lightController, sdCardContent.skits, *sdCardManager,
-                                              servoMinDegrees, servoMaxDegrees);
-  skullAudioAnimator->setSpeakingStateCallback(onSpeakingStateChange);
+  // Set the indication callback (Primary: the Secondary's skit start reports)
+  bluetoothController.setIndicationCallback(onIndication);
+
+  // Initialize SkullAudioAnimator, and only then hand it to the audio callbacks, so they never see it half set up
+  SkullAudioAnimator *animator = new SkullAudioAnimator(isPrimary, servoController, lightController, sdCardContent.skits,
+                                                        *sdCardManager, esp32Clock, freeRtosTasks, servoMinDegrees, servoMaxDegrees);
+  animator->setSpeakingStateCallback(onSpeakingStateChange);
+  animator->setJawLookahead(config.getJawLookaheadMs());
+  animator->begin(); // Start the animation and band energy analysis tasks
+  skullAudioAnimator = animator;
 
   // Set the characteristic change request callback
   bluetoothController.setCharacteristicChangeRequestCallback(onCharacteristicChangeRequest);
+
+  startTasks();
 }
 
-// Main loop function
+// Main loop function: housekeeping. The skulls run in the skit and BLE control tasks (see startTasks()).
 void loop()
 {
   unsigned long currentMillis = millis();
@@ -361,16 +989,18 @@ void loop()
   // Reset the watchdog timer to prevent system resets
   esp_task_wdt_reset();
 
-  // Update audio player state
   bool isAudioPlaying = audioPlayer->isAudioPlaying();
 
-  if (isAudioPlaying)
+  // Anything typed into the serial monitor prints the system state right away
+  bool isStateRequested = false;
+  while (Serial.available() > 0)
   {
-    lastTimeAudioPlayed = millis(); // Set the last time audio played
+    Serial.read();
+    isStateRequested = true;
   }
 
   // Periodic logging of system state (every 5 seconds)
-  if (currentMillis - lastStateLoggingMillis >= 5000)
+  if (isStateRequested || currentMillis - lastStateLoggingMillis >= 5000)
   {
     size_t freeHeap = ESP.getFreeHeap();
     esp_reset_reason_t reset_reason = esp_reset_reason();
@@ -385,6 +1015,65 @@ void loop()
     Serial.printf("BLE clientIsConnectedToServer: %s, ", bluetoothController.clientIsConnectedToServer() ? "true" : "false");
     Serial.printf("BLE serverHasClientConnected: %s, ", bluetoothController.serverHasClientConnected() ? "true" : "false");
     Serial.printf("Voltage: %d mV, ", voltage);
+    AudioPlayer::BufferStats bufferStats = audioPlayer->getBufferStats();
+    Serial.printf("Audio buffer: %zu/%zu bytes (low: %zu, high: %zu), underruns: %u/%u callbacks",
+                  bufferStats.currentFill, bufferStats.capacity, bufferStats.lowWatermark, bufferStats.highWatermark,
+                  bufferStats.underrunCount, bufferStats.callbackCount);
+    const DeadlineHistogram &callbackTime = bluetoothController.getAudioCallbackHistogram();
+    Serial.printf(", A2DP callback: %u, p50 < %lu us, p99 < %lu us, max %lu us, %u over the %lu us deadline, %u empty (p99 copy < %lu us, "
+                  "animator < %lu us, playback callbacks < %lu us; fillBuffer p99 < %lu us, max %lu us)",
+                  callbackTime.count(), static_cast<unsigned long>(callbackTime.percentileMicros(50)),
+                  static_cast<unsigned long>(callbackTime.percentileMicros(99)), static_cast<unsigned long>(callbackTime.maxMicros()),
+                  callbackTime.missCount(), static_cast<unsigned long>(callbackTime.deadlineMicros()),
+                  bluetoothController.getEmptyAudioCallbackCount(),
+                  static_cast<unsigned long>(audioPlayer->getCopyTimeHistogram().percentileMicros(99)),
+                  static_cast<unsigned long>(audioPlayer->getAnimatorTimeHistogram().percentileMicros(99)),
+                  static_cast<unsigned long>(audioPlayer->getPlaybackCallbackTimeHistogram().percentileMicros(99)),
+                  static_cast<unsigned long>(audioPlayer->getFillBufferTimeHistogram().percentileMicros(99)),
+                  static_cast<unsigned long>(audioPlayer->getFillBufferTimeHistogram().maxMicros()));
+    if (skullAudioAnimator != nullptr)
+    {
+      BandEnergyAnalyzer::Stats fftStats = skullAudioAnimator->getBandEnergyStats();
+      Serial.printf(", FFT: %u runs, avg %u us, max %u us, every %u ms", fftStats.analysisCount, fftStats.averageMicros,
+                    fftStats.maxMicros, fftStats.intervalMs);
+      Serial.printf(", Animator: %u frames dropped", skullAudioAnimator->getDroppedFrames());
+    }
+    ServoController::WriteStats servoStats = servoController.getWriteStats();
+    Serial.printf(", Servo: %u writes, %u suppressed", servoStats.writes, servoStats.suppressedWrites);
+    int32_t clockUncertainty = bluetoothController.getClockUncertaintyMicros();
+    if (clockUncertainty < 0)
+    {
+      Serial.printf(", Clock: not synchronized");
+    }
+    else if (isPrimary)
+    {
+      Serial.printf(", Clock: Secondary synchronized within %ld us", static_cast<long>(clockUncertainty));
+    }
+    else
+    {
+      Serial.printf(", Clock: synchronized within %ld us, drift %.1f ppm", static_cast<long>(clockUncertainty),
+                    bluetoothController.getClockDriftPpm());
+    }
+    if (isPrimary && bluetoothController.getLastReconnectMillis() > 0)
+    {
+      Serial.printf(", BLE reconnect: %lu ms (%s)", bluetoothController.getLastReconnectMillis(),
+                    bluetoothController.wasLastReconnectDirect() ? "direct" : "scan");
+    }
+    if (isPrimary)
+    {
+      const LatencyHistogram &ackLatency = bluetoothController.getCommandLatencyHistogram();
+      Serial.printf(", Command ACK: %u, p50 < %lu ms, p99 < %lu ms, max %lu ms", ackLatency.count(),
+                    (ackLatency.percentileMicros(50) + 999) / 1000, (ackLatency.percentileMicros(99) + 999) / 1000,
+                    (ackLatency.maxMicros() + 999) / 1000);
+    }
+    if (!isPrimary)
+    {
+      AudioPlayer::DriftCorrectionStats correctionStats = audioPlayer->getDriftCorrectionStats();
+      Serial.printf(", Playback drift: gap %ld us, %.1f +/- %.1f ppm, correcting %.1f ppm (%u inserted, %u dropped, %ld pending)",
+                    static_cast<long>(playbackDriftCorrector.gapMicros()), playbackDriftCorrector.driftPpm(),
+                    playbackDriftCorrector.driftUncertaintyPpm(), playbackDriftCorrector.correctionPpm(), correctionStats.insertedFrames, correctionStats.droppedFrames,
+                    static_cast<long>(correctionStats.pendingFrames));
+    }
     Serial.printf("\n");
 
     if (reset_reason == ESP_RST_BROWNOUT)
@@ -395,26 +1084,6 @@ void loop()
     lastStateLoggingMillis = currentMillis;
   }
 
-  // // A2DP + BLE TEST TEST CODE: play the Names skit after everything is properly initialized
-  // if (isPrimary && currentMillis - lastCharacteristicUpdateMillis >= 10000 && bluetoothController.clientIsConnectedToServer() &&
-  //     bluetoothController.isA2dpConnected() && !audioPlayer->isAudioPlaying())
-  // {
-  //   String message = "/audio/Skit - milkshakes.wav";
-  //   bool success = bluetoothController.setRemoteCharacteristicValue(message.c_str());
-  //   if (success)
-  //   {
-  //     Serial.printf("MAIN: Successfully updated BLE characteristic with message: %s\n", message.c_str());
-
-  //     // Play the same file immediatly outselves. It should be fast enough to be in sync with Secondary.
-  //     audioPlayer->playNext(message);
-  //   }
-  //   else
-  //   {
-  //     Serial.printf("MAIN: Failed to update BLE characteristic with message: %s\n", message.c_str());
-  //   }
-  //   lastCharacteristicUpdateMillis = currentMillis + 30000; // extra delay so it doens't play them back to back
-  // }
-
   // // SKULL_AUDIO_ANIMATOR TEST CODE: play the Names skit after A2DP is properly initialized
   // if (bluetoothController.isA2dpConnected() && !audioPlayer->isAudioPlaying() && currentMillis - lastCharacteristicUpdateMillis >= 10000)
   // {
@@ -422,87 +1091,5 @@ void loop()
   //   lastCharacteristicUpdateMillis = currentMillis;
   // }
 
-  // Priamry Only: Play "Marco!" ever 5 seconds when scanning for the BLE server (Secondary skull)
-  static unsigned long lastScanLogMillis = 0;
-  if (isPrimary && bluetoothController.getConnectionState() == ConnectionState::SCANNING)
-  {
-    if (currentMillis - lastScanLogMillis >= 5000)
-    {
-      if (bluetoothController.isA2dpConnected() && !audioPlayer->isAudioPlaying())
-      {
-        audioPlayer->playNext("/audio/Marco.wav");
-      }
-      lastScanLogMillis = currentMillis;
-    }
-  }
-  else
-  {
-    // Reset the timer if we're not scanning
-    lastScanLogMillis = currentMillis;
-  }
-
-  // Update Bluetooth controller (it will handle BLE initialization internally)
-  bluetoothController.update();
-
-  // Initialize comms (BLE) once the audio (A2DP) is initialized and done playing the "Initialized" wav
-  if (isDonePlayingInitializationAudio && !isBleInitializationStarted)
-  {
-    bluetoothController.initializeBLE(isPrimary);
-    isBleInitializationStarted = true;
-  }
-
-  // Primary Only: If connected to bluetooth speakers and the other skull, check if the Matter controller has been triggered.
-  // If so, play a random skit.
-  if (isPrimary)
-  {
-    if (matterTriggerDetected) {
-        Serial.printf("MAIN: Matter trigger detected on pin %d\n", MATTER_TRIGGER_PIN);
-        matterTriggerDetected = false; // Reset the flag
-        
-        if (bluetoothController.clientIsConnectedToServer() &&
-            bluetoothController.isA2dpConnected() &&
-            !audioPlayer->isAudioPlaying() &&
-            (millis() - lastTimeAudioPlayed > AUDIO_COOLDOWN_TIME))
-        {
-            Serial.printf("MAIN: Matter trigger detected (currentMillis: %lu, lastTimeAudioPlayed: %lu). Playing random skit...\n", 
-                          currentMillis, lastTimeAudioPlayed);
-            lightController.blinkEyes(1);
-            ParsedSkit selectedSkit = skitSelector->selectNextSkit();
-            String filePath = selectedSkit.audioFile;
-
-            // Attempt to set the characteristic value and verify the result
-            // This new process ensures both skulls agree on the audio to be played
-            bool success = bluetoothController.setRemoteCharacteristicValue(filePath.c_str());
-            if (success)
-            {
-              std::string finalValue = bluetoothController.getRemoteCharacteristicValue();
-              if (finalValue == filePath.c_str())
-              {
-                Serial.printf("MAIN: Successfully updated BLE characteristic with message: %s\n", filePath.c_str());
-                audioPlayer->playNext(filePath);
-                lastTimeAudioPlayed = currentMillis; // Update the time immediately when we start playing
-              }
-              else
-              {
-                Serial.printf("MAIN: BLE characteristic value mismatch. Expected: %s, Actual: %s\n", filePath.c_str(), finalValue.c_str());
-                // Do not play audio if there's a mismatch
-              }
-            }
-            else
-            {
-              Serial.printf("MAIN: Failed to update BLE characteristic with message: %s\n", filePath.c_str());
-            }
-        }
-    }
-  }
-
-  // Check if it's time to move the jaw for breathing
-  if (currentMillis - lastJawMovementTime >= BREATHING_INTERVAL && !isAudioPlaying)
-  {
-    breathingJawMovement();
-    lastJawMovementTime = currentMillis;
-  }
-
-  // Delay to allow for other componeents to update.
-  delay(1);
+  delay(HOUSEKEEPING_INTERVAL_MS);
 }
\ No newline at end of file
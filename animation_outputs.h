@@ -0,0 +1,39 @@
+#ifndef ANIMATION_OUTPUTS_H
+#define ANIMATION_OUTPUTS_H
+
+#include <stdint.h>
+
+// What SkullAudioAnimator drives: the jaw servo and the eye LEDs. ServoController and LightController implement them
+// on the skulls; the host tools record what the animator asks for instead.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+
+// The jaw servo
+class JawServo
+{
+public:
+    virtual ~JawServo() {}
+
+    // Move straight to a position in degrees, preempting any planned moves
+    virtual void setPosition(int degrees) = 0;
+
+    // Move toward a position in degrees as far as the motion limits allow since the last call
+    virtual void followPosition(int degrees) = 0;
+};
+
+// The eye LEDs
+class EyeLights
+{
+public:
+    // Brightness constants
+    static const uint8_t BRIGHTNESS_MAX = 255; // Maximum brightness level
+    static const uint8_t BRIGHTNESS_DIM = 100; // Dimmed brightness level
+    static const uint8_t BRIGHTNESS_OFF = 0;   // Lights off
+
+    virtual ~EyeLights() {}
+
+    // Fade both eyes to a brightness (0 - BRIGHTNESS_MAX) over durationMs without waiting for it
+    virtual void fadeEyeBrightness(uint8_t brightness, uint16_t durationMs) = 0;
+};
+
+#endif // ANIMATION_OUTPUTS_H
@@ -0,0 +1,104 @@
+/*
+    Converts decoded 16-bit PCM to the stereo 44.1kHz stream A2DP expects.
+
+    Resampling is linear interpolation between consecutive source frames. m_phase is the fractional
+    position of the next output frame between m_previous (phase 0) and m_current (phase 1.0); each output
+    frame advances it by m_step = sourceRate / outputRate, pulling in a new source frame every time it
+    passes 1.0. Linear interpolation is plenty for speech (mono 22.05kHz voice files are the main use),
+    and costs one multiply per channel per output frame.
+*/
+
+#include "audio_format_converter.h"
+#include <string.h>
+
+AudioFormatConverter::AudioFormatConverter()
+    : m_sourceChannels(2), m_step(PHASE_ONE), m_phase(PHASE_ONE), m_isPassthrough(true), m_isSameRate(true)
+{
+    memset(m_previous, 0, sizeof(m_previous));
+    memset(m_current, 0, sizeof(m_current));
+}
+
+bool AudioFormatConverter::configure(uint32_t sourceSampleRate, uint16_t sourceChannels, uint32_t outputSampleRate)
+{
+    if (sourceChannels < 1 || sourceChannels > 2 ||
+        sourceSampleRate < MIN_SOURCE_SAMPLE_RATE || sourceSampleRate > MAX_SOURCE_SAMPLE_RATE ||
+        outputSampleRate == 0)
+    {
+        return false;
+    }
+
+    m_sourceChannels = sourceChannels;
+    m_isSameRate = (sourceSampleRate == outputSampleRate);
+    m_isPassthrough = m_isSameRate && sourceChannels == 2;
+    m_step = static_cast<uint32_t>((static_cast<uint64_t>(sourceSampleRate) << 16) / outputSampleRate);
+
+    // Start "one frame behind" so the first output frame pulls in the first source frame,
+    // easing in from silence rather than jumping straight to the first sample
+    m_phase = PHASE_ONE;
+    memset(m_previous, 0, sizeof(m_previous));
+    memset(m_current, 0, sizeof(m_current));
+    return true;
+}
+
+size_t AudioFormatConverter::maxInputFrames(size_t outputFrames) const
+{
+    if (m_isSameRate)
+    {
+        return outputFrames;
+    }
+
+    // n source frames produce at most (n + 1) / step + 1 output frames, so leave two frames of headroom
+    uint64_t inputFrames = (static_cast<uint64_t>(outputFrames) * m_step) >> 16;
+    return inputFrames > 2 ? static_cast<size_t>(inputFrames - 2) : 0;
+}
+
+size_t AudioFormatConverter::convert(const int16_t *input, size_t inputFrames, int16_t *output, size_t outputCapacityFrames)
+{
+    // Same rate: at most an upmix
+    if (m_isSameRate)
+    {
+        size_t frames = inputFrames < outputCapacityFrames ? inputFrames : outputCapacityFrames;
+        if (m_sourceChannels == 2)
+        {
+            memcpy(output, input, frames * 2 * sizeof(int16_t));
+        }
+        else
+        {
+            for (size_t i = 0; i < frames; i++)
+            {
+                output[2 * i] = input[i];
+                output[2 * i + 1] = input[i];
+            }
+        }
+        return frames;
+    }
+
+    size_t inputIndex = 0;
+    size_t outputFrames = 0;
+    while (outputFrames < outputCapacityFrames)
+    {
+        // Pull in source frames until the output position lies between m_previous and m_current
+        while (m_phase >= PHASE_ONE)
+        {
+            if (inputIndex >= inputFrames)
+            {
+                return outputFrames; // Need more input; the state carries over to the next call
+            }
+            m_previous[0] = m_current[0];
+            m_previous[1] = m_current[1];
+            const int16_t *frame = input + inputIndex * m_sourceChannels;
+            m_current[0] = frame[0];
+            m_current[1] = (m_sourceChannels == 2) ? frame[1] : frame[0];
+            inputIndex++;
+            m_phase -= PHASE_ONE;
+        }
+
+        // Interpolate with a 15-bit fraction so the product of a full-scale difference still fits in int32
+        int32_t fraction = static_cast<int32_t>(m_phase >> 1);
+        output[2 * outputFrames] = static_cast<int16_t>(m_previous[0] + (((m_current[0] - m_previous[0]) * fraction) >> 15));
+        output[2 * outputFrames + 1] = static_cast<int16_t>(m_previous[1] + (((m_current[1] - m_previous[1]) * fraction) >> 15));
+        outputFrames++;
+        m_phase += m_step;
+    }
+    return outputFrames;
+}
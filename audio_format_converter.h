@@ -0,0 +1,47 @@
+#ifndef AUDIO_FORMAT_CONVERTER_H
+#define AUDIO_FORMAT_CONVERTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// AudioFormatConverter turns 16-bit PCM at any supported sample rate, mono or stereo, into 16-bit
+// stereo at the output (A2DP) rate. Channels are upmixed by duplication and the sample rate is
+// changed by linear interpolation using 16.16 fixed-point math (the ESP32 has no double-precision FPU).
+//
+// The converter keeps its interpolation state between calls, so a file can be converted in chunks.
+// Only standard C++ is used so it can be built and benchmarked on a host machine.
+class AudioFormatConverter
+{
+public:
+    static constexpr uint32_t MIN_SOURCE_SAMPLE_RATE = 8000;
+    static constexpr uint32_t MAX_SOURCE_SAMPLE_RATE = 48000;
+
+    AudioFormatConverter();
+
+    // Set up for a new file and reset the interpolation state. Returns false if the format isn't supported.
+    bool configure(uint32_t sourceSampleRate, uint16_t sourceChannels, uint32_t outputSampleRate);
+
+    // True if the source is already in the output format and can be copied as-is
+    bool isPassthrough() const { return m_isPassthrough; }
+
+    // Largest number of source frames that is guaranteed to produce at most outputFrames output frames
+    size_t maxInputFrames(size_t outputFrames) const;
+
+    // Convert inputFrames interleaved source frames into interleaved stereo output frames.
+    // Returns the number of output frames written. The output must have room for the frames produced;
+    // size the input with maxInputFrames() to guarantee that.
+    size_t convert(const int16_t *input, size_t inputFrames, int16_t *output, size_t outputCapacityFrames);
+
+private:
+    static constexpr uint32_t PHASE_ONE = 1 << 16; // 1.0 in 16.16 fixed point
+
+    uint16_t m_sourceChannels;
+    uint32_t m_step;  // Source frames advanced per output frame, 16.16 fixed point
+    uint32_t m_phase; // Position between m_previous and m_current, 16.16 fixed point
+    int16_t m_previous[2];
+    int16_t m_current[2];
+    bool m_isPassthrough;
+    bool m_isSameRate;
+};
+
+#endif // AUDIO_FORMAT_CONVERTER_H
@@ -0,0 +1,109 @@
+/*
+    Integer RMS kernel.
+
+    Each pair of squared samples is summed in 32 bits before being added to the 64-bit total:
+    a square is at most 32768^2 = 2^30, so two of them always fit in a uint32_t. The main loop handles
+    four samples per iteration with independent multiplies so the compiler can unroll/pipeline it
+    (on the ESP32 that's MULL + ADD per sample, with one 64-bit add per pair).
+*/
+
+#include "audio_level.h"
+#include "SoundData.h"
+
+uint64_t AudioLevel::sumOfSquares(const int16_t *samples, size_t count)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        int32_t a = samples[i];
+        int32_t b = samples[i + 1];
+        int32_t c = samples[i + 2];
+        int32_t d = samples[i + 3];
+        uint32_t pair1 = static_cast<uint32_t>(a * a) + static_cast<uint32_t>(b * b);
+        uint32_t pair2 = static_cast<uint32_t>(c * c) + static_cast<uint32_t>(d * d);
+        sum += pair1;
+        sum += pair2;
+    }
+    for (; i < count; i++)
+    {
+        int32_t sample = samples[i];
+        sum += static_cast<uint32_t>(sample * sample);
+    }
+    return sum;
+}
+
+uint64_t AudioLevel::sumOfSquares(const Frame *frames, size_t frameCount)
+{
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    for (; i + 2 <= frameCount; i += 2)
+    {
+        int32_t a = frames[i].channel1;
+        int32_t b = frames[i].channel2;
+        int32_t c = frames[i + 1].channel1;
+        int32_t d = frames[i + 1].channel2;
+        uint32_t pair1 = static_cast<uint32_t>(a * a) + static_cast<uint32_t>(b * b);
+        uint32_t pair2 = static_cast<uint32_t>(c * c) + static_cast<uint32_t>(d * d);
+        sum += pair1;
+        sum += pair2;
+    }
+    if (i < frameCount)
+    {
+        int32_t a = frames[i].channel1;
+        int32_t b = frames[i].channel2;
+        sum += static_cast<uint32_t>(a * a) + static_cast<uint32_t>(b * b);
+    }
+    return sum;
+}
+
+// Bit-by-bit (digit) square root: one compare and subtract per result bit, no division
+uint32_t AudioLevel::integerSqrt(uint64_t value)
+{
+    uint64_t result = 0;
+    uint64_t bit = static_cast<uint64_t>(1) << 62; // Highest power of four
+
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return static_cast<uint32_t>(result);
+}
+
+uint32_t AudioLevel::rms(const int16_t *samples, size_t count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // The mean square is at most 2^30, so the square root only needs the 32-bit range
+    uint32_t meanSquare = static_cast<uint32_t>(sumOfSquares(samples, count) / count);
+    return integerSqrt(meanSquare);
+}
+
+uint32_t AudioLevel::rms(const Frame *frames, size_t frameCount)
+{
+    if (frameCount == 0)
+    {
+        return 0;
+    }
+
+    uint32_t meanSquare = static_cast<uint32_t>(sumOfSquares(frames, frameCount) / (frameCount * 2));
+    return integerSqrt(meanSquare);
+}
@@ -0,0 +1,33 @@
+#ifndef AUDIO_LEVEL_H
+#define AUDIO_LEVEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Frame; // SoundData.h
+
+// AudioLevel measures the loudness (RMS) of 16-bit PCM samples using only integer arithmetic.
+// The ESP32 has a single-precision FPU only, so double math in the A2DP callback is done in software;
+// this keeps the per-callback work to 32-bit multiplies and 64-bit adds, plus one integer square root.
+// Only standard C++ is used so the live animator and the host-side jaw envelope generator share it.
+class AudioLevel
+{
+public:
+    // Sum of the squares of the samples. Exact for any count below 2^34 samples.
+    static uint64_t sumOfSquares(const int16_t *samples, size_t count);
+
+    // Floor of the square root
+    static uint32_t integerSqrt(uint64_t value);
+
+    // Sum of the squares of both channels' samples. Frame is packed, so the samples are read through its members
+    // rather than as an int16_t array, which could be misaligned.
+    static uint64_t sumOfSquares(const Frame *frames, size_t frameCount);
+
+    // Root mean square of the samples (0 - 32768), rounded down. 0 if count is 0.
+    static uint32_t rms(const int16_t *samples, size_t count);
+
+    // Root mean square of both channels' samples, as rms() of the interleaved samples. 0 if frameCount is 0.
+    static uint32_t rms(const Frame *frames, size_t frameCount);
+};
+
+#endif // AUDIO_LEVEL_H
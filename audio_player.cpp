@@ -20,142 +20,616 @@
 
 #include "audio_player.h"
 #include "sd_card_manager.h"
+#include "wav_header_parser.h"
+#include "ima_adpcm_decoder.h"
 #include <cmath>
 #include <algorithm>
+#include <string.h>
 #include <Arduino.h>
-#include <esp_task_wdt.h>
 #include <mutex>
-#include <thread>
-
-// Define a constant for an undefined buffer position
-constexpr size_t AudioPlayer::BUFFER_POS_UNDEFINED;
 
 // Keep track of the last printed second for logging purposes
 static unsigned long lastPrintedSecond = 0;
 
-AudioPlayer::AudioPlayer(SDCardManager &sdCardManager)
-    : m_writePos(0), m_readPos(0), m_bufferFilled(0), m_totalBufferWritePos(0), m_totalBufferReadPos(0),
-      m_currentBufferingFilePath(""),
-      m_fileStartBufferPos(BUFFER_POS_UNDEFINED), m_fileStartPath(""), m_fileEndBufferPos(BUFFER_POS_UNDEFINED), m_fileEndPath(""),
-      m_isAudioPlaying(false), m_muted(false), m_playbackStartTime(0), m_currentPlayingFilePath(""),
-      m_sdCardManager(sdCardManager), m_bytesPlayed(0)
+// Feeds an SD card file to the WAV header parser
+class FileByteSource : public WavByteSource
+{
+public:
+    FileByteSource(PlatformFile &file) : m_file(file) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return m_file.read(buffer, size);
+    }
+
+    bool skip(uint32_t size) override
+    {
+        size_t target = m_file.position() + size;
+        return target <= m_file.size() && m_file.seek(target);
+    }
+
+private:
+    PlatformFile &m_file;
+};
+
+AudioPlayer::AudioPlayer(SDCardManager &sdCardManager, Clock &clock, Tasks &tasks, size_t bufferSize, bool usePsram)
+    : m_currentBufferingTrackId(NO_TRACK), m_ringBuffer(bufferSize, usePsram), m_producerTaskHandle(nullptr),
+      m_totalBufferWritePos(0), m_totalBufferReadPos(0), m_lastFileMarkerPos(0), m_analysisOffsetBytes(0),
+      m_dataBytesRemaining(0), m_currentBlockAlign(sizeof(Frame)), m_currentAudioFormat(WavHeaderParser::FORMAT_PCM),
+      m_currentNumChannels(AUDIO_NUM_CHANNELS), m_decodedFrames(0), m_decodedPos(0),
+      m_currentPlayingTrackId(NO_TRACK), m_isAudioPlaying(false), m_muted(false), m_playbackStartTime(0), m_lastTrackId(NO_TRACK),
+      m_sdCardManager(sdCardManager), m_clock(clock), m_tasks(tasks), m_bytesPlayed(0),
+      m_isInFile(false), m_highWatermark(0), m_lowWatermark(SIZE_MAX), m_underrunCount(0), m_callbackCount(0),
+      m_copyTime(CALLBACK_DEADLINE_MICROS), m_animatorTime(CALLBACK_DEADLINE_MICROS), m_playbackCallbackTime(CALLBACK_DEADLINE_MICROS),
+      m_cpuMhz(clock.cyclesPerMicro()),
+      m_releasedTrackId(NO_TRACK), m_lastScheduledStartLateMicros(0), m_lastScheduledStartTrackId(NO_TRACK),
+      m_pendingCorrectionFrames(0), m_framesSinceCorrection(0), m_trackCorrectionFrames(0), m_insertedFrames(0), m_droppedFrames(0),
+      m_positionTrackId(NO_TRACK), m_positionBaseMicros(0), m_positionBaseFrame(0), m_positionSumMicros(0), m_positionSumFrames(0),
+      m_positionSamples(0), m_position(), m_positionSequence(0)
+{
+    Serial.printf("AudioPlayer: %zu byte audio buffer in %s (requested %zu bytes%s)\n",
+                  m_ringBuffer.capacity(), m_ringBuffer.isInPsram() ? "PSRAM" : "internal RAM",
+                  bufferSize, usePsram ? " in PSRAM" : "");
+}
+
+// Start the producer task that keeps the ring buffer full
+void AudioPlayer::begin()
+{
+    if (m_producerTaskHandle != nullptr)
+    {
+        return;
+    }
+
+    m_producerTaskHandle = m_tasks.start(producerTask, this, "AudioProducer", PRODUCER_TASK_STACK_SIZE,
+                                         PRODUCER_TASK_PRIORITY, PRODUCER_TASK_CORE);
+    if (m_producerTaskHandle == nullptr)
+    {
+        Serial.println("AudioPlayer::begin() Failed to create audio producer task");
+    }
+}
+
+// Offset the frames given to the frames provided callback from the frames being played
+void AudioPlayer::setAnalysisLookahead(long lookaheadMs)
+{
+    // The analysis window reaches |offset| plus its own length from the frames being played. Looking ahead, that much
+    // has to be buffered; looking back, that much played audio is kept in the buffer. Either way keep it to half the
+    // buffer, so at least half is always left for audio that hasn't been played yet.
+    ptrdiff_t windowFrames = static_cast<ptrdiff_t>(ANALYSIS_BUFFER_FRAMES);
+    ptrdiff_t maxOffsetFrames = std::max<ptrdiff_t>(static_cast<ptrdiff_t>(m_ringBuffer.capacity() / 2 / sizeof(Frame)) - windowFrames, 0);
+
+    // Whole frames only, so the callback's samples stay channel-aligned
+    ptrdiff_t offsetFrames = static_cast<ptrdiff_t>(static_cast<int64_t>(lookaheadMs) * AUDIO_SAMPLE_RATE / 1000);
+    if (offsetFrames > maxOffsetFrames || offsetFrames < -maxOffsetFrames)
+    {
+        long maxLookaheadMs = static_cast<long>(static_cast<int64_t>(maxOffsetFrames) * 1000 / AUDIO_SAMPLE_RATE);
+        Serial.printf("AudioPlayer::setAnalysisLookahead() %ld ms needs a bigger audio buffer; limiting to %ld ms\n", lookaheadMs,
+                      offsetFrames > 0 ? maxLookaheadMs : -maxLookaheadMs);
+        offsetFrames = offsetFrames > 0 ? maxOffsetFrames : -maxOffsetFrames;
+    }
+    m_analysisOffsetBytes = offsetFrames * static_cast<ptrdiff_t>(sizeof(Frame));
+
+    // Looking back needs that much of the played audio kept in the buffer, measured from the end of a callback's read
+    if (m_analysisOffsetBytes < 0)
+    {
+        m_ringBuffer.setRetainedSize(static_cast<size_t>(-m_analysisOffsetBytes) + ANALYSIS_BUFFER_FRAMES * sizeof(Frame));
+    }
+    else
+    {
+        m_ringBuffer.setRetainedSize(0);
+    }
+}
+
+// Producer task: sleep until the consumer makes room (or a file is queued), then refill the buffer.
+// The timeout means a missed notification only costs PRODUCER_IDLE_WAIT_MS, never a stall.
+void AudioPlayer::producerTask(void *param)
 {
+    AudioPlayer *self = static_cast<AudioPlayer *>(param);
+    while (true)
+    {
+        self->m_tasks.waitForNotification(PRODUCER_IDLE_WAIT_MS);
+        int64_t startMicros = self->m_clock.micros();
+        self->fillBuffer();
+        self->m_fillBufferTime.record(static_cast<uint32_t>(self->m_clock.micros() - startMicros));
+    }
+}
+
+// Add a new audio file to the playback queue and return its track ID
+uint32_t AudioPlayer::playNext(String filePath)
+{
+    return queueTrack(filePath, 0);
 }
 
-// Add a new audio file to the playback queue
-void AudioPlayer::playNext(String filePath)
+// Add a new audio file to the playback queue, to start at startMicros
+uint32_t AudioPlayer::playAt(String filePath, int64_t startMicros)
 {
-    if (filePath.length() > 0)
+    if (startMicros <= 0)
+    {
+        startMicros = 1; // 0 means "no start time"
+    }
+
+    Serial.printf("AudioPlayer::playAt() Starting %s in %ld ms\n", filePath.c_str(),
+                  static_cast<long>((startMicros - m_clock.micros()) / 1000));
+    return queueTrack(filePath, startMicros);
+}
+
+// Add a file to the playback queue and return its track ID.
+// The path is copied into the track table here, on the caller's thread, so the audio callback never copies it.
+uint32_t AudioPlayer::queueTrack(const String &filePath, int64_t startMicros)
+{
+    if (filePath.length() == 0)
+    {
+        return NO_TRACK;
+    }
+
+    uint32_t trackId;
     {
         std::lock_guard<std::mutex> lock(m_mutex); // Ensure thread-safe access to shared resources
-        audioQueue.push(filePath.c_str());
-        Serial.printf("AudioPlayer::playNext() Added file to queue: %s ...\n", filePath.c_str());
+        if (audioQueue.size() >= MAX_QUEUED_TRACKS)
+        {
+            Serial.printf("AudioPlayer::queueTrack() Queue full, dropping file: %s\n", filePath.c_str());
+            return NO_TRACK;
+        }
+
+        trackId = ++m_lastTrackId;
+        if (trackId == NO_TRACK)
+        {
+            trackId = ++m_lastTrackId; // Skip NO_TRACK when the counter wraps
+        }
+        m_trackPaths[trackId % TRACK_TABLE_SIZE] = filePath;
+        m_trackStartMicros[trackId % TRACK_TABLE_SIZE] = startMicros;
+        audioQueue.push(trackId);
     }
+    Serial.printf("AudioPlayer::queueTrack() Added file to queue: %s (track %u) ...\n", filePath.c_str(), trackId);
+
+    if (m_producerTaskHandle != nullptr)
+    {
+        m_tasks.notify(m_producerTaskHandle); // Start buffering right away
+    }
+    return trackId;
+}
+
+// How late a playAt() track's first sample was
+bool AudioPlayer::getStartLateness(uint32_t trackId, int32_t &lateMicros) const
+{
+    if (trackId == NO_TRACK || m_lastScheduledStartTrackId.load(std::memory_order_acquire) != trackId)
+    {
+        return false;
+    }
+    lateMicros = m_lastScheduledStartLateMicros.load(std::memory_order_relaxed);
+    return true;
 }
 
 // Provide audio frames to the audio output stream
 int32_t AudioPlayer::provideAudioFrames(Frame *frame, int32_t frame_count)
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t startCycles = m_clock.cycleCount();
 
-    // Exit if there's no data available to read
-    if (m_bufferFilled == 0)
+    // A file with a start time that is up next plays silence until then, while the producer fills the buffer
+    int64_t nowMicros = m_clock.micros();
+    int32_t silentFrames = framesUntilScheduledStart(frame_count, nowMicros);
+    if (silentFrames == frame_count)
     {
-        m_currentPlayingFilePath = "";
-        m_isAudioPlaying = false;
-        fillBuffer(); // Try to fill the buffer
-        return 0;
+        memset(frame, 0, frame_count * sizeof(Frame));
+        m_currentPlayingTrackId.store(NO_TRACK, std::memory_order_relaxed);
+        m_isAudioPlaying.store(false, std::memory_order_relaxed);
+        recordStageTime(m_copyTime, startCycles);
+        return frame_count;
     }
+    memset(frame, 0, silentFrames * sizeof(Frame));
+    int32_t requestedFrames = frame_count;
+    frame += silentFrames;
+    frame_count -= silentFrames;
 
+    // Stop short of a held file that comes up within this request; the next request waits for its start time
     size_t bytesToRead = frame_count * sizeof(Frame);
-    size_t bytesRead = 0;
+    const FileMarker *heldStart = nextHeldStartMarker();
+    if (heldStart != nullptr)
+    {
+        bytesToRead = std::min(bytesToRead, heldStart->bufferPos - m_totalBufferReadPos);
+    }
+
+    size_t playedPos = m_totalBufferReadPos;
+    recordBufferFill(m_ringBuffer.available());
 
-    // Read data from buffer, handling wrap-around if necessary
-    while (bytesRead < bytesToRead && m_bufferFilled > 0)
+    // Read one frame less or more than requested if a drift correction is due, and splice the difference
+    int32_t correction = takeDriftCorrection(frame_count, bytesToRead);
+    size_t bytesRead;
+    if (correction > 0)
+    {
+        bytesRead = m_ringBuffer.read(reinterpret_cast<uint8_t *>(frame), bytesToRead - sizeof(Frame));
+        insertFrame(frame, frame_count);
+    }
+    else if (correction < 0)
+    {
+        Frame next;
+        bytesRead = m_ringBuffer.read(reinterpret_cast<uint8_t *>(frame), bytesToRead);
+        bytesRead += m_ringBuffer.read(reinterpret_cast<uint8_t *>(&next), sizeof(Frame));
+        dropFrame(frame, frame_count, next);
+    }
+    else
     {
-        size_t chunkSize = std::min(bytesToRead - bytesRead, m_bufferFilled);
-        size_t firstChunkSize = std::min(chunkSize, AUDIO_BUFFER_SIZE - m_readPos);
-        memcpy((uint8_t *)frame + bytesRead, m_audioBuffer + m_readPos, firstChunkSize);
+        bytesRead = m_ringBuffer.read(reinterpret_cast<uint8_t *>(frame), bytesToRead);
+    }
+    size_t bytesOutput = bytesRead + correction * static_cast<ptrdiff_t>(sizeof(Frame));
 
-        m_readPos = (m_readPos + firstChunkSize) % AUDIO_BUFFER_SIZE;
-        m_bufferFilled -= firstChunkSize;
-        bytesRead += firstChunkSize;
+    // Wake the producer so it refills the space we just freed
+    if (m_producerTaskHandle != nullptr)
+    {
+        m_tasks.notify(m_producerTaskHandle);
+    }
 
-        // Handle buffer wrap-around
-        if (firstChunkSize < chunkSize)
+    // Exit if there's no data available to read
+    if (bytesRead == 0)
+    {
+        m_currentPlayingTrackId.store(NO_TRACK, std::memory_order_relaxed);
+        m_isAudioPlaying.store(false, std::memory_order_relaxed);
+        m_bytesPlayed = 0; // Reset byte counter to avoid overflows
+        uint32_t stageCycles = recordStageTime(m_copyTime, startCycles);
+        handleFileMarkers(); // An end marker may sit exactly at the current read position
+        recordStageTime(m_playbackCallbackTime, stageCycles);
+        if (m_isInFile)
         {
-            size_t secondChunkSize = chunkSize - firstChunkSize;
-            memcpy((uint8_t *)frame + bytesRead, m_audioBuffer + m_readPos, secondChunkSize);
-
-            m_readPos = (m_readPos + secondChunkSize) % AUDIO_BUFFER_SIZE;
-            m_bufferFilled -= secondChunkSize;
-            bytesRead += secondChunkSize;
+            m_underrunCount.fetch_add(1, std::memory_order_relaxed); // The file has more data, the producer just hasn't delivered it
         }
+        return silentFrames;
+    }
+
+    // Where in the file the first of these frames was, for comparing playback with the other skull's
+    if (m_isInFile && silentFrames == 0)
+    {
+        recordPlaybackPosition(m_currentPlayingTrackId.load(std::memory_order_relaxed), nowMicros,
+                               static_cast<int64_t>((playedPos - m_lastFileMarkerPos) / sizeof(Frame)));
     }
 
     m_totalBufferReadPos += bytesRead;
     m_bytesPlayed += bytesRead;
 
-    fillBuffer(); // Refill the buffer after reading
+    // Pad a partially filled request with silence
+    if (bytesOutput < frame_count * sizeof(Frame))
+    {
+        memset(reinterpret_cast<uint8_t *>(frame) + bytesOutput, 0, frame_count * sizeof(Frame) - bytesOutput);
+    }
 
     // Update playback status and time
-    m_isAudioPlaying = (bytesRead > 0 || m_bufferFilled > 0);
+    m_isAudioPlaying.store(true, std::memory_order_relaxed);
 
-    if (m_muted)
+    bool muted = m_muted.load(std::memory_order_relaxed);
+    if (muted)
     {
         memset(frame, 0, frame_count * sizeof(Frame)); // Mute audio if necessary
     }
+    uint32_t stageCycles = recordStageTime(m_copyTime, startCycles);
 
-    // Call the frames provided callback if set
+    // Call the frames provided callback if set, with the frames it should analyze: the ones being played,
+    // or (with a lookahead) the ones that far ahead of or behind them
     if (m_audioFramesProvidedCallback)
     {
-        m_audioFramesProvidedCallback(m_currentPlayingFilePath, frame, frame_count);
+        uint32_t trackId = m_currentPlayingTrackId.load(std::memory_order_relaxed);
+        if (m_analysisOffsetBytes != 0 && !muted)
+        {
+            int32_t analysisFrameCount = fillAnalysisFrames(playedPos, frame_count);
+            m_audioFramesProvidedCallback(trackId, m_analysisFrames, analysisFrameCount);
+        }
+        else
+        {
+            m_audioFramesProvidedCallback(trackId, frame, frame_count);
+        }
+        stageCycles = recordStageTime(m_animatorTime, stageCycles);
     }
 
     // Check for and handle file transitions
-    if (m_totalBufferReadPos >= m_fileStartBufferPos)
+    handleFileMarkers();
+    recordStageTime(m_playbackCallbackTime, stageCycles);
+
+    // A short read is only an underrun if the file didn't end within this request
+    if (bytesOutput < bytesToRead && m_isInFile)
     {
-        m_playbackStartTime = millis();
-        m_currentPlayingFilePath = m_fileStartPath;
-        m_bytesPlayed = 0; // Reset m_bytesPlayed to zero when starting a new file
+        m_underrunCount.fetch_add(1, std::memory_order_relaxed);
+    }
 
-        if (m_playbackStartCallback)
+    return requestedFrames;
+}
+
+// The start marker of the next file, if it has a start time that hasn't been reached yet
+const AudioPlayer::FileMarker *AudioPlayer::nextHeldStartMarker() const
+{
+    // Only an end marker can come before the next start marker
+    for (size_t i = 0; i < 2; i++)
+    {
+        const FileMarker *marker = m_fileMarkers.peek(i);
+        if (marker == nullptr)
+        {
+            return nullptr;
+        }
+        if (marker->isStart)
         {
-            m_playbackStartCallback(m_fileStartPath);
+            bool isHeld = m_trackStartMicros[marker->trackId % TRACK_TABLE_SIZE] != 0 && marker->trackId != m_releasedTrackId;
+            return isHeld ? marker : nullptr;
         }
-        // Keep: for debuug: Serial.printf("AudioPlayer::provideAudioFrames() FOUND FILE START MARKER: m_totalBufferReadPos (%zu) >= m_fileStartBufferPos (%zu), starting playback of file: %s\n", m_totalBufferReadPos, m_fileStartBufferPos, m_fileStartPath.c_str());
-        m_fileStartBufferPos = BUFFER_POS_UNDEFINED;
-        m_fileStartPath = "";
+    }
+    return nullptr;
+}
+
+// Frames of silence to play before a held file's first sample. Once its start time falls within this request,
+// the file is released: the silence lines its first sample up with the start time, to the nearest frame.
+int32_t AudioPlayer::framesUntilScheduledStart(int32_t frameCount, int64_t nowMicros)
+{
+    const FileMarker *marker = nextHeldStartMarker();
+    if (marker == nullptr || marker->bufferPos != m_totalBufferReadPos)
+    {
+        return 0; // Nothing held, or the file before it is still playing
+    }
+
+    int64_t startMicros = m_trackStartMicros[marker->trackId % TRACK_TABLE_SIZE];
+    int64_t waitFrames = startMicros > nowMicros ? ((startMicros - nowMicros) * AUDIO_SAMPLE_RATE + 999999) / 1000000 : 0;
+    if (waitFrames >= frameCount)
+    {
+        return frameCount;
+    }
+
+    // Release the file and record when its first sample goes out relative to its start time
+    int64_t firstSampleMicros = nowMicros + waitFrames * 1000000 / AUDIO_SAMPLE_RATE;
+    int64_t lateMicros = std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, firstSampleMicros - startMicros));
+    m_releasedTrackId = marker->trackId;
+    m_lastScheduledStartLateMicros.store(static_cast<int32_t>(lateMicros), std::memory_order_relaxed);
+    m_lastScheduledStartTrackId.store(marker->trackId, std::memory_order_release);
+    return static_cast<int32_t>(waitFrames);
+}
+
+// Whether to insert or drop a frame in this request. Corrections are spaced out, and only made inside a file
+// with the whole request buffered, so a splice never lands on silence, a file transition or an underrun.
+int32_t AudioPlayer::takeDriftCorrection(int32_t frameCount, size_t bytesToRead)
+{
+    m_framesSinceCorrection += frameCount;
+    int32_t pending = m_pendingCorrectionFrames.load(std::memory_order_relaxed);
+    if (pending == 0 || m_framesSinceCorrection < DRIFT_CORRECTION_SPACING_FRAMES || !m_isInFile || frameCount < 3 ||
+        bytesToRead != frameCount * sizeof(Frame) || m_ringBuffer.available() < bytesToRead + sizeof(Frame))
+    {
+        return 0;
+    }
+    const FileMarker *nextMarker = m_fileMarkers.front();
+    if (nextMarker != nullptr && nextMarker->bufferPos - m_totalBufferReadPos <= bytesToRead + sizeof(Frame))
+    {
+        return 0;
+    }
+
+    // The main loop may replace the correction meanwhile; then this one is skipped
+    int32_t correction = pending > 0 ? 1 : -1;
+    if (!m_pendingCorrectionFrames.compare_exchange_strong(pending, pending - correction, std::memory_order_relaxed))
+    {
+        return 0;
+    }
+    m_framesSinceCorrection = 0;
+    m_trackCorrectionFrames += correction;
+    (correction > 0 ? m_insertedFrames : m_droppedFrames).fetch_add(1, std::memory_order_relaxed);
+    return correction;
+}
+
+// Splice a frame into the middle of the request, halfway between its neighbours
+void AudioPlayer::insertFrame(Frame *frames, int32_t frameCount)
+{
+    int32_t middle = frameCount / 2;
+    memmove(frames + middle + 1, frames + middle, (frameCount - 1 - middle) * sizeof(Frame));
+    frames[middle] = Frame((frames[middle - 1].channel1 + frames[middle + 1].channel1) / 2,
+                           (frames[middle - 1].channel2 + frames[middle + 1].channel2) / 2);
+}
+
+// Splice the middle frame out of the request. The frame before it moves halfway towards it, so the waveform
+// steps no further than between two neighbouring samples.
+void AudioPlayer::dropFrame(Frame *frames, int32_t frameCount, const Frame &next)
+{
+    int32_t middle = frameCount / 2;
+    frames[middle - 1] = Frame((frames[middle - 1].channel1 + frames[middle].channel1) / 2,
+                               (frames[middle - 1].channel2 + frames[middle].channel2) / 2);
+    memmove(frames + middle, frames + middle + 1, (frameCount - 1 - middle) * sizeof(Frame));
+    frames[frameCount - 1] = next;
+}
+
+// Correct drift against another player
+void AudioPlayer::setDriftCorrection(int32_t frames)
+{
+    m_pendingCorrectionFrames.store(frames, std::memory_order_relaxed);
+}
+
+// Get the drift correction telemetry
+AudioPlayer::DriftCorrectionStats AudioPlayer::getDriftCorrectionStats() const
+{
+    DriftCorrectionStats stats;
+    stats.insertedFrames = m_insertedFrames.load(std::memory_order_relaxed);
+    stats.droppedFrames = m_droppedFrames.load(std::memory_order_relaxed);
+    stats.pendingFrames = m_pendingCorrectionFrames.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Add a callback's playback position (the file's frame handed to A2DP at atMicros) to the current window
+void AudioPlayer::recordPlaybackPosition(uint32_t trackId, int64_t atMicros, int64_t frame)
+{
+    if (trackId != m_positionTrackId || m_positionSamples == 0)
+    {
+        m_positionTrackId = trackId;
+        m_positionBaseMicros = atMicros;
+        m_positionBaseFrame = frame;
+        m_positionSumMicros = 0;
+        m_positionSumFrames = 0;
+        m_positionSamples = 0;
+    }
+    m_positionSumMicros += atMicros - m_positionBaseMicros;
+    m_positionSumFrames += frame - m_positionBaseFrame;
+    m_positionSamples++;
+    if (atMicros - m_positionBaseMicros < PLAYBACK_POSITION_WINDOW_MICROS)
+    {
+        return;
     }
 
-    if (m_totalBufferReadPos >= m_fileEndBufferPos)
+    // Publish the window's average
+    int64_t meanFrame = m_positionBaseFrame + m_positionSumFrames / m_positionSamples;
+    m_positionSequence.fetch_add(1, std::memory_order_acq_rel);
+    m_position.trackId = trackId;
+    m_position.atMicros = m_positionBaseMicros + m_positionSumMicros / m_positionSamples;
+    m_position.positionMicros = meanFrame * 1000000 / AUDIO_SAMPLE_RATE;
+    m_position.correctionFrames = m_trackCorrectionFrames;
+    m_positionSequence.fetch_add(1, std::memory_order_release);
+    m_positionSamples = 0;
+}
+
+// Get the latest playback position, retrying if the consumer was publishing a new one meanwhile
+bool AudioPlayer::getPlaybackPosition(PlaybackPosition &position) const
+{
+    for (int attempt = 0; attempt < 3; attempt++)
     {
-        if (m_playbackEndCallback)
+        uint32_t sequence = m_positionSequence.load(std::memory_order_acquire);
+        if (sequence == 0)
+        {
+            return false;
+        }
+        if (sequence % 2 != 0)
+        {
+            continue;
+        }
+        position = m_position;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_positionSequence.load(std::memory_order_relaxed) == sequence)
         {
-            m_playbackEndCallback(m_fileEndPath);
+            return true;
         }
-        // Keep: for debuug: Serial.printf("AudioPlayer::provideAudioFrames() FOUND FILE END MARKER: m_totalBufferReadPos (%zu) >= m_fileEndBufferPos (%zu), ending playback of file: %s\n", m_totalBufferReadPos, m_fileEndBufferPos, m_fileEndPath.c_str());
-        m_fileEndBufferPos = BUFFER_POS_UNDEFINED;
-        m_fileEndPath = "";
     }
+    return false;
+}
+
+// Record the buffer fill level seen at the start of a callback
+void AudioPlayer::recordBufferFill(size_t fill)
+{
+    if (!m_isInFile)
+    {
+        return;
+    }
+
+    m_callbackCount.fetch_add(1, std::memory_order_relaxed);
+    if (fill > m_highWatermark.load(std::memory_order_relaxed))
+    {
+        m_highWatermark.store(fill, std::memory_order_relaxed);
+    }
+    if (fill < m_lowWatermark.load(std::memory_order_relaxed))
+    {
+        m_lowWatermark.store(fill, std::memory_order_relaxed);
+    }
+}
+
+// Record the time since startCycles in a stage's histogram
+uint32_t AudioPlayer::recordStageTime(DeadlineHistogram &histogram, uint32_t startCycles)
+{
+    uint32_t nowCycles = m_clock.cycleCount();
+    histogram.record((nowCycles - startCycles) / m_cpuMhz);
+    return nowCycles;
+}
+
+// Fill m_analysisFrames with the audio m_analysisOffsetBytes away from the frames starting at playedPos.
+// The window never crosses a file transition: any part of it before the last transition played, or after the next
+// one queued, is silence. That way the jaw closes ahead of the end of a file instead of reacting to the next one.
+// Returns the number of frames filled.
+int32_t AudioPlayer::fillAnalysisFrames(size_t playedPos, int32_t frameCount)
+{
+    size_t windowFrames = std::min(static_cast<size_t>(frameCount), ANALYSIS_BUFFER_FRAMES);
+    ptrdiff_t windowSize = static_cast<ptrdiff_t>(windowFrames * sizeof(Frame));
+    memset(m_analysisFrames, 0, windowSize);
+
+    // Window bounds relative to playedPos (buffer positions are free-running, so compare differences)
+    ptrdiff_t start = m_analysisOffsetBytes;
+    ptrdiff_t end = start + windowSize;
+    ptrdiff_t fileStart = static_cast<ptrdiff_t>(m_lastFileMarkerPos - playedPos);
+    const FileMarker *nextMarker = m_fileMarkers.front();
+    ptrdiff_t clippedStart = std::max(start, fileStart);
+    ptrdiff_t clippedEnd = nextMarker != nullptr ? std::min(end, static_cast<ptrdiff_t>(nextMarker->bufferPos - playedPos)) : end;
+
+    if (clippedStart < clippedEnd)
+    {
+        // The ring buffer's read position is already past the frames just played
+        ptrdiff_t readOffset = static_cast<ptrdiff_t>(m_totalBufferReadPos - playedPos);
+        m_ringBuffer.peek(clippedStart - readOffset, reinterpret_cast<uint8_t *>(m_analysisFrames) + (clippedStart - start),
+                          static_cast<size_t>(clippedEnd - clippedStart));
+    }
+    return static_cast<int32_t>(windowFrames);
+}
+
+// Get a snapshot of the audio buffer telemetry
+AudioPlayer::BufferStats AudioPlayer::getBufferStats() const
+{
+    BufferStats stats;
+    stats.capacity = m_ringBuffer.capacity();
+    stats.isInPsram = m_ringBuffer.isInPsram();
+    stats.currentFill = m_ringBuffer.available();
+    stats.highWatermark = m_highWatermark.load(std::memory_order_relaxed);
+    stats.lowWatermark = m_lowWatermark.load(std::memory_order_relaxed);
+    stats.underrunCount = m_underrunCount.load(std::memory_order_relaxed);
+    stats.callbackCount = m_callbackCount.load(std::memory_order_relaxed);
+
+    // No playback has been sampled yet
+    if (stats.callbackCount == 0)
+    {
+        stats.lowWatermark = 0;
+    }
+    return stats;
+}
 
-    return frame_count;
+// Reset the watermarks and counters
+void AudioPlayer::resetBufferStats()
+{
+    m_highWatermark.store(0, std::memory_order_relaxed);
+    m_lowWatermark.store(SIZE_MAX, std::memory_order_relaxed);
+    m_underrunCount.store(0, std::memory_order_relaxed);
+    m_callbackCount.store(0, std::memory_order_relaxed);
 }
 
-// Fill the audio buffer with data from the current file or start the next file
+// Fire the start/end callbacks for every marker the playback position has reached, in buffer order
+void AudioPlayer::handleFileMarkers()
+{
+    const FileMarker *marker;
+    const FileMarker *heldStart = nextHeldStartMarker(); // Stays queued until its start time
+    while ((marker = m_fileMarkers.front()) != nullptr && m_totalBufferReadPos >= marker->bufferPos && marker != heldStart)
+    {
+        m_isInFile = marker->isStart;
+        m_lastFileMarkerPos = marker->bufferPos;
+        m_pendingCorrectionFrames.store(0, std::memory_order_relaxed); // Corrections belong to the file they were made for
+        m_trackCorrectionFrames = 0;
+        if (marker->isStart)
+        {
+            m_playbackStartTime = m_clock.millis();
+            m_currentPlayingTrackId.store(marker->trackId, std::memory_order_relaxed);
+            m_bytesPlayed = 0; // Reset m_bytesPlayed to zero when starting a new file
+
+            if (m_playbackStartCallback)
+            {
+                m_playbackStartCallback(marker->trackId, trackPath(marker->trackId));
+            }
+            // Keep: for debuug: Serial.printf("AudioPlayer::handleFileMarkers() FOUND FILE START MARKER: m_totalBufferReadPos (%zu) >= bufferPos (%zu), starting playback of track %u: %s\n", m_totalBufferReadPos, marker->bufferPos, marker->trackId, trackPath(marker->trackId).c_str());
+        }
+        else
+        {
+            if (m_playbackEndCallback)
+            {
+                m_playbackEndCallback(marker->trackId, trackPath(marker->trackId));
+            }
+            // Keep: for debuug: Serial.printf("AudioPlayer::handleFileMarkers() FOUND FILE END MARKER: m_totalBufferReadPos (%zu) >= bufferPos (%zu), ending playback of track %u: %s\n", m_totalBufferReadPos, marker->bufferPos, marker->trackId, trackPath(marker->trackId).c_str());
+        }
+        m_fileMarkers.pop();
+    }
+}
+
+// Fill the audio buffer with data from the current file or start the next file.
+// Runs only on the producer task. Each pass needs room for a full chunk so no file data is ever dropped,
+// and room for an end and a start marker so a file transition can always be recorded.
 void AudioPlayer::fillBuffer()
 {
-    while (m_bufferFilled < AUDIO_BUFFER_SIZE)
+    while (m_ringBuffer.freeSpace() >= FILE_READ_CHUNK_SIZE && m_fileMarkers.freeSlots() >= 2)
     {
-        if (!audioFile || !audioFile.available())
+        if (!audioFile || (m_dataBytesRemaining == 0 && m_decodedPos >= m_decodedFrames))
         {
             if (audioFile)
             {
-                // Add end-of-file transition for the current file
-                m_fileEndBufferPos = m_totalBufferWritePos;
-                m_fileEndPath = m_currentBufferingFilePath;
-                // Keep: for debuug: Serial.printf("AudioPlayer::fillBuffer() ADDING FILE END MARKER: m_fileEndBufferPos: %zu, m_fileEndPath: %s\n", m_fileEndBufferPos, m_fileEndPath.c_str());
-                audioFile.close();
+                // Add end-of-file transition for a file with no audio (bufferNextChunk() adds the others')
+                m_fileMarkers.push({m_totalBufferWritePos, false, m_currentBufferingTrackId});
+                // Keep: for debuug: Serial.printf("AudioPlayer::fillBuffer() ADDING FILE END MARKER: bufferPos: %zu, track: %u\n", m_totalBufferWritePos, m_currentBufferingTrackId);
+                audioFile.reset();
             }
 
             if (!startNextFile())
@@ -163,55 +637,100 @@ void AudioPlayer::fillBuffer()
                 break;
             }
         }
-        else
+        else if (!bufferNextChunk())
         {
-            uint8_t audioData[512];
-            size_t bytesRead = audioFile.read(audioData, sizeof(audioData));
-            if (bytesRead > 0)
-            {
-                writeToBuffer(audioData, bytesRead);
-            }
-            else
-            {
-                // Handle unexpected end of file
+            // Handle unexpected end of file
 
-                // Add end-of-file transition for the current file
-                m_fileEndBufferPos = m_totalBufferWritePos;
-                m_fileEndPath = m_currentBufferingFilePath;
-                // Keep: for debuug: Serial.printf("AudioPlayer::fillBuffer() ADDING FILE END MARKER (2): m_fileEndBufferPos: %zu, m_fileEndPath: %s\n", m_fileEndBufferPos, m_fileEndPath.c_str());
-                audioFile.close();
-            }
+            // Add end-of-file transition for the current file
+            m_fileMarkers.push({m_totalBufferWritePos, false, m_currentBufferingTrackId});
+            // Keep: for debuug: Serial.printf("AudioPlayer::fillBuffer() ADDING FILE END MARKER (2): bufferPos: %zu, track: %u\n", m_totalBufferWritePos, m_currentBufferingTrackId);
+            audioFile.reset();
         }
     }
 }
 
-// Write audio data to the circular buffer
-void AudioPlayer::writeToBuffer(const uint8_t *audioData, size_t dataSize)
+// Move the next piece of the current file into the buffer: decode more of the file if everything decoded so far
+// has been buffered, then convert as many decoded frames as the ring buffer has room for.
+// Returns false if the file couldn't be read.
+bool AudioPlayer::bufferNextChunk()
 {
-    // The circular buffer allows for continuous writing and reading without shuffling data.
-    // When the end of the buffer is reached, it wraps around to the beginning.
+    if (m_decodedPos >= m_decodedFrames && !decodeNextChunk())
+    {
+        return false;
+    }
+
+    // Take only as many decoded frames as will fit in the ring buffer once converted
+    size_t outputFrames = std::min(CONVERT_BUFFER_FRAMES, m_ringBuffer.freeSpace() / sizeof(Frame));
+    size_t inputFrames = std::min(m_decodedFrames - m_decodedPos, m_converter.maxInputFrames(outputFrames));
+    if (inputFrames == 0)
+    {
+        return true; // Not enough room yet; try again once the consumer has read some more
+    }
 
-    size_t spaceAvailable = AUDIO_BUFFER_SIZE - m_bufferFilled;
+    const int16_t *input = m_decodeBuffer + m_decodedPos * m_currentNumChannels;
+    const uint8_t *output = reinterpret_cast<const uint8_t *>(input);
+    size_t outputBytes = inputFrames * sizeof(Frame);
+    if (!m_converter.isPassthrough())
+    {
+        size_t framesConverted = m_converter.convert(input, inputFrames, m_convertBuffer, CONVERT_BUFFER_FRAMES);
+        output = reinterpret_cast<const uint8_t *>(m_convertBuffer);
+        outputBytes = framesConverted * sizeof(Frame);
+    }
+    m_decodedPos += inputFrames;
 
-    // Write audio data if available
-    if (audioData && dataSize > 0 && spaceAvailable > 0)
+    // The file's last frames: add its end marker before them, so the consumer can't read to the end of the file
+    // before the marker is there and count it as an underrun. It isn't handled until the frames before it are read.
+    if (m_dataBytesRemaining == 0 && m_decodedPos >= m_decodedFrames)
     {
-        size_t bytesToWrite = std::min(dataSize, spaceAvailable);
-        size_t firstChunkSize = std::min(bytesToWrite, AUDIO_BUFFER_SIZE - m_writePos);
-        memcpy(m_audioBuffer + m_writePos, audioData, firstChunkSize);
-        m_writePos = (m_writePos + firstChunkSize) % AUDIO_BUFFER_SIZE;
-        m_bufferFilled += firstChunkSize;
+        m_fileMarkers.push({m_totalBufferWritePos + outputBytes, false, m_currentBufferingTrackId});
+        audioFile.reset();
+    }
+    writeToBuffer(output, outputBytes);
+    return true;
+}
 
-        // Handle buffer wrap-around
-        if (firstChunkSize < bytesToWrite)
+// Read the next piece of the current file's data chunk and decode it to 16-bit PCM in m_decodeBuffer.
+// PCM is read straight into the decode buffer; IMA-ADPCM is read one block at a time and decoded.
+// Returns false if the file couldn't be read.
+bool AudioPlayer::decodeNextChunk()
+{
+    m_decodedPos = 0;
+    m_decodedFrames = 0;
+
+    // Stop at the end of the data chunk so trailing chunks (LIST, id3, ...) are never played
+    if (m_currentAudioFormat == ImaAdpcmDecoder::FORMAT_IMA_ADPCM)
+    {
+        size_t bytesToRead = std::min(static_cast<size_t>(m_currentBlockAlign), static_cast<size_t>(m_dataBytesRemaining));
+        size_t bytesRead = audioFile->read(m_blockBuffer, bytesToRead);
+        if (bytesRead == 0)
         {
-            size_t secondChunkSize = bytesToWrite - firstChunkSize;
-            memcpy(m_audioBuffer, audioData + firstChunkSize, secondChunkSize);
-            m_writePos = secondChunkSize;
-            m_bufferFilled += secondChunkSize;
+            return false;
         }
+        m_dataBytesRemaining -= bytesRead;
+        m_decodedFrames = ImaAdpcmDecoder::decodeBlock(m_blockBuffer, bytesRead, m_currentNumChannels, m_decodeBuffer);
+    }
+    else
+    {
+        size_t bytesToRead = std::min(FILE_READ_CHUNK_SIZE, static_cast<size_t>(m_dataBytesRemaining));
+        size_t bytesRead = audioFile->read(reinterpret_cast<uint8_t *>(m_decodeBuffer), bytesToRead);
+        if (bytesRead == 0)
+        {
+            return false;
+        }
+        m_dataBytesRemaining -= bytesRead;
+        m_decodedFrames = bytesRead / m_currentBlockAlign;
+    }
+    return true;
+}
 
-        m_totalBufferWritePos += bytesToWrite;
+// Write audio data to the circular buffer
+void AudioPlayer::writeToBuffer(const uint8_t *audioData, size_t dataSize)
+{
+    // The circular buffer allows for continuous writing and reading without shuffling data.
+    // When the end of the buffer is reached, it wraps around to the beginning.
+    if (audioData && dataSize > 0)
+    {
+        m_totalBufferWritePos += m_ringBuffer.write(audioData, dataSize);
     }
 }
 
@@ -220,18 +739,23 @@ bool AudioPlayer::startNextFile()
 {
     if (audioFile)
     {
-        audioFile.close();
+        audioFile.reset();
     }
 
-    if (audioQueue.empty())
+    uint32_t nextTrackId;
+    String nextFile;
     {
-        m_currentBufferingFilePath = "";
-        m_bytesPlayed = 0; // Reset byte counter to avoid overflows
-        return false;
-    }
+        std::lock_guard<std::mutex> lock(m_mutex); // playNext() may be pushing from the main loop
+        if (audioQueue.empty())
+        {
+            m_currentBufferingTrackId = NO_TRACK;
+            return false;
+        }
 
-    std::string nextFile = audioQueue.front();
-    audioQueue.pop(); // Remove the file from the queue after retrieving it
+        nextTrackId = audioQueue.front();
+        audioQueue.pop(); // Remove the file from the queue after retrieving it
+        nextFile = trackPath(nextTrackId);
+    }
 
     audioFile = m_sdCardManager.openFile(nextFile.c_str());
     if (!audioFile)
@@ -240,49 +764,87 @@ bool AudioPlayer::startNextFile()
         return startNextFile(); // Try the next file in the queue
     }
 
-    // Skip WAV header (simplified approach)
-    // 44 bytes is minimum, the skull files have closer to 128 bytes, and skipping a bit more just skips some blank audio at the start.
-    // Not skipping enough header will cause the header to be played, often rewsulting in a click at the start of the audio.
-    // There's a proper way to parse out the header, but it's involved and this is good enough.
-    audioFile.seek(128);
-
-    m_currentBufferingFilePath = String(nextFile.c_str());
-    m_fileStartBufferPos = m_totalBufferWritePos;
-    m_fileStartPath = m_currentBufferingFilePath;
-    // Keep: for debuug: Serial.printf("AudioPlayer::startNextFile() ADDING FILE START MARKER: m_fileStartBufferPos: %zu, m_fileStartPath: %s\n", m_fileStartBufferPos, m_fileStartPath.c_str());
+    // Parse the WAV header to find exactly where the audio starts and how long it is.
+    // The header length varies between files (44 bytes, or more when there's a LIST chunk), so skipping
+    // a fixed amount either plays header bytes as a click or cuts off the start of the audio.
+    WavFormat format;
+    FileByteSource source(*audioFile);
+    WavParseResult result = WavHeaderParser::parse(source, audioFile->size(), format);
+    if (result != WavParseResult::OK)
+    {
+        Serial.printf("AudioPlayer::startNextFile() Skipping %s: %s\n", nextFile.c_str(), WavHeaderParser::resultToString(result));
+        audioFile.reset();
+        return startNextFile(); // Try the next file in the queue
+    }
+    if (!isSupportedFormat(format) || !m_converter.configure(format.sampleRate, format.numChannels, AUDIO_SAMPLE_RATE))
+    {
+        Serial.printf("AudioPlayer::startNextFile() Skipping %s: unsupported format %u, %u Hz, %u-bit, %u channel(s), %u byte blocks. Expected %u-bit PCM or IMA-ADPCM (blocks up to %u bytes), mono or stereo, %u-%u Hz.\n",
+                      nextFile.c_str(), format.audioFormat, format.sampleRate, format.bitsPerSample, format.numChannels, format.blockAlign,
+                      AUDIO_BIT_DEPTH, MAX_ADPCM_BLOCK_SIZE, AudioFormatConverter::MIN_SOURCE_SAMPLE_RATE, AudioFormatConverter::MAX_SOURCE_SAMPLE_RATE);
+        audioFile.reset();
+        return startNextFile(); // Try the next file in the queue
+    }
+    m_currentAudioFormat = format.audioFormat;
+    m_currentNumChannels = format.numChannels;
+    m_currentBlockAlign = format.blockAlign;
+    m_decodedPos = 0;
+    m_decodedFrames = 0;
+    m_dataBytesRemaining = format.dataSize;
+
+    m_currentBufferingTrackId = nextTrackId;
+    m_fileMarkers.push({m_totalBufferWritePos, true, m_currentBufferingTrackId});
+    // Keep: for debuug: Serial.printf("AudioPlayer::startNextFile() ADDING FILE START MARKER: bufferPos: %zu, track: %u, path: %s\n", m_totalBufferWritePos, m_currentBufferingTrackId, nextFile.c_str());
     return true;
 }
 
+// Check whether a file's sample encoding can be decoded.
+// The sample rate and channel count are checked by AudioFormatConverter::configure().
+bool AudioPlayer::isSupportedFormat(const WavFormat &format)
+{
+    if (format.audioFormat == WavHeaderParser::FORMAT_PCM)
+    {
+        return format.bitsPerSample == AUDIO_BIT_DEPTH;
+    }
+    if (format.audioFormat == ImaAdpcmDecoder::FORMAT_IMA_ADPCM)
+    {
+        // Whole blocks are decoded into m_decodeBuffer, so they must fit
+        return format.bitsPerSample == ImaAdpcmDecoder::BITS_PER_SAMPLE && format.numChannels <= 2 &&
+               format.blockAlign <= MAX_ADPCM_BLOCK_SIZE &&
+               ImaAdpcmDecoder::samplesPerBlock(format.blockAlign, format.numChannels) > 0;
+    }
+    return false;
+}
+
 // Set the muted state of the audio player
 void AudioPlayer::setMuted(bool muted)
 {
-    m_muted = muted;
+    m_muted.store(muted, std::memory_order_relaxed);
 }
 
 // Check if audio is currently playing
 bool AudioPlayer::isAudioPlaying() const
 {
-    return m_isAudioPlaying;
+    return m_isAudioPlaying.load(std::memory_order_relaxed);
 }
 
 // Get the current playback time based on bytes played
 // Calculated based on bytes played and not wall clock time becasue various things like the speed of the
 // calls to provideAudioFrames, playback rate, latency, etc can cause the wall clock time to be inaccurate.
 // Basing it on the actual bytes read adjusts for a lot of these issues.
+// Since only the data chunk is buffered, time 0 is exactly the first sample of the file.
 unsigned long AudioPlayer::getPlaybackTime() const
 {
-    if (!m_isAudioPlaying)
+    if (!m_isAudioPlaying.load(std::memory_order_relaxed))
     {
         return 0;
     }
 
-    double secondsPlayed = static_cast<double>(m_bytesPlayed) / AUDIO_BYTES_PER_SECOND;
-
-    return static_cast<unsigned long>(secondsPlayed * 1000.0);
+    return static_cast<unsigned long>(static_cast<uint64_t>(m_bytesPlayed) * 1000 / AUDIO_BYTES_PER_SECOND);
 }
 
 // Get the file path of the currently playing audio
 String AudioPlayer::getCurrentlyPlayingFilePath() const
 {
-    return m_currentPlayingFilePath;
+    uint32_t trackId = m_currentPlayingTrackId.load(std::memory_order_relaxed);
+    return trackId == NO_TRACK ? String("") : trackPath(trackId);
 }
\ No newline at end of file
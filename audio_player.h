@@ -1,27 +1,95 @@
 #ifndef AUDIO_PLAYER_H
 #define AUDIO_PLAYER_H
 
-#include "SD.h"
 #include "sd_card_manager.h"
+#include "platform.h"
 #include "SoundData.h" // For Frame definition
+#include "audio_ring_buffer.h"
+#include "wav_header_parser.h"
+#include "audio_format_converter.h"
+#include "latency_histogram.h"
 #include <vector>
 #include <queue>
 #include <string>
 #include <mutex>
 #include <stdint.h>
+#include <atomic>
 #include <Arduino.h>
 
 // AudioPlayer class manages audio playback from SD card files
 class AudioPlayer
 {
 public:
-    // Constructor initializes the AudioPlayer with SDCardManager
-    AudioPlayer(SDCardManager &sdCardManager);
+    static constexpr size_t DEFAULT_AUDIO_BUFFER_SIZE = 8192; // Default size of the circular audio buffer (~46ms of audio)
 
-    // Add a new audio file to the playback queue
-    void playNext(String filePath);
+    // Audio format sent to A2DP. 16-bit PCM or IMA-ADPCM files at other sample rates, or mono, are decoded and
+    // converted to this as they're buffered.
+    static constexpr uint32_t AUDIO_SAMPLE_RATE = 44100;
+    static constexpr uint8_t AUDIO_BIT_DEPTH = 16;
+    static constexpr uint8_t AUDIO_NUM_CHANNELS = 2;
+    static constexpr uint32_t AUDIO_BYTES_PER_SECOND = AUDIO_SAMPLE_RATE * (AUDIO_BIT_DEPTH / 8) * AUDIO_NUM_CHANNELS;
+
+    // Constructor initializes the AudioPlayer with SDCardManager, the clock it times playback on and the tasks its
+    // producer runs on. bufferSize is rounded up to a power of two; usePsram places the buffer in PSRAM when the board has it.
+    AudioPlayer(SDCardManager &sdCardManager, Clock &clock, Tasks &tasks, size_t bufferSize = DEFAULT_AUDIO_BUFFER_SIZE,
+                bool usePsram = false);
+
+    // Start the producer task that reads audio files from the SD card into the ring buffer
+    void begin();
+
+    // Offset the frames given to the frames provided callback from the frames being played, in milliseconds.
+    // Positive values look ahead into the buffered audio, negative values look back at audio already played.
+    // Lets the jaw be driven in sync with the speaker despite Bluetooth latency and servo slew.
+    // Clamped so the offset plus the analysis window fits in half the buffer. Call before begin().
+    void setAnalysisLookahead(long lookaheadMs);
+
+    // Track ID of "no file": never assigned to a queued file
+    static constexpr uint32_t NO_TRACK = 0;
+
+    // Add a new audio file to the playback queue.
+    // Returns the track ID that identifies this play of the file in the callbacks, or NO_TRACK if it wasn't queued.
+    uint32_t playNext(String filePath);
+
+    // Add a new audio file to the playback queue, holding its first sample until startMicros (Clock::micros()).
+    // The file is buffered meanwhile, so it starts on time and on the exact sample; silence plays while it waits.
+    // If the start time has already passed when the file comes up, it plays right away.
+    uint32_t playAt(String filePath, int64_t startMicros);
+
+    // How late a playAt() track's first sample was given to A2DP, in microseconds (negative: early).
+    // Returns false until the track has started, and once another playAt() track has started after it.
+    bool getStartLateness(uint32_t trackId, int32_t &lateMicros) const;
+
+    // Where playback of the current file is, averaged over the A2DP callbacks of the last PLAYBACK_POSITION_WINDOW_MICROS
+    // so the burstiness of the callbacks cancels out
+    struct PlaybackPosition
+    {
+        uint32_t trackId;         // File being played
+        int64_t atMicros;         // Clock::micros() of the measurement
+        int64_t positionMicros;   // Audio of the file handed to A2DP by then (drift corrections don't count)
+        int32_t correctionFrames; // Frames inserted less frames dropped in the file by then
+    };
+    static constexpr int64_t PLAYBACK_POSITION_WINDOW_MICROS = 500000;
+
+    // Get the latest playback position. Returns false if no file has played for a whole window yet.
+    bool getPlaybackPosition(PlaybackPosition &position) const;
+
+    // Correct drift against another player: insert (positive) or drop (negative) this many frames of the current file,
+    // replacing any correction still pending. One frame at a time, at most one per DRIFT_CORRECTION_SPACING_FRAMES,
+    // each spliced in by interpolating its neighbours so there's no click. Pending corrections end with the file.
+    void setDriftCorrection(int32_t frames);
+    static constexpr int32_t DRIFT_CORRECTION_SPACING_FRAMES = 882; // 20ms: corrects up to ~1100ppm, about 2 cents of pitch
 
-    // Provide audio frames to the audio output stream
+    // Drift correction telemetry
+    struct DriftCorrectionStats
+    {
+        uint32_t insertedFrames; // Frames inserted since start
+        uint32_t droppedFrames;  // Frames dropped since start
+        int32_t pendingFrames;   // Correction not made yet (positive: to insert)
+    };
+    DriftCorrectionStats getDriftCorrectionStats() const;
+
+    // Provide audio frames to the audio output stream.
+    // Called from the A2DP data callback: only copies out of the ring buffer, never blocks or touches the SD card.
     int32_t provideAudioFrames(Frame *frame, int32_t frame_count);
 
     // Check if audio is currently playing
@@ -36,9 +104,45 @@ public:
     // Get the file path of the currently playing audio
     String getCurrentlyPlayingFilePath() const;
 
-    // Callback types
-    typedef void (*PlaybackCallback)(const String &filePath);
-    typedef void (*AudioFramesProvidedCallback)(const String &, const Frame *, int32_t);
+    // Get the track ID of the currently playing audio (NO_TRACK if none)
+    uint32_t getCurrentlyPlayingTrackId() const { return m_currentPlayingTrackId; }
+
+    // Audio buffer telemetry, sampled by the A2DP callback just before each read.
+    // Watermarks only cover callbacks made while a file is playing, so idle time doesn't skew them.
+    struct BufferStats
+    {
+        size_t capacity;         // Actual buffer size in bytes
+        bool isInPsram;          // True if the buffer lives in PSRAM
+        size_t currentFill;      // Bytes buffered right now
+        size_t highWatermark;    // Most bytes buffered at the start of a callback
+        size_t lowWatermark;     // Fewest bytes buffered at the start of a callback
+        uint32_t underrunCount;  // Callbacks that ran out of data in the middle of a file
+        uint32_t callbackCount;  // Callbacks made while a file was playing
+    };
+
+    // Get a snapshot of the audio buffer telemetry
+    BufferStats getBufferStats() const;
+
+    // Reset the watermarks and counters (e.g. after changing the buffer configuration)
+    void resetBufferStats();
+
+    // Time spent in each stage of provideAudioFrames(), from the cycle counter: copying out of the ring buffer (with
+    // the silence, drift splices, padding and muting), the frames provided callback that drives the animator (with
+    // its analysis window), and the playback start and end callbacks at file transitions. Each counts the calls where
+    // that stage alone took longer than CALLBACK_DEADLINE_MICROS.
+    static constexpr uint32_t CALLBACK_DEADLINE_MICROS = 128 * 1000000 / AUDIO_SAMPLE_RATE; // A2DP asks for 128 frames at a time
+    const DeadlineHistogram &getCopyTimeHistogram() const { return m_copyTime; }
+    const DeadlineHistogram &getAnimatorTimeHistogram() const { return m_animatorTime; }
+    const DeadlineHistogram &getPlaybackCallbackTimeHistogram() const { return m_playbackCallbackTime; }
+
+    // Time each producer pass of fillBuffer() takes. It runs outside the A2DP callback, but a pass that takes longer
+    // than the buffered audio lasts ends in an underrun.
+    const LatencyHistogram &getFillBufferTimeHistogram() const { return m_fillBufferTime; }
+
+    // Callback types. Called from the A2DP callback; files are identified by the track ID playNext() returned.
+    // filePath refers to the player's track table and is only valid during the call.
+    typedef void (*PlaybackCallback)(uint32_t trackId, const String &filePath);
+    typedef void (*AudioFramesProvidedCallback)(uint32_t trackId, const Frame *, int32_t);
 
     // Setters for callbacks
     void setPlaybackStartCallback(PlaybackCallback callback) { m_playbackStartCallback = callback; }
@@ -47,51 +151,147 @@ public:
 
 private:
     static constexpr const char *IDENTIFIER = "AudioPlayer";
-    static constexpr size_t BUFFER_POS_UNDEFINED = static_cast<size_t>(-1);
-    static constexpr size_t AUDIO_BUFFER_SIZE = 8192; // Size of the circular audio buffer
+    static constexpr size_t FILE_READ_CHUNK_SIZE = 512; // Bytes read from the SD card at a time
+    static constexpr size_t CONVERT_BUFFER_FRAMES = 512; // Output frames converted at a time for non-44.1kHz-stereo files
+    static constexpr uint16_t MAX_ADPCM_BLOCK_SIZE = 1024; // Largest IMA-ADPCM block we decode (the usual encoder default)
+    static constexpr size_t DECODE_BUFFER_SAMPLES = 2048;  // Holds a decoded 1024-byte ADPCM block (mono: 2041 samples, stereo: 2034)
+    static constexpr size_t ANALYSIS_BUFFER_FRAMES = 512;  // Most frames handed to the frames provided callback when a lookahead is set
 
-    // Hardcoded audio format specifications
-    static constexpr uint32_t AUDIO_SAMPLE_RATE = 44100;
-    static constexpr uint8_t AUDIO_BIT_DEPTH = 16;
-    static constexpr uint8_t AUDIO_NUM_CHANNELS = 2;
-    static constexpr double AUDIO_BYTES_PER_SECOND = AUDIO_SAMPLE_RATE * (AUDIO_BIT_DEPTH / 8.0) * AUDIO_NUM_CHANNELS;
+    // Producer task settings. The A2DP callback runs on core 0 with the Bluetooth stack,
+    // so SD reads are done on core 1 at a priority above loop().
+    static constexpr uint32_t PRODUCER_TASK_STACK_SIZE = 4096;
+    static constexpr uint32_t PRODUCER_TASK_PRIORITY = 5;
+    static constexpr int PRODUCER_TASK_CORE = 1;
+    static constexpr uint32_t PRODUCER_IDLE_WAIT_MS = 10; // Max time the producer sleeps when it isn't woken by the consumer
+
+    // File start/end transition, queued by the producer at the buffer position where it occurs.
+    // Plain data, so passing markers to the consumer never allocates.
+    struct FileMarker
+    {
+        size_t bufferPos;
+        bool isStart;
+        uint32_t trackId;
+    };
+    static constexpr size_t FILE_MARKER_QUEUE_SIZE = 8;
+
+    // Paths of the tracks that are queued, buffering or playing, in slot trackId % TRACK_TABLE_SIZE.
+    // playNext() refuses files beyond MAX_QUEUED_TRACKS, so a slot is never reused while its track is still live:
+    // at most MAX_QUEUED_TRACKS queued + FILE_MARKER_QUEUE_SIZE / 2 in the buffer + 1 playing < TRACK_TABLE_SIZE.
+    static constexpr size_t TRACK_TABLE_SIZE = 16;
+    static constexpr size_t MAX_QUEUED_TRACKS = 8;
+    static_assert(MAX_QUEUED_TRACKS + FILE_MARKER_QUEUE_SIZE / 2 + 1 < TRACK_TABLE_SIZE, "Track table too small");
+
+    // Producer task entry point: refills the ring buffer whenever the consumer has made room
+    static void producerTask(void *param);
 
-    // Fill the audio buffer with data from the current file or start the next file
+    // Producer only: fill the audio buffer with data from the current file or start the next file
     void fillBuffer();
 
+    // Consumer only: fire start/end callbacks for markers the playback position has reached
+    void handleFileMarkers();
+
+    // Consumer only: record the buffer fill level seen at the start of a callback
+    void recordBufferFill(size_t fill);
+
+    // Consumer only: record the time since startCycles (a cycle counter reading) in a stage's histogram.
+    // Returns the cycle counter now, where the next stage starts.
+    uint32_t recordStageTime(DeadlineHistogram &histogram, uint32_t startCycles);
+
+    // Consumer only: frames of silence to play before the next file's first sample, if that file has a start time
+    // and is next in the buffer. Never more than frameCount; records the start lateness once the file starts.
+    int32_t framesUntilScheduledStart(int32_t frameCount, int64_t nowMicros);
+
+    // Consumer only: +1 to insert a frame into this request, -1 to drop one, 0 for neither.
+    // Only when the whole request, and the frame to drop, are buffered audio of the current file.
+    int32_t takeDriftCorrection(int32_t frameCount, size_t bytesToRead);
+
+    // Splice a frame in the middle of frameCount frames, of which the first frameCount - 1 are filled
+    static void insertFrame(Frame *frames, int32_t frameCount);
+
+    // Splice out the middle one of frameCount frames, shifting next in at the end
+    static void dropFrame(Frame *frames, int32_t frameCount, const Frame &next);
+
+    // Consumer only: add a callback's playback position to the current window, publishing it once the window is full
+    void recordPlaybackPosition(uint32_t trackId, int64_t atMicros, int64_t frame);
+
+    // Consumer only: the next file's start marker if that file has a start time it hasn't been released at yet.
+    // The marker stays queued, and no audio past it is read, until then.
+    const FileMarker *nextHeldStartMarker() const;
+
+    // Add a file to the playback queue; startMicros is its Clock::micros() start time, or 0 to play as soon as it comes up
+    uint32_t queueTrack(const String &filePath, int64_t startMicros);
+
+    // Consumer only: fill m_analysisFrames with the audio m_analysisOffsetBytes away from the frames just played
+    int32_t fillAnalysisFrames(size_t playedPos, int32_t frameCount);
+
     // Start playing the next file in the queue
     bool startNextFile();
 
+    // Producer only: convert and buffer the next piece of the current file, decoding more as needed
+    bool bufferNextChunk();
+
+    // Producer only: read and decode the next piece of the current file into m_decodeBuffer
+    bool decodeNextChunk();
+
+    // Check whether a file's sample encoding can be decoded
+    static bool isSupportedFormat(const WavFormat &format);
+
     // Write audio data to the circular buffer
     void writeToBuffer(const uint8_t *audioData, size_t dataSize);
 
+    // Path of a live track
+    const String &trackPath(uint32_t trackId) const { return m_trackPaths[trackId % TRACK_TABLE_SIZE]; }
+
     // Buffer management
-    String m_currentBufferingFilePath;
-    uint8_t m_audioBuffer[AUDIO_BUFFER_SIZE];
-    size_t m_writePos;
-    size_t m_readPos;
-    size_t m_bufferFilled;
-     
+    // The producer task writes into m_ringBuffer and the A2DP callback reads from it; neither side locks.
+    uint32_t m_currentBufferingTrackId; // Producer only
+    AudioRingBuffer m_ringBuffer;
+    SpscQueue<FileMarker, FILE_MARKER_QUEUE_SIZE> m_fileMarkers;
+    Tasks::Handle m_producerTaskHandle;
+
     // Total number of bytes filled in the buffer since start
+    // (write position is owned by the producer, read position by the consumer)
     size_t m_totalBufferWritePos;
     size_t m_totalBufferReadPos;
+    size_t m_lastFileMarkerPos; // Consumer only: buffer position of the last file transition played
+
+    // Lookahead for the frames provided callback (see setAnalysisLookahead())
+    ptrdiff_t m_analysisOffsetBytes;
+    Frame m_analysisFrames[ANALYSIS_BUFFER_FRAMES];
 
     // Playback state
-    File audioFile;
-    String m_currentPlayingFilePath;
-    bool m_isAudioPlaying;
-    bool m_muted;
+    std::unique_ptr<PlatformFile> audioFile;
+    uint32_t m_dataBytesRemaining; // Producer only: bytes left in the current file's data chunk
+    uint16_t m_currentBlockAlign;  // Producer only: bytes per source frame (PCM) or block (ADPCM) of the current file
+    uint16_t m_currentAudioFormat; // Producer only: WAV format code of the current file
+    uint16_t m_currentNumChannels; // Producer only: channels in the current file
+
+    // Decode and conversion pipeline (producer only): SD -> m_blockBuffer -> decode -> m_decodeBuffer -> convert -> ring buffer
+    alignas(4) uint8_t m_blockBuffer[MAX_ADPCM_BLOCK_SIZE];
+    alignas(4) int16_t m_decodeBuffer[DECODE_BUFFER_SAMPLES];
+    size_t m_decodedFrames; // Frames in m_decodeBuffer
+    size_t m_decodedPos;    // Frames of m_decodeBuffer already buffered
+    AudioFormatConverter m_converter;
+    int16_t m_convertBuffer[CONVERT_BUFFER_FRAMES * 2];
+    std::atomic<uint32_t> m_currentPlayingTrackId; // Written by the consumer
+    std::atomic<bool> m_isAudioPlaying;            // Written by the consumer, read by the skit and housekeeping tasks
+    std::atomic<bool> m_muted;                     // Written by the animator's speaking state, read by the consumer
 
     // Timing
     unsigned long m_playbackStartTime = 0;
 
-    // Audio queue
-    std::queue<std::string> audioQueue;
+    // Audio queue: track IDs waiting to be buffered, and the paths of all live tracks
+    std::queue<uint32_t> audioQueue;
+    String m_trackPaths[TRACK_TABLE_SIZE];
+    int64_t m_trackStartMicros[TRACK_TABLE_SIZE]; // playAt() start times (Clock::micros()), 0 for playNext() tracks
+    uint32_t m_lastTrackId; // Last ID handed out by playNext()
 
-    // SD card manager
+    // SD card manager, and the platform's clock and tasks
     SDCardManager &m_sdCardManager;
+    Clock &m_clock;
+    Tasks &m_tasks;
 
-    // Thread safety
+    // Thread safety: guards audioQueue and m_trackPaths between playNext() and the producer task (never taken by the consumer)
     std::mutex m_mutex;
 
     // Callbacks
@@ -99,13 +299,47 @@ private:
     PlaybackCallback m_playbackEndCallback;
     AudioFramesProvidedCallback m_audioFramesProvidedCallback;
 
-    size_t m_fileStartBufferPos;
-    String m_fileStartPath;
-    size_t m_fileEndBufferPos;
-    String m_fileEndPath;
-
     size_t m_bytesPlayed;  // Total bytes played for the current file
 
+    // Buffer telemetry (written by the consumer, read from the main loop)
+    bool m_isInFile; // Consumer only: between a file's start and end markers
+    std::atomic<size_t> m_highWatermark;
+    std::atomic<size_t> m_lowWatermark;
+    std::atomic<uint32_t> m_underrunCount;
+    std::atomic<uint32_t> m_callbackCount;
+
+    // Callback stage timing (written by the consumer, which runs on the Bluetooth stack's pinned task, so the cycle
+    // counter is consistent across a call) and producer pass timing (written by the producer)
+    DeadlineHistogram m_copyTime;
+    DeadlineHistogram m_animatorTime;
+    DeadlineHistogram m_playbackCallbackTime;
+    LatencyHistogram m_fillBufferTime;
+    uint32_t m_cpuMhz; // Cycle counter ticks per microsecond
+
+    uint32_t m_releasedTrackId; // Consumer only: the last playAt() track whose start time was reached
+
+    // Start timing of the last playAt() track to start (written by the consumer, the track ID last)
+    std::atomic<int32_t> m_lastScheduledStartLateMicros;
+    std::atomic<uint32_t> m_lastScheduledStartTrackId;
+
+    // Drift correction (see setDriftCorrection())
+    std::atomic<int32_t> m_pendingCorrectionFrames; // Set by the main loop, counted down by the consumer
+    int32_t m_framesSinceCorrection;                // Consumer only
+    int32_t m_trackCorrectionFrames;                // Consumer only: net frames inserted into the current file
+    std::atomic<uint32_t> m_insertedFrames;
+    std::atomic<uint32_t> m_droppedFrames;
+
+    // Playback position window (consumer only) and the last one published. The consumer publishes under a sequence
+    // count that is odd while it writes, so the main loop can tell if it read a torn position.
+    uint32_t m_positionTrackId;
+    int64_t m_positionBaseMicros;
+    int64_t m_positionBaseFrame;
+    int64_t m_positionSumMicros; // Sums relative to the base, so they stay small
+    int64_t m_positionSumFrames;
+    uint32_t m_positionSamples;
+    PlaybackPosition m_position;
+    std::atomic<uint32_t> m_positionSequence;
+
     // New method to reset byte counters
     void resetByteCounters();
 };
@@ -0,0 +1,183 @@
+/*
+    Lock-free single-producer/single-consumer byte ring buffer used between the AudioPlayer's
+    SD card producer task and the A2DP data callback.
+
+    The producer owns m_writeCount and the consumer owns m_readCount. Each side publishes its counter
+    with release ordering after touching the bytes and reads the other side's counter with acquire
+    ordering before touching them, so the bytes in [readCount, writeCount) are always fully written
+    when the consumer sees them and never overwritten while the consumer may still be copying them.
+    The producer also stays m_retainedSize bytes short of the read position, so the consumer can peek back
+    at that much of the data it has already read.
+*/
+
+#include "audio_ring_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#if defined(ESP_PLATFORM)
+#include <esp_heap_caps.h>
+#endif
+
+// Smallest capacity we'll shrink to when an allocation fails
+static constexpr size_t MIN_CAPACITY = 1024;
+
+// Round a capacity up to the next power of two (minimum 2)
+static size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 2;
+    while (result < value)
+    {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Allocate storage of the given size, from PSRAM if requested and available
+static uint8_t *allocateStorage(size_t size, bool usePsram, bool &isInPsram)
+{
+    isInPsram = false;
+#if defined(ESP_PLATFORM)
+    if (usePsram)
+    {
+        void *storage = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (storage != nullptr)
+        {
+            isInPsram = true;
+            return static_cast<uint8_t *>(storage);
+        }
+    }
+    return static_cast<uint8_t *>(heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+#else
+    (void)usePsram;
+    return static_cast<uint8_t *>(malloc(size));
+#endif
+}
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity, bool usePsram)
+    : m_buffer(nullptr), m_capacity(roundUpToPowerOfTwo(capacity)), m_retainedSize(0), m_isInPsram(false), m_writeCount(0), m_readCount(0)
+{
+    m_buffer = allocateStorage(m_capacity, usePsram, m_isInPsram);
+    while (m_buffer == nullptr && m_capacity > MIN_CAPACITY)
+    {
+        m_capacity >>= 1;
+        m_buffer = allocateStorage(m_capacity, usePsram, m_isInPsram);
+    }
+    if (m_buffer == nullptr)
+    {
+        m_capacity = 0; // Nothing could be allocated; every read and write will be a no-op
+    }
+    m_mask = m_capacity > 0 ? m_capacity - 1 : 0;
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+    // heap_caps_malloc() memory is released with free() as well
+    free(m_buffer);
+}
+
+// Producer only: copy up to dataSize bytes into the buffer
+size_t AudioRingBuffer::write(const uint8_t *data, size_t dataSize)
+{
+    size_t writeCount = m_writeCount.load(std::memory_order_relaxed);
+    size_t readCount = m_readCount.load(std::memory_order_acquire);
+    size_t used = (writeCount - readCount) + m_retainedSize;
+    size_t bytesToWrite = used >= m_capacity ? 0 : std::min(dataSize, m_capacity - used);
+    if (bytesToWrite == 0)
+    {
+        return 0;
+    }
+
+    // Copy in up to two pieces, handling wrap-around at the end of the storage
+    size_t writePos = writeCount & m_mask;
+    size_t firstChunkSize = std::min(bytesToWrite, m_capacity - writePos);
+    memcpy(m_buffer + writePos, data, firstChunkSize);
+    if (firstChunkSize < bytesToWrite)
+    {
+        memcpy(m_buffer, data + firstChunkSize, bytesToWrite - firstChunkSize);
+    }
+
+    m_writeCount.store(writeCount + bytesToWrite, std::memory_order_release);
+    return bytesToWrite;
+}
+
+// Consumer only: copy up to dataSize bytes out of the buffer
+size_t AudioRingBuffer::read(uint8_t *data, size_t dataSize)
+{
+    size_t readCount = m_readCount.load(std::memory_order_relaxed);
+    size_t writeCount = m_writeCount.load(std::memory_order_acquire);
+    size_t bytesToRead = std::min(dataSize, writeCount - readCount);
+    if (bytesToRead == 0)
+    {
+        return 0;
+    }
+
+    // Copy out in up to two pieces, handling wrap-around at the end of the storage
+    size_t readPos = readCount & m_mask;
+    size_t firstChunkSize = std::min(bytesToRead, m_capacity - readPos);
+    memcpy(data, m_buffer + readPos, firstChunkSize);
+    if (firstChunkSize < bytesToRead)
+    {
+        memcpy(data + firstChunkSize, m_buffer, bytesToRead - firstChunkSize);
+    }
+
+    m_readCount.store(readCount + bytesToRead, std::memory_order_release);
+    return bytesToRead;
+}
+
+// Consumer only: discard up to dataSize bytes
+size_t AudioRingBuffer::skip(size_t dataSize)
+{
+    size_t readCount = m_readCount.load(std::memory_order_relaxed);
+    size_t writeCount = m_writeCount.load(std::memory_order_acquire);
+    size_t bytesToSkip = std::min(dataSize, writeCount - readCount);
+    m_readCount.store(readCount + bytesToSkip, std::memory_order_release);
+    return bytesToSkip;
+}
+
+// Consumer only: copy bytes at an offset from the read position without consuming them
+size_t AudioRingBuffer::peek(ptrdiff_t offset, uint8_t *data, size_t dataSize) const
+{
+    size_t readCount = m_readCount.load(std::memory_order_relaxed);
+    size_t writeCount = m_writeCount.load(std::memory_order_acquire);
+
+    // Only the retained bytes behind the read position are safe from the producer (and none before the first write)
+    size_t history = std::min(m_retainedSize, readCount);
+    if (offset < 0 && static_cast<size_t>(-offset) > history)
+    {
+        return 0;
+    }
+
+    size_t peekCount = readCount + offset;
+    size_t ahead = writeCount - readCount;
+    if (offset > 0 && static_cast<size_t>(offset) >= ahead)
+    {
+        return 0;
+    }
+    size_t bytesToPeek = std::min(dataSize, writeCount - peekCount);
+
+    // Copy out in up to two pieces, handling wrap-around at the end of the storage
+    size_t peekPos = peekCount & m_mask;
+    size_t firstChunkSize = std::min(bytesToPeek, m_capacity - peekPos);
+    memcpy(data, m_buffer + peekPos, firstChunkSize);
+    if (firstChunkSize < bytesToPeek)
+    {
+        memcpy(data + firstChunkSize, m_buffer, bytesToPeek - firstChunkSize);
+    }
+    return bytesToPeek;
+}
+
+void AudioRingBuffer::setRetainedSize(size_t retainedSize)
+{
+    m_retainedSize = std::min(retainedSize, m_capacity);
+}
+
+size_t AudioRingBuffer::available() const
+{
+    return m_writeCount.load(std::memory_order_acquire) - m_readCount.load(std::memory_order_acquire);
+}
+
+size_t AudioRingBuffer::freeSpace() const
+{
+    size_t used = available() + m_retainedSize;
+    return used >= m_capacity ? 0 : m_capacity - used;
+}
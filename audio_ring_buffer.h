@@ -0,0 +1,131 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// AudioRingBuffer is a lock-free single-producer/single-consumer byte ring buffer.
+// Exactly one task may call write() and exactly one other task may call read(). Neither side ever
+// blocks, which makes the read side safe to use from the A2DP data callback.
+//
+// Only standard C++ is used (no Arduino or FreeRTOS headers) so the class can be built and
+// stress-tested on a host machine. On the ESP32 the storage can optionally be placed in PSRAM.
+class AudioRingBuffer
+{
+public:
+    // Allocates the backing storage. Capacity is rounded up to the next power of two so that
+    // wrap-around is a mask rather than a modulo.
+    // If usePsram is set the storage is allocated from PSRAM, falling back to internal RAM when
+    // there is no PSRAM. If the allocation still fails the capacity is halved until it succeeds.
+    explicit AudioRingBuffer(size_t capacity, bool usePsram = false);
+    ~AudioRingBuffer();
+
+    AudioRingBuffer(const AudioRingBuffer &) = delete;
+    AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+    // Producer only: copy up to dataSize bytes into the buffer. Returns the number of bytes written,
+    // which is less than dataSize if the buffer doesn't have enough free space.
+    size_t write(const uint8_t *data, size_t dataSize);
+
+    // Consumer only: copy up to dataSize bytes out of the buffer. Returns the number of bytes read,
+    // which is less than dataSize if the buffer doesn't hold enough data.
+    size_t read(uint8_t *data, size_t dataSize);
+
+    // Consumer only: discard up to dataSize bytes without copying them. Returns the number of bytes discarded.
+    size_t skip(size_t dataSize);
+
+    // Consumer only: copy up to dataSize bytes starting offset bytes from the read position, without consuming them.
+    // A positive offset looks ahead into unread data; a negative one looks back at data already read, as far as
+    // the retained size allows. Returns the number of bytes copied (0 if the start isn't in the buffer).
+    size_t peek(ptrdiff_t offset, uint8_t *data, size_t dataSize) const;
+
+    // Keep the most recently read retainedSize bytes from being overwritten so peek() can look back at them.
+    // This reduces the space available to the producer by the same amount. Set it before the producer starts.
+    void setRetainedSize(size_t retainedSize);
+
+    size_t retainedSize() const { return m_retainedSize; }
+
+    // Number of bytes ready to be read. Exact for the consumer, a lower bound for the producer.
+    size_t available() const;
+
+    // Number of bytes that can be written. Exact for the producer, a lower bound for the consumer.
+    size_t freeSpace() const;
+
+    size_t capacity() const { return m_capacity; }
+
+    // True if the storage ended up in PSRAM
+    bool isInPsram() const { return m_isInPsram; }
+
+private:
+    uint8_t *m_buffer;
+    size_t m_capacity;
+    size_t m_mask;
+    size_t m_retainedSize;
+    bool m_isInPsram;
+
+    // Free-running byte counters. Only the producer stores m_writeCount and only the consumer
+    // stores m_readCount; unsigned overflow is harmless because only their difference is used.
+    std::atomic<size_t> m_writeCount;
+    std::atomic<size_t> m_readCount;
+};
+
+// SpscQueue is a fixed-capacity lock-free single-producer/single-consumer queue for small items
+// (e.g. file start/end markers) that travel alongside the audio bytes in an AudioRingBuffer.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : m_writeCount(0), m_readCount(0) {}
+
+    // Producer only: append an item. Returns false if the queue is full.
+    bool push(const T &item)
+    {
+        size_t writeCount = m_writeCount.load(std::memory_order_relaxed);
+        if (writeCount - m_readCount.load(std::memory_order_acquire) >= Capacity)
+        {
+            return false;
+        }
+        m_items[writeCount & (Capacity - 1)] = item;
+        m_writeCount.store(writeCount + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only: the oldest item, or nullptr if the queue is empty. Valid until pop().
+    const T *front() const
+    {
+        return peek(0);
+    }
+
+    // Consumer only: the item index places after the oldest, or nullptr if the queue holds fewer. Valid until pop().
+    const T *peek(size_t index) const
+    {
+        size_t readCount = m_readCount.load(std::memory_order_relaxed);
+        if (m_writeCount.load(std::memory_order_acquire) - readCount <= index)
+        {
+            return nullptr;
+        }
+        return &m_items[(readCount + index) & (Capacity - 1)];
+    }
+
+    // Consumer only: remove the oldest item. Must only be called after front() returned non-null.
+    void pop()
+    {
+        m_readCount.store(m_readCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Producer only: number of items that can still be pushed.
+    size_t freeSlots() const
+    {
+        return Capacity - (m_writeCount.load(std::memory_order_relaxed) - m_readCount.load(std::memory_order_acquire));
+    }
+
+private:
+    T m_items[Capacity];
+    std::atomic<size_t> m_writeCount;
+    std::atomic<size_t> m_readCount;
+};
+
+#endif // AUDIO_RING_BUFFER_H
@@ -0,0 +1,214 @@
+/*
+    Band energy analysis for the skull animation.
+
+    Pipeline:
+        A2DP callback:  stereo 44.1kHz frames -> mono, 2:1 decimation (pair averaging) -> FIFO
+        Analysis task:  every m_intervalMs, drop all but the newest FFT_SIZE samples, Hann window, FFT,
+                        sum bin power per band, publish
+
+    Band power is converted back to an RMS amplitude (Parseval, doubled for the one-sided spectrum and
+    corrected for the Hann window's power), so a band's value is on the same scale as the sample RMS the
+    jaw constants were tuned for. A full-scale tone in one band reads the same as its RMS.
+
+    The arduinoFFT library computes in double, which the ESP32 does in software, so each analysis takes
+    a few milliseconds. That's why it runs at a low priority on its own schedule instead of in the callback.
+*/
+
+#include "band_energy_analyzer.h"
+#include <algorithm>
+#include <math.h>
+
+BandEnergyAnalyzer::BandEnergyAnalyzer(Clock &clock, Tasks &tasks)
+    : m_clock(clock), m_tasks(tasks), m_taskHandle(nullptr), m_fifo(FIFO_SIZE), m_pendingSample(0), m_pendingCount(0),
+      m_fft(m_vReal, m_vImag, FFT_SIZE, ANALYSIS_SAMPLE_RATE), m_intervalMs(BASE_INTERVAL_MS),
+      m_resultLow(0.0f), m_resultMid(0.0f), m_resultHigh(0.0f), m_resultTimeMs(0), m_resultSequence(0), m_analysisCount(0), m_totalMicros(0), m_windowCount(0),
+      m_maxMicros(0), m_droppedSamples(0), m_publishedIntervalMs(BASE_INTERVAL_MS)
+{
+}
+
+// Start the analysis task
+void BandEnergyAnalyzer::begin()
+{
+    if (m_taskHandle != nullptr)
+    {
+        return;
+    }
+
+    m_taskHandle = m_tasks.start(analysisTask, this, "BandEnergy", TASK_STACK_SIZE, TASK_PRIORITY, TASK_CORE);
+    if (m_taskHandle == nullptr)
+    {
+        Serial.println("BandEnergyAnalyzer::begin() Failed to create analysis task");
+    }
+}
+
+// Queue frames for analysis: downmix to mono and decimate, then write to the FIFO
+void BandEnergyAnalyzer::pushFrames(const Frame *frames, int32_t frameCount)
+{
+    if (m_taskHandle == nullptr)
+    {
+        return;
+    }
+
+    int16_t chunk[PUSH_CHUNK_SAMPLES];
+    size_t chunkSamples = 0;
+    for (int32_t i = 0; i < frameCount; i++)
+    {
+        m_pendingSample += frames[i].channel1 + frames[i].channel2;
+        if (++m_pendingCount == DECIMATION)
+        {
+            chunk[chunkSamples++] = static_cast<int16_t>(m_pendingSample / static_cast<int32_t>(2 * DECIMATION));
+            m_pendingSample = 0;
+            m_pendingCount = 0;
+        }
+
+        if (chunkSamples == PUSH_CHUNK_SAMPLES || (i == frameCount - 1 && chunkSamples > 0))
+        {
+            size_t bytes = chunkSamples * sizeof(int16_t);
+            size_t written = m_fifo.write(reinterpret_cast<const uint8_t *>(chunk), bytes);
+            if (written < bytes)
+            {
+                m_droppedSamples.fetch_add((bytes - written) / sizeof(int16_t), std::memory_order_relaxed);
+            }
+            chunkSamples = 0;
+        }
+    }
+}
+
+// Get the latest band energies, if they're recent, retrying if the task was publishing a new result meanwhile
+bool BandEnergyAnalyzer::getLatest(BandEnergies &energies) const
+{
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        uint32_t sequence = m_resultSequence.load(std::memory_order_acquire);
+        if (sequence == 0)
+        {
+            return false;
+        }
+        if (sequence % 2 != 0)
+        {
+            continue;
+        }
+        energies.low = m_resultLow.load(std::memory_order_relaxed);
+        energies.mid = m_resultMid.load(std::memory_order_relaxed);
+        energies.high = m_resultHigh.load(std::memory_order_relaxed);
+        energies.timeMs = m_resultTimeMs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_resultSequence.load(std::memory_order_relaxed) == sequence)
+        {
+            return m_clock.millis() - energies.timeMs <= RESULT_MAX_AGE_MS;
+        }
+    }
+    return false;
+}
+
+// Get a snapshot of the analysis cost
+BandEnergyAnalyzer::Stats BandEnergyAnalyzer::getStats() const
+{
+    Stats stats;
+    stats.analysisCount = m_analysisCount.load(std::memory_order_relaxed);
+    uint32_t windowCount = m_windowCount.load(std::memory_order_relaxed);
+    stats.averageMicros = windowCount > 0 ? m_totalMicros.load(std::memory_order_relaxed) / windowCount : 0;
+    stats.maxMicros = m_maxMicros.load(std::memory_order_relaxed);
+    stats.intervalMs = m_publishedIntervalMs.load(std::memory_order_relaxed);
+    stats.droppedSamples = m_droppedSamples.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Analysis task: run one analysis per interval, timing each one to stay within the CPU budget
+void BandEnergyAnalyzer::analysisTask(void *param)
+{
+    BandEnergyAnalyzer *self = static_cast<BandEnergyAnalyzer *>(param);
+    unsigned long lastWakeMs = self->m_clock.millis();
+    while (true)
+    {
+        self->m_tasks.delayUntil(lastWakeMs, self->m_intervalMs);
+
+        int64_t start = self->m_clock.micros();
+        if (self->analyzeLatestWindow())
+        {
+            self->updateSchedule(static_cast<uint32_t>(self->m_clock.micros() - start));
+        }
+    }
+}
+
+// Analyze the most recent FFT_SIZE samples. Older samples are dropped: only the current sound matters.
+bool BandEnergyAnalyzer::analyzeLatestWindow()
+{
+    const size_t windowBytes = FFT_SIZE * sizeof(int16_t);
+    size_t available = m_fifo.available();
+    if (available < windowBytes)
+    {
+        return false;
+    }
+    m_fifo.skip(available - windowBytes);
+
+    int16_t samples[FFT_SIZE];
+    m_fifo.read(reinterpret_cast<uint8_t *>(samples), windowBytes);
+    for (uint16_t i = 0; i < FFT_SIZE; i++)
+    {
+        m_vReal[i] = samples[i];
+        m_vImag[i] = 0.0;
+    }
+
+    m_fft.Windowing(FFT_WIN_TYP_HANN, FFT_FORWARD);
+    m_fft.Compute(FFT_FORWARD);
+
+    // Work the result out first, so the sequence is only odd for the stores
+    float low = bandAmplitude(LOW_BAND_MIN_HZ, MID_BAND_MIN_HZ);
+    float mid = bandAmplitude(MID_BAND_MIN_HZ, HIGH_BAND_MIN_HZ);
+    float high = bandAmplitude(HIGH_BAND_MIN_HZ, HIGH_BAND_MAX_HZ);
+    unsigned long timeMs = m_clock.millis();
+    m_resultSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_resultLow.store(low, std::memory_order_relaxed);
+    m_resultMid.store(mid, std::memory_order_relaxed);
+    m_resultHigh.store(high, std::memory_order_relaxed);
+    m_resultTimeMs.store(timeMs, std::memory_order_relaxed);
+    m_resultSequence.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+// Double the interval while an analysis takes more than MAX_CPU_PERCENT of it, and halve it again
+// once the shorter interval would be comfortably (under half the budget) affordable.
+void BandEnergyAnalyzer::updateSchedule(uint32_t runMicros)
+{
+    m_analysisCount.fetch_add(1, std::memory_order_relaxed);
+    if (m_windowCount.load(std::memory_order_relaxed) >= STATS_WINDOW)
+    {
+        m_windowCount.store(0, std::memory_order_relaxed);
+        m_totalMicros.store(0, std::memory_order_relaxed);
+    }
+    m_windowCount.fetch_add(1, std::memory_order_relaxed);
+    m_totalMicros.fetch_add(runMicros, std::memory_order_relaxed);
+    if (runMicros > m_maxMicros.load(std::memory_order_relaxed))
+    {
+        m_maxMicros.store(runMicros, std::memory_order_relaxed);
+    }
+
+    uint32_t budgetMicros = m_intervalMs * 10 * MAX_CPU_PERCENT; // interval (ms) * 1000 * percent / 100
+    if (runMicros > budgetMicros && m_intervalMs < MAX_INTERVAL_MS)
+    {
+        m_intervalMs = std::min(m_intervalMs * 2, MAX_INTERVAL_MS);
+        Serial.printf("BandEnergyAnalyzer: analysis took %u us, over budget; interval now %u ms\n", runMicros, m_intervalMs);
+    }
+    else if (m_intervalMs > BASE_INTERVAL_MS && runMicros * 4 < budgetMicros)
+    {
+        m_intervalMs = std::max(m_intervalMs / 2, BASE_INTERVAL_MS);
+    }
+    m_publishedIntervalMs.store(m_intervalMs, std::memory_order_relaxed);
+}
+
+// Sum the power of the bins in [minHz, maxHz) and convert it to an RMS amplitude
+float BandEnergyAnalyzer::bandAmplitude(float minHz, float maxHz) const
+{
+    const double binWidth = ANALYSIS_SAMPLE_RATE / FFT_SIZE;
+    uint16_t firstBin = static_cast<uint16_t>(ceil(minHz / binWidth));
+    uint16_t lastBin = std::min(static_cast<uint16_t>(ceil(maxHz / binWidth)), static_cast<uint16_t>(FFT_SIZE / 2));
+
+    double power = 0.0;
+    for (uint16_t bin = firstBin; bin < lastBin; bin++)
+    {
+        power += m_vReal[bin] * m_vReal[bin] + m_vImag[bin] * m_vImag[bin];
+    }
+    return static_cast<float>(sqrt(2.0 * power / (static_cast<double>(FFT_SIZE) * FFT_SIZE * HANN_WINDOW_POWER)));
+}
@@ -0,0 +1,129 @@
+#ifndef BAND_ENERGY_ANALYZER_H
+#define BAND_ENERGY_ANALYZER_H
+
+#include "arduinoFFT.h"
+#include "audio_ring_buffer.h"
+#include "SoundData.h" // For Frame definition
+#include "platform.h"
+#include <Arduino.h>
+#include <atomic>
+
+// BandEnergyAnalyzer splits the playing audio into low/mid/high frequency bands with an FFT.
+//
+// Voiced speech (vowels) carries most of its energy in the low and mid bands, while fricatives ("s", "f", "sh")
+// are mostly high band, so the bands can drive the jaw (open on vowels) and eyes (flicker on consonants) more
+// naturally than a single RMS level.
+//
+// The A2DP callback only pushes downmixed, decimated samples into a lock-free FIFO (pushFrames()). The FFT runs
+// on a low-priority task on a fixed schedule, always on the most recent window, and publishes its results for
+// the callback to pick up. The task measures its own run time and backs off its schedule if it would use more
+// than MAX_CPU_PERCENT of a core, so it can never starve audio.
+class BandEnergyAnalyzer
+{
+public:
+    // Band energies of the latest analysis window, as RMS amplitudes (same scale as 16-bit sample RMS)
+    struct BandEnergies
+    {
+        float low;   // LOW_BAND_MIN_HZ - MID_BAND_MIN_HZ: voicing and first formant
+        float mid;   // MID_BAND_MIN_HZ - HIGH_BAND_MIN_HZ: vowel formants
+        float high;  // HIGH_BAND_MIN_HZ - HIGH_BAND_MAX_HZ: fricatives and sibilants
+        unsigned long timeMs; // Clock::millis() when the analysis finished
+    };
+
+    // Analysis cost, for the status log
+    struct Stats
+    {
+        uint32_t analysisCount;   // Windows analyzed
+        uint32_t averageMicros;   // Average run time of one analysis
+        uint32_t maxMicros;       // Longest run time of one analysis
+        uint32_t intervalMs;      // Current analysis interval (grows if over budget)
+        uint32_t droppedSamples;  // Samples the callback couldn't queue because the FIFO was full
+    };
+
+    // The analysis task runs on tasks and times itself with clock
+    BandEnergyAnalyzer(Clock &clock, Tasks &tasks);
+
+    // Start the analysis task
+    void begin();
+
+    // Called from the A2DP callback: queue the frames for analysis. Never blocks.
+    void pushFrames(const Frame *frames, int32_t frameCount);
+
+    // Get the latest band energies. Returns false if there are none newer than RESULT_MAX_AGE_MS
+    // (e.g. the task is behind, or nothing is playing).
+    bool getLatest(BandEnergies &energies) const;
+
+    // Get a snapshot of the analysis cost
+    Stats getStats() const;
+
+    static constexpr float LOW_BAND_MIN_HZ = 80.0f;
+    static constexpr float MID_BAND_MIN_HZ = 500.0f;
+    static constexpr float HIGH_BAND_MIN_HZ = 2000.0f;
+    static constexpr float HIGH_BAND_MAX_HZ = 8000.0f;
+
+private:
+    // FFT window: 256 samples of the decimated signal (~11.6ms, ~86Hz per bin)
+    static constexpr uint16_t FFT_SIZE = 256;
+    static constexpr uint32_t DECIMATION = 2; // 44.1kHz stereo is downmixed to 22.05kHz mono
+    static constexpr double ANALYSIS_SAMPLE_RATE = 44100.0 / DECIMATION;
+    static constexpr double HANN_WINDOW_POWER = 0.375; // Mean of the squared Hann window, to undo its attenuation
+
+    static constexpr size_t FIFO_SIZE = 4096; // Bytes of mono samples (~93ms)
+    static constexpr size_t PUSH_CHUNK_SAMPLES = 128;
+
+    // Task settings: below the audio producer and the Bluetooth stack, on the core A2DP doesn't use
+    static constexpr uint32_t TASK_STACK_SIZE = 4096;
+    static constexpr uint32_t TASK_PRIORITY = 1;
+    static constexpr int TASK_CORE = 1;
+
+    // Schedule: one analysis per interval, doubling the interval (up to the max) while over the CPU budget
+    static constexpr uint32_t BASE_INTERVAL_MS = 30;
+    static constexpr uint32_t MAX_INTERVAL_MS = 240;
+    static constexpr uint32_t MAX_CPU_PERCENT = 10;
+    static constexpr unsigned long RESULT_MAX_AGE_MS = 100;
+
+    // Analysis task entry point
+    static void analysisTask(void *param);
+
+    // Analysis task only: analyze the most recent window if there is one. Returns true if it ran.
+    bool analyzeLatestWindow();
+
+    // Analysis task only: adjust the interval to keep the task within its CPU budget
+    void updateSchedule(uint32_t runMicros);
+
+    // Sum the power of the bins in [minHz, maxHz) and convert it to an RMS amplitude
+    float bandAmplitude(float minHz, float maxHz) const;
+
+    Clock &m_clock;
+    Tasks &m_tasks;
+    Tasks::Handle m_taskHandle;
+    AudioRingBuffer m_fifo; // A2DP callback -> analysis task, int16 mono samples
+    int32_t m_pendingSample; // Callback only: running sum for the decimator
+    uint32_t m_pendingCount;
+
+    // Analysis task only
+    double m_vReal[FFT_SIZE];
+    double m_vImag[FFT_SIZE];
+    arduinoFFT m_fft;
+    uint32_t m_intervalMs;
+
+    // The latest result. The task publishes it under a sequence count that is odd while it writes (0 until the first),
+    // so the reader can tell if it copied a torn result and retry. The fields are relaxed atomics, so a copy that
+    // overlaps a write is only torn, which the count catches, rather than a data race.
+    std::atomic<float> m_resultLow;
+    std::atomic<float> m_resultMid;
+    std::atomic<float> m_resultHigh;
+    std::atomic<unsigned long> m_resultTimeMs;
+    std::atomic<uint32_t> m_resultSequence;
+
+    // Stats
+    std::atomic<uint32_t> m_analysisCount;
+    std::atomic<uint32_t> m_totalMicros; // Run time of the last m_windowCount analyses (reset every STATS_WINDOW)
+    std::atomic<uint32_t> m_windowCount;
+    std::atomic<uint32_t> m_maxMicros;
+    std::atomic<uint32_t> m_droppedSamples;
+    std::atomic<uint32_t> m_publishedIntervalMs;
+    static constexpr uint32_t STATS_WINDOW = 100;
+};
+
+#endif // BAND_ENERGY_ANALYZER_H
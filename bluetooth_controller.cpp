@@ -35,10 +35,14 @@
 
 #include "bluetooth_controller.h"
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_bt_device.h"
 #include "nvs_flash.h"
+#include "esp_timer.h"
+#include <Preferences.h>
 
 // BLE-related includes and definitions
 #include <BLEDevice.h>
@@ -62,37 +66,86 @@ class MyCharacteristicCallbacks : public BLECharacteristicCallbacks
 {
     void onWrite(BLECharacteristic *pCharacteristic)
     {
+        // Timestamp the write before anything else, for commands that carry the Primary's clock
+        if (bluetooth_controller::instance)
+        {
+            bluetooth_controller::instance->setLastWriteReceivedMicros(esp_timer_get_time());
+        }
+
         std::string value = pCharacteristic->getValue();
         if (value.length() > 0)
         {
-            Serial.println("*********");
-            Serial.print("New value: ");
-            Serial.println(value.c_str());
-            Serial.println("*********");
+            Serial.printf("BT-BLE: Received command: %s\n", SkitStartProtocol::describe(value).c_str());
 
-            // Call the callback to check if the change is acceptable
-            bool canAcceptChange = true;
+            // Ask the application whether it accepts the command, and indicate its reply back to the Primary
+            std::string reply;
+            bool canAcceptChange = false;
             if (bluetooth_controller::instance && bluetooth_controller::instance->m_characteristicChangeRequestCallback)
             {
-                canAcceptChange = bluetooth_controller::instance->m_characteristicChangeRequestCallback(value);
+                canAcceptChange = bluetooth_controller::instance->m_characteristicChangeRequestCallback(value, reply);
             }
+            if (reply.empty())
+            {
+                SkitMessageHeader header;
+                uint16_t sequence = SkitStartProtocol::decodeHeader(value, header) ? header.sequence : 0;
+                reply = canAcceptChange ? SkitStartProtocol::encodeAccept(sequence)
+                                        : SkitStartProtocol::encodeReject(sequence, SkitRejectReason::BAD_MESSAGE, 0);
+            }
+            pCharacteristic->setValue(reply);
+            pCharacteristic->notify();
 
             if (canAcceptChange)
             {
-                pCharacteristic->notify(); // Notify the client
                 bluetooth_controller::instance->triggerCharacteristicChangeCallback(value);
             }
-            else
-            {
-                // If change is not acceptable, set an error message
-                std::string errorMsg = "Error: Cannot play " + value;
-                pCharacteristic->setValue(errorMsg);
-                pCharacteristic->notify();
-            }
         }
     }
 };
 
+// Callback class for the Primary's pongs and playback positions on the clock sync characteristic
+class ClockSyncCharacteristicCallbacks : public BLECharacteristicCallbacks
+{
+    void onWrite(BLECharacteristic *pCharacteristic)
+    {
+        int64_t receivedMicros = esp_timer_get_time(); // Before anything else: this is when a pong arrived
+        if (bluetooth_controller::instance)
+        {
+            bluetooth_controller::instance->handleClockSyncWrite(pCharacteristic->getValue(), receivedMicros);
+        }
+    }
+};
+
+// Clock sync messages, little-endian:
+//     ping (Secondary -> Primary notification): sequence (4), Secondary's clock uncertainty in us, -1 if unsynchronized (4)
+//     pong (Primary -> Secondary write):        sequence (4), Primary's esp_timer time the ping arrived (8),
+//                                               us the Primary took to answer (4)
+//     playback position (Primary -> Secondary write): skit start time on the shared clock in ms (4),
+//                                               how far the Primary's playback is ahead of the skit's schedule in us (4)
+// The Secondary tells the writes apart by size. All fit the default 20 byte ATT payload.
+static constexpr size_t CLOCK_SYNC_PING_SIZE = 8;
+static constexpr size_t CLOCK_SYNC_PONG_SIZE = 16;
+static constexpr size_t PLAYBACK_POSITION_SIZE = 8;
+
+static void putUint32(uint8_t *data, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        data[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint32_t getUint32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// The esp_timer time of the whole millisecond millisValue (a wrapping millis() reading) nearest to nowMicros
+static int64_t millisToMicrosNear(int64_t nowMicros, unsigned long millisValue)
+{
+    int64_t nowMillis = nowMicros / 1000;
+    return (nowMillis + static_cast<long>(millisValue - static_cast<unsigned long>(nowMillis))) * 1000;
+}
+
 // Callback class for handling BLE server events (connect/disconnect)
 class MyServerCallbacks : public BLEServerCallbacks
 {
@@ -100,6 +153,7 @@ class MyServerCallbacks : public BLEServerCallbacks
     {
         bluetooth_controller::instance->setBLEServerConnectionStatus(true);
         bluetooth_controller::instance->setConnectionState(ConnectionState::CONNECTED);
+        bluetooth_controller::instance->setConnectionInterval(param->connect.conn_params.interval);
 
         // Log client address and connection details
         char remoteAddress[18];
@@ -112,6 +166,7 @@ class MyServerCallbacks : public BLEServerCallbacks
         Serial.printf("BT-BLE: Client Address: %s\n", remoteAddress);
         Serial.printf("BT-BLE: Connection ID: %d\n", param->connect.conn_id);
         Serial.printf("BT-BLE: Connection Handle: %d\n", param->connect.conn_handle);
+        Serial.printf("BT-BLE: Connection interval: %.2f ms\n", param->connect.conn_params.interval * 1.25);
     }
 
     void onDisconnect(BLEServer *pServer)
@@ -126,12 +181,28 @@ class MyServerCallbacks : public BLEServerCallbacks
     }
 };
 
+// Secondary (server) only: GAP events on top of the BLE library's own handling. The Primary may change the
+// connection interval after connecting.
+static void serverGapEventHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT && param->update_conn_params.status == ESP_BT_STATUS_SUCCESS &&
+        bluetooth_controller::instance)
+    {
+        Serial.printf("BT-BLE: Connection interval changed to %.2f ms\n", param->update_conn_params.conn_int * 1.25);
+        bluetooth_controller::instance->setConnectionInterval(param->update_conn_params.conn_int);
+    }
+}
+
 // Static instance pointer initialization
 bluetooth_controller *bluetooth_controller::instance = nullptr;
 
 // Constructor
 bluetooth_controller::bluetooth_controller()
-    : m_speaker_name(""),
+    : m_isPrimary(false),
+      m_speaker_name(""),
+      m_audioCallbackTime(AUDIO_CALLBACK_DEADLINE_MICROS),
+      m_emptyAudioCallbacks(0),
+      m_cpuMhz(getCpuFrequencyMhz()),
       m_clientIsConnectedToServer(false),
       m_serverHasClientConnected(false),
       m_connectionState(ConnectionState::DISCONNECTED),
@@ -139,8 +210,31 @@ bluetooth_controller::bluetooth_controller()
       scanStartTime(0),
       connectionStartTime(0),
       m_a2dpInitialized(false),
-      m_bleInitialized(false)
+      m_bleInitialized(false),
+      m_lastIndicationMicros(0),
+      m_lastWriteReceivedMicros(0),
+      m_clockSyncSequence(0),
+      m_clockSyncPingSentMicros(0),
+      m_lastClockSyncPingMillis(0),
+      m_clockSyncPongPending(false),
+      m_clockSyncPingSequence(0),
+      m_clockSyncPingReceivedMicros(0),
+      m_peerClockUncertaintyMicros(-1),
+      m_hasPeerPlaybackPosition(false),
+      m_peerPlaybackSkitStartMillis(0),
+      m_peerPlaybackLeadMicros(0),
+      m_lastRequestId(NO_REQUEST),
+      m_hasPeerAddress(false),
+      m_peerAddressType(BLE_ADDR_TYPE_PUBLIC),
+      m_directConnectFailures(0),
+      m_linkLostMillis(0),
+      m_lastReconnectMillis(0),
+      m_wasLastReconnectDirect(false)
 {
+    for (size_t i = 0; i < MAX_PENDING_COMMANDS; i++)
+    {
+        m_pendingCommands[i].requestId = NO_REQUEST;
+    }
     instance = this; // Ensure proper initialization of the static instance
 }
 
@@ -196,6 +290,15 @@ void bluetooth_controller::initializeBLEClient()
             return;
         }
     }
+
+    // Connect straight to the Secondary we last connected to, if we know it; update() scans if that fails
+    m_linkLostMillis = millis();
+    loadPeerAddress();
+    if (m_hasPeerAddress)
+    {
+        m_connectionState = ConnectionState::DISCONNECTED;
+        return;
+    }
     startScan();
 }
 
@@ -243,6 +346,7 @@ void bluetooth_controller::initializeBLEServer()
 
     // Initialize BLE device, create server and service
     BLEDevice::init("SkullSecondary-Server");
+    BLEDevice::setCustomGapHandler(serverGapEventHandler);
     BLEServer *pServer = BLEDevice::createServer();
     pServer->setCallbacks(new MyServerCallbacks());
 
@@ -261,6 +365,14 @@ void bluetooth_controller::initializeBLEServer()
     // Add descriptor for indications
     pCharacteristic->addDescriptor(new BLE2902());
 
+    // Clock sync characteristic: pings are notified to the Primary, which writes back pongs without a response
+    pClockSyncCharacteristic = pService->createCharacteristic(
+        CLOCK_SYNC_CHARACTERISTIC_UUID,
+        BLECharacteristic::PROPERTY_WRITE_NR |
+            BLECharacteristic::PROPERTY_NOTIFY);
+    pClockSyncCharacteristic->setCallbacks(new ClockSyncCharacteristicCallbacks());
+    pClockSyncCharacteristic->addDescriptor(new BLE2902());
+
     pService->start();
 
     // Set up advertising
@@ -307,7 +419,20 @@ void bluetooth_controller::update()
         switch (m_connectionState)
         {
         case ConnectionState::DISCONNECTED:
-            if (currentTime - m_lastReconnectAttempt > SCAN_INTERVAL)
+            if (m_hasPeerAddress && m_directConnectFailures < DIRECT_CONNECT_ATTEMPTS)
+            {
+                // No scan and no wait: the Secondary advertises again as soon as the link drops
+                if (connectDirectly())
+                {
+                    onConnectedToServer(true);
+                }
+                else if (++m_directConnectFailures == DIRECT_CONNECT_ATTEMPTS)
+                {
+                    Serial.println("BT-BLE: Direct connect to the cached Secondary address failed. Falling back to scanning.");
+                    m_lastReconnectAttempt = currentTime - SCAN_INTERVAL - 1; // Scan right away
+                }
+            }
+            else if (currentTime - m_lastReconnectAttempt > SCAN_INTERVAL)
             {
                 m_lastReconnectAttempt = currentTime;
                 startScan();
@@ -343,6 +468,7 @@ void bluetooth_controller::update()
             {
                 m_connectionState = ConnectionState::CONNECTED;
                 Serial.println("BT-BLE: Successfully connected to server");
+                onConnectedToServer(false);
             }
             else
             {
@@ -357,6 +483,12 @@ void bluetooth_controller::update()
                 Serial.println("BT-BLE: Connection lost. Moving to DISCONNECTED state.");
                 disconnectFromServer();
                 m_connectionState = ConnectionState::DISCONNECTED;
+                m_linkLostMillis = currentTime;
+                m_directConnectFailures = 0;
+            }
+            else
+            {
+                sendClockSyncPong();
             }
             break;
         }
@@ -371,6 +503,18 @@ void bluetooth_controller::update()
                           m_serverHasClientConnected ? "true" : "false");
             lastStatusUpdate = currentTime;
         }
+
+        updatePendingCommands();
+    }
+    else if (m_serverHasClientConnected && pClockSyncCharacteristic != nullptr)
+    {
+        // Ping quickly until synchronized, then keep tracking the Primary's clock
+        unsigned long interval = isClockSynchronized() ? CLOCK_SYNC_INTERVAL : CLOCK_SYNC_FAST_INTERVAL;
+        if (millis() - m_lastClockSyncPingMillis >= interval)
+        {
+            m_lastClockSyncPingMillis = millis();
+            sendClockSyncPing();
+        }
     }
 }
 
@@ -466,8 +610,14 @@ bool bluetooth_controller::connectToServer()
         return false;
     }
 
+    return connectToAddress(myDevice->getAddress(), myDevice->getAddressType(), portMAX_DELAY);
+}
+
+// Connect to the BLE server at an address and discover its characteristics
+bool bluetooth_controller::connectToAddress(BLEAddress address, esp_ble_addr_type_t type, uint32_t timeoutMs)
+{
     Serial.print("BT-BLE: Forming a connection to ");
-    Serial.println(myDevice->getAddress().toString().c_str());
+    Serial.println(address.toString().c_str());
 
     pClient = BLEDevice::createClient();
     Serial.println("BT-BLE: Created client");
@@ -476,10 +626,8 @@ bool bluetooth_controller::connectToServer()
     Serial.println("BT-BLE: Set client callbacks");
 
     // Connect to the remote BLE Server
-    BLEAddress address = myDevice->getAddress();
-    esp_ble_addr_type_t type = myDevice->getAddressType();
     Serial.println("BT-BLE: Attempting to connect...");
-    if (pClient->connect(address, type))
+    if (pClient->connect(address, type, timeoutMs))
     {
         Serial.println("BT-BLE: Connected to the server");
         pClient->setMTU(517); // Set MTU after connection
@@ -494,20 +642,40 @@ bool bluetooth_controller::connectToServer()
         }
 
         // Discover characteristic
-        pRemoteCharacteristic = pRemoteService->getCharacteristic(BLEUUID(CHARACTERISTIC_UUID));
-        if (pRemoteCharacteristic == nullptr)
+        BLERemoteCharacteristic *remoteCharacteristic = pRemoteService->getCharacteristic(BLEUUID(CHARACTERISTIC_UUID));
+        if (remoteCharacteristic == nullptr)
         {
             Serial.println("BT-BLE: Failed to find our characteristic UUID");
             pClient->disconnect();
             return false;
         }
 
-        if (pRemoteCharacteristic->canIndicate())
+        if (remoteCharacteristic->canIndicate())
         {
-            pRemoteCharacteristic->registerForNotify(notifyCallback);
+            remoteCharacteristic->registerForNotify(notifyCallback);
             Serial.println("BT-BLE: Registered for notifications/indications");
         }
 
+        // Clock sync characteristic: the Secondary pings over it to track our clock
+        BLERemoteCharacteristic *remoteClockSyncCharacteristic = pRemoteService->getCharacteristic(BLEUUID(CLOCK_SYNC_CHARACTERISTIC_UUID));
+        if (remoteClockSyncCharacteristic != nullptr && remoteClockSyncCharacteristic->canNotify())
+        {
+            remoteClockSyncCharacteristic->registerForNotify(clockSyncNotifyCallback);
+            Serial.println("BT-BLE: Registered for clock sync pings");
+        }
+        else
+        {
+            remoteClockSyncCharacteristic = nullptr;
+            Serial.println("BT-BLE: Secondary has no clock sync characteristic; skits will start on estimated link delay");
+        }
+
+        // Only now can other tasks write to the Secondary
+        {
+            std::lock_guard<std::mutex> lock(m_clientMutex);
+            pRemoteCharacteristic = remoteCharacteristic;
+            pRemoteClockSyncCharacteristic = remoteClockSyncCharacteristic;
+        }
+
         m_connectionState = ConnectionState::CONNECTED;
         m_clientIsConnectedToServer = true;
         return true;
@@ -517,9 +685,92 @@ bool bluetooth_controller::connectToServer()
     return false;
 }
 
+// Connect to the Secondary at its cached address, without scanning for it
+bool bluetooth_controller::connectDirectly()
+{
+    Serial.println("BT-BLE: Connecting directly to the cached Secondary address");
+    m_connectionState = ConnectionState::CONNECTING;
+    if (connectToAddress(BLEAddress(m_peerAddress), m_peerAddressType, DIRECT_CONNECT_TIMEOUT))
+    {
+        return true;
+    }
+    disconnectFromServer();
+    return false;
+}
+
+// Cache the Secondary's address and report how long the connection took
+void bluetooth_controller::onConnectedToServer(bool isDirect)
+{
+    if (pClient != nullptr)
+    {
+        savePeerAddress(pClient->getPeerAddress(), myDevice != nullptr && !isDirect ? myDevice->getAddressType() : m_peerAddressType);
+    }
+    m_directConnectFailures = 0;
+    m_lastReconnectMillis = millis() - m_linkLostMillis;
+    m_wasLastReconnectDirect = isDirect;
+    Serial.printf("BT-BLE: Connected to the Secondary %lu ms after losing the link (%s)\n", m_lastReconnectMillis,
+                  isDirect ? "direct connect to the cached address" : "scan");
+}
+
+// Load the Secondary's address cached by an earlier connection, or else the one from setPeerAddressHint()
+void bluetooth_controller::loadPeerAddress()
+{
+    Preferences preferences;
+    if (preferences.begin(PEER_PREFERENCES_NAMESPACE, true))
+    {
+        m_hasPeerAddress = preferences.getBytes("address", m_peerAddress, sizeof(m_peerAddress)) == sizeof(m_peerAddress);
+        m_peerAddressType = static_cast<esp_ble_addr_type_t>(preferences.getUChar("addressType", BLE_ADDR_TYPE_PUBLIC));
+        preferences.end();
+    }
+
+    unsigned int bytes[6];
+    if (!m_hasPeerAddress &&
+        sscanf(m_peerAddressHint.c_str(), "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) == 6)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            m_peerAddress[i] = static_cast<uint8_t>(bytes[i]);
+        }
+        m_peerAddressType = BLE_ADDR_TYPE_PUBLIC;
+        m_hasPeerAddress = true;
+    }
+
+    if (m_hasPeerAddress)
+    {
+        Serial.printf("BT-BLE: Secondary address: %s\n", BLEAddress(m_peerAddress).toString().c_str());
+    }
+}
+
+// Cache the Secondary's address in NVS, if it changed
+void bluetooth_controller::savePeerAddress(BLEAddress address, esp_ble_addr_type_t type)
+{
+    if (m_hasPeerAddress && memcmp(m_peerAddress, *address.getNative(), sizeof(m_peerAddress)) == 0 && m_peerAddressType == type)
+    {
+        return;
+    }
+    memcpy(m_peerAddress, *address.getNative(), sizeof(m_peerAddress));
+    m_peerAddressType = type;
+    m_hasPeerAddress = true;
+
+    Preferences preferences;
+    if (preferences.begin(PEER_PREFERENCES_NAMESPACE, false))
+    {
+        preferences.putBytes("address", m_peerAddress, sizeof(m_peerAddress));
+        preferences.putUChar("addressType", static_cast<uint8_t>(m_peerAddressType));
+        preferences.end();
+        Serial.printf("BT-BLE: Cached Secondary address %s\n", address.toString().c_str());
+    }
+}
+
 // Disconnect from the BLE server
 void bluetooth_controller::disconnectFromServer()
 {
+    {
+        // The remote characteristics go with the client, so wait out any write another task is making
+        std::lock_guard<std::mutex> lock(m_clientMutex);
+        pRemoteCharacteristic = nullptr;
+        pRemoteClockSyncCharacteristic = nullptr;
+    }
     if (pClient != nullptr)
     {
         if (pClient->isConnected())
@@ -529,6 +780,11 @@ void bluetooth_controller::disconnectFromServer()
         delete pClient;
         pClient = nullptr;
     }
+    {
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        m_clockSyncPongPending = false;
+    }
+    m_peerClockUncertaintyMicros = -1;
     m_clientIsConnectedToServer = false;
     m_connectionState = ConnectionState::DISCONNECTED;
     Serial.println("BT-BLE: Disconnected from server");
@@ -563,9 +819,13 @@ void bluetooth_controller::notifyCallback(BLERemoteCharacteristic *pBLERemoteCha
 // Handle received indications
 void bluetooth_controller::handleIndication(const std::string &value)
 {
-    Serial.print("BT-BLE: Received indication: ");
-    Serial.println(value.c_str());
-    indicationReceived = true;
+    m_lastIndicationMicros = esp_timer_get_time();
+    Serial.printf("BT-BLE: Received indication: %s\n", SkitStartProtocol::describe(value).c_str());
+
+    if (!handleCommandReply(value, m_lastIndicationMicros) && m_indicationCallback)
+    {
+        m_indicationCallback(value);
+    }
 }
 
 // Set the value of the BLE characteristic
@@ -574,51 +834,175 @@ void bluetooth_controller::setCharacteristicValue(const char *value)
     pCharacteristic->setValue(value);
 }
 
-// Primary (client) only: Set the value of the remote characteristic
-bool bluetooth_controller::setRemoteCharacteristicValue(const std::string &value)
+// Secondary (server) only: Set the value of the characteristic and indicate it to the Primary
+bool bluetooth_controller::indicateCharacteristicValue(const std::string &value)
+{
+    if (!m_serverHasClientConnected || pCharacteristic == nullptr)
+    {
+        Serial.println("BT-BLE: No client connected to indicate to");
+        return false;
+    }
+    pCharacteristic->setValue(value);
+    pCharacteristic->notify();
+    return true;
+}
+
+// Primary (client) only: write a command to the Secondary without waiting for its reply
+uint32_t bluetooth_controller::sendCommand(const std::string &value, CommandCallback callback, unsigned long timeoutMs)
+{
+    std::lock_guard<std::mutex> clientLock(m_clientMutex);
+    if (!m_clientIsConnectedToServer || pRemoteCharacteristic == nullptr)
+    {
+        Serial.println("BT-BLE: Not connected or characteristic not available");
+        return NO_REQUEST;
+    }
+
+    uint32_t requestId;
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        PendingCommand *pending = nullptr;
+        for (size_t i = 0; i < MAX_PENDING_COMMANDS && pending == nullptr; i++)
+        {
+            if (m_pendingCommands[i].requestId == NO_REQUEST)
+            {
+                pending = &m_pendingCommands[i];
+            }
+        }
+        if (pending == nullptr)
+        {
+            Serial.printf("BT-BLE: %u commands already awaiting a reply; not sending %s\n", static_cast<unsigned>(MAX_PENDING_COMMANDS),
+                          SkitStartProtocol::describe(value).c_str());
+            return NO_REQUEST;
+        }
+
+        // Request IDs are the messages' 16-bit sequence numbers
+        m_lastRequestId = (m_lastRequestId + 1) & 0xFFFF;
+        if (m_lastRequestId == NO_REQUEST)
+        {
+            m_lastRequestId++; // Skip NO_REQUEST when the counter wraps
+        }
+        requestId = m_lastRequestId;
+        pending->requestId = requestId;
+        pending->callback = callback;
+        pending->sentMicros = esp_timer_get_time();
+        pending->timeoutMs = timeoutMs;
+        pending->hasReply = false;
+        pending->reply.clear();
+    }
+
+    // Only queues the write: the reply arrives as an indication on the BLE task
+    std::string message = value;
+    SkitStartProtocol::setSequence(message, static_cast<uint16_t>(requestId));
+    pRemoteCharacteristic->writeValue(message);
+    return requestId;
+}
+
+// Primary (client) only: match an indication to the command it replies to
+bool bluetooth_controller::handleCommandReply(const std::string &value, int64_t receivedMicros)
 {
-    if (m_clientIsConnectedToServer && pRemoteCharacteristic)
+    SkitMessageHeader header;
+    if (!SkitStartProtocol::decodeHeader(value, header) ||
+        (header.opcode != SkitStartProtocol::OPCODE_ACCEPT && header.opcode != SkitStartProtocol::OPCODE_REJECT))
     {
-        indicationReceived = false;
-        pRemoteCharacteristic->writeValue(value);
-        delay(100); // Wait for the server to process the write
+        return false;
+    }
 
-        // Wait for indication (with timeout)
-        unsigned long startTime = millis();
-        while (!indicationReceived && (millis() - startTime < 5000))
+    std::lock_guard<std::mutex> lock(m_commandMutex);
+    for (size_t i = 0; i < MAX_PENDING_COMMANDS; i++)
+    {
+        PendingCommand &pending = m_pendingCommands[i];
+        if (pending.requestId == header.sequence && !pending.hasReply)
         {
-            delay(10);
+            pending.hasReply = true;
+            pending.isAccepted = header.opcode == SkitStartProtocol::OPCODE_ACCEPT;
+            pending.replyMicros = receivedMicros;
+            pending.reply = value;
+            return true;
         }
+    }
+    return true; // A reply to a command that already timed out
+}
+
+// Primary (client) only: report the outcome of commands that got a reply, timed out or lost the connection.
+// Callbacks run outside the lock, so they can send more commands.
+void bluetooth_controller::updatePendingCommands()
+{
+    struct Outcome
+    {
+        uint32_t requestId;
+        CommandCallback callback;
+        CommandResult result;
+        std::string reply;
+    };
+    Outcome outcomes[MAX_PENDING_COMMANDS];
+    size_t outcomeCount = 0;
 
-        if (indicationReceived)
+    {
+        std::lock_guard<std::mutex> lock(m_commandMutex);
+        int64_t nowMicros = esp_timer_get_time();
+        for (size_t i = 0; i < MAX_PENDING_COMMANDS; i++)
         {
-            // Check if the final value matches what we set
-            std::string finalValue = getRemoteCharacteristicValue();
-            if (finalValue == value)
+            PendingCommand &pending = m_pendingCommands[i];
+            if (pending.requestId == NO_REQUEST)
             {
-                Serial.println("BT-BLE: Successfully set characteristic value and received indication");
-                return true;
+                continue;
+            }
+
+            Outcome &outcome = outcomes[outcomeCount];
+            if (pending.hasReply)
+            {
+                outcome.result = pending.isAccepted ? CommandResult::ACCEPTED : CommandResult::REJECTED;
+                outcome.reply.swap(pending.reply);
+                m_commandLatency.record(static_cast<uint32_t>(pending.replyMicros - pending.sentMicros));
+            }
+            else if (!m_clientIsConnectedToServer)
+            {
+                outcome.result = CommandResult::DISCONNECTED;
+            }
+            else if (nowMicros - pending.sentMicros >= static_cast<int64_t>(pending.timeoutMs) * 1000)
+            {
+                outcome.result = CommandResult::TIMED_OUT;
             }
             else
             {
-                Serial.print("BT-BLE: Characteristic value mismatch. Expected: ");
-                Serial.print(value.c_str());
-                Serial.print(", Actual: ");
-                Serial.println(finalValue.c_str());
-                return false;
+                continue; // Still waiting
             }
+            outcome.requestId = pending.requestId;
+            outcome.callback.swap(pending.callback);
+            pending.requestId = NO_REQUEST;
+            outcomeCount++;
         }
-        else
+    }
+
+    for (size_t i = 0; i < outcomeCount; i++)
+    {
+        Outcome &outcome = outcomes[i];
+        if (outcome.result != CommandResult::ACCEPTED)
         {
-            Serial.println("BT-BLE: Failed to receive indication after setting characteristic value");
-            return false;
+            Serial.printf("BT-BLE: Command %u %s\n", outcome.requestId, commandResultToString(outcome.result));
+        }
+        if (outcome.callback)
+        {
+            outcome.callback(outcome.requestId, outcome.result, outcome.reply);
         }
     }
-    else
+}
+
+// Name of a command outcome, for logging
+const char *bluetooth_controller::commandResultToString(CommandResult result)
+{
+    switch (result)
     {
-        Serial.println("BT-BLE: Not connected or characteristic not available");
-        return false;
+    case CommandResult::ACCEPTED:
+        return "accepted";
+    case CommandResult::REJECTED:
+        return "rejected";
+    case CommandResult::TIMED_OUT:
+        return "timed out";
+    case CommandResult::DISCONNECTED:
+        return "lost the connection";
     }
+    return "unknown";
 }
 
 // Set the BLE client connection status
@@ -633,10 +1017,23 @@ void bluetooth_controller::setBLEClientConnectionStatus(bool status)
 void bluetooth_controller::setBLEServerConnectionStatus(bool status)
 {
     m_serverHasClientConnected = status;
+    {
+        // The Primary may have restarted by the time it reconnects, so start the clock sync over
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        m_clockSync.reset();
+        m_clockSyncPingSentMicros = 0;
+    }
     setConnectionState(status ? ConnectionState::CONNECTED : ConnectionState::DISCONNECTED);
     Serial.printf("BT-BLE: Server connection status changed to %s\n", status ? "connected" : "disconnected");
 }
 
+// Secondary (server) only: the BLE connection interval, for the clock sync
+void bluetooth_controller::setConnectionInterval(uint16_t interval)
+{
+    std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+    m_clockSync.setConnectionInterval(static_cast<int64_t>(interval) * 1250);
+}
+
 // Get the speaker name
 const String &bluetooth_controller::get_speaker_name() const
 {
@@ -698,12 +1095,20 @@ bool bluetooth_controller::isBleConnected() const
     return m_serverHasClientConnected || m_serverHasClientConnected;
 }
 
-// Static trampoline function for audio callback
+// Static trampoline function for audio callback. Times every call with the cycle counter, which is cheap enough
+// to read on each one.
 int bluetooth_controller::audio_callback_trampoline(Frame *frame, int frame_count)
 {
     if (instance && instance->audio_provider_callback)
     {
-        return instance->audio_provider_callback(frame, frame_count);
+        uint32_t startCycles = ESP.getCycleCount();
+        int32_t framesProvided = instance->audio_provider_callback(frame, frame_count);
+        instance->m_audioCallbackTime.record((ESP.getCycleCount() - startCycles) / instance->m_cpuMhz);
+        if (framesProvided == 0 && frame_count > 0)
+        {
+            instance->m_emptyAudioCallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+        return framesProvided;
     }
     return 0;
 }
@@ -731,16 +1136,207 @@ bool bluetooth_controller::isFullyInitialized() const
     return m_a2dpInitialized && m_bleInitialized;
 }
 
-void bluetooth_controller::setCharacteristicChangeRequestCallback(std::function<bool(const std::string &)> callback)
+void bluetooth_controller::setCharacteristicChangeRequestCallback(CharacteristicChangeRequestCallback callback)
 {
     m_characteristicChangeRequestCallback = callback;
 }
 
-std::string bluetooth_controller::getRemoteCharacteristicValue()
+// Secondary (server) only: notify the Primary of a clock sync ping
+void bluetooth_controller::sendClockSyncPing()
+{
+    uint8_t ping[CLOCK_SYNC_PING_SIZE];
+    {
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        int64_t uncertainty = m_clockSync.isSynchronized() ? m_clockSync.uncertaintyMicros(esp_timer_get_time()) : -1;
+        m_clockSyncSequence++;
+        putUint32(ping, m_clockSyncSequence);
+        putUint32(ping + 4, static_cast<uint32_t>(static_cast<int32_t>(std::min<int64_t>(uncertainty, INT32_MAX))));
+        m_clockSyncPingSentMicros = esp_timer_get_time();
+    }
+    pClockSyncCharacteristic->setValue(ping, sizeof(ping));
+    pClockSyncCharacteristic->notify();
+}
+
+// Secondary (server) only: handle a pong, or keep a playback position for takePeerPlaybackPosition()
+void bluetooth_controller::handleClockSyncWrite(const std::string &value, int64_t receivedMicros)
+{
+    if (value.size() == PLAYBACK_POSITION_SIZE)
+    {
+        const uint8_t *position = reinterpret_cast<const uint8_t *>(value.data());
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        m_peerPlaybackSkitStartMillis = getUint32(position);
+        m_peerPlaybackLeadMicros = static_cast<int32_t>(getUint32(position + 4));
+        m_hasPeerPlaybackPosition = true;
+        return;
+    }
+    if (value.size() == CLOCK_SYNC_PONG_SIZE)
+    {
+        handleClockSyncPong(value, receivedMicros);
+    }
+}
+
+// Secondary (server) only: complete the exchange for the latest ping. Pongs to older pings are dropped.
+void bluetooth_controller::handleClockSyncPong(const std::string &value, int64_t receivedMicros)
+{
+    const uint8_t *pong = reinterpret_cast<const uint8_t *>(value.data());
+    uint32_t sequence = getUint32(pong);
+    int64_t remoteReceiveMicros = static_cast<int64_t>(getUint32(pong + 4)) | (static_cast<int64_t>(getUint32(pong + 8)) << 32);
+    int64_t remoteSendMicros = remoteReceiveMicros + getUint32(pong + 12);
+
+    std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+    if (sequence != m_clockSyncSequence || m_clockSyncPingSentMicros == 0)
+    {
+        return;
+    }
+    bool wasSynchronized = m_clockSync.isSynchronized();
+    m_clockSync.addSample(m_clockSyncPingSentMicros, remoteReceiveMicros, remoteSendMicros, receivedMicros);
+    m_clockSyncPingSentMicros = 0;
+    if (!wasSynchronized && m_clockSync.isSynchronized())
+    {
+        Serial.printf("BT-BLE: Clock synchronized to Primary (uncertainty %lld us)\n", m_clockSync.uncertaintyMicros(receivedMicros));
+    }
+}
+
+// Primary (client) only: a clock sync ping arrived. Note when, and answer it from update(): writing from here would
+// wait for the write's completion event, which the BLE library delivers on this same task.
+void bluetooth_controller::clockSyncNotifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify)
+{
+    int64_t receivedMicros = esp_timer_get_time(); // Before anything else: this is when the ping arrived
+    if (instance == nullptr || length != CLOCK_SYNC_PING_SIZE)
+    {
+        return;
+    }
+    instance->m_peerClockUncertaintyMicros = static_cast<int32_t>(getUint32(pData + 4));
+    std::lock_guard<std::mutex> lock(instance->m_clockSyncMutex);
+    instance->m_clockSyncPingSequence = getUint32(pData);
+    instance->m_clockSyncPingReceivedMicros = receivedMicros;
+    instance->m_clockSyncPongPending = true;
+}
+
+// Primary (client) only: answer the last clock sync ping, if there's one waiting. The Secondary counts the pong as
+// leaving at the first connection event after it's written, so the hold time reported is up to the write.
+void bluetooth_controller::sendClockSyncPong()
+{
+    if (pRemoteClockSyncCharacteristic == nullptr)
+    {
+        return;
+    }
+
+    uint8_t pong[CLOCK_SYNC_PONG_SIZE];
+    {
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        if (!m_clockSyncPongPending)
+        {
+            return;
+        }
+        m_clockSyncPongPending = false;
+        putUint32(pong, m_clockSyncPingSequence);
+        putUint32(pong + 4, static_cast<uint32_t>(m_clockSyncPingReceivedMicros));
+        putUint32(pong + 8, static_cast<uint32_t>(m_clockSyncPingReceivedMicros >> 32));
+        putUint32(pong + 12, static_cast<uint32_t>(esp_timer_get_time() - m_clockSyncPingReceivedMicros));
+    }
+    pRemoteClockSyncCharacteristic->writeValue(pong, sizeof(pong), false);
+}
+
+// The shared clock: the Primary's millis()
+unsigned long bluetooth_controller::syncedMillis()
+{
+    if (!m_isPrimary)
+    {
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        if (m_clockSync.isSynchronized())
+        {
+            return static_cast<unsigned long>(m_clockSync.toRemote(esp_timer_get_time()) / 1000);
+        }
+    }
+    return millis();
+}
+
+// esp_timer time when the shared clock reads syncedMillis
+int64_t bluetooth_controller::localMicrosAtSyncedMillis(unsigned long syncedMillis)
+{
+    int64_t nowMicros = esp_timer_get_time();
+    if (!m_isPrimary)
+    {
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        if (m_clockSync.isSynchronized())
+        {
+            return m_clockSync.toLocal(millisToMicrosNear(m_clockSync.toRemote(nowMicros), syncedMillis));
+        }
+    }
+    return millisToMicrosNear(nowMicros, syncedMillis);
+}
+
+// Shared clock time from syncedMillis to the esp_timer time localMicros
+int64_t bluetooth_controller::syncedMicrosSince(unsigned long syncedMillis, int64_t localMicros)
 {
-    if (pRemoteCharacteristic)
+    if (!m_isPrimary)
     {
-        return pRemoteCharacteristic->readValue();
+        std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+        if (m_clockSync.isSynchronized())
+        {
+            int64_t remoteMicros = m_clockSync.toRemote(localMicros);
+            return remoteMicros - millisToMicrosNear(remoteMicros, syncedMillis);
+        }
+    }
+    return localMicros - millisToMicrosNear(localMicros, syncedMillis);
+}
+
+// Primary (client) only: tell the Secondary where our playback of a skit is
+bool bluetooth_controller::sendPlaybackPosition(unsigned long skitStartMillis, int32_t leadMicros)
+{
+    std::lock_guard<std::mutex> lock(m_clientMutex);
+    if (!m_clientIsConnectedToServer || pRemoteClockSyncCharacteristic == nullptr)
+    {
+        return false;
     }
-    return "";
-}
\ No newline at end of file
+
+    uint8_t position[PLAYBACK_POSITION_SIZE];
+    putUint32(position, static_cast<uint32_t>(skitStartMillis));
+    putUint32(position + 4, static_cast<uint32_t>(leadMicros));
+    pRemoteClockSyncCharacteristic->writeValue(position, sizeof(position), false);
+    return true;
+}
+
+// Secondary (server) only: the Primary's last playback position, if one came since the last call
+bool bluetooth_controller::takePeerPlaybackPosition(unsigned long &skitStartMillis, int32_t &leadMicros)
+{
+    std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+    if (!m_hasPeerPlaybackPosition)
+    {
+        return false;
+    }
+    skitStartMillis = m_peerPlaybackSkitStartMillis;
+    leadMicros = m_peerPlaybackLeadMicros;
+    m_hasPeerPlaybackPosition = false;
+    return true;
+}
+
+// True once the Secondary tracks the Primary's clock
+bool bluetooth_controller::isClockSynchronized()
+{
+    return getClockUncertaintyMicros() >= 0;
+}
+
+// How far the Secondary's shared clock may be off the Primary's
+int32_t bluetooth_controller::getClockUncertaintyMicros()
+{
+    if (m_isPrimary)
+    {
+        return m_clientIsConnectedToServer ? m_peerClockUncertaintyMicros.load() : -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+    if (!m_clockSync.isSynchronized())
+    {
+        return -1;
+    }
+    return static_cast<int32_t>(std::min<int64_t>(m_clockSync.uncertaintyMicros(esp_timer_get_time()), INT32_MAX));
+}
+
+// Drift between the skulls' crystals, as measured by the Secondary
+double bluetooth_controller::getClockDriftPpm()
+{
+    std::lock_guard<std::mutex> lock(m_clockSyncMutex);
+    return m_clockSync.driftPpm();
+}
@@ -8,6 +8,11 @@
 #include <BLEServer.h>
 #include <functional>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include "clock_sync_estimator.h"
+#include "latency_histogram.h"
+#include "skit_start_protocol.h"
 
 // Enum to represent the current connection state of the Bluetooth controller
 enum class ConnectionState
@@ -37,6 +42,14 @@ public:
     // Check if A2DP is currently connected
     bool isA2dpConnected();
 
+    // Time each A2DP data callback takes, start to return. The callback has to be back well within the time its
+    // frames play for, or the speaker stutters; the histogram counts the calls that weren't.
+    static constexpr uint32_t AUDIO_CALLBACK_DEADLINE_MICROS = 2902; // 128 frames at 44.1kHz
+    const DeadlineHistogram &getAudioCallbackHistogram() const { return m_audioCallbackTime; }
+
+    // A2DP data callbacks that returned no frames at all (the A2DP library sends nothing for them)
+    uint32_t getEmptyAudioCallbackCount() const { return m_emptyAudioCallbacks.load(std::memory_order_relaxed); }
+
     // Set the volume for A2DP audio
     // @param volume: Volume level (0-255)
     void set_volume(uint8_t volume);
@@ -47,18 +60,85 @@ public:
     // Set the value of the BLE characteristic (for server mode)
     void setCharacteristicValue(const char *value);
 
-    // Update the Bluetooth controller state (call this in the main loop)
+    // Set the value of the BLE characteristic and indicate it to the connected client (for server mode)
+    bool indicateCharacteristicValue(const std::string &value);
+
+    // esp_timer_get_time() when the client last wrote the characteristic, taken before any callback runs (for server mode)
+    int64_t getLastWriteReceivedMicros() const { return m_lastWriteReceivedMicros; }
+    void setLastWriteReceivedMicros(int64_t time) { m_lastWriteReceivedMicros = time; }
+
+    // Shared clock between the skulls: the Primary's millis(). The Secondary tracks it with NTP-style ping/pong
+    // exchanges over the clock sync characteristic; until it's synchronized, this is the Secondary's own millis().
+    unsigned long syncedMillis();
+
+    // esp_timer_get_time() when the shared clock reads syncedMillis (a time within ~24 days of now)
+    int64_t localMicrosAtSyncedMillis(unsigned long syncedMillis);
+
+    // True once the Secondary tracks the Primary's clock (on the Primary: as last reported by the Secondary)
+    bool isClockSynchronized();
+
+    // How far the Secondary's shared clock may be off the Primary's, in microseconds (-1 if not synchronized)
+    int32_t getClockUncertaintyMicros();
+
+    // Secondary (server) only: the clock sync estimator's drift between the skulls' crystals, in ppm
+    double getClockDriftPpm();
+
+    // Shared clock microseconds from the shared time syncedMillis to the esp_timer_get_time() time localMicros
+    int64_t syncedMicrosSince(unsigned long syncedMillis, int64_t localMicros);
+
+    // Primary (client) only: report how far our playback of the skit started at skitStartMillis (shared clock) is
+    // ahead of its schedule, so the Secondary can correct its drift. Written without a response.
+    bool sendPlaybackPosition(unsigned long skitStartMillis, int32_t leadMicros);
+
+    // Secondary (server) only: the Primary's latest playback position report, if one arrived since the last call
+    bool takePeerPlaybackPosition(unsigned long &skitStartMillis, int32_t &leadMicros);
+
+    // Secondary (server) only: handle a write to the clock sync characteristic (internal use)
+    void handleClockSyncWrite(const std::string &value, int64_t receivedMicros);
+
+    // Update the Bluetooth controller state (call this regularly, always from the same task). It may block for seconds
+    // while connecting, so the other public methods can be called from other tasks meanwhile.
     void update();
 
     // Singleton instance of the Bluetooth controller
     static bluetooth_controller *instance;
 
-    // Set the value of the remote BLE characteristic (for client mode)
-    bool setRemoteCharacteristicValue(const std::string &value);
+    // Outcome of a command sent to the Secondary
+    enum class CommandResult
+    {
+        ACCEPTED,
+        REJECTED,
+        TIMED_OUT,
+        DISCONNECTED
+    };
+    static const char *commandResultToString(CommandResult result);
+
+    // Called from update() once a command's outcome is known, with the Secondary's reply message (empty if there was none)
+    typedef std::function<void(uint32_t requestId, CommandResult result, const std::string &reply)> CommandCallback;
+
+    static constexpr uint32_t NO_REQUEST = 0;                 // Request ID of a command that couldn't be sent
+    static const unsigned long DEFAULT_COMMAND_TIMEOUT = 5000; // ms to wait for the Secondary's reply
+
+    // Primary (client) only: write a command (a SkitStartProtocol message) to the Secondary's characteristic without
+    // waiting for its reply. The message's sequence number is set to a request ID that the Secondary's ACCEPT or
+    // REJECT indication carries back; update() calls the callback with the outcome and the reply message.
+    // Returns the request ID, or NO_REQUEST if it couldn't be sent.
+    uint32_t sendCommand(const std::string &value, CommandCallback callback, unsigned long timeoutMs = DEFAULT_COMMAND_TIMEOUT);
+
+    // Primary (client) only: time from writing each command to its accept or reject indication
+    const LatencyHistogram &getCommandLatencyHistogram() const { return m_commandLatency; }
 
     // Register for indications from the remote BLE characteristic
     bool registerForIndications();
 
+    // esp_timer_get_time() when the last indication from the server arrived (for client mode)
+    int64_t getLastIndicationMicros() const { return m_lastIndicationMicros; }
+
+    // Called with the value of every indication from the server that isn't a command reply (for client mode),
+    // on the BLE task
+    typedef std::function<void(const std::string &)> IndicationCallback;
+    void setIndicationCallback(IndicationCallback callback) { m_indicationCallback = callback; }
+
     // Check if the BLE client is connected to a server
     bool clientIsConnectedToServer() const;
 
@@ -74,12 +154,25 @@ public:
     // Set the BLE server connection status
     void setBLEServerConnectionStatus(bool status);
 
+    // Secondary (server) only: the BLE connection interval, in 1.25ms units as BLE reports it. The clock sync counts
+    // its exchanges from the connection events the packets left at.
+    void setConnectionInterval(uint16_t interval);
+
     // Start scanning for BLE devices
     void startScan();
 
     // Connect to a BLE server
     bool connectToServer();
 
+    // Primary (client) only: the Secondary's BLE address (e.g. "24:6f:28:aa:bb:cc") to connect to directly if none has
+    // been cached from an earlier connection. Call before initializeBLE().
+    void setPeerAddressHint(const String &address) { m_peerAddressHint = address; }
+
+    // Primary (client) only: how long the last connection to the Secondary took, from losing the link (or starting BLE)
+    // to being connected, in ms (0 if it hasn't connected yet), and whether it connected directly or after a scan
+    unsigned long getLastReconnectMillis() const { return m_lastReconnectMillis; }
+    bool wasLastReconnectDirect() const { return m_wasLastReconnectDirect; }
+
     // Get the current connection state
     ConnectionState getConnectionState() const { return m_connectionState; }
 
@@ -142,10 +235,12 @@ public:
     // New method to check if both A2DP and BLE are initialized
     bool isFullyInitialized() const;
 
-    void setCharacteristicChangeRequestCallback(std::function<bool(const std::string&)> callback);
-    std::string getRemoteCharacteristicValue();
+    // Secondary (server) only: called on the BLE task with each command the Primary writes. Returns whether the
+    // command is accepted, and may fill in the reply to indicate back (by default an accept, or a bad message reject).
+    typedef std::function<bool(const std::string &value, std::string &reply)> CharacteristicChangeRequestCallback;
+    void setCharacteristicChangeRequestCallback(CharacteristicChangeRequestCallback callback);
 
-    std::function<bool(const std::string&)> m_characteristicChangeRequestCallback = nullptr;
+    CharacteristicChangeRequestCallback m_characteristicChangeRequestCallback = nullptr;
 
 private:
     BLEScan *pBLEScanner;
@@ -161,13 +256,46 @@ private:
     bool m_isPrimary;
     String m_speaker_name;
     std::function<int32_t(Frame *, int32_t)> audio_provider_callback;
+
+    // A2DP data callback timing (written by the callback, read from the main loop). The callback runs on the
+    // Bluetooth stack's task, which is pinned to one core, so its cycle counter is consistent across a call.
+    DeadlineHistogram m_audioCallbackTime;
+    std::atomic<uint32_t> m_emptyAudioCallbacks;
+    uint32_t m_cpuMhz; // Cycle counter ticks per microsecond
     unsigned long last_reconnection_attempt;
     BluetoothA2DPSource a2dp_source;
 
     static void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify);
     void handleIndication(const std::string &value);
 
-    bool indicationReceived;
+    // Commands awaiting the Secondary's reply, in slots that are free while requestId is NO_REQUEST.
+    // The BLE task fills in replies; update() reports outcomes and frees the slots.
+    struct PendingCommand
+    {
+        uint32_t requestId;
+        CommandCallback callback;
+        int64_t sentMicros;
+        unsigned long timeoutMs;
+        bool hasReply;
+        bool isAccepted;
+        int64_t replyMicros;
+        std::string reply;
+    };
+    static const size_t MAX_PENDING_COMMANDS = 4;
+
+    // Primary (client) only: match an indication to the command it replies to. Returns false if it isn't a reply.
+    bool handleCommandReply(const std::string &value, int64_t receivedMicros);
+
+    // Primary (client) only: report the outcome of commands that got a reply, timed out or lost the connection
+    void updatePendingCommands();
+
+    // Clock sync. The Secondary sends a ping by notification; the Primary answers with a pong write from update(),
+    // since a write can't be made from the BLE task that delivers the notification.
+    static void clockSyncNotifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length, bool isNotify);
+    void sendClockSyncPing();
+    void sendClockSyncPong();
+    void handleClockSyncPong(const std::string &value, int64_t receivedMicros);
+
     bool m_clientIsConnectedToServer;
     bool m_serverHasClientConnected;
 
@@ -178,6 +306,25 @@ private:
 
     void disconnectFromServer();
 
+    // Primary (client) only: connect and discover the characteristics. Blocks for up to timeoutMs while connecting.
+    bool connectToAddress(BLEAddress address, esp_ble_addr_type_t type, uint32_t timeoutMs);
+
+    // Primary (client) only: fast reconnect. The Secondary's address is cached in NVS after each connection, so after
+    // a restart or a dropped link the Primary connects to it straight away and only scans if that fails.
+    void loadPeerAddress();
+    void savePeerAddress(BLEAddress address, esp_ble_addr_type_t type);
+    bool connectDirectly();
+    void onConnectedToServer(bool isDirect);
+
+    bool m_hasPeerAddress;
+    esp_bd_addr_t m_peerAddress;
+    esp_ble_addr_type_t m_peerAddressType;
+    String m_peerAddressHint;
+    int m_directConnectFailures;         // Since the link was lost; scanning takes over after DIRECT_CONNECT_ATTEMPTS
+    unsigned long m_linkLostMillis;      // When the link was lost, or BLE started
+    unsigned long m_lastReconnectMillis; // Time to reconnect, for the status line
+    bool m_wasLastReconnectDirect;
+
     static BLEAdvertisedDevice *myDevice;
 
     ConnectionStateChangeCallback m_connectionStateChangeCallback = nullptr;
@@ -186,15 +333,52 @@ private:
     // UUIDs for BLE services and characteristics
     static constexpr const char *SERVER_SERVICE_UUID = "4fafc201-1fb5-459e-8fcc-c5c9c331914b";
     static constexpr const char *CHARACTERISTIC_UUID = "beb5483e-36e1-4688-b7f5-ea07361b26a8";
+    static constexpr const char *CLOCK_SYNC_CHARACTERISTIC_UUID = "0e5b6ea1-2c1d-4c5e-9b47-3f1a8d2e7c90";
+    static constexpr const char *PEER_PREFERENCES_NAMESPACE = "ble_peer"; // NVS namespace of the cached Secondary address
 
     // Timing constants
     static const unsigned long SCAN_INTERVAL = 10000;      // 10 seconds between scan attempts
     static const unsigned long SCAN_DURATION = 10000;      // 10 seconds scan duration
     static const unsigned long CONNECTION_TIMEOUT = 30000; // 30 seconds connection timeout
     static const unsigned long SCAN_TIMEOUT = 30000;       // 30 seconds
+    static const unsigned long DIRECT_CONNECT_TIMEOUT = 2000; // A direct connect to an advertising Secondary takes well under this
+    static const int DIRECT_CONNECT_ATTEMPTS = 2;             // Direct connects to try before falling back to scanning
+    static const unsigned long CLOCK_SYNC_FAST_INTERVAL = 200; // Ping interval until synchronized
+    static const unsigned long CLOCK_SYNC_INTERVAL = 1000;     // Ping interval after that
 
     bool m_a2dpInitialized;
     bool m_bleInitialized;
+
+    IndicationCallback m_indicationCallback = nullptr;
+
+    PendingCommand m_pendingCommands[MAX_PENDING_COMMANDS];
+    std::mutex m_commandMutex; // Guards m_pendingCommands (BLE stack and the tasks sending commands)
+    std::mutex m_clientMutex;  // Guards the remote characteristics: update() replaces them while other tasks write to them
+    uint32_t m_lastRequestId;
+    LatencyHistogram m_commandLatency;
+    int64_t m_lastIndicationMicros;    // Set on the BLE task
+    int64_t m_lastWriteReceivedMicros; // Set on the BLE task
+
+    // Clock sync, Secondary side: the estimator of the Primary's clock and the ping awaiting its pong
+    BLECharacteristic *pClockSyncCharacteristic = nullptr;
+    ClockSyncEstimator m_clockSync;
+    std::mutex m_clockSyncMutex; // Guards m_clockSync, the ping state and the pong to send (BLE stack and the other tasks)
+    uint32_t m_clockSyncSequence;
+    int64_t m_clockSyncPingSentMicros;
+    unsigned long m_lastClockSyncPingMillis;
+
+    // Clock sync, Primary side: the ping to answer (guarded by m_clockSyncMutex), and the Secondary's last reported
+    // uncertainty
+    BLERemoteCharacteristic *pRemoteClockSyncCharacteristic = nullptr;
+    bool m_clockSyncPongPending;
+    uint32_t m_clockSyncPingSequence;
+    int64_t m_clockSyncPingReceivedMicros;
+    std::atomic<int32_t> m_peerClockUncertaintyMicros;
+
+    // Playback position, Secondary side: the Primary's last report (guarded by m_clockSyncMutex)
+    bool m_hasPeerPlaybackPosition;
+    unsigned long m_peerPlaybackSkitStartMillis;
+    int32_t m_peerPlaybackLeadMicros;
 };
 
 #endif // BLUETOOTH_CONTROLLER_H
\ No newline at end of file
@@ -0,0 +1,202 @@
+/*
+    NTP-style clock offset and drift estimation. See clock_sync_estimator.h.
+
+    The fit is a weighted least squares line through the fast exchanges, weighting each by 1 / delay^2: an exchange's
+    error is bounded by delay / 2, so a quick exchange says much more about the offset than a slow one. Times are
+    taken relative to the best exchange before they're converted to double, so no precision is lost to the size of
+    the clocks. The line passes through the weighted mean, so that's where it's anchored.
+*/
+
+#include "clock_sync_estimator.h"
+#include <math.h>
+#include <algorithm>
+
+// Floor on the delay used for weights, so a near-zero delay doesn't take over the fit
+static constexpr double MIN_WEIGHT_DELAY_MICROS = 100.0;
+
+ClockSyncEstimator::ClockSyncEstimator()
+    : m_connectionInterval(0)
+{
+    reset();
+}
+
+// Forget all exchanges
+void ClockSyncEstimator::reset()
+{
+    m_next = 0;
+    m_count = 0;
+    m_referenceLocal = 0;
+    m_offset = 0.0;
+    m_drift = 0.0;
+    m_driftUncertainty = MAX_DRIFT_PPM * 1e-6;
+    m_offsetBound = 0.0;
+    m_hasLastEvent = false;
+    m_lastEventLocal = 0;
+}
+
+// Connection interval of the link
+void ClockSyncEstimator::setConnectionInterval(int64_t intervalMicros)
+{
+    m_connectionInterval = intervalMicros;
+    m_hasLastEvent = false; // The events fall elsewhere now
+}
+
+// Add one ping/pong exchange
+void ClockSyncEstimator::addSample(int64_t localSendMicros, int64_t remoteReceiveMicros, int64_t remoteSendMicros, int64_t localReceiveMicros)
+{
+    // Over BLE, count the exchange from the connection events the ping and pong left at
+    if (m_connectionInterval > 0)
+    {
+        // The ping left at the first event after it was sent, and the last pong arrived at one
+        if (m_hasLastEvent && localSendMicros - m_lastEventLocal <= MAX_EVENT_AGE_MICROS)
+        {
+            int64_t sinceEvent = (localSendMicros - m_lastEventLocal) % m_connectionInterval;
+            if (sinceEvent < 0)
+            {
+                sinceEvent += m_connectionInterval;
+            }
+            if (sinceEvent > 0)
+            {
+                localSendMicros += m_connectionInterval - sinceEvent;
+            }
+        }
+        m_hasLastEvent = true;
+        m_lastEventLocal = localReceiveMicros;
+
+        // The pong left at the first event after it was written, and no sooner than the one after the ping's
+        int64_t hold = std::max<int64_t>(remoteSendMicros - remoteReceiveMicros, 0);
+        int64_t events = std::max<int64_t>((hold + m_connectionInterval - 1) / m_connectionInterval, 1);
+        remoteSendMicros = remoteReceiveMicros + events * m_connectionInterval;
+    }
+
+    int64_t delay = (localReceiveMicros - localSendMicros) - (remoteSendMicros - remoteReceiveMicros);
+    if (delay < 0)
+    {
+        delay = 0; // Only possible if the clocks drifted noticeably during the exchange
+    }
+
+    Sample &sample = m_samples[m_next];
+    sample.localMicros = localSendMicros + (localReceiveMicros - localSendMicros) / 2;
+    sample.offsetMicros = ((remoteReceiveMicros - localSendMicros) + (remoteSendMicros - localReceiveMicros)) / 2;
+    sample.delayMicros = delay;
+
+    m_next = (m_next + 1) % WINDOW_SIZE;
+    if (m_count < WINDOW_SIZE)
+    {
+        m_count++;
+    }
+    refit();
+}
+
+// Refit the offset line to the exchanges in the window
+void ClockSyncEstimator::refit()
+{
+    const Sample *best = &m_samples[0];
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const Sample &sample = m_samples[i];
+        if (sample.delayMicros < best->delayMicros || (sample.delayMicros == best->delayMicros && sample.localMicros > best->localMicros))
+        {
+            best = &sample;
+        }
+    }
+
+    // Weighted average of the fast exchanges, x = local time and y = offset, both relative to the best one
+    double maxDelay = fmax(static_cast<double>(best->delayMicros), MIN_WEIGHT_DELAY_MICROS) * MAX_DELAY_RATIO;
+    double sumW = 0.0, sumX = 0.0, sumY = 0.0, sumBound = 0.0, minX = 0.0, maxX = 0.0;
+    size_t used = 0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const Sample &sample = m_samples[i];
+        if (sample.delayMicros <= maxDelay)
+        {
+            double x = static_cast<double>(sample.localMicros - best->localMicros);
+            sumW += weight(sample);
+            sumX += weight(sample) * x;
+            sumY += weight(sample) * static_cast<double>(sample.offsetMicros - best->offsetMicros);
+            sumBound += weight(sample) * static_cast<double>(sample.delayMicros) / 2.0;
+            minX = fmin(minX, x);
+            maxX = fmax(maxX, x);
+            used++;
+        }
+    }
+    double meanX = sumX / sumW;
+    double meanY = sumY / sumW;
+    m_offsetBound = sumBound / sumW;
+
+    // Until the drift can be measured, the offset is that average
+    m_referenceLocal = best->localMicros + static_cast<int64_t>(llround(meanX));
+    m_offset = static_cast<double>(best->offsetMicros) + meanY;
+    m_drift = 0.0;
+    m_driftUncertainty = MAX_DRIFT_PPM * 1e-6;
+    if (used < 3 || maxX - minX < static_cast<double>(MIN_DRIFT_SPAN_MICROS))
+    {
+        return;
+    }
+
+    // Weighted least squares line through the same exchanges
+    double sxx = 0.0, sxy = 0.0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const Sample &sample = m_samples[i];
+        if (sample.delayMicros <= maxDelay)
+        {
+            double dx = static_cast<double>(sample.localMicros - best->localMicros) - meanX;
+            double dy = static_cast<double>(sample.offsetMicros - best->offsetMicros) - meanY;
+            sxx += weight(sample) * dx * dx;
+            sxy += weight(sample) * dx * dy;
+        }
+    }
+    double slope = sxy / sxx;
+    if (fabs(slope) > 2.0 * MAX_DRIFT_PPM * 1e-6)
+    {
+        return; // Not a believable crystal drift; keep the average
+    }
+
+    // Slope standard error, from the weighted residuals
+    double residualSum = 0.0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const Sample &sample = m_samples[i];
+        if (sample.delayMicros <= maxDelay)
+        {
+            double dx = static_cast<double>(sample.localMicros - best->localMicros) - meanX;
+            double residual = static_cast<double>(sample.offsetMicros - best->offsetMicros) - meanY - slope * dx;
+            residualSum += weight(sample) * residual * residual;
+        }
+    }
+    double slopeError = sqrt(residualSum / (static_cast<double>(used - 2) * sxx));
+
+    m_drift = slope;
+    m_driftUncertainty = fmin(2.0 * slopeError, MAX_DRIFT_PPM * 1e-6);
+}
+
+// Fit weight of an exchange: 1 / delay^2
+double ClockSyncEstimator::weight(const Sample &sample)
+{
+    double delay = fmax(static_cast<double>(sample.delayMicros), MIN_WEIGHT_DELAY_MICROS);
+    return 1.0 / (delay * delay);
+}
+
+// Remote clock at a local time
+int64_t ClockSyncEstimator::toRemote(int64_t localMicros) const
+{
+    double offset = m_offset + m_drift * static_cast<double>(localMicros - m_referenceLocal);
+    return localMicros + static_cast<int64_t>(llround(offset));
+}
+
+// Local time at a remote time
+int64_t ClockSyncEstimator::toLocal(int64_t remoteMicros) const
+{
+    // Solve local + offset(local) = remote; the offset changes so slowly that one correction step is exact enough
+    int64_t local = remoteMicros - static_cast<int64_t>(llround(m_offset));
+    return local - (toRemote(local) - remoteMicros);
+}
+
+// How far toRemote(localMicros) may be from the true remote time
+int64_t ClockSyncEstimator::uncertaintyMicros(int64_t localMicros) const
+{
+    double age = fabs(static_cast<double>(localMicros - m_referenceLocal));
+    double stampLatency = m_connectionInterval > 0 ? static_cast<double>(MAX_STAMP_LATENCY_MICROS) : 0.0;
+    return static_cast<int64_t>(ceil(m_offsetBound + stampLatency + age * m_driftUncertainty));
+}
@@ -0,0 +1,110 @@
+#ifndef CLOCK_SYNC_ESTIMATOR_H
+#define CLOCK_SYNC_ESTIMATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ClockSyncEstimator tracks a remote clock from NTP-style ping/pong exchanges over a link with variable delay.
+//
+// Each exchange gives four timestamps: the ping leaves here (t1, local clock), reaches the remote (t2, remote clock),
+// the pong leaves the remote (t3, remote clock) and gets back here (t4, local clock). Then
+//     offset = ((t2 - t1) + (t3 - t4)) / 2   (remote - local)
+//     delay  = (t4 - t1) - (t3 - t2)         (time spent on the link, both ways)
+// and the true offset lies within delay / 2 of the measured one: the measurement is only wrong by however much
+// the two directions' delays differ.
+//
+// Over BLE, a packet waits for the next connection event, and both skulls send from periodic tasks, so those waits
+// don't even out: the pong, written soon after the ping arrived, waits most of an interval, and the ping's wait
+// slides slowly with the tasks' phase. Left in, they bias the offset by up to half an interval and show up as drift.
+// With the connection interval set, the exchange is counted between the events the packets left at instead:
+//     - every packet arrives at a connection event, so this side knows when its events fall from the last pong,
+//       and takes the ping to have left at the first of them after t1 (while that pong is recent enough)
+//     - the pong left at the first event at least the remote's hold time (t3 - t2) after the one that brought the
+//       ping, which is when the remote stamped the ping's arrival
+// Stamps are taken in BLE callbacks a little after the event, so those departure times can be late by up to
+// MAX_STAMP_LATENCY_MICROS; the uncertainty allows for that. Guessing an event too early only adds delay.
+//
+// BLE delays jump around by whole connection intervals, so most exchanges are poor. The estimator keeps a window of
+// recent exchanges, throws out the slow ones, and fits a line through the rest: the offset, and how fast it changes
+// (the drift between the two crystals). Until the window spans long enough to measure the drift, the offset is the
+// average of the fast exchanges.
+//
+// The fitted offset is a weighted average of the exchanges' offsets, so its error is at most the same weighted
+// average of their delay / 2. The uncertainty is that bound, plus the drift uncertainty times the time from the
+// middle of the fit. tools/clock_sync_test.cpp checks the estimate against it on simulated links with 7.5-50ms
+// connection intervals, pongs held for up to 10ms, 15% retransmits and +/-40ppm of drift.
+//
+// Times are microseconds. Only standard C++ is used so it can be built and tested on a host machine.
+class ClockSyncEstimator
+{
+public:
+    static constexpr size_t WINDOW_SIZE = 64;               // Exchanges the estimate is fitted over
+    static constexpr size_t MIN_SAMPLES = 4;                // Exchanges needed before the estimate is used
+    static constexpr double MAX_DRIFT_PPM = 50.0;           // Drift assumed until measured (two +/-20ppm crystals, and margin)
+    static constexpr int64_t MIN_DRIFT_SPAN_MICROS = 10000000; // Window span needed to measure the drift
+    static constexpr int64_t MAX_STAMP_LATENCY_MICROS = 1000;  // Most a BLE callback stamps a packet after its connection event
+    static constexpr int64_t MAX_EVENT_AGE_MICROS = 2000000;    // Oldest pong the ping's connection event is found from
+
+    ClockSyncEstimator();
+
+    // Forget all exchanges (e.g. when the link drops and the remote may have restarted)
+    void reset();
+
+    // Connection interval of the link, so exchanges are counted from the connection events the packets left at
+    // (see above). 0, the default, takes t1 and t3 as when they left. Set it again whenever the interval changes.
+    void setConnectionInterval(int64_t intervalMicros);
+
+    // Add one ping/pong exchange
+    void addSample(int64_t localSendMicros, int64_t remoteReceiveMicros, int64_t remoteSendMicros, int64_t localReceiveMicros);
+
+    // True once enough exchanges have been made to use the estimate
+    bool isSynchronized() const { return m_count >= MIN_SAMPLES; }
+
+    // Remote clock at a local time, and the local time at a remote time
+    int64_t toRemote(int64_t localMicros) const;
+    int64_t toLocal(int64_t remoteMicros) const;
+
+    // How far toRemote(localMicros) may be from the true remote time
+    int64_t uncertaintyMicros(int64_t localMicros) const;
+
+    // Remote clock rate relative to the local one, in parts per million (0 until it can be measured)
+    double driftPpm() const { return m_drift * 1e6; }
+
+    size_t sampleCount() const { return m_count; }
+
+private:
+    // Exchanges with a delay more than this many times the lowest in the window are left out of the fit
+    static constexpr double MAX_DELAY_RATIO = 5.0;
+
+    struct Sample
+    {
+        int64_t localMicros;  // Local midpoint of the exchange
+        int64_t offsetMicros; // Measured remote - local
+        int64_t delayMicros;  // Round trip spent on the link
+    };
+
+    // Refit the offset line to the exchanges in the window
+    void refit();
+
+    // Fit weight of an exchange
+    static double weight(const Sample &sample);
+
+    Sample m_samples[WINDOW_SIZE];
+    size_t m_next;  // Slot the next exchange goes in
+    size_t m_count; // Exchanges in the window
+
+    // remote - local = m_offset + m_drift * (local - m_referenceLocal)
+    int64_t m_referenceLocal;
+    double m_offset;
+    double m_drift;
+    double m_driftUncertainty;
+
+    // Most the fitted offset can be off at m_referenceLocal: the weighted average of the fitted exchanges' delay / 2
+    double m_offsetBound;
+
+    int64_t m_connectionInterval; // 0 if unknown
+    bool m_hasLastEvent;
+    int64_t m_lastEventLocal; // When the last pong arrived, which was at a connection event
+};
+
+#endif // CLOCK_SYNC_ESTIMATOR_H
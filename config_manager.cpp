@@ -1,4 +1,5 @@
 #include "config_manager.h"
+#include "config_parser.h"
 
 ConfigManager &ConfigManager::getInstance()
 {
@@ -6,38 +7,46 @@ ConfigManager &ConfigManager::getInstance()
     return instance;
 }
 
-bool ConfigManager::loadConfig()
+bool ConfigManager::loadConfig(FileSystem &fileSystem)
 {
-    File configFile = SD.open("/config.txt", FILE_READ);
+    std::unique_ptr<PlatformFile> configFile = fileSystem.open("/config.txt");
     if (!configFile)
     {
         Serial.println("Failed to open config file");
         return false;
     }
 
+    // Read the whole file; it's a few lines
+    std::string text;
+    uint8_t buffer[256];
+    size_t bytesRead;
+    while ((bytesRead = configFile->read(buffer, sizeof(buffer))) > 0)
+    {
+        text.append(reinterpret_cast<const char *>(buffer), bytesRead);
+    }
+    configFile.reset();
+
     Serial.println("Reading configuration file:");
-    while (configFile.available())
+    m_config.clear();
+    size_t lineStart = 0;
+    while (lineStart < text.size())
     {
-        String line = configFile.readStringUntil('\n');
-        line.trim();
-        if (line.length() > 0 && line[0] != '#')
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
         {
-            parseConfigLine(line);
+            lineEnd = text.size();
+        }
+        std::string key;
+        std::string value;
+        if (ConfigParser::parseLine(text.substr(lineStart, lineEnd - lineStart), key, value))
+        {
+            m_config[String(key.c_str())] = String(value.c_str());
             // Output the key-value pair
-            int separatorIndex = line.indexOf('=');
-            if (separatorIndex != -1)
-            {
-                String key = line.substring(0, separatorIndex);
-                String value = line.substring(separatorIndex + 1);
-                key.trim();
-                value.trim();
-                Serial.printf("  %s: %s\n", key.c_str(), value.c_str());
-            }
+            Serial.printf("  %s: %s\n", key.c_str(), value.c_str());
         }
+        lineStart = lineEnd + 1;
     }
 
-    configFile.close();
-
     // Validate speaker volume
     speakerVolume = getValue("speaker_volume", "100").toInt();
     if (speakerVolume < 0 || speakerVolume > 100)
@@ -46,6 +55,45 @@ bool ConfigManager::loadConfig()
         speakerVolume = 100;
     }
 
+    // Validate audio buffer size (bytes; rounded up to a power of two by the AudioPlayer)
+    long audioBufferSize = getValue("audio_buffer_size", "8192").toInt();
+    if (audioBufferSize < 4096 || audioBufferSize > 1048576)
+    {
+        Serial.println("Invalid audio buffer size (must be 4096-1048576). Using default value of 8192.");
+        audioBufferSize = 8192;
+    }
+    m_audioBufferSize = static_cast<size_t>(audioBufferSize);
+
+    // PSRAM placement only makes sense on boards that have it (e.g. WROVER); falls back to internal RAM otherwise
+    String audioBufferPsram = getValue("audio_buffer_psram", "false");
+    audioBufferPsram.toLowerCase();
+    m_audioBufferUsePsram = audioBufferPsram.equals("true") || audioBufferPsram.equals("1") || audioBufferPsram.equals("yes");
+
+    // Validate jaw lookahead (ms the jaw is driven ahead of the audio sent to the speaker; negative = behind).
+    // Calibrated per speaker: Bluetooth latency delays the sound, servo slew delays the jaw.
+    long jawLookaheadMs = getValue("jaw_lookahead_ms", "0").toInt();
+    if (jawLookaheadMs < -1000 || jawLookaheadMs > 1000)
+    {
+        Serial.println("Invalid jaw lookahead (must be -1000 to 1000 ms). Using default value of 0.");
+        jawLookaheadMs = 0;
+    }
+    m_jawLookaheadMs = jawLookaheadMs;
+
+    // Validate jaw motion limits (degrees/s and degrees/s^2; 0 = unlimited). Lower limits are smoother and draw
+    // less servo current, higher ones follow the audio more closely.
+    m_jawMaxVelocity = getValue("jaw_max_velocity", "1000").toFloat();
+    if (m_jawMaxVelocity < 0 || m_jawMaxVelocity > 10000)
+    {
+        Serial.println("Invalid jaw max velocity (must be 0-10000 degrees/s). Using default value of 1000.");
+        m_jawMaxVelocity = 1000;
+    }
+    m_jawMaxAcceleration = getValue("jaw_max_acceleration", "40000").toFloat();
+    if (m_jawMaxAcceleration < 0 || m_jawMaxAcceleration > 1000000)
+    {
+        Serial.println("Invalid jaw max acceleration (must be 0-1000000 degrees/s^2). Using default value of 40000.");
+        m_jawMaxAcceleration = 40000;
+    }
+
     // Hardcode servo min/max degrees for now
     m_servoMinDegrees = 0;  // Default min degrees
     m_servoMaxDegrees = 80; // Default max degrees
@@ -53,19 +101,6 @@ bool ConfigManager::loadConfig()
     return true;
 }
 
-void ConfigManager::parseConfigLine(const String &line)
-{
-    int separatorIndex = line.indexOf('=');
-    if (separatorIndex != -1)
-    {
-        String key = line.substring(0, separatorIndex);
-        String value = line.substring(separatorIndex + 1);
-        key.trim();
-        value.trim();
-        m_config[key] = value;
-    }
-}
-
 String ConfigManager::getValue(const String &key, const String &defaultValue) const
 {
     auto it = m_config.find(key);
@@ -109,4 +144,7 @@ void ConfigManager::printConfig() const
         Serial.printf("%s: %s\n", pair.first.c_str(), pair.second.c_str());
     }
     Serial.printf("Speaker Volume: %d\n", speakerVolume);
+    Serial.printf("Audio Buffer: %zu bytes%s\n", m_audioBufferSize, m_audioBufferUsePsram ? " (PSRAM)" : "");
+    Serial.printf("Jaw Lookahead: %ld ms\n", m_jawLookaheadMs);
+    Serial.printf("Jaw Motion Limits: %.0f degrees/s, %.0f degrees/s^2\n", m_jawMaxVelocity, m_jawMaxAcceleration);
 }
\ No newline at end of file
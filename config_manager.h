@@ -2,14 +2,15 @@
 #define CONFIG_MANAGER_H
 
 #include <Arduino.h>
-#include <SD.h>
+#include "platform.h"
 #include <map>
 
 class ConfigManager {
 public:
     static ConfigManager& getInstance();
     
-    bool loadConfig();
+    // Loads and validates /config.txt from the file system (the SD card on the skulls). Returns false if it can't be opened.
+    bool loadConfig(FileSystem &fileSystem);
     String getBluetoothSpeakerName() const;
     String getRole() const;
     String getPrimaryMacAddress() const;
@@ -19,6 +20,11 @@ public:
     void printConfig() const;
     int getServoMinDegrees() const;
     int getServoMaxDegrees() const;
+    size_t getAudioBufferSize() const { return m_audioBufferSize; }
+    bool getAudioBufferUsePsram() const { return m_audioBufferUsePsram; }
+    long getJawLookaheadMs() const { return m_jawLookaheadMs; }
+    float getJawMaxVelocity() const { return m_jawMaxVelocity; }
+    float getJawMaxAcceleration() const { return m_jawMaxAcceleration; }
 
 private:
     ConfigManager() {}
@@ -26,8 +32,11 @@ private:
     int speakerVolume;
     int m_servoMinDegrees;
     int m_servoMaxDegrees;
-
-    void parseConfigLine(const String& line);
+    size_t m_audioBufferSize;
+    bool m_audioBufferUsePsram;
+    long m_jawLookaheadMs;
+    float m_jawMaxVelocity;
+    float m_jawMaxAcceleration;
 };
 
 #endif // CONFIG_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+/*
+    config.txt line parsing. See config_parser.h.
+*/
+
+#include "config_parser.h"
+#include <ctype.h>
+
+static std::string trim(const std::string &text)
+{
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && isspace(static_cast<unsigned char>(text[start])))
+    {
+        start++;
+    }
+    while (end > start && isspace(static_cast<unsigned char>(text[end - 1])))
+    {
+        end--;
+    }
+    return text.substr(start, end - start);
+}
+
+// Split a "key=value" line
+bool ConfigParser::parseLine(const std::string &line, std::string &key, std::string &value)
+{
+    std::string trimmed = trim(line);
+    if (trimmed.empty() || trimmed[0] == '#')
+    {
+        return false;
+    }
+
+    size_t separatorIndex = trimmed.find('=');
+    if (separatorIndex == std::string::npos)
+    {
+        return false;
+    }
+    key = trim(trimmed.substr(0, separatorIndex));
+    value = trim(trimmed.substr(separatorIndex + 1));
+    return true;
+}
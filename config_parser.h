@@ -0,0 +1,17 @@
+#ifndef CONFIG_PARSER_H
+#define CONFIG_PARSER_H
+
+#include <string>
+
+// ConfigParser reads the lines of config.txt: "key=value", with whitespace around either ignored. Blank lines,
+// lines starting with '#' and lines without an '=' are skipped.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+class ConfigParser
+{
+public:
+    // Returns false if the line isn't a setting
+    static bool parseLine(const std::string &line, std::string &key, std::string &value);
+};
+
+#endif // CONFIG_PARSER_H
@@ -0,0 +1,123 @@
+/*
+    The skulls' platform: the SD card, esp_timer and FreeRTOS behind the interfaces in platform.h.
+*/
+
+#include "esp32_platform.h"
+#include <Arduino.h>
+#include "FS.h"
+#include "SD.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// An SD library File
+class SdFile : public PlatformFile
+{
+public:
+    explicit SdFile(File file) : m_file(file) {}
+    ~SdFile() override { m_file.close(); }
+
+    size_t read(uint8_t *buffer, size_t size) override { return m_file.read(buffer, size); }
+    bool seek(uint32_t position) override { return m_file.seek(position); }
+    uint32_t position() override { return static_cast<uint32_t>(m_file.position()); }
+    uint32_t size() override { return static_cast<uint32_t>(m_file.size()); }
+
+private:
+    File m_file;
+};
+
+// Mount the SD card
+bool SdFileSystem::begin()
+{
+    return SD.begin();
+}
+
+// Open a file on the SD card for reading
+std::unique_ptr<PlatformFile> SdFileSystem::open(const char *path)
+{
+    File file = SD.open(path);
+    if (!file)
+    {
+        return nullptr;
+    }
+    if (file.isDirectory())
+    {
+        file.close();
+        return nullptr;
+    }
+    return std::unique_ptr<PlatformFile>(new SdFile(file));
+}
+
+// List the files in a directory on the SD card
+bool SdFileSystem::listFiles(const char *directory, std::vector<std::string> &names)
+{
+    File root = SD.open(directory);
+    if (!root || !root.isDirectory())
+    {
+        return false;
+    }
+
+    File file = root.openNextFile();
+    while (file)
+    {
+        if (!file.isDirectory())
+        {
+            names.push_back(file.name());
+        }
+        file = root.openNextFile();
+    }
+    root.close();
+    return true;
+}
+
+int64_t Esp32Clock::micros()
+{
+    return esp_timer_get_time();
+}
+
+unsigned long Esp32Clock::millis()
+{
+    return ::millis();
+}
+
+uint32_t Esp32Clock::cycleCount()
+{
+    return ESP.getCycleCount();
+}
+
+uint32_t Esp32Clock::cyclesPerMicro()
+{
+    return getCpuFrequencyMhz();
+}
+
+// Start a task pinned to a core
+Tasks::Handle FreeRtosTasks::start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core)
+{
+    TaskHandle_t handle = nullptr;
+    if (xTaskCreatePinnedToCore(entry, name, stackSize, param, priority, &handle, core) != pdPASS)
+    {
+        return nullptr;
+    }
+    return handle;
+}
+
+void FreeRtosTasks::notify(Handle task)
+{
+    xTaskNotifyGive(static_cast<TaskHandle_t>(task));
+}
+
+void FreeRtosTasks::waitForNotification(uint32_t timeoutMs)
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+}
+
+// Sleep until the next period, as vTaskDelayUntil() does but on the millis() clock
+void FreeRtosTasks::delayUntil(unsigned long &wakeMs, uint32_t periodMs)
+{
+    wakeMs += periodMs;
+    long remainingMs = static_cast<long>(wakeMs - ::millis());
+    if (remainingMs > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(remainingMs));
+    }
+}
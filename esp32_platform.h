@@ -0,0 +1,37 @@
+#ifndef ESP32_PLATFORM_H
+#define ESP32_PLATFORM_H
+
+#include "platform.h"
+
+// The skulls' platform (see platform.h): files on the SD card, esp_timer and the CPU cycle counter, FreeRTOS tasks
+
+// Files on the SD card, through the SD library
+class SdFileSystem : public FileSystem
+{
+public:
+    bool begin() override;
+    std::unique_ptr<PlatformFile> open(const char *path) override;
+    bool listFiles(const char *directory, std::vector<std::string> &names) override;
+};
+
+// esp_timer, millis() and the CPU cycle counter
+class Esp32Clock : public Clock
+{
+public:
+    int64_t micros() override;
+    unsigned long millis() override;
+    uint32_t cycleCount() override;
+    uint32_t cyclesPerMicro() override;
+};
+
+// FreeRTOS tasks pinned to a core, woken with task notifications
+class FreeRtosTasks : public Tasks
+{
+public:
+    Handle start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core) override;
+    void notify(Handle task) override;
+    void waitForNotification(uint32_t timeoutMs) override;
+    void delayUntil(unsigned long &wakeMs, uint32_t periodMs) override;
+};
+
+#endif // ESP32_PLATFORM_H
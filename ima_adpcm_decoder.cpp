@@ -0,0 +1,132 @@
+/*
+    IMA-ADPCM (Intel/DVI ADPCM as stored in WAV files) decoder.
+
+    Block layout for N channels:
+
+        N x 4-byte headers:  int16 first sample, uint8 step index, uint8 reserved
+        then repeating groups of N x 4 bytes: 8 samples (low nibble first) for channel 0,
+                                             8 samples for channel 1, ...
+
+    The first sample of each channel is stored verbatim in its header, so a block of B bytes holds
+    (B - 4N) * 2 / N + 1 frames. Each nibble is decoded with the reference IMA shift-and-add
+    algorithm, so the output is bit-exact with other IMA reference decoders.
+*/
+
+#include "ima_adpcm_decoder.h"
+
+static const int8_t INDEX_TABLE[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+static const int16_t STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static constexpr size_t HEADER_SIZE_PER_CHANNEL = 4;
+static constexpr size_t GROUP_SIZE_PER_CHANNEL = 4; // 4 bytes = 8 samples
+
+// Decoder state for one channel
+struct ChannelState
+{
+    int32_t predictor;
+    int32_t stepIndex;
+};
+
+// Decode a single 4-bit code and update the channel state
+static inline int16_t decodeNibble(ChannelState &state, uint8_t nibble)
+{
+    int32_t step = STEP_TABLE[state.stepIndex];
+    int32_t diff = step >> 3;
+    if (nibble & 1)
+    {
+        diff += step >> 2;
+    }
+    if (nibble & 2)
+    {
+        diff += step >> 1;
+    }
+    if (nibble & 4)
+    {
+        diff += step;
+    }
+
+    state.predictor += (nibble & 8) ? -diff : diff;
+    if (state.predictor > 32767)
+    {
+        state.predictor = 32767;
+    }
+    else if (state.predictor < -32768)
+    {
+        state.predictor = -32768;
+    }
+
+    state.stepIndex += INDEX_TABLE[nibble];
+    if (state.stepIndex < 0)
+    {
+        state.stepIndex = 0;
+    }
+    else if (state.stepIndex > 88)
+    {
+        state.stepIndex = 88;
+    }
+
+    return static_cast<int16_t>(state.predictor);
+}
+
+uint32_t ImaAdpcmDecoder::samplesPerBlock(uint16_t blockAlign, uint16_t numChannels)
+{
+    if (numChannels == 0 || blockAlign < HEADER_SIZE_PER_CHANNEL * numChannels)
+    {
+        return 0;
+    }
+    return (blockAlign - HEADER_SIZE_PER_CHANNEL * numChannels) * 2 / numChannels + 1;
+}
+
+size_t ImaAdpcmDecoder::decodeBlock(const uint8_t *block, size_t blockSize, uint16_t numChannels, int16_t *output)
+{
+    if (numChannels == 0 || numChannels > 2 || blockSize < HEADER_SIZE_PER_CHANNEL * numChannels)
+    {
+        return 0;
+    }
+
+    // Block header: the first frame is stored uncompressed
+    ChannelState states[2];
+    for (uint16_t channel = 0; channel < numChannels; channel++)
+    {
+        const uint8_t *header = block + channel * HEADER_SIZE_PER_CHANNEL;
+        states[channel].predictor = static_cast<int16_t>(header[0] | (header[1] << 8));
+        states[channel].stepIndex = header[2] > 88 ? 88 : header[2];
+        output[channel] = static_cast<int16_t>(states[channel].predictor);
+    }
+
+    // Only whole 8-sample groups for every channel are decoded from a short final block
+    size_t groupSize = GROUP_SIZE_PER_CHANNEL * numChannels;
+    size_t numGroups = (blockSize - HEADER_SIZE_PER_CHANNEL * numChannels) / groupSize;
+    const uint8_t *data = block + HEADER_SIZE_PER_CHANNEL * numChannels;
+    int16_t *frames = output + numChannels; // Frame 0 came from the header
+
+    for (size_t group = 0; group < numGroups; group++)
+    {
+        for (uint16_t channel = 0; channel < numChannels; channel++)
+        {
+            const uint8_t *bytes = data + channel * GROUP_SIZE_PER_CHANNEL;
+            int16_t *out = frames + channel;
+            for (size_t i = 0; i < GROUP_SIZE_PER_CHANNEL; i++)
+            {
+                out[(2 * i) * numChannels] = decodeNibble(states[channel], bytes[i] & 0x0F);
+                out[(2 * i + 1) * numChannels] = decodeNibble(states[channel], bytes[i] >> 4);
+            }
+        }
+        data += groupSize;
+        frames += 8 * numChannels;
+    }
+
+    return 1 + numGroups * 8;
+}
@@ -0,0 +1,26 @@
+#ifndef IMA_ADPCM_DECODER_H
+#define IMA_ADPCM_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ImaAdpcmDecoder decodes IMA-ADPCM WAV blocks (WAVE_FORMAT_IMA_ADPCM, 4 bits per sample) to 16-bit PCM.
+// Each block is self-contained (it starts with the predictor and step index for every channel), so
+// blocks can be decoded one at a time as they're read from the SD card with no state carried between them.
+// Only standard C++ is used so it can be built, verified and benchmarked on a host machine.
+class ImaAdpcmDecoder
+{
+public:
+    static constexpr uint16_t FORMAT_IMA_ADPCM = 0x0011;
+    static constexpr uint16_t BITS_PER_SAMPLE = 4;
+
+    // Frames in a full block of blockAlign bytes
+    static uint32_t samplesPerBlock(uint16_t blockAlign, uint16_t numChannels);
+
+    // Decode one block (which may be a short final block) into interleaved 16-bit samples.
+    // Output must have room for samplesPerBlock(blockSize, numChannels) * numChannels samples.
+    // Returns the number of frames decoded, or 0 if the block is malformed.
+    static size_t decodeBlock(const uint8_t *block, size_t blockSize, uint16_t numChannels, int16_t *output);
+};
+
+#endif // IMA_ADPCM_DECODER_H
@@ -0,0 +1,107 @@
+/*
+    Precomputed jaw envelope (.jaw) file support.
+
+    File layout (little-endian):
+
+        4 bytes   "JAWE" magic
+        1 byte    version (1)
+        1 byte    frame duration in ms (10)
+        2 bytes   reserved (0)
+        4 bytes   frame count N
+        N bytes   jaw level per frame, 0 (closed) - 255 (fully open)
+*/
+
+#include "jaw_envelope.h"
+#include <string.h>
+
+static const uint8_t FILE_MAGIC[4] = {'J', 'A', 'W', 'E'};
+static constexpr uint8_t FILE_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 12;
+
+double JawEnvelope::smoothAmplitude(double smoothedAmplitude, double rmsAmplitude)
+{
+    return AMPLITUDE_SMOOTHING_FACTOR * rmsAmplitude + (1 - AMPLITUDE_SMOOTHING_FACTOR) * smoothedAmplitude;
+}
+
+double JawEnvelope::adjustAmplitude(double smoothedAmplitude)
+{
+    // Apply gain and adjust amplitude
+    double adjustedAmplitude = smoothedAmplitude * AMPLITUDE_GAIN;
+    if (adjustedAmplitude > MAX_EXPECTED_AMPLITUDE)
+    {
+        adjustedAmplitude = MAX_EXPECTED_AMPLITUDE;
+    }
+
+    // Implement a threshold to avoid small movements
+    if (adjustedAmplitude < AMPLITUDE_THRESHOLD)
+    {
+        adjustedAmplitude = 0.0;
+    }
+    return adjustedAmplitude;
+}
+
+uint8_t JawEnvelope::amplitudeToLevel(double adjustedAmplitude)
+{
+    double level = adjustedAmplitude * 255.0 / MAX_EXPECTED_AMPLITUDE + 0.5;
+    if (level <= 0.0)
+    {
+        return 0;
+    }
+    return level >= 255.0 ? 255 : static_cast<uint8_t>(level);
+}
+
+double JawEnvelope::levelToAmplitude(uint8_t level)
+{
+    return level * MAX_EXPECTED_AMPLITUDE / 255.0;
+}
+
+bool JawEnvelope::parse(const uint8_t *data, size_t size)
+{
+    m_levels.clear();
+
+    if (size < HEADER_SIZE || memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        data[4] != FILE_VERSION || data[5] != FRAME_DURATION_MS)
+    {
+        return false;
+    }
+
+    uint32_t frameCount = static_cast<uint32_t>(data[8]) | (static_cast<uint32_t>(data[9]) << 8) |
+                          (static_cast<uint32_t>(data[10]) << 16) | (static_cast<uint32_t>(data[11]) << 24);
+    if (frameCount != size - HEADER_SIZE)
+    {
+        return false;
+    }
+
+    m_levels.assign(data + HEADER_SIZE, data + size);
+    return true;
+}
+
+std::vector<uint8_t> JawEnvelope::serialize(const std::vector<uint8_t> &levels)
+{
+    std::vector<uint8_t> file(HEADER_SIZE + levels.size(), 0);
+    memcpy(file.data(), FILE_MAGIC, sizeof(FILE_MAGIC));
+    file[4] = FILE_VERSION;
+    file[5] = FRAME_DURATION_MS;
+
+    uint32_t frameCount = static_cast<uint32_t>(levels.size());
+    for (int i = 0; i < 4; i++)
+    {
+        file[8 + i] = static_cast<uint8_t>(frameCount >> (8 * i));
+    }
+
+    if (!levels.empty())
+    {
+        memcpy(file.data() + HEADER_SIZE, levels.data(), levels.size());
+    }
+    return file;
+}
+
+double JawEnvelope::amplitudeAt(unsigned long playbackTimeMs) const
+{
+    size_t frame = playbackTimeMs / FRAME_DURATION_MS;
+    if (frame >= m_levels.size())
+    {
+        return 0.0;
+    }
+    return levelToAmplitude(m_levels[frame]);
+}
@@ -0,0 +1,73 @@
+#ifndef JAW_ENVELOPE_H
+#define JAW_ENVELOPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// JawEnvelope is a precomputed jaw-opening track for an audio file: one byte per 10ms giving how far
+// the jaw should be open (0 = closed, 255 = fully open).
+//
+// Envelopes are generated offline by tools/jaw_envelope_generator.cpp and stored on the SD card next to
+// the skit's txt file ("Skit - name.jaw"). When one exists, SkullAudioAnimator looks the jaw opening up
+// by playback time instead of analyzing audio in the A2DP callback, which also makes jaw motion identical
+// on both skulls. The amplitude processing constants live here so the live analysis and the offline tool
+// can't drift apart.
+//
+// Only standard C++ is used so the same code builds into the host-side generator.
+class JawEnvelope
+{
+public:
+    static constexpr uint32_t FRAME_DURATION_MS = 10;       // Playback time covered by each envelope byte
+    static constexpr const char *FILE_EXTENSION = ".jaw";   // Replaces ".txt"/".wav" in the skit file name
+
+    // Frames per live analysis block: the A2DP source asks for 512 bytes (128 frames, ~2.9ms) per callback.
+    // The generator smooths over blocks of the same length so offline and live motion match.
+    static constexpr uint32_t ANALYSIS_BLOCK_FRAMES = 128;
+    static constexpr uint32_t ANALYSIS_SAMPLE_RATE = 44100;
+
+    // Controls how much weight is given to new amplitude vs. previous smoothed value.
+    // Lower value (e.g., 0.1) results in more smoothing, reducing sensitivity to transient peaks.
+    static constexpr double AMPLITUDE_SMOOTHING_FACTOR = 0.1;
+
+    // Amplifies the smoothed amplitude to utilize the full range of the servo.
+    // Adjust based on testing to achieve desired jaw movement range.
+    static constexpr double AMPLITUDE_GAIN = 5.0;
+
+    // Sets the upper limit for mapping amplitudes to servo positions.
+    // Adjust based on your audio levels to prevent over-extension of the jaw.
+    static constexpr double MAX_EXPECTED_AMPLITUDE = 15000.0;
+
+    // Determines the minimum amplitude required to start moving the jaw.
+    // Helps achieve "mostly open" and "mostly closed" effect by ignoring minor fluctuations.
+    static constexpr double AMPLITUDE_THRESHOLD = 1000.0;
+
+    // Exponentially smooth a new RMS amplitude into the running value
+    static double smoothAmplitude(double smoothedAmplitude, double rmsAmplitude);
+
+    // Apply gain, clamp to MAX_EXPECTED_AMPLITUDE, and zero anything under AMPLITUDE_THRESHOLD
+    static double adjustAmplitude(double smoothedAmplitude);
+
+    // Convert between adjusted amplitude (0 - MAX_EXPECTED_AMPLITUDE) and an envelope byte
+    static uint8_t amplitudeToLevel(double adjustedAmplitude);
+    static double levelToAmplitude(uint8_t level);
+
+    // Load an envelope from the contents of a .jaw file. Returns false (leaving the envelope empty) if it's invalid.
+    bool parse(const uint8_t *data, size_t size);
+
+    // Produce the contents of a .jaw file for the given levels
+    static std::vector<uint8_t> serialize(const std::vector<uint8_t> &levels);
+
+    bool isEmpty() const { return m_levels.empty(); }
+
+    // Number of 10ms frames in the envelope
+    size_t frameCount() const { return m_levels.size(); }
+
+    // Adjusted amplitude (0 - MAX_EXPECTED_AMPLITUDE) at the given playback time; 0 past the end
+    double amplitudeAt(unsigned long playbackTimeMs) const;
+
+private:
+    std::vector<uint8_t> m_levels;
+};
+
+#endif // JAW_ENVELOPE_H
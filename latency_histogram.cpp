@@ -0,0 +1,103 @@
+/*
+    Latency histograms. See latency_histogram.h.
+*/
+
+#include "latency_histogram.h"
+
+template <typename Buckets>
+Histogram<Buckets>::Histogram()
+{
+    reset();
+}
+
+// Forget all recorded durations
+template <typename Buckets>
+void Histogram<Buckets>::reset()
+{
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_maxMicros.store(0, std::memory_order_relaxed);
+}
+
+// Count one duration
+template <typename Buckets>
+void Histogram<Buckets>::record(uint32_t micros)
+{
+    m_buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    if (micros > m_maxMicros.load(std::memory_order_relaxed))
+    {
+        m_maxMicros.store(micros, std::memory_order_relaxed); // Only one task records
+    }
+}
+
+// Upper bound on a percentile of the durations
+template <typename Buckets>
+uint32_t Histogram<Buckets>::percentileMicros(uint32_t percent) const
+{
+    uint32_t total = count();
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the duration at that percentile, counting from 1
+    uint64_t rank = (static_cast<uint64_t>(total) * (percent > 100 ? 100 : percent) + 99) / 100;
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    uint32_t maximum = maxMicros();
+    for (size_t i = 0; i < BUCKET_COUNT - 1; i++)
+    {
+        seen += bucketCount(i);
+        if (seen >= rank)
+        {
+            uint32_t upper = bucketLowerMicros(i + 1) - 1;
+            return upper < maximum ? upper : maximum;
+        }
+    }
+    return maximum;
+}
+
+template class Histogram<PowerOfTwoBuckets>;
+template class Histogram<DeadlineBuckets>;
+
+// Bucket a duration is counted in: the position of its highest set bit
+size_t PowerOfTwoBuckets::bucketFor(uint32_t micros)
+{
+    size_t bucket = 0;
+    while (micros > 1 && bucket < COUNT - 1)
+    {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+DeadlineHistogram::DeadlineHistogram(uint32_t deadlineMicros)
+    : m_deadlineMicros(deadlineMicros), m_missCount(0)
+{
+}
+
+// Forget all recorded durations
+void DeadlineHistogram::reset()
+{
+    Histogram<DeadlineBuckets>::reset();
+    m_missCount.store(0, std::memory_order_relaxed);
+}
+
+// Count one duration, and whether it missed the deadline
+void DeadlineHistogram::record(uint32_t micros)
+{
+    Histogram<DeadlineBuckets>::record(micros);
+    if (micros > m_deadlineMicros)
+    {
+        m_missCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
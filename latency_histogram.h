@@ -0,0 +1,103 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Histogram counts durations in the buckets of a Buckets mapping, which provides:
+//     static constexpr size_t COUNT;                    Number of buckets; the last holds everything from its lower bound up
+//     static size_t bucketFor(uint32_t micros);         Bucket a duration is counted in
+//     static uint32_t lowerMicros(size_t bucket);       Lowest duration a bucket holds
+// Percentiles come out within a bucket from COUNT counters, and recording is a few instructions with no allocation.
+//
+// One task records; any task can read. Counters are relaxed atomics, so a reader may see a snapshot that's a
+// record or two out of step between counters, never a torn one.
+//
+// The members are defined in latency_histogram.cpp, for the mappings below.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+template <typename Buckets>
+class Histogram
+{
+public:
+    static constexpr size_t BUCKET_COUNT = Buckets::COUNT;
+
+    Histogram();
+
+    // Forget all recorded durations
+    void reset();
+
+    // Count one duration
+    void record(uint32_t micros);
+
+    // Durations recorded since reset()
+    uint32_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+    // Longest duration recorded (0 if none)
+    uint32_t maxMicros() const { return m_maxMicros.load(std::memory_order_relaxed); }
+
+    // Upper bound on the given percentile (0-100) of the durations: the top of the bucket it falls in, or the
+    // maximum if that's lower. 0 if nothing has been recorded.
+    uint32_t percentileMicros(uint32_t percent) const;
+
+    // Durations counted in a bucket, and the lowest duration the bucket holds
+    uint32_t bucketCount(size_t bucket) const { return m_buckets[bucket].load(std::memory_order_relaxed); }
+    static uint32_t bucketLowerMicros(size_t bucket) { return Buckets::lowerMicros(bucket); }
+
+    // Bucket a duration is counted in
+    static size_t bucketFor(uint32_t micros) { return Buckets::bucketFor(micros); }
+
+private:
+    std::atomic<uint32_t> m_buckets[BUCKET_COUNT];
+    std::atomic<uint32_t> m_count;
+    std::atomic<uint32_t> m_maxMicros;
+};
+
+// Power-of-two buckets: bucket 0 holds 0-1us, bucket i holds [2^i, 2^(i+1)) us, and the last bucket everything from
+// 2^(COUNT - 1) us (~8.4s) up. Coarse, but percentiles come out within a factor of two over any range.
+struct PowerOfTwoBuckets
+{
+    static constexpr size_t COUNT = 24;
+    static size_t bucketFor(uint32_t micros);
+    static uint32_t lowerMicros(size_t bucket) { return bucket == 0 ? 0 : (1u << bucket); }
+};
+
+// Linear MICROS buckets up to just past twice a ~2.9ms deadline (the last bucket holds everything from there up),
+// where power-of-two buckets can't tell 2.1ms from 4ms
+struct DeadlineBuckets
+{
+    static constexpr uint32_t MICROS = 64;
+    static constexpr size_t COUNT = 96; // 0-6.1ms
+    static size_t bucketFor(uint32_t micros) { return micros / MICROS < COUNT ? micros / MICROS : COUNT - 1; }
+    static uint32_t lowerMicros(size_t bucket) { return static_cast<uint32_t>(bucket) * MICROS; }
+};
+
+// Durations of any length, such as BLE command round trips
+typedef Histogram<PowerOfTwoBuckets> LatencyHistogram;
+
+// Durations that have to finish within a deadline, such as the A2DP data callback's ~2.9ms. Also counts the
+// durations over the deadline, exactly rather than from the buckets.
+class DeadlineHistogram : public Histogram<DeadlineBuckets>
+{
+public:
+    explicit DeadlineHistogram(uint32_t deadlineMicros);
+
+    // Forget all recorded durations
+    void reset();
+
+    // Count one duration
+    void record(uint32_t micros);
+
+    // Durations recorded since reset() that took longer than the deadline
+    uint32_t missCount() const { return m_missCount.load(std::memory_order_relaxed); }
+
+    // The deadline given to the constructor
+    uint32_t deadlineMicros() const { return m_deadlineMicros; }
+
+private:
+    uint32_t m_deadlineMicros;
+    std::atomic<uint32_t> m_missCount;
+};
+
+#endif // LATENCY_HISTOGRAM_H
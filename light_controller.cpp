@@ -1,9 +1,13 @@
 #include "light_controller.h"
+#include <driver/ledc.h>
+#include <algorithm>
 
 // LightController class constructor
 // Initializes the pins for left and right eyes and sets initial brightness to off
 LightController::LightController(int leftEyePin, int rightEyePin)
-    : _leftEyePin(leftEyePin), _rightEyePin(rightEyePin), _currentBrightness(BRIGHTNESS_OFF) {}
+    : _leftEyePin(leftEyePin), _rightEyePin(rightEyePin), _currentBrightness(-1),
+      _requestedBrightness(BRIGHTNESS_OFF), _requestedFadeMs(0), _fadeEndMillis(0),
+      _patternLength(0), _patternStep(0), _timer(nullptr) {}
 
 // Initializes the LightController
 // Sets up PWM channels and attaches them to the eye pins
@@ -22,63 +26,149 @@ void LightController::begin()
     ledcAttachPin(_leftEyePin, PWM_CHANNEL_LEFT);
     ledcAttachPin(_rightEyePin, PWM_CHANNEL_RIGHT);
 
+    // Enable the LEDC hardware fade
+    if (ledc_fade_func_install(0) != ESP_OK)
+    {
+        Serial.println("LightController::begin() Failed to install LEDC fade; brightness changes will be immediate");
+    }
+
+    // Timer for blink patterns and fades waiting on a running fade
+    _timer = xTimerCreate("Eyes", 1, pdFALSE, this, timerCallback);
+    if (_timer == nullptr)
+    {
+        Serial.println("LightController::begin() Failed to create eye timer");
+    }
+
     // Initialize eyes to maximum brightness
     setEyeBrightness(BRIGHTNESS_MAX);
 }
 
 // Sets the brightness of both eyes
 // @param brightness: uint8_t value between 0 (off) and 255 (max brightness)
-// NOTE: I can't get PWM to go to full brightness, so we're setting the pin value to HIGH
-//       when brightness is set to BRIGHTNESS_MAX, and using BRIGHTNESS_MAX as "dim".
 void LightController::setEyeBrightness(uint8_t brightness)
 {
-    // Ensure brightness is within valid range (0-255)
-    brightness = constrain(brightness, BRIGHTNESS_OFF, BRIGHTNESS_MAX);
+    fadeEyeBrightness(brightness, 0);
+}
 
-    if (brightness != _currentBrightness)
-    {
-        if (brightness == BRIGHTNESS_MAX)
-        {
-            // Detach PWM from pins
-            ledcDetachPin(_leftEyePin);
-            ledcDetachPin(_rightEyePin);
-
-            // Set pins to HIGH
-            pinMode(_leftEyePin, OUTPUT);
-            pinMode(_rightEyePin, OUTPUT);
-            digitalWrite(_leftEyePin, HIGH);
-            digitalWrite(_rightEyePin, HIGH);
-        }
-        else
-        {
-            if (_currentBrightness == BRIGHTNESS_DIM)
-            {
-                _currentBrightness = BRIGHTNESS_MAX;
-            }
-            // Reattach PWM to pins
-            ledcAttachPin(_leftEyePin, PWM_CHANNEL_LEFT);
-            ledcAttachPin(_rightEyePin, PWM_CHANNEL_RIGHT);
-
-            // Set PWM duty cycle
-            ledcWrite(PWM_CHANNEL_LEFT, _currentBrightness);
-            ledcWrite(PWM_CHANNEL_RIGHT, _currentBrightness);
-        }
-        _currentBrightness = brightness;
-    }
+// Fades both eyes to a brightness in hardware
+// @param brightness: uint8_t value between 0 (off) and 255 (max brightness)
+// @param durationMs: Fade time (0 sets the brightness straight away)
+void LightController::fadeEyeBrightness(uint8_t brightness, uint16_t durationMs)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _requestedBrightness = brightness;
+    _requestedFadeMs = durationMs;
+    applyRequestedBrightness();
 }
 
-// Blinks the eyes a specified number of times
+// Blinks the eyes a specified number of times, in the background
 // @param numBlinks: Number of times to blink
 // @param onBrightness: Brightness level when eyes are on
 // @param offBrightness: Brightness level when eyes are off
 void LightController::blinkEyes(int numBlinks, int onBrightness, int offBrightness)
 {
+    numBlinks = constrain(numBlinks, 0, MAX_BLINKS);
+    onBrightness = constrain(onBrightness, BRIGHTNESS_OFF, BRIGHTNESS_MAX);
+    offBrightness = constrain(offBrightness, BRIGHTNESS_OFF, BRIGHTNESS_MAX);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _patternLength = 0;
     for (int i = 0; i < numBlinks; i++)
     {
-        setEyeBrightness(onBrightness);
-        delay(100); // Eyes on for 100ms
-        setEyeBrightness(offBrightness);
-        delay(100); // Eyes off for 100ms
+        _pattern[_patternLength++] = {static_cast<uint8_t>(onBrightness), BLINK_PHASE_MS};
+        _pattern[_patternLength++] = {static_cast<uint8_t>(offBrightness), BLINK_PHASE_MS};
+    }
+    _patternStep = 0;
+
+    // Ensure eyes are on at the end of blinking sequence (unless something asks for another brightness meanwhile)
+    _requestedBrightness = onBrightness;
+    _requestedFadeMs = 0;
+
+    if (_timer == nullptr)
+    {
+        _patternLength = 0; // No timer to play it; just show the end result
+    }
+    if (_patternLength == 0)
+    {
+        applyRequestedBrightness();
+        return;
+    }
+    scheduleTimer(0);
+}
+
+// True while a blink pattern is playing
+bool LightController::isBlinking()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _patternStep < _patternLength;
+}
+
+// Timer callback: play the next pattern step (then go back to the requested brightness at the end),
+// or start a fade that was waiting for the last one to end
+void LightController::timerCallback(TimerHandle_t timer)
+{
+    LightController *self = static_cast<LightController *>(pvTimerGetTimerID(timer));
+    std::lock_guard<std::mutex> lock(self->_mutex);
+
+    if (self->_patternStep < self->_patternLength)
+    {
+        const PatternStep &step = self->_pattern[self->_patternStep++];
+        self->startFade(step.brightness, 0);
+        self->scheduleTimer(step.durationMs);
+        return;
+    }
+    self->applyRequestedBrightness();
+}
+
+// Show the requested brightness if nothing else is in the way
+void LightController::applyRequestedBrightness()
+{
+    // Coalesce: nothing to do if the eyes already show (or are fading to) this brightness
+    if (_patternStep < _patternLength || _requestedBrightness == _currentBrightness)
+    {
+        return;
     }
-    setEyeBrightness(onBrightness); // Ensure eyes are on at the end of blinking sequence
-}
\ No newline at end of file
+
+    // Starting a fade waits for the running one to finish, so hold the request until then
+    long remainingMs = static_cast<long>(_fadeEndMillis - millis());
+    if (remainingMs > 0 && _timer != nullptr)
+    {
+        scheduleTimer(remainingMs + 1);
+        return;
+    }
+
+    startFade(_requestedBrightness, _requestedFadeMs);
+}
+
+// Start a hardware fade of both eyes.
+// The channels map to LEDC speed mode and channel the same way the Arduino ledc functions map them.
+void LightController::startFade(uint8_t brightness, uint16_t durationMs)
+{
+    const uint8_t channels[] = {PWM_CHANNEL_LEFT, PWM_CHANNEL_RIGHT};
+    uint32_t duty = brightnessToDuty(brightness);
+    for (uint8_t channel : channels)
+    {
+        ledc_mode_t speedMode = static_cast<ledc_mode_t>(channel / 8);
+        ledc_channel_t ledcChannel = static_cast<ledc_channel_t>(channel % 8);
+        if (durationMs == 0 || ledc_set_fade_time_and_start(speedMode, ledcChannel, duty, durationMs, LEDC_FADE_NO_WAIT) != ESP_OK)
+        {
+            ledc_set_duty(speedMode, ledcChannel, duty);
+            ledc_update_duty(speedMode, ledcChannel);
+        }
+    }
+    _currentBrightness = brightness;
+    _fadeEndMillis = millis() + durationMs;
+}
+
+// Run the timer callback again in delayMs
+void LightController::scheduleTimer(uint32_t delayMs)
+{
+    // Never blocks: from another task this only queues a command for the timer task
+    xTimerChangePeriod(_timer, std::max<TickType_t>(pdMS_TO_TICKS(delayMs), 1), 0);
+}
+
+// LEDC duty for a brightness
+uint32_t LightController::brightnessToDuty(uint8_t brightness)
+{
+    return brightness == BRIGHTNESS_MAX ? (1u << PWM_RESOLUTION) : brightness;
+}
@@ -2,6 +2,10 @@
 #define LIGHT_CONTROLLER_H
 
 #include <Arduino.h>
+#include "animation_outputs.h"
+#include <mutex>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
 
 // PWM configuration constants
 #define PWM_FREQUENCY 5000  // PWM frequency in Hz
@@ -10,15 +14,20 @@
 #define PWM_CHANNEL_LEFT 0  // PWM channel for left eye
 #define PWM_CHANNEL_RIGHT 1 // PWM channel for right eye
 
-class LightController
+// LightController drives the eye LEDs with the ESP32's LEDC peripheral.
+//
+// Brightness changes can fade in hardware (LEDC fade), so a fade costs no CPU once started. Requests are
+// coalesced: asking for the brightness the eyes already have (or are fading to) writes nothing, and a request
+// made while a fade is still running is held and started when that fade ends, so the caller never waits on the
+// hardware. That makes it cheap enough to call from every audio callback.
+//
+// Blinks are played from a timer in the background, so blinkEyes() returns immediately. While a blink pattern
+// plays, brightness requests are remembered and the eyes go back to the latest one when it ends.
+class LightController : public EyeLights
 {
 public:
-    // Brightness constants
-    // NOTE: I can't get PWM to go to full brightness, so these constants don't really do much.
-    //       See LightController::setEyeBrightness() for actual implementation.
-    static const uint8_t BRIGHTNESS_MAX = PWM_MAX; // Maximum brightness level
-    static const uint8_t BRIGHTNESS_DIM = 100;     // Dimmed brightness level
-    static const uint8_t BRIGHTNESS_OFF = 0;       // Lights off
+    // Brightness constants (BRIGHTNESS_MAX, BRIGHTNESS_DIM, BRIGHTNESS_OFF) are EyeLights'
+    static_assert(BRIGHTNESS_MAX == PWM_MAX, "Full brightness must be the full PWM duty");
 
     // Constructor: Initializes the pins for left and right eyes
     LightController(int leftEyePin, int rightEyePin);
@@ -30,16 +39,62 @@ public:
     // @param brightness: uint8_t value between 0 (off) and 255 (max brightness)
     void setEyeBrightness(uint8_t brightness);
 
-    // Blinks the eyes a specified number of times
-    // @param numBlinks: Number of times to blink
+    // Fades both eyes to a brightness in hardware. Returns immediately.
+    // @param brightness: uint8_t value between 0 (off) and 255 (max brightness)
+    // @param durationMs: Fade time (0 sets the brightness straight away)
+    void fadeEyeBrightness(uint8_t brightness, uint16_t durationMs) override;
+
+    // Blinks the eyes a specified number of times, in the background. Replaces any blink already playing.
+    // @param numBlinks: Number of times to blink (up to MAX_BLINKS)
     // @param onBrightness: Brightness level when eyes are on (default: BRIGHTNESS_MAX)
     // @param offBrightness: Brightness level when eyes are off (default: BRIGHTNESS_OFF)
     void blinkEyes(int numBlinks, int onBrightness = BRIGHTNESS_MAX, int offBrightness = BRIGHTNESS_OFF);
 
+    // True while a blink pattern is playing
+    bool isBlinking();
+
+    static const int MAX_BLINKS = 8;
+
 private:
+    static const uint16_t BLINK_PHASE_MS = 100; // Eyes on (or off) for this long in each half of a blink
+
+    // One step of a blink pattern: show a brightness for a time
+    struct PatternStep
+    {
+        uint8_t brightness;
+        uint16_t durationMs;
+    };
+
+    // Timer callback: play the next pattern step, or start a fade that was waiting for the last one to end
+    static void timerCallback(TimerHandle_t timer);
+
+    // Show the requested brightness, unless the eyes already show it, a pattern is playing, or a fade is
+    // running (then the timer starts it when the fade ends). Caller holds _mutex.
+    void applyRequestedBrightness();
+
+    // Start a hardware fade of both eyes (caller holds _mutex)
+    void startFade(uint8_t brightness, uint16_t durationMs);
+
+    // Run the timer callback again in delayMs (caller holds _mutex)
+    void scheduleTimer(uint32_t delayMs);
+
+    // LEDC duty for a brightness: full on needs a duty of 2^resolution, one more than PWM_MAX
+    static uint32_t brightnessToDuty(uint8_t brightness);
+
     int _leftEyePin;        // Pin number for the left eye LED
     int _rightEyePin;       // Pin number for the right eye LED
-    int _currentBrightness; // Current brightness level of both eyes
+    int _currentBrightness; // Brightness the eyes show (or are fading to)
+    int _requestedBrightness;       // Latest setEyeBrightness()/fadeEyeBrightness() brightness
+    uint16_t _requestedFadeMs;      // and its fade time
+    unsigned long _fadeEndMillis;   // When the running fade ends
+
+    // Blink pattern being played
+    PatternStep _pattern[MAX_BLINKS * 2];
+    size_t _patternLength;
+    size_t _patternStep; // Next step to play; the pattern is playing while < _patternLength
+
+    TimerHandle_t _timer;
+    std::mutex _mutex; // Guards the state above and the LEDC writes (callers: main loop, audio callback, timer)
 };
 
-#endif // LIGHT_CONTROLLER_H
\ No newline at end of file
+#endif // LIGHT_CONTROLLER_H
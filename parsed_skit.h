@@ -2,17 +2,13 @@
 
 #include <Arduino.h>
 #include <vector>
-
-struct ParsedSkitLine {
-    size_t lineNumber;
-    char speaker;
-    unsigned long timestamp;
-    unsigned long duration;
-    float jawPosition;
-};
+#include <memory>
+#include "jaw_envelope.h"
+#include "skit_script_parser.h" // ParsedSkitLine
 
 struct ParsedSkit {
     String audioFile;
     String txtFile;
     std::vector<ParsedSkitLine> lines;
+    std::shared_ptr<const JawEnvelope> jawEnvelope; // Precomputed jaw motion, null if the skit has no .jaw file
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Thin interfaces to what the audio path needs from the platform: files, a clock and background tasks.
+//
+// AudioPlayer, SDCardManager, SkullAudioAnimator, BandEnergyAnalyzer and ConfigManager only reach the SD card, esp_timer
+// and FreeRTOS through these, so the same translation units build on a host machine. esp32_platform.h implements them
+// for the skulls; tools/host/host_platform.h implements them with stdio, std::chrono and std::thread for the host tools.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+
+// A file open for reading. Closed when destroyed.
+class PlatformFile
+{
+public:
+    virtual ~PlatformFile() {}
+
+    // Read up to size bytes. Returns the number read, 0 at the end of the file.
+    virtual size_t read(uint8_t *buffer, size_t size) = 0;
+
+    // Move the read position to an offset from the start of the file
+    virtual bool seek(uint32_t position) = 0;
+
+    virtual uint32_t position() = 0;
+    virtual uint32_t size() = 0;
+};
+
+// Opens files for reading by their absolute path on the card (e.g. "/audio/Skit - names.wav")
+class FileSystem
+{
+public:
+    virtual ~FileSystem() {}
+
+    // Mount the file system. Returns false if it can't be mounted.
+    virtual bool begin() = 0;
+
+    // Open a file for reading. Returns nullptr if there's no such file (or it's a directory).
+    virtual std::unique_ptr<PlatformFile> open(const char *path) = 0;
+
+    // Names (without the directory) of the files in a directory, in the order the file system lists them.
+    // Returns false if the directory can't be opened.
+    virtual bool listFiles(const char *directory, std::vector<std::string> &names) = 0;
+};
+
+// Time since startup
+class Clock
+{
+public:
+    virtual ~Clock() {}
+
+    // Microseconds: esp_timer_get_time() on the ESP32, the clock playAt() start times are on
+    virtual int64_t micros() = 0;
+
+    // Milliseconds, as Arduino's millis() (wraps after ~49 days)
+    virtual unsigned long millis() = 0;
+
+    // Free-running cycle counter, for timing short stretches of code on one core (wraps), and its ticks per microsecond
+    virtual uint32_t cycleCount() = 0;
+    virtual uint32_t cyclesPerMicro() = 0;
+};
+
+// Background tasks that sleep until they're notified or until their next period
+class Tasks
+{
+public:
+    typedef void *Handle;
+    typedef void (*Entry)(void *param);
+
+    virtual ~Tasks() {}
+
+    // Run entry(param) on a new task; entry never returns. Priority and core are FreeRTOS's (higher runs first, and
+    // the task is pinned to the core) and may be ignored by other platforms. Returns nullptr if it couldn't start.
+    virtual Handle start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core) = 0;
+
+    // Wake a task sleeping in waitForNotification(), or make its next call return straight away
+    virtual void notify(Handle task) = 0;
+
+    // From a task: sleep until notified, or for at most timeoutMs
+    virtual void waitForNotification(uint32_t timeoutMs) = 0;
+
+    // From a task: sleep until periodMs after wakeMs (a Clock::millis() time), then advance wakeMs by periodMs.
+    // Runs a task every periodMs however long each run takes; a task that's behind doesn't sleep until it catches up.
+    virtual void delayUntil(unsigned long &wakeMs, uint32_t periodMs) = 0;
+};
+
+#endif // PLATFORM_H
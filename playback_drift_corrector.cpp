@@ -0,0 +1,144 @@
+/*
+    Playback drift correction between the skulls. See playback_drift_corrector.h.
+*/
+
+#include "playback_drift_corrector.h"
+#include <math.h>
+
+PlaybackDriftCorrector::PlaybackDriftCorrector(uint32_t sampleRate)
+    : m_sampleRate(sampleRate)
+{
+    reset();
+}
+
+// Start over for a new skit
+void PlaybackDriftCorrector::reset()
+{
+    m_count = 0;
+    m_smoothedRawGap = 0.0;
+    m_correctionFrames = 0;
+    m_isCorrecting = false;
+    m_firstElapsed = 0;
+    m_lastElapsed = 0;
+    m_sumT = 0.0;
+    m_sumGap = 0.0;
+    m_sumTT = 0.0;
+    m_sumTGap = 0.0;
+    m_sumGapGap = 0.0;
+}
+
+// Add a measurement and return the correction to make
+int32_t PlaybackDriftCorrector::update(int64_t elapsedMicros, int64_t measuredGapMicros, int32_t correctionFrames)
+{
+    // Inserting frames holds the Secondary back, so without them it would be that much further ahead
+    double rawGap = static_cast<double>(measuredGapMicros + framesToMicros(correctionFrames));
+    if (m_count == 0)
+    {
+        m_firstElapsed = elapsedMicros;
+        m_smoothedRawGap = rawGap;
+    }
+    else
+    {
+        m_smoothedRawGap += SMOOTHING * (rawGap - m_smoothedRawGap);
+    }
+    m_count++;
+    m_correctionFrames = correctionFrames;
+    m_lastElapsed = elapsedMicros;
+
+    double t = static_cast<double>(elapsedMicros - m_firstElapsed) / 1e6;
+    m_sumT += t;
+    m_sumGap += rawGap;
+    m_sumTT += t * t;
+    m_sumTGap += t * rawGap;
+    m_sumGapGap += rawGap * rawGap;
+
+    // Only correct a drift that's been measured, and only the gap it opens: one against it closes by itself
+    double drift = driftPpm();
+    int64_t gap = gapMicros();
+    if (!isDriftSignificant() || (gap > 0) != (drift > 0))
+    {
+        m_isCorrecting = false;
+        return 0;
+    }
+    int64_t gapSize = gap < 0 ? -gap : gap;
+    if (m_isCorrecting ? gapSize <= STOP_GAP_MICROS : gapSize <= START_GAP_MICROS)
+    {
+        m_isCorrecting = false;
+        return 0;
+    }
+    m_isCorrecting = true;
+    return static_cast<int32_t>(llround(static_cast<double>(gap) * m_sampleRate / 1e6));
+}
+
+// Gap after the corrections made so far
+int64_t PlaybackDriftCorrector::gapMicros() const
+{
+    double intercept;
+    double slope;
+    double slopeError;
+    double rawGap = m_smoothedRawGap;
+    if (fitDrift(intercept, slope, slopeError))
+    {
+        rawGap = intercept + slope * static_cast<double>(m_lastElapsed - m_firstElapsed) / 1e6;
+    }
+    return llround(rawGap) - framesToMicros(m_correctionFrames);
+}
+
+// Slope of the uncorrected gap over the skit
+double PlaybackDriftCorrector::driftPpm() const
+{
+    double intercept;
+    double slope;
+    double slopeError;
+    return fitDrift(intercept, slope, slopeError) ? slope : 0.0;
+}
+
+// Standard error of the slope
+double PlaybackDriftCorrector::driftUncertaintyPpm() const
+{
+    double intercept;
+    double slope;
+    double slopeError;
+    return fitDrift(intercept, slope, slopeError) ? slopeError : 0.0;
+}
+
+// Whether the drift is far enough from zero to correct
+bool PlaybackDriftCorrector::isDriftSignificant() const
+{
+    double intercept;
+    double slope;
+    double slopeError;
+    return fitDrift(intercept, slope, slopeError) && fabs(slope) > DRIFT_SIGNIFICANCE * slopeError;
+}
+
+// Fit a line to the uncorrected gap over time (t in seconds from the first measurement, gap in us: the slope is ppm)
+bool PlaybackDriftCorrector::fitDrift(double &interceptMicros, double &slopePpm, double &slopeErrorPpm) const
+{
+    if (m_count < 3 || m_lastElapsed - m_firstElapsed < MIN_DRIFT_SPAN_MICROS)
+    {
+        return false;
+    }
+    double n = static_cast<double>(m_count);
+    double sxx = m_sumTT - m_sumT * m_sumT / n;
+    if (sxx <= 0.0)
+    {
+        return false;
+    }
+    double sxy = m_sumTGap - m_sumT * m_sumGap / n;
+    double syy = m_sumGapGap - m_sumGap * m_sumGap / n;
+    slopePpm = sxy / sxx;
+    interceptMicros = (m_sumGap - slopePpm * m_sumT) / n;
+    double residualVariance = (syy - slopePpm * sxy) / (n - 2.0);
+    slopeErrorPpm = residualVariance > 0.0 ? sqrt(residualVariance / sxx) : 0.0;
+    return true;
+}
+
+// Net correction made so far, as a rate
+double PlaybackDriftCorrector::correctionPpm() const
+{
+    if (m_lastElapsed <= 0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(framesToMicros(m_correctionFrames)) * 1e6 / static_cast<double>(m_lastElapsed);
+}
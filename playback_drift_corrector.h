@@ -0,0 +1,81 @@
+#ifndef PLAYBACK_DRIFT_CORRECTOR_H
+#define PLAYBACK_DRIFT_CORRECTOR_H
+
+#include <stdint.h>
+
+// PlaybackDriftCorrector keeps the Secondary's playback of a skit aligned with the Primary's.
+//
+// Both skulls start a skit on the same sample, but each clocks its audio out to its own A2DP speaker from its own
+// crystal, so over a few minutes they drift apart (two +/-20ppm crystals: up to 2.4ms a minute). While the skit plays
+// the Primary reports its playback position over BLE; the Secondary compares it with its own, both measured against
+// the shared clock, and inserts or drops single frames to close the gap.
+//
+// The gap is only measured as well as the clock sync allows, so most of what changes in it from report to report is
+// noise. Corrections wait until the drift is known: a straight line fitted to the uncorrected gap (the gap plus the
+// corrections made) over at least MIN_DRIFT_SPAN_MICROS, with a slope DRIFT_SIGNIFICANCE standard errors from zero.
+// The gap then comes from that line rather than the latest reports. A correction starts once the gap has grown past
+// START_GAP_MICROS in the direction of the drift, and runs until it's back within STOP_GAP_MICROS. A gap against
+// the drift is left alone: the drift closes it.
+//
+// Times are microseconds. Only standard C++ is used so it can be built and tested on a host machine.
+class PlaybackDriftCorrector
+{
+public:
+    static constexpr int64_t START_GAP_MICROS = 500;           // A correction starts when the gap grows past this
+    static constexpr int64_t STOP_GAP_MICROS = 100;            // and stops when it's back within this
+    static constexpr double DRIFT_SIGNIFICANCE = 3.0;           // Standard errors the drift must be from zero to act on
+    static constexpr double SMOOTHING = 0.3;                    // Weight of each new measurement in the gap before the drift is known
+    static constexpr int64_t MIN_DRIFT_SPAN_MICROS = 10000000; // Measurements needed to span this long to report drift
+
+    explicit PlaybackDriftCorrector(uint32_t sampleRate);
+
+    // Start over for a new skit
+    void reset();
+
+    // Add a measurement: elapsedMicros into the skit (shared clock), the Secondary's playback was measuredGapMicros
+    // ahead of the Primary's, after correctionFrames net frames had been inserted into it. Returns the correction to
+    // make from now on: frames to insert (positive) or drop (negative), replacing any still pending.
+    int32_t update(int64_t elapsedMicros, int64_t measuredGapMicros, int32_t correctionFrames);
+
+    // Gap after the corrections made so far (positive: Secondary ahead): from the drift once it's known, smoothed
+    // from the measurements before that
+    int64_t gapMicros() const;
+
+    // How fast the skulls drift apart without correction, in ppm (positive: Secondary runs fast). 0 until measured.
+    double driftPpm() const;
+
+    // Standard error of driftPpm(). 0 until measured.
+    double driftUncertaintyPpm() const;
+
+    // Whether the drift is far enough from zero, for its uncertainty, to correct
+    bool isDriftSignificant() const;
+
+    // Net correction made so far, as a rate in ppm of the skit played (positive: frames inserted)
+    double correctionPpm() const;
+
+    // Measurements added since reset()
+    uint32_t measurementCount() const { return m_count; }
+
+private:
+    int64_t framesToMicros(int64_t frames) const { return frames * 1000000 / m_sampleRate; }
+
+    // Least squares fit of the uncorrected gap: false until it spans MIN_DRIFT_SPAN_MICROS
+    bool fitDrift(double &interceptMicros, double &slopePpm, double &slopeErrorPpm) const;
+
+    uint32_t m_sampleRate;
+    uint32_t m_count;
+    double m_smoothedRawGap; // Gap there would be without the corrections
+    int32_t m_correctionFrames;
+    bool m_isCorrecting;
+    int64_t m_firstElapsed;
+    int64_t m_lastElapsed;
+
+    // Least squares sums of the uncorrected gap over time, relative to the first measurement, in seconds and us
+    double m_sumT;
+    double m_sumGap;
+    double m_sumTT;
+    double m_sumTGap;
+    double m_sumGapGap;
+};
+
+#endif // PLAYBACK_DRIFT_CORRECTOR_H
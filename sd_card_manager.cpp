@@ -1,9 +1,10 @@
 #include "sd_card_manager.h"
+#include <ctype.h>
 
-SDCardManager::SDCardManager() {}
+SDCardManager::SDCardManager(FileSystem& fileSystem) : m_fileSystem(fileSystem) {}
 
 bool SDCardManager::begin() {
-    if (!SD.begin()) {
+    if (!m_fileSystem.begin()) {
         Serial.println("SD Card: Mount Failed!");
         return false;
     }
@@ -33,20 +34,18 @@ SDCardContent SDCardManager::loadContent() {
 }
 
 bool SDCardManager::processSkitFiles(SDCardContent& content) {
-    File root = SD.open("/audio");
-    if (!root || !root.isDirectory()) {
+    std::vector<std::string> names;
+    if (!m_fileSystem.listFiles("/audio", names)) {
         Serial.println("SD Card: Failed to open /audio directory");
         return false;
     }
 
     std::vector<String> skitFiles;
-    File file = root.openNextFile();
-    while (file) {
-        String fileName = file.name();
+    for (const auto& name : names) {
+        String fileName = name.c_str();
         if (fileName.startsWith("Skit") && fileName.endsWith(".wav")) {
             skitFiles.push_back(fileName);
         }
-        file = root.openNextFile();
     }
 
     Serial.println("Processing " + String(skitFiles.size()) + " skits:");
@@ -55,18 +54,22 @@ bool SDCardManager::processSkitFiles(SDCardContent& content) {
         String txtFileName = baseName + ".txt";
         String fullWavPath = constructValidPath("/audio", fileName);
         String fullTxtPath = constructValidPath("/audio", txtFileName);
+        String fullJawPath = constructValidPath("/audio", baseName + JawEnvelope::FILE_EXTENSION);
 
         if (fileExists(fullTxtPath.c_str())) {
             ParsedSkit parsedSkit = parseSkitFile(fullWavPath, fullTxtPath);
+            if (fileExists(fullJawPath.c_str())) {
+                parsedSkit.jawEnvelope = loadJawEnvelope(fullJawPath);
+            }
             content.skits.push_back(parsedSkit);
-            Serial.println("- Processing skit '" + fileName + "' - success. (" + String(parsedSkit.lines.size()) + " lines)");
+            Serial.println("- Processing skit '" + fileName + "' - success. (" + String(parsedSkit.lines.size()) + " lines" +
+                (parsedSkit.jawEnvelope ? ", jaw envelope " + String(parsedSkit.jawEnvelope->frameCount()) + " frames" : "") + ")");
         } else {
             Serial.println("- Processing skit '" + fileName + "' - WARNING: missing txt file.");
         }
         content.audioFiles.push_back(fullWavPath);
     }
 
-    root.close();
     return true;
 }
 
@@ -75,39 +78,39 @@ ParsedSkit SDCardManager::parseSkitFile(const String& wavFile, const String& txt
     parsedSkit.audioFile = wavFile;
     parsedSkit.txtFile = txtFile;
 
-    File file = openFile(txtFile.c_str());
+    std::unique_ptr<PlatformFile> file = openFile(txtFile.c_str());
     if (!file) {
         Serial.println("Failed to open skit file: " + txtFile);
         return parsedSkit;
     }
 
-    size_t lineNumber = 0;
-    while (file.available()) {
-        String line = readLine(file);
-        line.trim();
-        if (line.length() == 0) continue;
+    // Scripts are small: read the whole file, then parse it
+    std::string text(file->size(), '\0');
+    text.resize(readFileBytes(*file, reinterpret_cast<uint8_t*>(&text[0]), text.size()));
+    file.reset();
 
-        ParsedSkitLine skitLine;
-        int commaIndex1 = line.indexOf(',');
-        int commaIndex2 = line.indexOf(',', commaIndex1 + 1);
-        int commaIndex3 = line.indexOf(',', commaIndex2 + 1);
+    parsedSkit.lines = SkitScriptParser::parse(text);
+    return parsedSkit;
+}
 
-        skitLine.lineNumber = lineNumber++;
-        skitLine.speaker = line.charAt(0);
-        skitLine.timestamp = line.substring(commaIndex1 + 1, commaIndex2).toInt();
-        skitLine.duration = line.substring(commaIndex2 + 1, commaIndex3).toInt();
+// Load a precomputed jaw envelope. This reads the whole file at startup so nothing touches the SD card during playback.
+std::shared_ptr<const JawEnvelope> SDCardManager::loadJawEnvelope(const String& jawFile) {
+    std::unique_ptr<PlatformFile> file = openFile(jawFile.c_str());
+    if (!file) {
+        Serial.println("Failed to open jaw envelope file: " + jawFile);
+        return nullptr;
+    }
 
-        if (commaIndex3 != -1) {
-            skitLine.jawPosition = line.substring(commaIndex3 + 1).toFloat();
-        } else {
-            skitLine.jawPosition = -1;  // Indicating dynamic jaw movement
-        }
+    std::vector<uint8_t> data(file->size());
+    size_t bytesRead = readFileBytes(*file, data.data(), data.size());
+    file.reset();
 
-        parsedSkit.lines.push_back(skitLine);
+    std::shared_ptr<JawEnvelope> envelope = std::make_shared<JawEnvelope>();
+    if (bytesRead != data.size() || !envelope->parse(data.data(), data.size())) {
+        Serial.println("Invalid jaw envelope file, using live audio analysis instead: " + jawFile);
+        return nullptr;
     }
-
-    file.close();
-    return parsedSkit;
+    return envelope;
 }
 
 ParsedSkit SDCardManager::findSkitByName(const std::vector<ParsedSkit>& skits, const String& name) {
@@ -120,23 +123,14 @@ ParsedSkit SDCardManager::findSkitByName(const std::vector<ParsedSkit>& skits, c
 }
 
 bool SDCardManager::fileExists(const char* path) {
-    File file = SD.open(path);
-    if (!file || file.isDirectory()) {
-        return false;
-    }
-    file.close();
-    return true;
-}
-
-File SDCardManager::openFile(const char* path) {
-    return SD.open(path);
+    return m_fileSystem.open(path) != nullptr;
 }
 
-String SDCardManager::readLine(File& file) {
-    return file.readStringUntil('\n');
+std::unique_ptr<PlatformFile> SDCardManager::openFile(const char* path) {
+    return m_fileSystem.open(path);
 }
 
-size_t SDCardManager::readFileBytes(File& file, uint8_t* buffer, size_t bufferSize) {
+size_t SDCardManager::readFileBytes(PlatformFile& file, uint8_t* buffer, size_t bufferSize) {
     return file.read(buffer, bufferSize);
 }
 
@@ -1,10 +1,10 @@
 #ifndef SD_CARD_MANAGER_H
 #define SD_CARD_MANAGER_H
 
-#include "FS.h"
-#include "SD.h"
 #include <vector>
+#include <memory>
 #include "parsed_skit.h"
+#include "platform.h"
 
 struct SDCardContent {
     std::vector<ParsedSkit> skits;
@@ -15,21 +15,24 @@ struct SDCardContent {
     String secondaryMacAddress;
 };
 
+// SDCardManager loads the audio files and skits from the SD card, through a FileSystem
 class SDCardManager {
 public:
-    SDCardManager();
+    explicit SDCardManager(FileSystem& fileSystem);
     bool begin();
     SDCardContent loadContent();
     ParsedSkit findSkitByName(const std::vector<ParsedSkit>& skits, const String& name);
     bool fileExists(const char* path);
-    File openFile(const char* path);
-    String readLine(File& file);
-    size_t readFileBytes(File& file, uint8_t* buffer, size_t bufferSize);
+    std::unique_ptr<PlatformFile> openFile(const char* path);
+    size_t readFileBytes(PlatformFile& file, uint8_t* buffer, size_t bufferSize);
     String constructValidPath(const String& basePath, const String& fileName);
 
 private:
+    FileSystem& m_fileSystem;
+
     bool processSkitFiles(SDCardContent& content);
     ParsedSkit parseSkitFile(const String& wavFile, const String& txtFile);
+    std::shared_ptr<const JawEnvelope> loadJawEnvelope(const String& jawFile);
     bool isValidPathChar(char c);
 };
 
@@ -5,7 +5,8 @@
 // Initializes member variables with default values
 ServoController::ServoController()
     : servoPin(-1), currentPosition(0), minDegrees(0), maxDegrees(0),
-      smoothedPosition(0), lastPosition(0), maxObservedRMS(0), shouldInterruptMovement(false) {}
+      smoothedPosition(0), lastPosition(0), maxObservedRMS(0), motionTaskHandle(nullptr),
+      lastFollowMicros(0), hasWrittenPosition(false), writeCount(0), suppressedWriteCount(0) {}
 
 // Initialize the servo controller with specified parameters
 void ServoController::initialize(int pin, int minDeg, int maxDeg)
@@ -28,14 +29,77 @@ void ServoController::initialize(int pin, int minDeg, int maxDeg)
     Serial.println("Servo animation init complete; resetting to 0 degrees");
     delay(500);
     setPosition(minDegrees);
+
+    // Start the task that runs smoothMove()s in the background
+    if (motionTaskHandle == nullptr &&
+        xTaskCreatePinnedToCore(motionTask, "ServoMotion", MOTION_TASK_STACK_SIZE, this,
+                                MOTION_TASK_PRIORITY, &motionTaskHandle, MOTION_TASK_CORE) != pdPASS)
+    {
+        Serial.println("ServoController::initialize() Failed to create motion task");
+        motionTaskHandle = nullptr;
+    }
 }
 
-// Set the servo position within the allowed range
+// Set the servo position within the allowed range, preempting any queued moves
 void ServoController::setPosition(int degrees)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    planner.cancel();
+    writePosition(degrees);
+    trajectoryFilter.reset(currentPosition);
+}
+
+// Move toward degrees within the velocity and acceleration limits, preempting any queued moves
+void ServoController::followPosition(int degrees)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    planner.cancel();
+
+    unsigned long now = micros();
+    float elapsedSeconds = (now - lastFollowMicros) / 1000000.0f;
+    if (now - lastFollowMicros > FOLLOW_TIMEOUT_MICROS)
+    {
+        // After a pause (or other moves) start from rest wherever the servo is now
+        trajectoryFilter.reset(currentPosition);
+        elapsedSeconds = 0.0f;
+    }
+    lastFollowMicros = now;
+
+    float position = trajectoryFilter.update(constrain(degrees, minDegrees, maxDegrees), elapsedSeconds);
+    writePosition(static_cast<int>(lroundf(position)));
+}
+
+// Set the followPosition() limits
+void ServoController::setMotionLimits(float maxVelocity, float maxAcceleration)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    trajectoryFilter.setLimits(maxVelocity, maxAcceleration);
+}
+
+// Get a snapshot of the write counters
+ServoController::WriteStats ServoController::getWriteStats() const
+{
+    WriteStats stats;
+    stats.writes = writeCount.load(std::memory_order_relaxed);
+    stats.suppressedWrites = suppressedWriteCount.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Write a position to the servo, within the allowed range, unless it's already there
+void ServoController::writePosition(int degrees)
 {
     // Ensure the position is within the allowed range
     int constrainedDegrees = constrain(degrees, minDegrees, maxDegrees);
 
+    // Skip writes that wouldn't move the servo
+    if (hasWrittenPosition && constrainedDegrees == currentPosition)
+    {
+        suppressedWriteCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    hasWrittenPosition = true;
+    writeCount.fetch_add(1, std::memory_order_relaxed);
+
     // Write the position to the servo
     servo.write(servoPin, constrainedDegrees); // Corrected: Added servoPin as first argument
 
@@ -111,32 +175,83 @@ void ServoController::updatePosition(int targetPosition, double alpha, int minMo
     }
 }
 
-// Add this new method implementation
-void ServoController::smoothMove(int targetPosition, int duration) {
-    int startPosition = currentPosition;
-    unsigned long startTime = millis();
-    unsigned long endTime = startTime + duration;
-    
-    shouldInterruptMovement = false;  // Reset the interrupt flag at the start of movement
-    
-    while (millis() < endTime) {
-        if (shouldInterruptMovement) {
-            shouldInterruptMovement = false;  // Reset the flag
-            return;  // Exit the loop if interrupted
-        }
-        
-        unsigned long currentTime = millis();
-        float progress = static_cast<float>(currentTime - startTime) / duration;
-        int newPosition = startPosition + (targetPosition - startPosition) * progress;
-        
-        setPosition(newPosition);
-        delay(20); // Small delay to prevent overwhelming the servo
+// Queue a move to targetPosition over duration ms; the motion task runs it
+bool ServoController::smoothMove(int targetPosition, int duration, ServoMotionPlanner::Easing easing)
+{
+    bool queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued = planner.moveTo(constrain(targetPosition, minDegrees, maxDegrees), duration, easing, millis(), currentPosition);
     }
-    
-    // Ensure we reach the final position if not interrupted
-    setPosition(targetPosition);
+
+    if (!queued)
+    {
+        Serial.printf("ServoController::smoothMove() Too many moves queued, dropping move to %d\n", targetPosition);
+    }
+    else if (motionTaskHandle != nullptr)
+    {
+        xTaskNotifyGive(motionTaskHandle);
+    }
+    return queued;
+}
+
+// Queue a pause at the end of the queued moves
+bool ServoController::holdPosition(int duration)
+{
+    bool queued;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued = planner.hold(duration, millis(), currentPosition);
+    }
+
+    if (queued && motionTaskHandle != nullptr)
+    {
+        xTaskNotifyGive(motionTaskHandle);
+    }
+    return queued;
 }
 
-void ServoController::interruptMovement() {
-    shouldInterruptMovement = true;
-}
\ No newline at end of file
+// True while queued moves are running
+bool ServoController::isMoving()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return planner.isActive();
+}
+
+// Stop any queued moves where they are
+void ServoController::interruptMovement()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    planner.cancel();
+}
+
+// Motion task: sleep until a move is queued, then write the planned position every MOTION_STEP_MS until the
+// plan is done or preempted
+void ServoController::motionTask(void *param)
+{
+    ServoController *self = static_cast<ServoController *>(param);
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        TickType_t lastWake = xTaskGetTickCount();
+        bool isMoving = true;
+        while (isMoving)
+        {
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                isMoving = self->planner.isActive();
+                if (isMoving)
+                {
+                    self->writePosition(self->planner.positionAt(millis()));
+                    isMoving = self->planner.isActive();
+                }
+            }
+
+            if (isMoving)
+            {
+                vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(MOTION_STEP_MS));
+            }
+        }
+    }
+}
@@ -3,8 +3,20 @@
 
 #include <Arduino.h>
 #include <Servo.h>
+#include <mutex>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "servo_motion_planner.h"
+#include "servo_trajectory_filter.h"
+#include "animation_outputs.h"
 
-class ServoController {
+// ServoController drives the jaw servo, either directly (setPosition()), by following a changing target within
+// velocity and acceleration limits (followPosition(), e.g. from the audio), or through timed, eased moves
+// (smoothMove()) that a motion task steps in the background, so a move never blocks the caller.
+// setPosition() and followPosition() preempt any planned moves.
+// The servo is only written when its (whole degree) position changes.
+class ServoController : public JawServo {
 private:
     Servo servo;
     int servoPin;
@@ -14,17 +26,75 @@ private:
     double smoothedPosition;
     int lastPosition;
     double maxObservedRMS;
-    bool shouldInterruptMovement;  // Renamed from interruptMovement
+
+    // Planned moves, stepped by the motion task. The mutex guards the planner and servo writes; it's only ever
+    // held for one write, so a direct setPosition() from the audio callback never waits on a move.
+    ServoMotionPlanner planner;
+    std::mutex mutex;
+    TaskHandle_t motionTaskHandle;
+
+    // Motion task settings: one step per servo PWM frame, on the core A2DP doesn't use
+    static constexpr uint32_t MOTION_STEP_MS = 20;
+    static constexpr uint32_t MOTION_TASK_STACK_SIZE = 3072;
+    static constexpr UBaseType_t MOTION_TASK_PRIORITY = 2;
+    static constexpr BaseType_t MOTION_TASK_CORE = 1;
+
+    // Motion task entry point: sleeps until a move is queued, then steps the plan until it's done
+    static void motionTask(void *param);
+
+    // Write a position to the servo if it changed (caller holds the mutex, or the motion task isn't running yet)
+    void writePosition(int degrees);
+
+    // Velocity/acceleration limiting for followPosition()
+    ServoTrajectoryFilter trajectoryFilter;
+    unsigned long lastFollowMicros;
+    bool hasWrittenPosition;
+
+    // A followPosition() this long after the last one starts again from rest at the current position
+    static constexpr unsigned long FOLLOW_TIMEOUT_MICROS = 100000;
+
+    // Write counters (read from the main loop)
+    std::atomic<uint32_t> writeCount;
+    std::atomic<uint32_t> suppressedWriteCount;
 
 public:
+    // Servo write counters, for the status log
+    struct WriteStats
+    {
+        uint32_t writes;           // Positions written to the servo
+        uint32_t suppressedWrites; // Updates skipped because the position hadn't changed
+    };
+
     ServoController();
     void initialize(int pin, int minDeg, int maxDeg);
-    void setPosition(int degrees);
+    void setPosition(int degrees) override;
+
+    // Move toward degrees as far as the velocity and acceleration limits allow since the last call.
+    // Call it every time the target updates (e.g. every audio callback). Preempts queued moves.
+    void followPosition(int degrees) override;
+
+    // Set the followPosition() limits in degrees per second and degrees per second per second (<= 0: unlimited)
+    void setMotionLimits(float maxVelocity, float maxAcceleration);
+
+    // Get a snapshot of the write counters
+    WriteStats getWriteStats() const;
+
     int getPosition() const;
     void setMinMaxDegrees(int minDeg, int maxDeg);
     int mapRMSToPosition(double rms, double silenceThreshold);
     void updatePosition(int targetPosition, double alpha, int minMovementThreshold);
-    void smoothMove(int targetPosition, int duration);
+
+    // Queue a move to targetPosition over duration ms, after any moves already queued. Returns immediately;
+    // returns false if too many moves are queued.
+    bool smoothMove(int targetPosition, int duration, ServoMotionPlanner::Easing easing = ServoMotionPlanner::Easing::EASE_IN_OUT_SINE);
+
+    // Queue a pause of duration ms at the end of the queued moves. Returns false if too many moves are queued.
+    bool holdPosition(int duration);
+
+    // True while queued moves are running
+    bool isMoving();
+
+    // Stop any queued moves where they are
     void interruptMovement();
 };
 
@@ -0,0 +1,103 @@
+/*
+    Servo motion planning. See servo_motion_planner.h.
+
+    Times are uint32_t milliseconds (millis()) and only ever compared as differences, so the plan keeps working
+    across the ~49 day millis() wraparound.
+*/
+
+#include "servo_motion_planner.h"
+#include <math.h>
+
+ServoMotionPlanner::ServoMotionPlanner()
+    : m_head(0), m_count(0), m_moveStartMs(0), m_moveStartPosition(0), m_lastPosition(0)
+{
+}
+
+// Queue a move after the last queued one
+bool ServoMotionPlanner::moveTo(int targetPosition, uint32_t durationMs, Easing easing, uint32_t nowMs, int currentPosition)
+{
+    if (m_count == MAX_MOVES)
+    {
+        return false;
+    }
+
+    if (m_count == 0)
+    {
+        m_moveStartMs = nowMs;
+        m_moveStartPosition = currentPosition;
+        m_lastPosition = currentPosition;
+    }
+    m_moves[(m_head + m_count) % MAX_MOVES] = {targetPosition, durationMs, easing};
+    m_count++;
+    return true;
+}
+
+// Queue a pause at the end position of the plan
+bool ServoMotionPlanner::hold(uint32_t durationMs, uint32_t nowMs, int currentPosition)
+{
+    int position = m_count > 0 ? m_moves[(m_head + m_count - 1) % MAX_MOVES].targetPosition : currentPosition;
+    return moveTo(position, durationMs, Easing::LINEAR, nowMs, currentPosition);
+}
+
+// Drop all queued moves
+void ServoMotionPlanner::cancel()
+{
+    m_head = 0;
+    m_count = 0;
+}
+
+// The position at nowMs, moving on to the next queued move whenever the current one has run its duration
+int ServoMotionPlanner::positionAt(uint32_t nowMs)
+{
+    while (m_count > 0)
+    {
+        const Move &move = m_moves[m_head];
+        uint32_t elapsedMs = nowMs - m_moveStartMs;
+        if (elapsedMs < move.durationMs)
+        {
+            float progress = ease(move.easing, static_cast<float>(elapsedMs) / move.durationMs);
+            m_lastPosition = m_moveStartPosition + static_cast<int>(lroundf((move.targetPosition - m_moveStartPosition) * progress));
+            return m_lastPosition;
+        }
+
+        // This move is done: the next one starts where and when it ended
+        m_moveStartMs += move.durationMs;
+        m_moveStartPosition = move.targetPosition;
+        m_lastPosition = move.targetPosition;
+        m_head = (m_head + 1) % MAX_MOVES;
+        m_count--;
+    }
+    return m_lastPosition;
+}
+
+// Progress through an easing curve
+float ServoMotionPlanner::ease(Easing easing, float t)
+{
+    if (t <= 0.0f)
+    {
+        return 0.0f;
+    }
+    if (t >= 1.0f)
+    {
+        return 1.0f;
+    }
+
+    switch (easing)
+    {
+    case Easing::EASE_IN_OUT_SINE:
+        return 0.5f - 0.5f * cosf(static_cast<float>(M_PI) * t);
+    case Easing::EASE_IN_OUT_CUBIC:
+        if (t < 0.5f)
+        {
+            return 4.0f * t * t * t;
+        }
+        else
+        {
+            float u = 2.0f - 2.0f * t;
+            return 1.0f - 0.5f * u * u * u;
+        }
+    case Easing::LINEAR:
+    default:
+        return t;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef SERVO_MOTION_PLANNER_H
+#define SERVO_MOTION_PLANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ServoMotionPlanner computes where a servo should be at a given time along a queue of timed moves.
+//
+// Each move goes from wherever the previous one ended to a target position over a duration, following an easing
+// curve. Moves are queued back to back: a move starts exactly when the previous one ends (not when it's next
+// stepped), so a sequence takes the same time however often it's sampled. It holds no servo or clock of its own:
+// the caller samples positionAt() from a periodic task and writes the result, and cancel() drops the rest of the plan.
+//
+// Only standard C++ is used so the trajectory math can be built and tested on a host machine.
+class ServoMotionPlanner
+{
+public:
+    // Shape of a move's position over its duration
+    enum class Easing : uint8_t
+    {
+        LINEAR,           // Constant speed (starts and stops abruptly)
+        EASE_IN_OUT_SINE, // Gentle acceleration and deceleration, like a breath
+        EASE_IN_OUT_CUBIC // Stronger acceleration and deceleration, for snappier moves
+    };
+
+    static constexpr size_t MAX_MOVES = 4;
+
+    ServoMotionPlanner();
+
+    // Queue a move to targetPosition over durationMs, starting when the last queued move ends
+    // (or now, from currentPosition, if nothing is queued). Returns false if the queue is full.
+    bool moveTo(int targetPosition, uint32_t durationMs, Easing easing, uint32_t nowMs, int currentPosition);
+
+    // Queue a pause at the position the last queued move ends at. Returns false if the queue is full.
+    bool hold(uint32_t durationMs, uint32_t nowMs, int currentPosition);
+
+    // Drop all queued moves
+    void cancel();
+
+    // True while there are moves left to run
+    bool isActive() const { return m_count > 0; }
+
+    // The position at nowMs. Finished moves are removed; after the last one the plan is inactive and this
+    // returns its final target. Times must not go backwards.
+    int positionAt(uint32_t nowMs);
+
+    // Progress through an easing curve: t and the result are in [0, 1]
+    static float ease(Easing easing, float t);
+
+private:
+    struct Move
+    {
+        int targetPosition;
+        uint32_t durationMs;
+        Easing easing;
+    };
+
+    Move m_moves[MAX_MOVES]; // Ring of queued moves, the current one at m_head
+    size_t m_head;
+    size_t m_count;
+    uint32_t m_moveStartMs;    // When the current move started
+    int m_moveStartPosition;   // Where the current move started
+    int m_lastPosition;        // Last position returned, or the final target once the plan is done
+};
+
+#endif // SERVO_MOTION_PLANNER_H
@@ -0,0 +1,78 @@
+/*
+    Velocity and acceleration limited servo trajectory. See servo_trajectory_filter.h.
+
+    Each step picks the speed it would like to be going toward the target: the lowest of
+        the velocity limit,
+        the fastest speed it can travel this step at and still brake to stop at the target: the v where
+        v * dt + v^2 / (2 * acceleration) = distance,
+        the speed that would reach the target in exactly this step,
+    then changes the current velocity toward it by no more than the acceleration limit allows in one step.
+*/
+
+#include "servo_trajectory_filter.h"
+#include <math.h>
+
+ServoTrajectoryFilter::ServoTrajectoryFilter()
+    : m_maxVelocity(DEFAULT_MAX_VELOCITY), m_maxAcceleration(DEFAULT_MAX_ACCELERATION), m_position(0.0f), m_velocity(0.0f)
+{
+}
+
+// Set the limits (<= 0: unlimited)
+void ServoTrajectoryFilter::setLimits(float maxVelocity, float maxAcceleration)
+{
+    m_maxVelocity = maxVelocity;
+    m_maxAcceleration = maxAcceleration;
+}
+
+// Jump to a position, at rest
+void ServoTrajectoryFilter::reset(float position)
+{
+    m_position = position;
+    m_velocity = 0.0f;
+}
+
+// Advance dtSeconds toward target
+float ServoTrajectoryFilter::update(float target, float dtSeconds)
+{
+    if (dtSeconds <= 0.0f)
+    {
+        return m_position;
+    }
+
+    float error = target - m_position;
+    float distance = fabsf(error);
+    float maxVelocityChange = m_maxAcceleration > 0.0f ? m_maxAcceleration * dtSeconds : INFINITY;
+
+    // Close enough and slow enough to stop this step: settle exactly on the target
+    if (distance <= SETTLE_DISTANCE && fabsf(m_velocity) <= maxVelocityChange)
+    {
+        m_position = target;
+        m_velocity = 0.0f;
+        return m_position;
+    }
+
+    float desiredSpeed = distance / dtSeconds;
+    if (m_maxVelocity > 0.0f)
+    {
+        desiredSpeed = fminf(desiredSpeed, m_maxVelocity);
+    }
+    if (m_maxAcceleration > 0.0f)
+    {
+        float brakingSpeed = m_maxAcceleration * (sqrtf(dtSeconds * dtSeconds + 2.0f * distance / m_maxAcceleration) - dtSeconds);
+        desiredSpeed = fminf(desiredSpeed, brakingSpeed);
+    }
+    float desiredVelocity = error > 0.0f ? desiredSpeed : -desiredSpeed;
+
+    float velocityChange = desiredVelocity - m_velocity;
+    if (velocityChange > maxVelocityChange)
+    {
+        velocityChange = maxVelocityChange;
+    }
+    else if (velocityChange < -maxVelocityChange)
+    {
+        velocityChange = -maxVelocityChange;
+    }
+    m_velocity += velocityChange;
+    m_position += m_velocity * dtSeconds;
+    return m_position;
+}
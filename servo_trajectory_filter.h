@@ -0,0 +1,49 @@
+#ifndef SERVO_TRAJECTORY_FILTER_H
+#define SERVO_TRAJECTORY_FILTER_H
+
+// ServoTrajectoryFilter moves a servo position toward a target that can change at every step, never faster than
+// a maximum velocity and never changing speed faster than a maximum acceleration.
+//
+// The audio-driven jaw target jumps around from one A2DP callback to the next. Writing it straight to the servo
+// makes the servo slam between positions, which is jitter to watch and a current spike each time; enough of them
+// can brown out the board. Bounding acceleration bounds the motor's torque (and so its current), and bounding
+// velocity keeps it within what the servo can physically do, so it tracks the target instead of lagging behind.
+//
+// The filter decelerates in time to stop at the target (like a trapezoidal velocity profile that is re-planned
+// every step), so a held target is reached without overshoot.
+//
+// Only standard C++ is used so it can be built, tested and benchmarked on a host machine.
+class ServoTrajectoryFilter
+{
+public:
+    // Defaults for a hobby servo jaw: full 80 degree travel in ~0.1s, reaching full speed in 25ms.
+    // On the SD card's recordings this tracks the audio-driven target within 2.5 - 5.5 degrees RMS (8 on the
+    // half-second Polo clip, which is mostly onsets the jaw lags behind); tools/trajectory_filter_test.cpp measures it.
+    static constexpr float DEFAULT_MAX_VELOCITY = 1000.0f;      // Degrees per second
+    static constexpr float DEFAULT_MAX_ACCELERATION = 40000.0f; // Degrees per second per second
+
+    ServoTrajectoryFilter();
+
+    // Set the limits. A limit <= 0 means unlimited.
+    void setLimits(float maxVelocity, float maxAcceleration);
+
+    // Jump to a position, at rest (e.g. after the servo was written directly)
+    void reset(float position);
+
+    // Advance dtSeconds toward target and return the new position
+    float update(float target, float dtSeconds);
+
+    float position() const { return m_position; }
+    float velocity() const { return m_velocity; }
+
+private:
+    // Once this close to the target and slow enough to stop within a step, snap to it
+    static constexpr float SETTLE_DISTANCE = 0.05f;
+
+    float m_maxVelocity;
+    float m_maxAcceleration;
+    float m_position;
+    float m_velocity;
+};
+
+#endif // SERVO_TRAJECTORY_FILTER_H
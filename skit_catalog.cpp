@@ -0,0 +1,94 @@
+/*
+    Skit catalog IDs and hash. See skit_catalog.h.
+*/
+
+#include "skit_catalog.h"
+#include <algorithm>
+
+// Forget all skits
+void SkitCatalog::clear()
+{
+    m_skits.clear();
+    m_hash = FNV_OFFSET_BASIS;
+}
+
+// Add a skit
+void SkitCatalog::add(const std::string &audioFile, uint32_t fingerprint)
+{
+    m_skits.push_back({audioFile, fingerprint});
+}
+
+// Hash a 32-bit value, little-endian
+static uint32_t hashUint32(uint32_t hash, uint32_t value)
+{
+    uint8_t bytes[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value >> 16),
+                        static_cast<uint8_t>(value >> 24)};
+    return SkitCatalog::hashBytes(hash, bytes, sizeof(bytes));
+}
+
+// Fingerprint of a skit's audio file size and script
+uint32_t SkitCatalog::fingerprint(uint32_t audioFileSize, const std::vector<ParsedSkitLine> &lines)
+{
+    uint32_t hash = hashUint32(FNV_OFFSET_BASIS, audioFileSize);
+    for (const ParsedSkitLine &line : lines)
+    {
+        hash = hashBytes(hash, &line.speaker, sizeof(line.speaker));
+        hash = hashUint32(hash, static_cast<uint32_t>(line.timestamp));
+        hash = hashUint32(hash, static_cast<uint32_t>(line.duration));
+    }
+    return hash;
+}
+
+// Sort the skits by path, which numbers them, and hash the result
+void SkitCatalog::finalize()
+{
+    std::sort(m_skits.begin(), m_skits.end(), [](const Skit &a, const Skit &b)
+              { return a.audioFile < b.audioFile; });
+
+    // IDs are 16 bits; skits past that many can't be named
+    if (m_skits.size() > UINT16_MAX)
+    {
+        m_skits.resize(UINT16_MAX);
+    }
+
+    m_hash = FNV_OFFSET_BASIS;
+    for (const Skit &skit : m_skits)
+    {
+        m_hash = hashBytes(m_hash, skit.audioFile.c_str(), skit.audioFile.size() + 1); // With the terminator, so paths can't run together
+        m_hash = hashUint32(m_hash, skit.fingerprint);
+    }
+}
+
+// ID of a skit
+uint16_t SkitCatalog::idOf(const std::string &audioFile) const
+{
+    auto it = std::lower_bound(m_skits.begin(), m_skits.end(), audioFile, [](const Skit &skit, const std::string &path)
+                               { return skit.audioFile < path; });
+    if (it == m_skits.end() || it->audioFile != audioFile)
+    {
+        return NO_SKIT;
+    }
+    return static_cast<uint16_t>(it - m_skits.begin() + 1);
+}
+
+// Audio file path of a skit
+const std::string *SkitCatalog::audioFileOf(uint16_t id) const
+{
+    if (id == NO_SKIT || id > m_skits.size())
+    {
+        return nullptr;
+    }
+    return &m_skits[id - 1].audioFile;
+}
+
+// 32-bit FNV-1a
+uint32_t SkitCatalog::hashBytes(uint32_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,60 @@
+#ifndef SKIT_CATALOG_H
+#define SKIT_CATALOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "skit_script_parser.h"
+
+// SkitCatalog numbers the skits on the SD card so the skulls can name them in a couple of bytes instead of a path.
+//
+// IDs follow the order of the audio file paths, so two skulls with the same skits give them the same IDs whatever
+// order the card listed them in. The catalog hash covers every skit's path and content fingerprint (whatever the
+// caller says must match between the skulls, e.g. the audio file's size and the parsed lines), so equal hashes mean
+// an ID picks the same skit, with the same script, on both.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+class SkitCatalog
+{
+public:
+    static constexpr uint16_t NO_SKIT = 0; // Never assigned
+
+    // Forget all skits
+    void clear();
+
+    // Add a skit by its audio file path and content fingerprint (see fingerprint()). Call finalize() after the last one.
+    void add(const std::string &audioFile, uint32_t fingerprint);
+
+    // Fingerprint of what must match for a skit ID to play the same skit on both skulls: the audio file's size and
+    // the script's lines
+    static uint32_t fingerprint(uint32_t audioFileSize, const std::vector<ParsedSkitLine> &lines);
+
+    // Assign the IDs and compute the catalog hash
+    void finalize();
+
+    // ID of a skit, or NO_SKIT if it isn't in the catalog
+    uint16_t idOf(const std::string &audioFile) const;
+
+    // Audio file path of a skit, or nullptr if there's no such ID
+    const std::string *audioFileOf(uint16_t id) const;
+
+    uint32_t hash() const { return m_hash; }
+    size_t size() const { return m_skits.size(); }
+
+    // 32-bit FNV-1a over data, continuing from hash (start from FNV_OFFSET_BASIS)
+    static constexpr uint32_t FNV_OFFSET_BASIS = 2166136261u;
+    static uint32_t hashBytes(uint32_t hash, const void *data, size_t size);
+
+private:
+    struct Skit
+    {
+        std::string audioFile;
+        uint32_t fingerprint;
+    };
+
+    std::vector<Skit> m_skits; // In ID order after finalize(): ID = index + 1
+    uint32_t m_hash = FNV_OFFSET_BASIS;
+};
+
+#endif // SKIT_CATALOG_H
@@ -0,0 +1,109 @@
+/*
+    Interval index over a skull's skit lines. See skit_line_index.h.
+
+    Invariant after a lookup at time t:
+        m_cursor         = first segment with end > t (or size() if none)
+        m_active         = that segment if it has already started (start <= t), else nullptr
+        m_nextTransition = its end if active, its start if not, NO_TRANSITION past the last segment
+    so any later lookup at a time in [t, m_nextTransition) has the same answer and needs no work.
+*/
+
+#include "skit_line_index.h"
+#include <algorithm>
+
+void SkitLineIndex::assign(std::vector<Segment> segments)
+{
+    std::stable_sort(segments.begin(), segments.end(),
+                     [](const Segment &a, const Segment &b)
+                     { return a.start < b.start; });
+
+    // Clip each line to start where the previous one ends, so segments never overlap
+    m_segments.clear();
+    m_segments.reserve(segments.size());
+    unsigned long previousEnd = 0;
+    for (Segment segment : segments)
+    {
+        if (!m_segments.empty() && segment.start < previousEnd)
+        {
+            segment.start = previousEnd;
+        }
+        if (segment.end <= segment.start)
+        {
+            continue;
+        }
+        m_segments.push_back(segment);
+        previousEnd = segment.end;
+    }
+
+    rewind();
+}
+
+void SkitLineIndex::clear()
+{
+    m_segments.clear();
+    rewind();
+}
+
+void SkitLineIndex::rewind()
+{
+    m_cursor = 0;
+    m_lastTime = 0;
+    seek(0);
+}
+
+const SkitLineIndex::Segment *SkitLineIndex::find(unsigned long playbackTime)
+{
+    // Fast path: nothing is scheduled to change before the next transition
+    if (playbackTime < m_lastTime || playbackTime >= m_nextTransition)
+    {
+        seek(playbackTime);
+    }
+    m_lastTime = playbackTime;
+    return m_active;
+}
+
+const SkitLineIndex::Segment *SkitLineIndex::lineAt(unsigned long playbackTime) const
+{
+    std::vector<Segment>::const_iterator segment = std::upper_bound(m_segments.begin(), m_segments.end(), playbackTime,
+                                                                    [](unsigned long time, const Segment &segment)
+                                                                    { return time < segment.end; });
+    return segment != m_segments.end() && segment->start <= playbackTime ? &*segment : nullptr;
+}
+
+void SkitLineIndex::seek(unsigned long playbackTime)
+{
+    // Step forward for normal playback; binary search on a seek backwards or a big jump forwards
+    size_t steps = 0;
+    if (playbackTime >= m_lastTime)
+    {
+        while (m_cursor < m_segments.size() && m_segments[m_cursor].end <= playbackTime && steps < MAX_CURSOR_STEPS)
+        {
+            m_cursor++;
+            steps++;
+        }
+    }
+    if (playbackTime < m_lastTime || steps == MAX_CURSOR_STEPS)
+    {
+        m_cursor = std::upper_bound(m_segments.begin(), m_segments.end(), playbackTime,
+                                    [](unsigned long time, const Segment &segment)
+                                    { return time < segment.end; }) -
+                   m_segments.begin();
+    }
+    m_lastTime = playbackTime;
+
+    if (m_cursor >= m_segments.size())
+    {
+        m_active = nullptr;
+        m_nextTransition = NO_TRANSITION;
+    }
+    else if (m_segments[m_cursor].start <= playbackTime)
+    {
+        m_active = &m_segments[m_cursor];
+        m_nextTransition = m_active->end;
+    }
+    else
+    {
+        m_active = nullptr;
+        m_nextTransition = m_segments[m_cursor].start;
+    }
+}
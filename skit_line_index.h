@@ -0,0 +1,64 @@
+#ifndef SKIT_LINE_INDEX_H
+#define SKIT_LINE_INDEX_H
+
+#include <stddef.h>
+#include <vector>
+
+// SkitLineIndex finds the skit line being spoken at a given playback time.
+//
+// Lines are stored as non-overlapping time segments sorted by start time. A cursor remembers the last lookup,
+// so as playback moves forward a lookup is a compare against the next scheduled transition (the end of the
+// current line or the start of the next one) in O(1); only seeks (playback time going backwards or jumping
+// several lines ahead) fall back to a binary search. The per-callback cost doesn't depend on the number of lines.
+//
+// Only standard C++ is used so it can be built and benchmarked on a host machine.
+class SkitLineIndex
+{
+public:
+    // A line's time span [start, end) in ms of playback time
+    struct Segment
+    {
+        unsigned long start;
+        unsigned long end;
+        size_t lineNumber;
+    };
+
+    static constexpr unsigned long NO_TRANSITION = static_cast<unsigned long>(-1);
+
+    // Replace the index with the given lines (in any order). Where lines overlap, the one that starts first
+    // keeps the overlap, matching a first-match scan in time order. Empty lines are dropped.
+    void assign(std::vector<Segment> segments);
+
+    void clear();
+
+    // Reset the cursor for a fresh playback from time 0. Keeps the lines; never allocates.
+    void rewind();
+
+    bool isEmpty() const { return m_segments.empty(); }
+    size_t size() const { return m_segments.size(); }
+
+    // The line being spoken at playbackTime, or nullptr between lines
+    const Segment *find(unsigned long playbackTime);
+
+    // The line being spoken at playbackTime, or nullptr between lines, by binary search. Leaves the cursor alone,
+    // so it can look up a second time (e.g. the jaw's lookahead) without costing find() its O(1) path.
+    const Segment *lineAt(unsigned long playbackTime) const;
+
+    // Playback time of the next change in the result of find(), as of the last lookup (NO_TRANSITION after the last line)
+    unsigned long nextTransition() const { return m_nextTransition; }
+
+private:
+    // Lookups that move more than this many segments forward use a binary search instead of stepping
+    static constexpr size_t MAX_CURSOR_STEPS = 4;
+
+    // Point the cursor at the first segment that ends after playbackTime and schedule the next transition
+    void seek(unsigned long playbackTime);
+
+    std::vector<Segment> m_segments;
+    size_t m_cursor = 0;                            // First segment that ends after m_lastTime
+    unsigned long m_lastTime = 0;                   // Playback time of the last lookup
+    unsigned long m_nextTransition = 0;             // The cached result is valid for [m_lastTime, m_nextTransition)
+    const Segment *m_active = nullptr;              // Cached result of the last lookup
+};
+
+#endif // SKIT_LINE_INDEX_H
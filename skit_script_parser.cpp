@@ -0,0 +1,77 @@
+/*
+    Skit script parsing. See skit_script_parser.h.
+*/
+
+#include "skit_script_parser.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+static std::string trim(const std::string &text)
+{
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && isspace(static_cast<unsigned char>(text[start])))
+    {
+        start++;
+    }
+    while (end > start && isspace(static_cast<unsigned char>(text[end - 1])))
+    {
+        end--;
+    }
+    return text.substr(start, end - start);
+}
+
+// Parse a whole script
+std::vector<ParsedSkitLine> SkitScriptParser::parse(const std::string &text)
+{
+    std::vector<ParsedSkitLine> lines;
+    size_t lineNumber = 0;
+    size_t lineStart = 0;
+    while (lineStart < text.size())
+    {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+        {
+            lineEnd = text.size();
+        }
+
+        ParsedSkitLine skitLine;
+        if (parseLine(text.substr(lineStart, lineEnd - lineStart), lineNumber, skitLine))
+        {
+            lines.push_back(skitLine);
+            lineNumber++;
+        }
+        lineStart = lineEnd + 1;
+    }
+    return lines;
+}
+
+// Parse one line of a script. Missing fields read as 0, like the String::toInt() parsing this replaces.
+bool SkitScriptParser::parseLine(const std::string &line, size_t lineNumber, ParsedSkitLine &skitLine)
+{
+    std::string trimmed = trim(line);
+    if (trimmed.empty())
+    {
+        return false;
+    }
+
+    size_t commaIndex1 = trimmed.find(',');
+    size_t commaIndex2 = trimmed.find(',', commaIndex1 + 1);
+    size_t commaIndex3 = trimmed.find(',', commaIndex2 + 1);
+    size_t timestampStart = commaIndex1 == std::string::npos ? 0 : commaIndex1 + 1;
+    size_t durationStart = commaIndex2 == std::string::npos ? 0 : commaIndex2 + 1;
+
+    skitLine.lineNumber = lineNumber;
+    skitLine.speaker = trimmed[0];
+    skitLine.timestamp = strtoul(trimmed.substr(timestampStart, commaIndex2 - timestampStart).c_str(), nullptr, 10);
+    skitLine.duration = strtoul(trimmed.substr(durationStart, commaIndex3 - durationStart).c_str(), nullptr, 10);
+    if (commaIndex3 != std::string::npos)
+    {
+        skitLine.jawPosition = strtof(trimmed.c_str() + commaIndex3 + 1, nullptr);
+    }
+    else
+    {
+        skitLine.jawPosition = -1; // Indicating dynamic jaw movement
+    }
+    return true;
+}
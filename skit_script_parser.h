@@ -0,0 +1,32 @@
+#ifndef SKIT_SCRIPT_PARSER_H
+#define SKIT_SCRIPT_PARSER_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct ParsedSkitLine {
+    size_t lineNumber;
+    char speaker;
+    unsigned long timestamp;
+    unsigned long duration;
+    float jawPosition;
+};
+
+// SkitScriptParser reads a skit's .txt script: one line per spoken part, as
+//     speaker,timestamp ms,duration ms[,jaw position]
+// e.g. "A,1500,2300". Without a jaw position the jaw follows the audio (jawPosition -1). Blank lines are skipped
+// and don't count towards the line numbers.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+class SkitScriptParser
+{
+public:
+    // Parse a whole script
+    static std::vector<ParsedSkitLine> parse(const std::string &text);
+
+    // Parse one line of a script. Returns false if it's blank.
+    static bool parseLine(const std::string &line, size_t lineNumber, ParsedSkitLine &skitLine);
+};
+
+#endif // SKIT_SCRIPT_PARSER_H
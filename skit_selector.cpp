@@ -1,32 +1,36 @@
 #include "skit_selector.h"
 #include <algorithm>
 #include <cmath>
-#include <Arduino.h>
 
-// Constructor: Initializes the SkitSelector with a list of parsed skits
-SkitSelector::SkitSelector(const std::vector<ParsedSkit> &skits)
+// Constructor: Initializes the SkitSelector with the skits' audio file paths
+SkitSelector::SkitSelector(const std::vector<std::string> &audioFiles)
     : m_lastPlayedSkitName("") // Initialize to an empty string
 {
-    for (const auto &skit : skits)
+    for (const auto &audioFile : audioFiles)
     {
-        m_skitStats.push_back({skit, 0, 0});
+        m_skitStats.push_back({audioFile, 0, 0});
+        // Room for any skit's name, so updateSkitPlayCount() doesn't allocate
+        m_lastPlayedSkitName.reserve(std::max(m_lastPlayedSkitName.capacity(), audioFile.size()));
     }
 }
 
 // Selects the next skit to be played based on weighted random selection
-ParsedSkit SkitSelector::selectNextSkit()
+std::string SkitSelector::selectNextSkit(unsigned long currentTime, uint32_t randomValue)
 {
-    unsigned long currentTime = millis();
-    sortSkitsByWeight();
+    if (m_skitStats.empty())
+    {
+        return "";
+    }
+    sortSkitsByWeight(currentTime);
 
     // Define the maximum size of the selection pool
-    int maxPoolSize = std::min(3, static_cast<int>(m_skitStats.size()));
+    size_t maxPoolSize = std::min<size_t>(3, m_skitStats.size());
 
     // Build a selection pool excluding the last played skit
     std::vector<SkitStats *> availableSkits;
     for (auto &skitStat : m_skitStats)
     {
-        if (skitStat.skit.audioFile != m_lastPlayedSkitName)
+        if (skitStat.audioFile != m_lastPlayedSkitName)
         {
             availableSkits.push_back(&skitStat);
             if (availableSkits.size() >= maxPoolSize)
@@ -47,7 +51,7 @@ ParsedSkit SkitSelector::selectNextSkit()
 
     // If only one skit exists, it will be selected regardless of previous play
     // Otherwise, select randomly from the available pool
-    int selectedIndex;
+    size_t selectedIndex;
     if (availableSkits.empty())
     {
         // Only one skit exists
@@ -55,13 +59,13 @@ ParsedSkit SkitSelector::selectNextSkit()
     }
     else
     {
-        int randomIdx = random(availableSkits.size());
+        size_t randomIdx = randomValue % availableSkits.size();
         // Find the index of the selected skit in m_skitStats
-        selectedIndex = std::distance(
+        selectedIndex = static_cast<size_t>(std::distance(
             m_skitStats.begin(),
             std::find_if(m_skitStats.begin(), m_skitStats.end(),
                          [&](const SkitStats &stat)
-                         { return &stat == availableSkits[randomIdx]; }));
+                         { return &stat == availableSkits[randomIdx]; })));
     }
 
     // Debug output: List all skits in the selection pool and their weights
@@ -69,7 +73,7 @@ ParsedSkit SkitSelector::selectNextSkit()
     // {
     //     Serial.printf("SkitSelector::selectNextSkit: Skit %d: %s, weight: %f\n",
     //                   i,
-    //                   availableSkits[i]->skit.audioFile.c_str(),
+    //                   availableSkits[i]->audioFile.c_str(),
     //                   calculateSkitWeight(*availableSkits[i], currentTime));
     // }
 
@@ -77,22 +81,22 @@ ParsedSkit SkitSelector::selectNextSkit()
     auto &selectedSkit = m_skitStats[selectedIndex];
     selectedSkit.playCount++;
     selectedSkit.lastPlayedTime = currentTime;
-    m_lastPlayedSkitName = selectedSkit.skit.audioFile;
+    m_lastPlayedSkitName = selectedSkit.audioFile;
 
-    return selectedSkit.skit;
+    return selectedSkit.audioFile;
 }
 
 // Updates the play count and last played time for a specific skit
-void SkitSelector::updateSkitPlayCount(const String &skitName)
+void SkitSelector::updateSkitPlayCount(const char *skitName, unsigned long currentTime)
 {
     auto it = std::find_if(m_skitStats.begin(), m_skitStats.end(),
                            [&skitName](const SkitStats &stats)
-                           { return stats.skit.audioFile == skitName; });
+                           { return stats.audioFile == skitName; });
     if (it != m_skitStats.end())
     {
         it->playCount++;
-        it->lastPlayedTime = millis();
-        m_lastPlayedSkitName = it->skit.audioFile; // Ensure consistency
+        it->lastPlayedTime = currentTime;
+        m_lastPlayedSkitName = it->audioFile; // Ensure consistency
     }
 }
 
@@ -107,9 +111,8 @@ double SkitSelector::calculateSkitWeight(const SkitStats &stats, unsigned long c
 }
 
 // Sorts the skits by their calculated weights in descending order
-void SkitSelector::sortSkitsByWeight()
+void SkitSelector::sortSkitsByWeight(unsigned long currentTime)
 {
-    unsigned long currentTime = millis();
     std::sort(m_skitStats.begin(), m_skitStats.end(),
               [this, currentTime](const SkitStats &a, const SkitStats &b) -> bool
               {
@@ -1,31 +1,38 @@
 #ifndef SKIT_SELECTOR_H
 #define SKIT_SELECTOR_H
 
+#include <stdint.h>
 #include <vector>
 #include <string>
-#include "parsed_skit.h"
 
 // SkitSelector class manages the selection and playback of skits
 // It uses a weighted random selection algorithm to ensure variety and fairness in skit playback
+// Skits are named by their audio file path.
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
 class SkitSelector
 {
 public:
-    // Constructor: Initializes the SkitSelector with a list of parsed skits
-    SkitSelector(const std::vector<ParsedSkit> &skits);
+    // Constructor: Initializes the SkitSelector with the skits' audio file paths
+    SkitSelector(const std::vector<std::string> &audioFiles);
 
     // Selects the next skit to be played based on weighted random selection
-    // Returns: A ParsedSkit object representing the selected skit
-    ParsedSkit selectNextSkit();
+    // Params:
+    //   currentTime - The current time in milliseconds
+    //   randomValue - A random number, which picks the skit from the pool of the most deserving ones
+    // Returns: The selected skit's audio file path, or an empty string if there are no skits
+    std::string selectNextSkit(unsigned long currentTime, uint32_t randomValue);
 
     // Updates the play count and last played time for a specific skit
-    // Param: skitName - The name of the skit to update
-    void updateSkitPlayCount(const String &skitName);
+    // Param: skitName - The audio file path of the skit to update
+    // Doesn't allocate. Like the rest of the selector it isn't thread safe: call it on the task that selects skits.
+    void updateSkitPlayCount(const char *skitName, unsigned long currentTime);
 
 private:
     // Struct to hold statistics for each skit
     struct SkitStats
     {
-        ParsedSkit skit;
+        std::string audioFile;
         int playCount;
         unsigned long lastPlayedTime;
     };
@@ -34,7 +41,7 @@ private:
     std::vector<SkitStats> m_skitStats;
 
     // Stores the name of the last played skit
-    String m_lastPlayedSkitName;
+    std::string m_lastPlayedSkitName;
 
     // Calculates the weight of a skit based on its play count and last played time
     // This weight is used to prioritize skits that haven't been played recently or frequently
@@ -45,7 +52,7 @@ private:
     double calculateSkitWeight(const SkitStats &stats, unsigned long currentTime);
 
     // Sorts the skits by their calculated weights in descending order
-    void sortSkitsByWeight();
+    void sortSkitsByWeight(unsigned long currentTime);
 };
 
 #endif // SKIT_SELECTOR_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+/*
+    Skit start messages between the skulls. See skit_start_protocol.h.
+*/
+
+#include "skit_start_protocol.h"
+#include <stdio.h>
+
+static void putUint16(std::string &message, size_t offset, uint16_t value)
+{
+    message[offset] = static_cast<char>(value & 0xFF);
+    message[offset + 1] = static_cast<char>(value >> 8);
+}
+
+static void putUint32(std::string &message, size_t offset, uint32_t value)
+{
+    putUint16(message, offset, static_cast<uint16_t>(value & 0xFFFF));
+    putUint16(message, offset + 2, static_cast<uint16_t>(value >> 16));
+}
+
+static uint16_t getUint16(const std::string &message, size_t offset)
+{
+    return static_cast<uint16_t>(static_cast<uint8_t>(message[offset]) | (static_cast<uint8_t>(message[offset + 1]) << 8));
+}
+
+static uint32_t getUint32(const std::string &message, size_t offset)
+{
+    return getUint16(message, offset) | (static_cast<uint32_t>(getUint16(message, offset + 2)) << 16);
+}
+
+std::string SkitStartProtocol::encodeHeader(uint8_t opcode, uint16_t sequence, size_t size)
+{
+    std::string message(size, '\0');
+    message[0] = static_cast<char>(VERSION);
+    message[1] = static_cast<char>(opcode);
+    putUint16(message, 2, sequence);
+    return message;
+}
+
+bool SkitStartProtocol::decodeHeader(const std::string &value, SkitMessageHeader &header)
+{
+    if (value.size() < HEADER_SIZE || static_cast<uint8_t>(value[0]) != VERSION)
+    {
+        return false;
+    }
+    header.version = static_cast<uint8_t>(value[0]);
+    header.opcode = static_cast<uint8_t>(value[1]);
+    header.sequence = getUint16(value, 2);
+    return true;
+}
+
+bool SkitStartProtocol::hasHeader(const std::string &value, uint8_t opcode, size_t size)
+{
+    SkitMessageHeader header;
+    return value.size() == size && decodeHeader(value, header) && header.opcode == opcode;
+}
+
+void SkitStartProtocol::setSequence(std::string &message, uint16_t sequence)
+{
+    if (message.size() >= HEADER_SIZE)
+    {
+        putUint16(message, 2, sequence);
+    }
+}
+
+std::string SkitStartProtocol::encodeCommand(const SkitStartCommand &command)
+{
+    std::string message = encodeHeader(OPCODE_START, command.sequence, START_SIZE);
+    putUint16(message, 4, command.skitId);
+    putUint16(message, 6, command.flags);
+    putUint32(message, 8, command.sentAtMillis);
+    putUint32(message, 12, command.startAtMillis);
+    putUint32(message, 16, command.catalogHash);
+    return message;
+}
+
+bool SkitStartProtocol::decodeCommand(const std::string &value, SkitStartCommand &command)
+{
+    if (!hasHeader(value, OPCODE_START, START_SIZE))
+    {
+        return false;
+    }
+    command.sequence = getUint16(value, 2);
+    command.skitId = getUint16(value, 4);
+    command.flags = getUint16(value, 6);
+    command.sentAtMillis = getUint32(value, 8);
+    command.startAtMillis = getUint32(value, 12);
+    command.catalogHash = getUint32(value, 16);
+    return true;
+}
+
+std::string SkitStartProtocol::encodeAccept(uint16_t sequence)
+{
+    return encodeHeader(OPCODE_ACCEPT, sequence, ACCEPT_SIZE);
+}
+
+std::string SkitStartProtocol::encodeReject(uint16_t sequence, SkitRejectReason reason, uint32_t catalogHash)
+{
+    std::string message = encodeHeader(OPCODE_REJECT, sequence, REJECT_SIZE);
+    message[4] = static_cast<char>(reason);
+    putUint32(message, 5, catalogHash);
+    return message;
+}
+
+bool SkitStartProtocol::decodeReject(const std::string &value, SkitRejectReason &reason, uint32_t &catalogHash)
+{
+    if (!hasHeader(value, OPCODE_REJECT, REJECT_SIZE))
+    {
+        return false;
+    }
+    reason = static_cast<SkitRejectReason>(static_cast<uint8_t>(value[4]));
+    catalogHash = getUint32(value, 5);
+    return true;
+}
+
+std::string SkitStartProtocol::encodeStartedReport(uint16_t sequence, int32_t lateMicros, int32_t clockUncertaintyMicros)
+{
+    std::string message = encodeHeader(OPCODE_STARTED, sequence, STARTED_SIZE);
+    putUint32(message, 4, static_cast<uint32_t>(lateMicros));
+    putUint32(message, 8, static_cast<uint32_t>(clockUncertaintyMicros));
+    return message;
+}
+
+bool SkitStartProtocol::decodeStartedReport(const std::string &value, int32_t &lateMicros, int32_t &clockUncertaintyMicros)
+{
+    if (!hasHeader(value, OPCODE_STARTED, STARTED_SIZE))
+    {
+        return false;
+    }
+    lateMicros = static_cast<int32_t>(getUint32(value, 4));
+    clockUncertaintyMicros = static_cast<int32_t>(getUint32(value, 8));
+    return true;
+}
+
+std::string SkitStartProtocol::describe(const std::string &value)
+{
+    static const char *const OPCODE_NAMES[] = {"?", "START", "ACCEPT", "REJECT", "STARTED"};
+    char text[48];
+    SkitMessageHeader header;
+    if (!decodeHeader(value, header))
+    {
+        snprintf(text, sizeof(text), "unknown message (%u bytes)", static_cast<unsigned>(value.size()));
+    }
+    else
+    {
+        const char *name = header.opcode < sizeof(OPCODE_NAMES) / sizeof(OPCODE_NAMES[0]) ? OPCODE_NAMES[header.opcode] : "?";
+        snprintf(text, sizeof(text), "%s #%u (%u bytes)", name, header.sequence, static_cast<unsigned>(value.size()));
+    }
+    return text;
+}
+
+const char *SkitStartProtocol::rejectReasonToString(SkitRejectReason reason)
+{
+    switch (reason)
+    {
+    case SkitRejectReason::BAD_MESSAGE:
+        return "bad message";
+    case SkitRejectReason::BUSY:
+        return "busy";
+    case SkitRejectReason::UNKNOWN_SKIT:
+        return "unknown skit";
+    case SkitRejectReason::CATALOG_MISMATCH:
+        return "skit catalogs differ";
+    }
+    return "unknown reason";
+}
@@ -0,0 +1,115 @@
+#ifndef SKIT_START_PROTOCOL_H
+#define SKIT_START_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Messages the skulls exchange over the BLE characteristic to start a skit on both at the same time.
+//
+// The Primary writes a start command: which skit, and a start time a little in the future on the shared clock.
+// The Secondary accepts or rejects it; if it accepts, it maps the start time onto its own clock, pre-buffers the
+// skit and holds its first sample until then, and the Primary does the same. Once a skull has started it knows how
+// late its first sample was, and the Secondary indicates that back so the Primary can log the start skew. On the
+// shared clock the Secondary measures its lateness through the clock sync, so it sends the clock's uncertainty too.
+//
+// Messages are binary and little-endian, and each fits the default 20 byte ATT payload, so no MTU negotiation is
+// needed. Every message starts with the same header:
+//     version (1), opcode (1), sequence (2)
+// A reply carries the sequence number of the command it answers. Skits are named by their ID in the skit catalog
+// (see SkitCatalog), and the command carries the Primary's catalog hash so the Secondary can refuse to start a skit
+// its catalog numbers differently. Messages with another version are rejected, not guessed at.
+//
+//     START    header, skit ID (2), flags (2), sent at ms (4), start at ms (4), catalog hash (4)   Primary -> Secondary
+//     ACCEPT   header                                                                         Secondary -> Primary
+//     REJECT   header, reason (1), Secondary's catalog hash (4)                               Secondary -> Primary
+//     STARTED  header, late us (4), clock uncertainty us (4)                                  Secondary -> Primary
+//
+// Only standard C++ is used so it can be built and tested on a host machine.
+struct SkitMessageHeader
+{
+    uint8_t version;
+    uint8_t opcode;
+    uint16_t sequence;
+};
+
+struct SkitStartCommand
+{
+    uint16_t sequence;      // Set by the sender; the reply carries it back
+    uint16_t skitId;        // Skit catalog ID
+    uint16_t flags;         // SkitStartProtocol::FLAG_*
+    uint32_t sentAtMillis;  // Shared clock when the command was sent
+    uint32_t startAtMillis; // Shared clock when the first sample should play
+    uint32_t catalogHash;   // Primary's skit catalog hash
+};
+
+// Why the Secondary rejected a start command
+enum class SkitRejectReason : uint8_t
+{
+    BAD_MESSAGE = 1,      // Not a start command this version understands
+    BUSY = 2,             // Already playing
+    UNKNOWN_SKIT = 3,     // No such skit ID, or its audio file is missing
+    CATALOG_MISMATCH = 4, // The skulls' skit catalogs differ
+};
+
+class SkitStartProtocol
+{
+public:
+    static constexpr uint8_t VERSION = 2;
+    static constexpr size_t MAX_MESSAGE_SIZE = 20; // Default ATT payload (23 byte MTU)
+
+    static constexpr uint8_t OPCODE_START = 1;
+    static constexpr uint8_t OPCODE_ACCEPT = 2;
+    static constexpr uint8_t OPCODE_REJECT = 3;
+    static constexpr uint8_t OPCODE_STARTED = 4;
+
+    // Start command flags
+    static constexpr uint16_t FLAG_CLOCK_SYNCHRONIZED = 0x0001; // Start on the shared clock, not on the link delay estimate
+
+    // Returns false if value is too short for a header or has another version
+    static bool decodeHeader(const std::string &value, SkitMessageHeader &header);
+
+    // Replace the sequence number of an encoded message
+    static void setSequence(std::string &message, uint16_t sequence);
+
+    static std::string encodeCommand(const SkitStartCommand &command);
+
+    // Returns false if value isn't a well-formed start command
+    static bool decodeCommand(const std::string &value, SkitStartCommand &command);
+
+    static std::string encodeAccept(uint16_t sequence);
+
+    static std::string encodeReject(uint16_t sequence, SkitRejectReason reason, uint32_t catalogHash);
+
+    // Returns false if value isn't a well-formed reject
+    static bool decodeReject(const std::string &value, SkitRejectReason &reason, uint32_t &catalogHash);
+
+    // lateMicros: how far after the start time the Secondary's first sample played (negative: early). On the shared
+    // clock if the skit was started on it, and then clockUncertaintyMicros is how far off that clock may be;
+    // otherwise on the Secondary's own clock, against the start it mapped from the link delay, and -1.
+    static std::string encodeStartedReport(uint16_t sequence, int32_t lateMicros, int32_t clockUncertaintyMicros);
+
+    // Returns false if value isn't a well-formed started report
+    static bool decodeStartedReport(const std::string &value, int32_t &lateMicros, int32_t &clockUncertaintyMicros);
+
+    // Short description of a message for logs, e.g. "START #12 (20 bytes)"
+    static std::string describe(const std::string &value);
+
+    static const char *rejectReasonToString(SkitRejectReason reason);
+
+private:
+    static constexpr size_t HEADER_SIZE = 4;
+    static constexpr size_t START_SIZE = HEADER_SIZE + 16;
+    static constexpr size_t ACCEPT_SIZE = HEADER_SIZE;
+    static constexpr size_t REJECT_SIZE = HEADER_SIZE + 5;
+    static constexpr size_t STARTED_SIZE = HEADER_SIZE + 8;
+    static_assert(START_SIZE <= MAX_MESSAGE_SIZE, "Start command doesn't fit one ATT packet");
+
+    // Encoded header, with room reserved for the body
+    static std::string encodeHeader(uint8_t opcode, uint16_t sequence, size_t size);
+
+    // Header check for a message of a known opcode and size
+    static bool hasHeader(const std::string &value, uint8_t opcode, size_t size);
+};
+
+#endif // SKIT_START_PROTOCOL_H
@@ -6,6 +6,10 @@
     Although it provides pass-throughs for playing audio, it has no effect on the playing state.
     It only reacts to what is being currently played, which is entirely controlled by the audio player.
 
+    The A2DP callback hands the frames over through m_frameFifo, and an AnimationEvent per chunk of them (or per track
+    start or end) through m_events, the way AudioPlayer's producer hands it audio and file markers. The event is pushed
+    after its frames are written, so the animation task always finds them there.
+
     Note: Frame is defined in SoundData.h in https://github.com/pschatzmann/ESP32-A2DP like so:
 
       Frame(int ch1, int ch2){
@@ -15,14 +19,17 @@
 */
 
 #include "skull_audio_animator.h"
+#include "audio_player.h"
+#include "audio_level.h"
 #include <cmath>
 #include <algorithm>
 #include <Arduino.h>
 
 // Constructor for SkullAudioAnimator class
 // Initializes the animator with necessary controllers and parameters
-SkullAudioAnimator::SkullAudioAnimator(bool isPrimary, ServoController &servoController, LightController &lightController,
-                                       std::vector<ParsedSkit> &skits, SDCardManager &sdCardManager, int servoMinDegrees, int servoMaxDegrees)
+SkullAudioAnimator::SkullAudioAnimator(bool isPrimary, JawServo &servoController, EyeLights &lightController,
+                                       std::vector<ParsedSkit> &skits, SDCardManager &sdCardManager, Clock &clock, Tasks &tasks,
+                                       int servoMinDegrees, int servoMaxDegrees)
     : m_servoController(servoController),
       m_lightController(lightController),
       m_sdCardManager(sdCardManager),
@@ -32,40 +39,238 @@ SkullAudioAnimator::SkullAudioAnimator(bool isPrimary, ServoController &servoCon
       m_servoMaxDegrees(servoMaxDegrees),
       m_isCurrentlySpeaking(false),
       m_currentSkitLineNumber(-1),
+      m_currentTrackId(AudioPlayer::NO_TRACK),
+      m_currentSkit(nullptr),
+      m_currentLineIndex(nullptr),
+      m_bandEnergyAnalyzer(clock, tasks),
+      m_hasBandEnergies(false),
       m_smoothedAmplitude(0.0),
+      m_jawAmplitude(0.0),
       m_previousJawPosition(servoMinDegrees),
-      FFT(vReal, vImag, SAMPLES, SAMPLE_RATE)
+      m_playingTrackId(AudioPlayer::NO_TRACK),
+      m_currentPlaybackTime(0),
+      m_isAudioPlaying(false),
+      m_jawLookaheadMs(0),
+      m_tasks(tasks),
+      m_taskHandle(nullptr),
+      m_frameFifo(FRAME_FIFO_SIZE),
+      m_droppedFrames(0)
+{
+    // Filter each skit's lines for this skull (primary or secondary) and index them by time, once up front,
+    // so starting a skit during playback only has to point at its index
+    m_skitLineIndexes.resize(m_skits.size());
+    for (size_t i = 0; i < m_skits.size(); i++)
+    {
+        std::vector<SkitLineIndex::Segment> segments;
+        for (const auto &line : m_skits[i].lines)
+        {
+            // We need to clip the end of the line to avoid overlap with the next line.
+            // Even if you get the timings exactly right in the skit file, I believe this is taking the buffer into account.
+            if (((line.speaker == 'A' && m_isPrimary) || (line.speaker == 'B' && !m_isPrimary)) && line.duration > SKIT_AUDIO_LINE_OFFSET)
+            {
+                segments.push_back({line.timestamp, line.timestamp + line.duration - SKIT_AUDIO_LINE_OFFSET, line.lineNumber});
+            }
+        }
+        m_skitLineIndexes[i].assign(std::move(segments));
+    }
+}
+
+// Starts the animation and band energy analysis tasks
+void SkullAudioAnimator::begin()
+{
+    m_bandEnergyAnalyzer.begin();
+    if (m_taskHandle != nullptr)
+    {
+        return;
+    }
+
+    m_taskHandle = m_tasks.start(animationTask, this, "Animation", ANIMATION_TASK_STACK_SIZE, ANIMATION_TASK_PRIORITY, ANIMATION_TASK_CORE);
+    if (m_taskHandle == nullptr)
+    {
+        Serial.println("SkullAudioAnimator::begin() Failed to create animation task; animating in the A2DP callback");
+    }
+}
+
+// Queue the frames for the animation task, in chunks it can take one at a time
+void SkullAudioAnimator::queueAudioFrames(const Frame *frames, int32_t frameCount, uint32_t trackId, unsigned long playbackTime)
+{
+    if (m_taskHandle == nullptr)
+    {
+        processAudioFrames(frames, frameCount, trackId, playbackTime);
+        return;
+    }
+
+    // An empty request is queued too: it closes the jaw
+    int32_t queuedFrames = 0;
+    do
+    {
+        int32_t chunkFrames = std::min(frameCount - queuedFrames, ANIMATION_CHUNK_FRAMES);
+        size_t bytes = static_cast<size_t>(chunkFrames) * sizeof(Frame);
+        if (m_events.freeSlots() <= PLAYBACK_EVENT_SLOTS || m_frameFifo.freeSpace() < bytes)
+        {
+            m_droppedFrames.fetch_add(static_cast<uint32_t>(frameCount - queuedFrames), std::memory_order_relaxed);
+            break;
+        }
+        m_frameFifo.write(reinterpret_cast<const uint8_t *>(frames + queuedFrames), bytes);
+
+        AnimationEvent event = {};
+        event.type = AnimationEvent::FRAMES;
+        event.trackId = trackId;
+        event.playbackTime = playbackTime;
+        event.frameCount = chunkFrames;
+        m_events.push(event);
+        queuedFrames += chunkFrames;
+    } while (queuedFrames < frameCount);
+
+    m_tasks.notify(m_taskHandle);
+}
+
+// Queue a track start for the animation task. The skit is looked up here, as the path can't be queued without
+// allocating; m_skits doesn't change after construction, so reading it from the callback is safe.
+void SkullAudioAnimator::queuePlaybackStarted(uint32_t trackId, const String &filePath)
+{
+    if (m_taskHandle == nullptr)
+    {
+        setPlaybackStarted(trackId, filePath);
+        return;
+    }
+
+    AnimationEvent event = {};
+    event.type = AnimationEvent::STARTED;
+    event.trackId = trackId;
+    event.skitIndex = findSkitIndex(filePath);
+    if (!m_events.push(event))
+    {
+        Serial.printf("SkullAudioAnimator::queuePlaybackStarted() Queue full; dropped track %u\n", trackId);
+    }
+    m_tasks.notify(m_taskHandle);
+}
+
+// Queue a track end for the animation task
+void SkullAudioAnimator::queuePlaybackEnded(uint32_t trackId)
+{
+    if (m_taskHandle == nullptr)
+    {
+        Serial.printf("SkullAudioAnimator::setPlaybackEnded() Track %u\n", trackId);
+        endPlayback();
+        return;
+    }
+
+    AnimationEvent event = {};
+    event.type = AnimationEvent::ENDED;
+    event.trackId = trackId;
+    if (!m_events.push(event))
+    {
+        Serial.printf("SkullAudioAnimator::queuePlaybackEnded() Queue full; dropped track %u\n", trackId);
+    }
+    m_tasks.notify(m_taskHandle);
+}
+
+// Animation task: sleep until the callback queues something, then animate it
+void SkullAudioAnimator::animationTask(void *param)
 {
+    SkullAudioAnimator *animator = static_cast<SkullAudioAnimator *>(param);
+    while (true)
+    {
+        animator->m_tasks.waitForNotification(ANIMATION_IDLE_MS);
+        animator->animateQueuedEvents();
+    }
+}
+
+// Animate everything the callback has queued, in order
+void SkullAudioAnimator::animateQueuedEvents()
+{
+    const AnimationEvent *event;
+    while ((event = m_events.front()) != nullptr)
+    {
+        switch (event->type)
+        {
+        case AnimationEvent::FRAMES:
+            m_frameFifo.read(reinterpret_cast<uint8_t *>(m_taskFrames), static_cast<size_t>(event->frameCount) * sizeof(Frame));
+            processAudioFrames(m_taskFrames, event->frameCount, event->trackId, event->playbackTime);
+            break;
+
+        case AnimationEvent::STARTED:
+            startPlayback(event->trackId, event->skitIndex);
+            break;
+
+        case AnimationEvent::ENDED:
+            Serial.printf("SkullAudioAnimator::setPlaybackEnded() Track %u\n", event->trackId);
+            endPlayback();
+            break;
+        }
+        m_events.pop();
+    }
 }
 
 // Main function to process incoming audio frames and update animations
-void SkullAudioAnimator::processAudioFrames(const Frame *frames, int32_t frameCount, const String &currentFile, unsigned long playbackTime)
+void SkullAudioAnimator::processAudioFrames(const Frame *frames, int32_t frameCount, uint32_t trackId, unsigned long playbackTime)
 {
     // Update internal state based on new audio data
-    m_currentFile = currentFile;
+    m_playingTrackId = trackId;
     m_currentPlaybackTime = playbackTime;
     m_isAudioPlaying = (frameCount > 0);
 
-    // Serial.printf("SkullAudioAnimator::processAudioFrames() m_currentFile: %s, m_isAudioPlaying: %s, frameCount: %d, isSpeaking: %s\n", m_currentFile.c_str(), m_isAudioPlaying ? "true" : "false", frameCount, m_isCurrentlySpeaking ? "true" : "false");
+    // Queue the audio for band analysis and pick up the latest result (computed on the analysis task)
+    m_bandEnergyAnalyzer.pushFrames(frames, frameCount);
+    m_hasBandEnergies = m_isAudioPlaying && m_bandEnergyAnalyzer.getLatest(m_bandEnergies);
 
-    // Process audio frames for various animations
+    // Serial.printf("SkullAudioAnimator::processAudioFrames() m_playingTrackId: %u, m_isAudioPlaying: %s, frameCount: %d, isSpeaking: %s\n", m_playingTrackId, m_isAudioPlaying ? "true" : "false", frameCount, m_isCurrentlySpeaking ? "true" : "false");
+
+    // Process audio frames for various animations (the eyes follow the jaw amplitude, so they go after it)
     updateSkit();
-    updateEyes();
     updateJawPosition(frames, frameCount);
+    updateEyes();
+}
+
+// Called when the AudioPlayer starts playing a track: point at the file's skit and its prebuilt line index
+void SkullAudioAnimator::setPlaybackStarted(uint32_t trackId, const String &filePath)
+{
+    startPlayback(trackId, findSkitIndex(filePath));
+}
+
+// Point at the track's skit, if it is one. The skit's path is printed on its own rather than through Print::printf(),
+// which would put a line that long on the heap.
+void SkullAudioAnimator::startPlayback(uint32_t trackId, size_t skitIndex)
+{
+    m_currentTrackId = trackId;
+    m_currentSkitLineNumber = -1;
+
+    if (skitIndex == m_skits.size())
+    {
+        m_currentSkit = nullptr;
+        m_currentLineIndex = nullptr;
+        Serial.printf("SkullAudioAnimator::setPlaybackStarted() Track %u (not a skit)\n", trackId);
+        return;
+    }
+
+    m_currentSkit = &m_skits[skitIndex];
+    m_currentLineIndex = &m_skitLineIndexes[skitIndex];
+    m_currentLineIndex->rewind();
+    Serial.printf("SkullAudioAnimator::setPlaybackStarted() Track %u: ", trackId);
+    Serial.print(m_currentSkit->audioFile);
+    Serial.printf(" (skit of %zu lines, %zu for us)\n", m_currentSkit->lines.size(), m_currentLineIndex->size());
 }
 
 void SkullAudioAnimator::setPlaybackEnded(const String &filePath)
+{
+    Serial.print("SkullAudioAnimator::setPlaybackEnded() filePath: ");
+    Serial.println(filePath);
+    endPlayback();
+}
+
+// Clear the track and skit state, and close the jaw and dim the eyes
+void SkullAudioAnimator::endPlayback()
 {
     // TODO: is this much tracking necessary??
-    m_currentFile = "";
+    m_playingTrackId = AudioPlayer::NO_TRACK;
     m_currentPlaybackTime = 0;
     m_isAudioPlaying = false;
-    m_currentAudioFilePath = "";
-    m_currentSkit = ParsedSkit();
+    m_currentTrackId = AudioPlayer::NO_TRACK;
+    m_currentSkit = nullptr;
+    m_currentLineIndex = nullptr;
     m_currentSkitLineNumber = -1;
 
-    Serial.printf("SkullAudioAnimator::setPlaybackEnded() filePath: %s\n", filePath.c_str());
-
     // Process audio frames for various animations
     updateSkit();
     updateEyes();
@@ -86,69 +291,35 @@ void SkullAudioAnimator::updateSkit()
         return;
     }
 
-    // Handle case when current file is emptyPlaying non-skit audio file
-    if (m_currentFile.isEmpty())
+    // No file playing (e.g. between files)
+    if (m_playingTrackId == AudioPlayer::NO_TRACK)
     {
         setSpeakingState(false);
         return;
     }
 
-    // If we're playing a new file, parse the skit and reset the line number
-    if (m_currentFile != m_currentAudioFilePath)
-    {
-        m_currentAudioFilePath = m_currentFile;
-        m_currentSkitLineNumber = -1;
-
-        m_currentSkit = findSkitByName(m_skits, m_currentFile);
-        if (m_currentSkit.lines.empty())
-        {
-            Serial.printf("SkullAudioAnimator::updateSkit() Playing non-skit audio file (m_currentFile): %s, m_currentPlaybackTime: %lu, (m_currentAudioFilePath): %s\n", m_currentFile.c_str(), m_currentPlaybackTime, m_currentAudioFilePath.c_str());
-            setSpeakingState(true);
-            return;
-        }
-
-        Serial.printf("SkullAudioAnimator::updateSkit() Playing new skit at m_currentPlaybackTime: %lu, %s\n", m_currentPlaybackTime, m_currentSkit.audioFile.c_str());
-
-        // Filter skit lines for the current skull (primary or secondary)
-        std::vector<ParsedSkitLine> lines;
-        for (const auto &line : m_currentSkit.lines)
-        {
-            if ((line.speaker == 'A' && m_isPrimary) || (line.speaker == 'B' && !m_isPrimary))
-            {
-                lines.push_back(line);
-            }
-        }
-        Serial.printf("SkullAudioAnimator::updateSkit() Parsed skit '%s' with %d lines. %d lines for us.\n",
-                      m_currentSkit.audioFile.c_str(), m_currentSkit.lines.size(), lines.size());
-        m_currentSkit.lines = lines;
-    }
-
-    // If we're playing a non-skit, we're speaking
-    if (m_currentSkit.lines.empty())
+    // If we're playing a non-skit, or a track we didn't see start (so can't know is a skit), we're speaking
+    if (m_playingTrackId != m_currentTrackId || m_currentLineIndex == nullptr || m_currentLineIndex->isEmpty())
     {
         setSpeakingState(true);
         return;
     }
 
-    // Find the current speaking line in the skit based on playback time
+    // Find the current speaking line in the skit based on playback time.
+    // The index only does any work when a line is scheduled to start or end.
     size_t originalLineNumber = m_currentSkitLineNumber;
-    bool foundLine = false;
-    for (const auto &line : m_currentSkit.lines)
+    const SkitLineIndex::Segment *line = m_currentLineIndex->find(m_currentPlaybackTime);
+    bool foundLine = (line != nullptr);
+    if (foundLine)
     {
-        // We need to clip the end of the line to avoid overlap with the next line.
-        // Even if you get the timings exactly right in the skit file, I believe this is taking the buffer into account.
-        if (m_currentPlaybackTime >= line.timestamp && m_currentPlaybackTime < line.timestamp + line.duration - SKIT_AUDIO_LINE_OFFSET)
-        {
-            m_currentSkitLineNumber = line.lineNumber;
-            foundLine = true;
-            break;
-        }
+        m_currentSkitLineNumber = line->lineNumber;
     }
 
-    // Log when a new line starts speaking
+    // Log when a new line starts speaking (these logs stay within Print::printf()'s 64 byte stack buffer, so they don't
+    // allocate in the A2DP callback)
     if (m_currentSkitLineNumber != originalLineNumber)
     {
-        Serial.printf("SkullAudioAnimator::updateSkit() Now speaking line %d at time %lu\n", m_currentSkitLineNumber, m_currentPlaybackTime);
+        Serial.printf("SkullAudioAnimator::updateSkit() Line %d starts at %lu\n", m_currentSkitLineNumber, m_currentPlaybackTime);
     }
 
     setSpeakingState(foundLine);
@@ -156,60 +327,91 @@ void SkullAudioAnimator::updateSkit()
     // Log when a line finishes speaking
     if (m_isCurrentlySpeaking && !foundLine)
     {
-        Serial.printf("SkullAudioAnimator::updateSkit() Ended speaking line %d at time %lu\n", m_currentSkitLineNumber, m_currentPlaybackTime);
+        Serial.printf("SkullAudioAnimator::updateSkit() Line %d ends at %lu\n", m_currentSkitLineNumber, m_currentPlaybackTime);
     }
 }
 
-// Updates the eye brightness based on the speaking state
+// Updates the eye brightness based on the speaking state.
+// The LightController skips unchanged levels and holds new ones until the running fade ends, so this is cheap per callback.
 void SkullAudioAnimator::updateEyes()
 {
-    if (m_isCurrentlySpeaking)
+    if (!m_isCurrentlySpeaking)
     {
-        m_lightController.setEyeBrightness(LightController::BRIGHTNESS_MAX);
+        m_lightController.fadeEyeBrightness(EyeLights::BRIGHTNESS_DIM, EYE_FADE_MS);
+        return;
+    }
+
+    float level;
+    if (m_hasBandEnergies)
+    {
+        // Flicker with articulation: brighter on formants and consonants, dimmer in pauses
+        float articulation = sqrtf(m_bandEnergies.mid * m_bandEnergies.mid + m_bandEnergies.high * m_bandEnergies.high);
+        level = articulation * static_cast<float>(JawEnvelope::AMPLITUDE_GAIN / JawEnvelope::MAX_EXPECTED_AMPLITUDE);
     }
     else
     {
-        m_lightController.setEyeBrightness(LightController::BRIGHTNESS_DIM);
+        // Follow the jaw envelope (precomputed or live RMS)
+        level = static_cast<float>(m_jawAmplitude / JawEnvelope::MAX_EXPECTED_AMPLITUDE);
     }
+    level = std::min(1.0f, std::max(0.0f, level));
+    m_lightController.fadeEyeBrightness(EyeLights::BRIGHTNESS_DIM +
+                                            static_cast<uint8_t>((EyeLights::BRIGHTNESS_MAX - EyeLights::BRIGHTNESS_DIM) * level),
+                                        EYE_FADE_MS);
 }
 
 void SkullAudioAnimator::updateJawPosition(const Frame *frames, int32_t frameCount)
 {
-    // Interrupt any ongoing smooth movement
-    m_servoController.interruptMovement();
+    // Writing a jaw position below preempts any ongoing smooth movement (e.g. breathing)
 
     if (frameCount > 0)
     {
-        // Compute RMS amplitude over the frames
-        double rmsAmplitude = calculateRMSFromFrames(frames, frameCount);
-
-        // Apply exponential smoothing to the amplitude
-        m_smoothedAmplitude = AMPLITUDE_SMOOTHING_FACTOR * rmsAmplitude + (1 - AMPLITUDE_SMOOTHING_FACTOR) * m_smoothedAmplitude;
-
-        // Apply gain and adjust amplitude
-        double adjustedAmplitude = m_smoothedAmplitude * AMPLITUDE_GAIN;
-        adjustedAmplitude = std::min(adjustedAmplitude, MAX_EXPECTED_AMPLITUDE);
+        double adjustedAmplitude;
+        if (m_currentSkit != nullptr && m_currentSkit->jawEnvelope)
+        {
+            // The envelope was generated offline with the same smoothing, gain and threshold, so just look it up.
+            // It covers both skulls' voices, so it only applies where one of our lines is, at the looked-up time rather
+            // than the playing one, or the lookahead would cut the start of our lines and let the other skull's voice in.
+            long envelopeTime = static_cast<long>(m_currentPlaybackTime) + m_jawLookaheadMs;
+            bool speakingAtEnvelopeTime = envelopeTime >= 0 &&
+                                          (m_currentLineIndex->isEmpty() ? m_isCurrentlySpeaking
+                                                                         : m_currentLineIndex->lineAt(static_cast<unsigned long>(envelopeTime)) != nullptr);
+            adjustedAmplitude = speakingAtEnvelopeTime ? m_currentSkit->jawEnvelope->amplitudeAt(static_cast<unsigned long>(envelopeTime)) : 0.0;
+        }
+        else if (m_hasBandEnergies)
+        {
+            // Open the jaw on voiced sound (low/mid bands); fricatives only open it a little
+            float fricative = FRICATIVE_JAW_WEIGHT * m_bandEnergies.high;
+            double voicedAmplitude = sqrtf(m_bandEnergies.low * m_bandEnergies.low + m_bandEnergies.mid * m_bandEnergies.mid + fricative * fricative);
 
-        // Implement a threshold to avoid small movements
-        if (adjustedAmplitude < AMPLITUDE_THRESHOLD)
+            m_smoothedAmplitude = JawEnvelope::smoothAmplitude(m_smoothedAmplitude, voicedAmplitude);
+            adjustedAmplitude = JawEnvelope::adjustAmplitude(m_smoothedAmplitude);
+        }
+        else
         {
-            adjustedAmplitude = 0.0;
+            // No recent band analysis: compute RMS amplitude over the frames
+            double rmsAmplitude = calculateRMSFromFrames(frames, frameCount);
+
+            // Apply exponential smoothing, gain and threshold to the amplitude
+            m_smoothedAmplitude = JawEnvelope::smoothAmplitude(m_smoothedAmplitude, rmsAmplitude);
+            adjustedAmplitude = JawEnvelope::adjustAmplitude(m_smoothedAmplitude);
         }
 
+        m_jawAmplitude = adjustedAmplitude;
+
         // Map the adjusted amplitude to jaw position
-        int targetJawPosition = mapFloat(adjustedAmplitude, 0.0, MAX_EXPECTED_AMPLITUDE, m_servoMinDegrees, m_servoMaxDegrees);
+        int targetJawPosition = mapFloat(adjustedAmplitude, 0.0, JawEnvelope::MAX_EXPECTED_AMPLITUDE, m_servoMinDegrees, m_servoMaxDegrees);
 
         // Smooth the jaw position to reduce jitter
         int jawPosition = static_cast<int>(JAW_POSITION_SMOOTHING_FACTOR * targetJawPosition + (1 - JAW_POSITION_SMOOTHING_FACTOR) * m_previousJawPosition);
 
-        // Update the servo position
-        m_servoController.setPosition(jawPosition);
+        // Move the servo toward the position, within its velocity and acceleration limits
+        m_servoController.followPosition(jawPosition);
 
         // Store the previous jaw position for the next iteration
         m_previousJawPosition = jawPosition;
 
         // For debugging purposes
-        // Serial.printf("RMS Amplitude: %.2f, Adjusted Amplitude: %.2f, Jaw Position: %d\n", rmsAmplitude, adjustedAmplitude, jawPosition);
+        // Serial.printf("Adjusted Amplitude: %.2f, Jaw Position: %d\n", adjustedAmplitude, jawPosition);
     }
     else
     {
@@ -217,21 +419,13 @@ void SkullAudioAnimator::updateJawPosition(const Frame *frames, int32_t frameCou
         m_servoController.setPosition(m_servoMinDegrees);
         m_previousJawPosition = m_servoMinDegrees;
         m_smoothedAmplitude = 0.0;
+        m_jawAmplitude = 0.0;
     }
 }
 
 double SkullAudioAnimator::calculateRMSFromFrames(const Frame *frames, int32_t frameCount)
 {
-    double sum = 0.0;
-    for (int32_t i = 0; i < frameCount; i++)
-    {
-        int32_t sample1 = frames[i].channel1;
-        int32_t sample2 = frames[i].channel2;
-        sum += sample1 * sample1;
-        sum += sample2 * sample2;
-    }
-    int numSamples = frameCount * 2; // Two channels
-    return sqrt(sum / numSamples);
+    return AudioLevel::rms(frames, static_cast<size_t>(frameCount));
 }
 
 int SkullAudioAnimator::mapFloat(double x, double in_min, double in_max, int out_min, int out_max)
@@ -239,17 +433,17 @@ int SkullAudioAnimator::mapFloat(double x, double in_min, double in_max, int out
     return static_cast<int>((x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min);
 }
 
-// Finds a skit by its name in the list of parsed skits
-ParsedSkit SkullAudioAnimator::findSkitByName(const std::vector<ParsedSkit> &skits, const String &name)
+// Index in m_skits of the skit with the given audio file, or m_skits.size() if there's none
+size_t SkullAudioAnimator::findSkitIndex(const String &audioFile) const
 {
-    for (const auto &skit : skits)
+    for (size_t i = 0; i < m_skits.size(); i++)
     {
-        if (skit.audioFile == name)
+        if (m_skits[i].audioFile == audioFile)
         {
-            return skit;
+            return i;
         }
     }
-    return ParsedSkit();
+    return m_skits.size();
 }
 
 // Sets the callback function for speaking state changes
@@ -1,38 +1,56 @@
 #ifndef SKULL_AUDIO_ANIMATOR_H
 #define SKULL_AUDIO_ANIMATOR_H
 
-#include "servo_controller.h"
-#include "arduinoFFT.h"
-#include "light_controller.h"
+#include "animation_outputs.h"
+#include "audio_ring_buffer.h"
+#include "band_energy_analyzer.h"
+#include "platform.h"
 #include "parsed_skit.h"
+#include "skit_line_index.h"
 #include <vector>
 #include <Arduino.h>
 #include "SoundData.h" // Include this to get the Frame struct definition
 #include <functional>
 
-// TODO: Should probably be defined by the audioPlayer and passed in from it, either during init or via processAudioFrames()
-#define SAMPLES 256
-#define SAMPLE_RATE 44100
-
 // Forward declarations
 class SDCardManager;
 
-// SkullAudioAnimator class handles the animation of skulls based on audio input
+// SkullAudioAnimator class handles the animation of skulls based on audio input.
+//
+// The animation runs on its own task: the A2DP callback only queues the frames and the track starts and ends
+// (queueAudioFrames() etc.), and the task animates the jaw and eyes from them in order. Moving the jaw and eyes takes
+// the ServoController and LightController mutexes, which their own tasks on core 1 hold, so it stays out of the callback.
 class SkullAudioAnimator
 {
 public:
-    // Constructor: initializes the animator with necessary controllers and parameters
-    SkullAudioAnimator(bool isPrimary, ServoController &servoController, LightController &lightController,
-                       std::vector<ParsedSkit> &skits, SDCardManager &sdCardManager, int servoMinDegrees, int servoMaxDegrees);
+    // Constructor: initializes the animator with necessary controllers and parameters.
+    // The jaw and eyes are the ServoController and LightController on the skulls; the band analysis runs on tasks.
+    SkullAudioAnimator(bool isPrimary, JawServo &servoController, EyeLights &lightController,
+                       std::vector<ParsedSkit> &skits, SDCardManager &sdCardManager, Clock &clock, Tasks &tasks,
+                       int servoMinDegrees, int servoMaxDegrees);
+
+    // Starts the animation and band energy analysis tasks
+    void begin();
+
+    // Called from the A2DP callback: queue the frames, with the track and playback time they belong to, for the animation
+    // task to run processAudioFrames() on. Never blocks or allocates. Drops the frames if the task is too far behind.
+    // Without the task (before begin(), or if it couldn't start) the frames are processed straight away.
+    void queueAudioFrames(const Frame *frames, int32_t frameCount, uint32_t trackId, unsigned long playbackTime);
 
-    // Finds a skit by its name in the list of parsed skits
-    ParsedSkit findSkitByName(const std::vector<ParsedSkit> &skits, const String &name);
+    // Called from the A2DP callback: queue setPlaybackStarted() / setPlaybackEnded() for the animation task, in order
+    // with the frames. Never blocks or allocates.
+    void queuePlaybackStarted(uint32_t trackId, const String &filePath);
+    void queuePlaybackEnded(uint32_t trackId);
+
+    // Frames queueAudioFrames() dropped because the animation task was behind, for the status log
+    uint32_t getDroppedFrames() const { return m_droppedFrames.load(std::memory_order_relaxed); }
 
     // Returns the current speaking state of the skull
     bool isCurrentlySpeaking() { return m_isCurrentlySpeaking; }
 
-    // Main function to process incoming audio frames and update animations
-    void processAudioFrames(const Frame *frames, int32_t frameCount, const String &currentFile, unsigned long playbackTime);
+    // Main function to process incoming audio frames and update animations. Runs on the animation task; call it directly
+    // only if nothing is queued. trackId is the AudioPlayer track the frames belong to (AudioPlayer::NO_TRACK if none).
+    void processAudioFrames(const Frame *frames, int32_t frameCount, uint32_t trackId, unsigned long playbackTime);
 
     // Typedef for the speaking state callback function
     using SpeakingStateCallback = std::function<void(bool)>;
@@ -40,61 +58,118 @@ public:
     // Sets the callback function for speaking state changes
     void setSpeakingStateCallback(SpeakingStateCallback callback);
 
-    // Sets the playback ended state
+    // Called when the AudioPlayer starts playing a track: looks up the file's skit, if it is one.
+    // Runs on the animation task, like processAudioFrames().
+    void setPlaybackStarted(uint32_t trackId, const String &filePath);
+
+    // Sets the playback ended state. Runs on the animation task, like processAudioFrames().
     void setPlaybackEnded(const String &filePath);
 
+    // Returns the cost of the band energy analysis, for the status log
+    BandEnergyAnalyzer::Stats getBandEnergyStats() const { return m_bandEnergyAnalyzer.getStats(); }
+
+    // Sets how far ahead (positive) or behind (negative) of the playing audio the jaw is driven, in milliseconds.
+    // Must match the AudioPlayer's analysis lookahead: live frames arrive already offset, this offsets envelope lookups.
+    void setJawLookahead(long lookaheadMs) { m_jawLookaheadMs = lookaheadMs; }
+
 private:
-    ServoController &m_servoController;
-    LightController &m_lightController;
+    // What the A2DP callback queues for the animation task
+    struct AnimationEvent
+    {
+        enum Type : uint8_t
+        {
+            FRAMES,  // frameCount frames in m_frameFifo
+            STARTED, // setPlaybackStarted()
+            ENDED,   // setPlaybackEnded()
+        } type;
+        uint32_t trackId;
+        unsigned long playbackTime; // FRAMES
+        int32_t frameCount;         // FRAMES
+        size_t skitIndex;           // STARTED: index in m_skits, m_skits.size() if the file isn't a skit
+    };
+
+    // Animation task: below the audio producer, above the skit, servo motion and band analysis tasks, so the jaw keeps
+    // up with the audio, on the core A2DP doesn't use
+    static constexpr uint32_t ANIMATION_TASK_STACK_SIZE = 4096;
+    static constexpr uint32_t ANIMATION_TASK_PRIORITY = 3;
+    static constexpr int ANIMATION_TASK_CORE = 1;
+    static constexpr uint32_t ANIMATION_IDLE_MS = 100; // Longest the task sleeps without a notification from the callback
+
+    static constexpr size_t FRAME_FIFO_SIZE = 8192;        // Bytes of frames (~46ms)
+    static constexpr int32_t ANIMATION_CHUNK_FRAMES = 512; // Most frames in one FRAMES event
+    static constexpr size_t EVENT_QUEUE_SLOTS = 32;
+    static constexpr size_t PLAYBACK_EVENT_SLOTS = 4; // Slots FRAMES events leave free, so starts and ends aren't dropped
+
+    // Animation task entry point
+    static void animationTask(void *param);
+
+    // Animation task only: animate everything the callback has queued, in order
+    void animateQueuedEvents();
+
+    // Point at the skit (an index in m_skits, m_skits.size() for a non-skit file) the track plays, or clear it
+    void startPlayback(uint32_t trackId, size_t skitIndex);
+    void endPlayback();
+
+    JawServo &m_servoController;
+    EyeLights &m_lightController;
     SDCardManager &m_sdCardManager;
     bool m_isPrimary;
     std::vector<ParsedSkit> &m_skits;
-    String m_currentAudioFilePath;
+    std::vector<SkitLineIndex> m_skitLineIndexes; // This skull's lines of each of m_skits, indexed by time (built once)
     bool m_isCurrentlySpeaking;
     size_t m_currentSkitLineNumber;
-    ParsedSkit m_currentSkit;
-    double vReal[SAMPLES];
-    double vImag[SAMPLES];
-    arduinoFFT FFT;
+    uint32_t m_currentTrackId;               // Track the skit state below belongs to
+    const ParsedSkit *m_currentSkit;         // Skit being played, or nullptr for a non-skit file
+    SkitLineIndex *m_currentLineIndex;       // This skull's lines of m_currentSkit, or nullptr
+    BandEnergyAnalyzer m_bandEnergyAnalyzer;
+    BandEnergyAnalyzer::BandEnergies m_bandEnergies; // Latest analysis, valid if m_hasBandEnergies
+    bool m_hasBandEnergies;
     double m_smoothedAmplitude; // Exponential smoothing of amplitude
+    double m_jawAmplitude;      // Adjusted amplitude the jaw was last positioned from
     int m_previousJawPosition;  // Previous jaw position for smoothing
 
-    String m_currentFile;
+    uint32_t m_playingTrackId; // Track of the frames being processed
     unsigned long m_currentPlaybackTime;
     bool m_isAudioPlaying;
+    long m_jawLookaheadMs;
 
-    // Constants for jaw position calculation
+    // A2DP callback -> animation task
+    Tasks &m_tasks;
+    Tasks::Handle m_taskHandle;
+    AudioRingBuffer m_frameFifo;
+    SpscQueue<AnimationEvent, EVENT_QUEUE_SLOTS> m_events;
+    std::atomic<uint32_t> m_droppedFrames;
+    Frame m_taskFrames[ANIMATION_CHUNK_FRAMES]; // Animation task only: the frames of the FRAMES event being animated
 
-    // Controls how much weight is given to new amplitude vs. previous smoothed value.
-    // Lower value (e.g., 0.1) results in more smoothing, reducing sensitivity to transient peaks.
-    static constexpr double AMPLITUDE_SMOOTHING_FACTOR = 0.1;
+    // Constants for jaw position calculation.
+    // The amplitude smoothing, gain and threshold constants are in JawEnvelope, shared with the offline envelope generator.
 
     // Controls the smoothing of jaw movements.
     // Helps create fluid transitions between positions, reducing jitter.
     static constexpr double JAW_POSITION_SMOOTHING_FACTOR = 0.2;
 
-    // Amplifies the smoothed amplitude to utilize the full range of the servo.
-    // Adjust based on testing to achieve desired jaw movement range.
-    static constexpr double AMPLITUDE_GAIN = 5.0;
+    // How much fricative (high band) energy opens the jaw, relative to voiced (low/mid band) energy.
+    // Teeth stay nearly closed on "s" and "f", so this is kept low.
+    static constexpr float FRICATIVE_JAW_WEIGHT = 0.3f;
 
-    // Sets the upper limit for mapping amplitudes to servo positions.
-    // Adjust based on your audio levels to prevent over-extension of the jaw.
-    static constexpr double MAX_EXPECTED_AMPLITUDE = 15000.0;
+    // While speaking, the eyes follow the voice between BRIGHTNESS_DIM and BRIGHTNESS_MAX: articulation
+    // (mid/high band energy) if there's band analysis, otherwise the jaw amplitude. Each change is a hardware
+    // fade of this length, which also limits LED updates to one per fade.
+    static constexpr uint16_t EYE_FADE_MS = 40;
 
-    // Determines the minimum amplitude required to start moving the jaw.
-    // Helps achieve "mostly open" and "mostly closed" effect by ignoring minor fluctuations.
-    static constexpr double AMPLITUDE_THRESHOLD = 1000.0;
-
-    // Updates the jaw position based on the audio amplitude
+    // Updates the jaw position based on the audio amplitude, or the skit's precomputed jaw envelope if it has one
     void updateJawPosition(const Frame *frames, int32_t frameCount);
 
-    // Updates the eye brightness based on the speaking state
+    // Updates the eye brightness based on the speaking state and, while speaking, the band energies or jaw amplitude
     void updateEyes();
 
     // Updates the current skit state and speaking status based on audio playback
     void updateSkit();
 
-    // Calculates the Root Mean Square (RMS) of the audio samples
+    // Index in m_skits of the skit with the given audio file, or m_skits.size() if there's none
+    size_t findSkitIndex(const String &audioFile) const;
+
+    // Calculates the Root Mean Square (RMS) of the audio samples (integer math, see AudioLevel)
     double calculateRMSFromFrames(const Frame *frames, int32_t frameCount);
     int mapFloat(double x, double in_min, double in_max, int out_min, int out_max);
 
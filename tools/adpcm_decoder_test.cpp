@@ -0,0 +1,228 @@
+/*
+    ADPCM Decoder Test (host-side tool)
+
+    Checks ImaAdpcmDecoder bit for bit:
+      - Hand-worked blocks: a run of the largest positive code from step index 0, clamping of the predictor at both
+        ends and of the step index at 88, a stereo block (the channels' 8-sample groups interleave), and a short
+        final block (a partial group is dropped).
+      - A block of random codes, which mostly saturates, against the output of Python's audioop.adpcm2lin, an
+        independent IMA decoder.
+      - Round trips: audio encoded with the IMA reference encoder, in mono and stereo blocks of the sizes ffmpeg
+        writes, must decode to exactly the encoder's own reconstruction.
+      - samplesPerBlock(), and the blocks decodeBlock() must refuse.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/adpcm_decoder_test.cpp ima_adpcm_decoder.cpp -o adpcm_decoder_test
+
+    Usage:
+        ./adpcm_decoder_test
+*/
+
+#include "ima_adpcm_decoder.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// A block header for one channel
+static void appendHeader(std::vector<uint8_t> &block, int16_t predictor, uint8_t stepIndex)
+{
+    block.push_back(static_cast<uint8_t>(predictor & 0xFF));
+    block.push_back(static_cast<uint8_t>((predictor >> 8) & 0xFF));
+    block.push_back(stepIndex);
+    block.push_back(0);
+}
+
+// Decode a block and compare it with the expected interleaved samples
+static void expectBlock(const std::string &name, const std::vector<uint8_t> &block, uint16_t channels,
+                        const std::vector<int16_t> &expected)
+{
+    std::vector<int16_t> output(ImaAdpcmDecoder::samplesPerBlock(static_cast<uint16_t>(block.size()), channels) * channels);
+    size_t frames = ImaAdpcmDecoder::decodeBlock(block.data(), block.size(), channels, output.data());
+    output.resize(frames * channels);
+    check(output == expected, name, "output differs");
+}
+
+static void checkVectors()
+{
+    // Code 7 adds step * 15/8 (as step/8 + step/4 + step/2 + step, each rounded down) and moves the step index up 8
+    std::vector<uint8_t> block;
+    appendHeader(block, 0, 0);
+    block.insert(block.end(), {0x77, 0x77, 0x77, 0x77});
+    expectBlock("code 7 from step index 0", block, 1, {0, 11, 41, 104, 240, 533, 1164, 2521, 5431});
+
+    // At step 32767, codes 7 and 15 swing 61436 either way: the predictor clamps to 32767 and -32768 and the step
+    // index stays at 88. Codes 0 then move it back down one at a time. A stored step index over 88 reads as 88.
+    block.clear();
+    appendHeader(block, 32000, 200);
+    block.insert(block.end(), {0xF7, 0x0F, 0x00, 0x00});
+    expectBlock("predictor and step index clamping", block, 1, {32000, 32767, -28669, -32768, -28673, -24949, -21564, -18487, -15689});
+
+    // Code 0 at step index 0: step 7 / 8 adds nothing and the index can't go below 0. Code 8 is the same, negated.
+    block.clear();
+    appendHeader(block, -5, 0);
+    block.insert(block.end(), {0x00, 0x88, 0x80, 0x08});
+    expectBlock("step index floor", block, 1, {-5, -5, -5, -5, -5, -5, -5, -5, -5});
+
+    // Stereo: both headers, then 4 bytes (8 samples) of the left channel, 4 of the right
+    block.clear();
+    appendHeader(block, 100, 0);
+    appendHeader(block, -100, 0);
+    block.insert(block.end(), {0x77, 0x77, 0x77, 0x77, 0xFF, 0xFF, 0xFF, 0xFF});
+    std::vector<int16_t> stereo = {100, -100, 111, -111, 141, -141, 204, -204, 340, -340,
+                                   633, -633, 1264, -1264, 2621, -2621, 5531, -5531};
+    expectBlock("stereo", block, 2, stereo);
+
+    // A short final block: the 3 bytes after the last whole group are dropped
+    block.insert(block.end(), {0x77, 0x77, 0x77});
+    expectBlock("short final block", block, 2, stereo);
+
+    // Random codes from step index 40, decoded by Python's audioop.adpcm2lin (fed the same nibbles high first)
+    block.clear();
+    appendHeader(block, -1234, 40);
+    block.insert(block.end(), {0x82, 0xB7, 0x0E, 0xEE, 0x7F, 0x1A, 0x50, 0x39, 0xBE, 0xF0, 0x7E, 0xC2, 0x34, 0x7F, 0x06, 0x6E,
+                               0xD0, 0x8F, 0x5D, 0xC7, 0x51, 0x24, 0x47, 0xE3, 0x40, 0x43, 0x00, 0x02, 0x6B, 0x6E, 0x54, 0x55});
+    expectBlock("random codes against audioop", block, 1,
+                {-1234, -1024, -1062, -541, -1063, -1947, -1827, -3250, -5772, -10925, 125, -7771, -3465,
+                 -2160, 10892, 5681, 16735, -1930, -19735, -17423, -32768, -32768, 28668, 32767, -751, 32767,
+                 32767, -23096, 32767, 32767, 32767, -15648, 32767, 32767, -8199, -32768, -32768, -32768, 12285,
+                 32767, -4095, 8191, 32767, 32767, 32767, 32767, 32767, 32767, -15648, -11553, 21965, 32767,
+                 32767, 32767, 32767, 32767, 32767, 13181, 32767, -20478, 32767, 32767, 32767, 32767, 32767});
+}
+
+// IMA reference encoder for one channel. It tracks the decoder's state, so predictor is what a decoder outputs.
+class Encoder
+{
+public:
+    Encoder() : predictor(0), stepIndex(0) {}
+
+    uint8_t encode(int16_t sample)
+    {
+        static const int8_t INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+        static const int16_t STEP_TABLE[89] = {
+            7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60,
+            66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408,
+            449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272,
+            2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+            11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+        int32_t step = STEP_TABLE[stepIndex];
+        int32_t difference = sample - predictor;
+        uint8_t code = 0;
+        if (difference < 0)
+        {
+            code = 8;
+            difference = -difference;
+        }
+
+        // Successive approximation, halving the step: the same sum the decoder makes from the code's bits
+        int32_t change = step >> 3;
+        for (uint8_t bit = 4; bit > 0; bit >>= 1)
+        {
+            if (difference >= step)
+            {
+                code |= bit;
+                difference -= step;
+                change += step;
+            }
+            step >>= 1;
+        }
+
+        predictor += (code & 8) ? -change : change;
+        predictor = predictor > 32767 ? 32767 : (predictor < -32768 ? -32768 : predictor);
+        stepIndex += INDEX_TABLE[code];
+        stepIndex = stepIndex > 88 ? 88 : (stepIndex < 0 ? 0 : stepIndex);
+        return code;
+    }
+
+    int32_t predictor;
+    int32_t stepIndex;
+};
+
+// Encode audio into blocks as a WAV file holds them, and decode them again
+static void checkRoundTrip(const std::string &name, uint16_t channels, uint16_t blockAlign, uint64_t seed)
+{
+    uint32_t framesPerBlock = ImaAdpcmDecoder::samplesPerBlock(blockAlign, channels);
+    Random random(seed);
+    Encoder encoders[2];
+    size_t mismatches = 0;
+    for (int blockNumber = 0; blockNumber < 64; blockNumber++)
+    {
+        // Tones with noise, louder block by block until they clip
+        std::vector<int16_t> audio(framesPerBlock * channels);
+        double amplitude = 2000.0 * (blockNumber + 1);
+        for (uint32_t frame = 0; frame < framesPerBlock; frame++)
+        {
+            for (uint16_t channel = 0; channel < channels; channel++)
+            {
+                double t = (blockNumber * framesPerBlock + frame) / 22050.0;
+                double value = amplitude * sin(2 * M_PI * (220.0 + 110.0 * channel) * t) + 1000.0 * (2.0 * random.uniform() - 1.0);
+                value = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+                audio[frame * channels + channel] = static_cast<int16_t>(value);
+            }
+        }
+
+        // Headers carry each encoder's state; the first frame is stored as is
+        std::vector<uint8_t> block;
+        std::vector<int16_t> expected(framesPerBlock * channels);
+        for (uint16_t channel = 0; channel < channels; channel++)
+        {
+            encoders[channel].predictor = audio[channel];
+            appendHeader(block, audio[channel], static_cast<uint8_t>(encoders[channel].stepIndex));
+            expected[channel] = audio[channel];
+        }
+        for (uint32_t group = 0; group < (framesPerBlock - 1) / 8; group++)
+        {
+            for (uint16_t channel = 0; channel < channels; channel++)
+            {
+                for (uint32_t i = 0; i < 8; i += 2)
+                {
+                    size_t first = (1 + group * 8 + i) * channels + channel;
+                    size_t second = first + channels;
+                    uint8_t low = encoders[channel].encode(audio[first]);
+                    expected[first] = static_cast<int16_t>(encoders[channel].predictor);
+                    uint8_t high = encoders[channel].encode(audio[second]);
+                    expected[second] = static_cast<int16_t>(encoders[channel].predictor);
+                    block.push_back(static_cast<uint8_t>(low | (high << 4)));
+                }
+            }
+        }
+
+        std::vector<int16_t> output(expected.size());
+        size_t frames = ImaAdpcmDecoder::decodeBlock(block.data(), block.size(), channels, output.data());
+        if (block.size() != blockAlign || frames != framesPerBlock || output != expected)
+        {
+            mismatches++;
+        }
+    }
+    check(mismatches == 0, name, "a block decoded differently from the encoder's reconstruction");
+}
+
+static void checkSizes()
+{
+    check(ImaAdpcmDecoder::samplesPerBlock(512, 1) == 1017, "512-byte mono block", "wrong samplesPerBlock()");
+    check(ImaAdpcmDecoder::samplesPerBlock(1024, 1) == 2041, "1024-byte mono block", "wrong samplesPerBlock()");
+    check(ImaAdpcmDecoder::samplesPerBlock(1024, 2) == 1017, "1024-byte stereo block", "wrong samplesPerBlock()");
+    check(ImaAdpcmDecoder::samplesPerBlock(8, 2) == 1, "header-only stereo block", "wrong samplesPerBlock()");
+    check(ImaAdpcmDecoder::samplesPerBlock(3, 1) == 0, "block shorter than its header", "wrong samplesPerBlock()");
+    check(ImaAdpcmDecoder::samplesPerBlock(512, 0) == 0, "no channels", "wrong samplesPerBlock()");
+
+    uint8_t block[16] = {};
+    int16_t output[32];
+    check(ImaAdpcmDecoder::decodeBlock(block, sizeof(block), 0, output) == 0, "decode with no channels", "not refused");
+    check(ImaAdpcmDecoder::decodeBlock(block, sizeof(block), 3, output) == 0, "decode with 3 channels", "not refused");
+    check(ImaAdpcmDecoder::decodeBlock(block, 7, 2, output) == 0, "stereo block shorter than its headers", "not refused");
+}
+
+int main()
+{
+    checkVectors();
+    checkRoundTrip("mono round trip, 512-byte blocks", 1, 512, 1);
+    checkRoundTrip("mono round trip, 1024-byte blocks", 1, 1024, 2);
+    checkRoundTrip("stereo round trip, 1024-byte blocks", 2, 1024, 3);
+    checkRoundTrip("stereo round trip, 2048-byte blocks", 2, 2048, 4);
+    checkSizes();
+    return checkSummary();
+}
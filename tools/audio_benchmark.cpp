@@ -0,0 +1,741 @@
+/*
+    Audio Benchmark (host-side tool)
+
+    Times the work the skulls do for each A2DP request, so a change that makes the audio path slower shows up before
+    it reaches a speaker. It runs the skulls' own AudioPlayer and SkullAudioAnimator on the host platform (tools/host),
+    at the request sizes A2DP asks for (128 - 1024 frames), on audio files it writes to a temporary folder:
+
+        provide_frames            AudioPlayer::provideAudioFrames(): copying the request out of the ring buffer (across
+                                  its wrap), with a frames callback that does nothing
+        provide_frames_lookback   provideAudioFrames() with a -10 ms jaw lookahead and a 16KB buffer: also reading the
+                                  analysis window back out of the buffer
+        provide_frames_transition provideAudioFrames() requests in which one file ends and the next starts: the file
+                                  markers and the start and end callbacks (which do nothing)
+        fill_buffer               A producer pass, AudioPlayer::fillBuffer(), refilling what a request freed: reading
+                                  the file and AudioPlayer::writeToBuffer()
+        fill_buffer_22k_mono      The same from a mono 22.05kHz file, converted to 44.1kHz stereo on the way
+        animator_skit             SkullAudioAnimator::processAudioFrames() during a skit: updateSkit() finding the line,
+                                  updateJawPosition() from calculateRMSFromFrames() and the band energies, updateEyes(),
+                                  and queueing the frames for band analysis
+        animator_envelope         processAudioFrames() during a skit with a .jaw envelope: updateJawPosition() from it
+        animator_seek             processAudioFrames() with playback jumping each request: updateSkit() seeking
+        callback                  The whole A2DP callback as TwoSkulls.ino wires it: provideAudioFrames() queueing the
+                                  frames for the animation task during a skit (the task's pass is animator_skit's work)
+    and the portable modules under them on their own:
+        convert_22k_mono          AudioFormatConverter converting mono 22.05kHz to the request's worth of 44.1kHz stereo
+        adpcm_decode              ImaAdpcmDecoder decoding the request's worth of IMA-ADPCM (mono 22.05kHz, 1024 byte
+                                  blocks; the producer's decode path for such files)
+        rms                       AudioLevel::rms(), which is all of calculateRMSFromFrames()
+        rms_double                The RMS as calculateRMSFromFrames() did it before AudioLevel: a double sum and
+                                  sqrt(), which the ESP32 does in software; compare with rms
+
+    The producer, animation and band analysis tasks run one pass at a time between requests, so nothing runs behind a timed call
+    and a producer pass can be timed on its own. The jaw servo and eye LEDs do nothing: their own work happens on
+    other tasks. Serial prints nothing (tools/host), so logging isn't timed.
+
+    The results are CSV on stdout, one line per benchmark and request size:
+        label,benchmark,frames,calls,ns_per_call,ns_per_frame,budget_percent
+    ns_per_call is the median of the timed calls (for the modules, of several timed runs of many calls);
+    budget_percent is that as a share of the time the request's frames take to play (the callback's deadline). Run it
+    with --label set to the commit and append the output to one file to track it over time. Host timings don't carry
+    over to the ESP32, but changes in them usually do.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -pthread -I. -Itools/host tools/audio_benchmark.cpp tools/host/host_platform.cpp \
+            audio_player.cpp sd_card_manager.cpp skull_audio_animator.cpp band_energy_analyzer.cpp \
+            audio_ring_buffer.cpp wav_header_parser.cpp ima_adpcm_decoder.cpp audio_format_converter.cpp \
+            latency_histogram.cpp audio_level.cpp jaw_envelope.cpp skit_script_parser.cpp \
+            skit_line_index.cpp -o audio_benchmark
+
+    Usage:
+        ./audio_benchmark [--label NAME] [--filter TEXT]
+    e.g.
+        ./audio_benchmark --label $(git rev-parse --short HEAD) >> benchmarks.csv
+*/
+
+#include "host_platform.h"
+#include "audio_player.h"
+#include "sd_card_manager.h"
+#include "skull_audio_animator.h"
+#include "audio_format_converter.h"
+#include "ima_adpcm_decoder.h"
+#include "audio_level.h"
+#include "jaw_envelope.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static constexpr uint32_t SAMPLE_RATE = AudioPlayer::AUDIO_SAMPLE_RATE;
+static constexpr int32_t REQUEST_SIZES[] = {128, 256, 512, 1024};
+static constexpr size_t TIMED_CALLS = 2000;                  // Timed requests per benchmark; the median is reported
+static constexpr size_t WARMUP_CALLS = 50;
+static constexpr size_t TRANSITION_FILE_FRAMES = SAMPLE_RATE / 4; // Short enough for many transitions per benchmark
+static constexpr long LOOKBACK_MS = -10;
+static constexpr size_t LOOKBACK_BUFFER_SIZE = 16384;
+static constexpr int SERVO_MIN_DEGREES = 0; // TwoSkulls.ino's defaults
+static constexpr int SERVO_MAX_DEGREES = 80;
+static constexpr unsigned long SKIT_LENGTH_MS = 600000;
+static constexpr int RUNS = 5;                  // Module benchmarks: timed runs; the median is reported
+static constexpr double MIN_RUN_SECONDS = 0.05; // Module benchmarks: each run repeats the call at least this long
+
+using SteadyClock = std::chrono::steady_clock;
+
+// Stops the compiler from dropping work whose result isn't otherwise used
+static volatile uint64_t sink;
+
+// Runs each task on its own thread, but only a pass at a time: step() lets it run to its next wait while the caller
+// waits, and returns how long it ran. Notifications and periods are ignored; the benchmark decides when tasks run.
+class SteppedTasks : public Tasks
+{
+public:
+    ~SteppedTasks() { stop(); }
+
+    // Start a task and run it up to its first wait
+    Handle start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core) override
+    {
+        (void)stackSize;
+        (void)priority;
+        (void)core;
+        m_tasks.emplace_back(new Task());
+        Task *task = m_tasks.back().get();
+        task->name = name;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        task->isRunning = true;
+        task->thread = std::thread([task, entry, param]()
+                                   {
+                                       t_currentTask = task;
+                                       try
+                                       {
+                                           entry(param);
+                                       }
+                                       catch (const Stopped &)
+                                       {
+                                       } });
+        m_changed.wait(lock, [task]()
+                       { return !task->isRunning; });
+        return task;
+    }
+
+    void notify(Handle task) override { (void)task; }
+    void waitForNotification(uint32_t timeoutMs) override
+    {
+        (void)timeoutMs;
+        pause();
+    }
+    void delayUntil(unsigned long &wakeMs, uint32_t periodMs) override
+    {
+        wakeMs += periodMs;
+        pause();
+    }
+
+    // The task started with this name, or nullptr
+    Handle find(const char *name) const
+    {
+        for (const std::unique_ptr<Task> &task : m_tasks)
+        {
+            if (task->name == name)
+            {
+                return task.get();
+            }
+        }
+        return nullptr;
+    }
+
+    // Run a task's next pass, up to its next wait, and return how long it ran in nanoseconds
+    int64_t step(Handle handle)
+    {
+        Task *task = static_cast<Task *>(handle);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        task->isRunning = true;
+        m_changed.notify_all();
+        m_changed.wait(lock, [task]()
+                       { return !task->isRunning; });
+        return task->passNanos;
+    }
+
+    // End every task at its wait
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isStopping = true;
+        }
+        m_changed.notify_all();
+        for (std::unique_ptr<Task> &task : m_tasks)
+        {
+            task->thread.join();
+        }
+        m_tasks.clear();
+    }
+
+private:
+    struct Task
+    {
+        std::string name;
+        std::thread thread;
+        bool isRunning = false;
+        SteadyClock::time_point passStart;
+        int64_t passNanos = 0;
+    };
+
+    // Thrown out of a task's wait to end it
+    struct Stopped
+    {
+    };
+
+    // Called by a task at its wait: hand back to step(), and wait for the next one
+    void pause()
+    {
+        Task *task = t_currentTask;
+        SteadyClock::time_point passEnd = SteadyClock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        task->passNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(passEnd - task->passStart).count();
+        task->isRunning = false;
+        m_changed.notify_all();
+        m_changed.wait(lock, [this, task]()
+                       { return task->isRunning || m_isStopping; });
+        if (m_isStopping)
+        {
+            throw Stopped();
+        }
+        task->passStart = SteadyClock::now();
+    }
+
+    static thread_local Task *t_currentTask;
+
+    std::vector<std::unique_ptr<Task>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    bool m_isStopping = false;
+};
+
+thread_local SteppedTasks::Task *SteppedTasks::t_currentTask = nullptr;
+
+// The jaw and eyes, doing nothing
+class IdleJaw : public JawServo
+{
+public:
+    void setPosition(int degrees) override { (void)degrees; }
+    void followPosition(int degrees) override { (void)degrees; }
+};
+
+class IdleEyes : public EyeLights
+{
+public:
+    void fadeEyeBrightness(uint8_t brightness, uint16_t durationMs) override
+    {
+        (void)brightness;
+        (void)durationMs;
+    }
+};
+
+// Deterministic test signal: speech-like bursts of a few tones, loud enough to open the jaw half the time
+static std::vector<int16_t> makeSignal(size_t frames, uint16_t channels, uint32_t sampleRate)
+{
+    std::vector<int16_t> samples(frames * channels);
+    for (size_t i = 0; i < frames; i++)
+    {
+        double t = static_cast<double>(i) / sampleRate;
+        double envelope = 0.5 + 0.5 * sin(2 * M_PI * 3.0 * t);
+        double value = envelope * (6000 * sin(2 * M_PI * 180 * t) + 3000 * sin(2 * M_PI * 720 * t) + 1500 * sin(2 * M_PI * 2900 * t));
+        for (uint16_t channel = 0; channel < channels; channel++)
+        {
+            samples[i * channels + channel] = static_cast<int16_t>(value);
+        }
+    }
+    return samples;
+}
+
+// Write a 16-bit PCM WAV file (little-endian host)
+static bool writeWav(const std::string &path, const std::vector<int16_t> &samples, uint16_t channels, uint32_t sampleRate)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    uint32_t dataSize = static_cast<uint32_t>(samples.size() * sizeof(int16_t));
+    uint32_t riffSize = 36 + dataSize;
+    uint32_t fmtSize = 16;
+    uint16_t format = 1;
+    uint32_t byteRate = sampleRate * channels * sizeof(int16_t);
+    uint16_t blockAlign = channels * sizeof(int16_t);
+    uint16_t bitsPerSample = 16;
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffSize, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bitsPerSample, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&dataSize, 4, 1, file);
+    bool written = fwrite(samples.data(), sizeof(int16_t), samples.size(), file) == samples.size();
+    return fclose(file) == 0 && written;
+}
+
+// The RMS as SkullAudioAnimator::calculateRMSFromFrames() calculated it before AudioLevel
+static double doubleRms(const int16_t *stereo, int32_t frameCount)
+{
+    double sum = 0.0;
+    for (int32_t i = 0; i < frameCount; i++)
+    {
+        int32_t sample1 = stereo[2 * i];
+        int32_t sample2 = stereo[2 * i + 1];
+        sum += sample1 * sample1;
+        sum += sample2 * sample2;
+    }
+    return sqrt(sum / (frameCount * 2));
+}
+
+// A skit for the audio file: lines alternating between the skulls, a few seconds each, over ten minutes
+static ParsedSkit makeSkit(const String &audioFile)
+{
+    ParsedSkit skit;
+    skit.audioFile = audioFile;
+    unsigned long time = 0;
+    for (size_t line = 0; time < SKIT_LENGTH_MS; line++)
+    {
+        unsigned long duration = 1500 + (line * 7919) % 3000;
+        skit.lines.push_back({line, line % 2 == 0 ? 'A' : 'B', time, duration, -1.0f});
+        time += duration;
+    }
+    return skit;
+}
+
+static std::string s_label;
+static std::string s_filter;
+
+static bool isSelected(const char *name)
+{
+    return s_filter.empty() || strstr(name, s_filter.c_str()) != nullptr;
+}
+
+// Print the median of timed calls
+static void report(const char *name, int32_t frames, std::vector<int64_t> &nanos)
+{
+    if (nanos.empty())
+    {
+        fprintf(stderr, "%s at %d frames: nothing timed\n", name, frames);
+        return;
+    }
+    std::sort(nanos.begin(), nanos.end());
+    double median = static_cast<double>(nanos[nanos.size() / 2]);
+    double deadlineNs = frames * 1e9 / SAMPLE_RATE;
+    printf("%s,%s,%d,%zu,%.1f,%.3f,%.4f\n", s_label.c_str(), name, frames, nanos.size(), median, median / frames,
+           median / deadlineNs * 100);
+    fflush(stdout);
+}
+
+// Time one module benchmark: setup() prepares a run, call() is timed in batches. Prints the median of the runs.
+static void run(const char *name, int32_t frames, const std::function<void()> &setup, const std::function<void()> &call)
+{
+    if (!isSelected(name))
+    {
+        return;
+    }
+
+    // Size the runs to MIN_RUN_SECONDS from a warm-up
+    setup();
+    uint64_t calls = 1;
+    while (true)
+    {
+        SteadyClock::time_point start = SteadyClock::now();
+        for (uint64_t i = 0; i < calls; i++)
+        {
+            call();
+        }
+        double seconds = std::chrono::duration<double>(SteadyClock::now() - start).count();
+        if (seconds >= MIN_RUN_SECONDS / 4)
+        {
+            calls = std::max<uint64_t>(1, static_cast<uint64_t>(calls * MIN_RUN_SECONDS / seconds));
+            break;
+        }
+        calls *= 4;
+    }
+
+    std::vector<double> nsPerCall;
+    for (int r = 0; r < RUNS; r++)
+    {
+        setup();
+        SteadyClock::time_point start = SteadyClock::now();
+        for (uint64_t i = 0; i < calls; i++)
+        {
+            call();
+        }
+        nsPerCall.push_back(std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count() / calls);
+    }
+    std::sort(nsPerCall.begin(), nsPerCall.end());
+    double median = nsPerCall[RUNS / 2];
+    double deadlineNs = frames * 1e9 / SAMPLE_RATE;
+    printf("%s,%s,%d,%llu,%.1f,%.3f,%.4f\n", s_label.c_str(), name, frames, static_cast<unsigned long long>(calls), median,
+           median / frames, median / deadlineNs * 100);
+    fflush(stdout);
+}
+
+// What the player benchmarks' callbacks do: count the files that start, and (for callback) queue the audio for the animation task
+static SkullAudioAnimator *s_animator = nullptr;
+static AudioPlayer *s_player = nullptr;
+static size_t s_fileStarts = 0;
+
+static void onPlaybackStart(uint32_t trackId, const String &filePath)
+{
+    s_fileStarts++;
+    if (s_animator != nullptr)
+    {
+        s_animator->queuePlaybackStarted(trackId, filePath);
+    }
+}
+
+static void onPlaybackEnd(uint32_t trackId, const String &filePath)
+{
+    (void)filePath;
+    if (s_animator != nullptr)
+    {
+        s_animator->queuePlaybackEnded(trackId);
+    }
+}
+
+static void onFramesProvided(uint32_t trackId, const Frame *frames, int32_t frameCount)
+{
+    if (s_animator != nullptr)
+    {
+        s_animator->queueAudioFrames(frames, frameCount, trackId, s_player->getPlaybackTime());
+    }
+}
+
+// A player benchmark: a file played over and over, one request at a time, with the producer refilling between them
+struct PlayerRun
+{
+    const char *file;
+    size_t bufferSize = AudioPlayer::DEFAULT_AUDIO_BUFFER_SIZE;
+    long lookaheadMs = 0;
+    bool withAnimator = false;
+};
+
+// What a player benchmark timed: requests with and without a file transition, and the producer passes after them
+struct PlayerTimes
+{
+    std::vector<int64_t> requests;
+    std::vector<int64_t> transitionRequests;
+    std::vector<int64_t> producerPasses;
+    uint32_t underruns = 0;
+};
+
+static PlayerTimes runPlayer(FileSystem &fileSystem, std::vector<ParsedSkit> &skits, const PlayerRun &setup, int32_t frames)
+{
+    PlayerTimes times;
+    HostClock clock;
+    SteppedTasks tasks;
+    SDCardManager sdCardManager(fileSystem);
+    AudioPlayer player(sdCardManager, clock, tasks, setup.bufferSize);
+    player.setAnalysisLookahead(setup.lookaheadMs);
+    IdleJaw jaw;
+    IdleEyes eyes;
+    SkullAudioAnimator animator(true, jaw, eyes, skits, sdCardManager, clock, tasks, SERVO_MIN_DEGREES, SERVO_MAX_DEGREES);
+    s_player = &player;
+    s_animator = setup.withAnimator ? &animator : nullptr;
+    s_fileStarts = 0;
+    player.setPlaybackStartCallback(onPlaybackStart);
+    player.setPlaybackEndCallback(onPlaybackEnd);
+    player.setAudioFramesProvidedCallback(onFramesProvided);
+    player.begin();
+    animator.begin();
+    Tasks::Handle producer = tasks.find("AudioProducer");
+    Tasks::Handle animation = tasks.find("Animation");
+    Tasks::Handle analysis = tasks.find("BandEnergy");
+
+    // Keep two files queued, so one is always up next
+    size_t filesQueued = 2;
+    player.playNext(setup.file);
+    player.playNext(setup.file);
+    tasks.step(producer);
+
+    std::vector<Frame> request(frames);
+    for (size_t call = 0; call < WARMUP_CALLS + TIMED_CALLS; call++)
+    {
+        size_t fileStarts = s_fileStarts;
+        SteadyClock::time_point start = SteadyClock::now();
+        player.provideAudioFrames(request.data(), frames);
+        int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - start).count();
+        if (call >= WARMUP_CALLS)
+        {
+            (s_fileStarts != fileStarts ? times.transitionRequests : times.requests).push_back(nanos);
+        }
+
+        while (filesQueued < s_fileStarts + 2)
+        {
+            player.playNext(setup.file);
+            filesQueued++;
+        }
+        int64_t passNanos = tasks.step(producer);
+        if (call >= WARMUP_CALLS && s_fileStarts == fileStarts)
+        {
+            times.producerPasses.push_back(passNanos);
+        }
+        tasks.step(animation);
+        tasks.step(analysis);
+        if (call == WARMUP_CALLS - 1)
+        {
+            player.resetBufferStats();
+        }
+    }
+    times.underruns = player.getBufferStats().underrunCount;
+
+    tasks.stop(); // Before the player and animator the tasks run on go
+    s_animator = nullptr;
+    s_player = nullptr;
+    return times;
+}
+
+// Time SkullAudioAnimator::processAudioFrames() on its own, with playback moving on a request at a time (or jumping)
+static std::vector<int64_t> runAnimator(FileSystem &fileSystem, std::vector<ParsedSkit> &skits, const std::vector<int16_t> &stereo,
+                                        int32_t frames, bool isSeeking)
+{
+    std::vector<int64_t> nanos;
+    HostClock clock;
+    SteppedTasks tasks;
+    SDCardManager sdCardManager(fileSystem);
+    IdleJaw jaw;
+    IdleEyes eyes;
+    SkullAudioAnimator animator(true, jaw, eyes, skits, sdCardManager, clock, tasks, SERVO_MIN_DEGREES, SERVO_MAX_DEGREES);
+    animator.begin();
+    Tasks::Handle analysis = tasks.find("BandEnergy");
+
+    const uint32_t trackId = 1;
+    animator.setPlaybackStarted(trackId, skits[0].audioFile);
+    const Frame *audio = reinterpret_cast<const Frame *>(stereo.data());
+    size_t audioFrames = stereo.size() / 2;
+    size_t frameOffset = 0;
+    unsigned long playbackMs = 0;
+    unsigned long requestMs = static_cast<unsigned long>(frames * 1000 / SAMPLE_RATE);
+    uint64_t seekState = 1;
+    for (size_t call = 0; call < WARMUP_CALLS + TIMED_CALLS; call++)
+    {
+        SteadyClock::time_point start = SteadyClock::now();
+        animator.processAudioFrames(audio + frameOffset, frames, trackId, playbackMs);
+        int64_t callNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(SteadyClock::now() - start).count();
+        if (call >= WARMUP_CALLS)
+        {
+            nanos.push_back(callNanos);
+        }
+        tasks.step(analysis);
+
+        frameOffset = (frameOffset + frames) % (audioFrames - frames);
+        if (isSeeking)
+        {
+            seekState = seekState * 6364136223846793005ull + 1442695040888963407ull;
+            playbackMs = static_cast<unsigned long>((seekState >> 33) % SKIT_LENGTH_MS);
+        }
+        else
+        {
+            playbackMs = (playbackMs + requestMs) % SKIT_LENGTH_MS;
+        }
+    }
+
+    tasks.stop(); // Before the animator the tasks run on goes
+    return nanos;
+}
+
+static void warnOfUnderruns(const char *name, int32_t frames, const PlayerTimes &times)
+{
+    if (times.underruns > 0)
+    {
+        fprintf(stderr, "%s at %d frames: %u underruns, so some requests weren't full\n", name, frames, times.underruns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    s_label = "local";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--label") == 0 && i + 1 < argc)
+        {
+            s_label = argv[++i];
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            s_filter = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--label NAME] [--filter TEXT]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Audio at the output format, and at the format the producer commonly converts from
+    std::vector<int16_t> stereo = makeSignal(SAMPLE_RATE * 20, 2, SAMPLE_RATE);
+    std::vector<int16_t> mono22k = makeSignal(SAMPLE_RATE * 10, 1, SAMPLE_RATE / 2);
+    std::vector<int16_t> shortStereo(stereo.begin(), stereo.begin() + TRANSITION_FILE_FRAMES * 2);
+
+    // A stand-in SD card in a temporary folder
+    char folder[] = "/tmp/audio_benchmark.XXXXXX";
+    if (mkdtemp(folder) == nullptr)
+    {
+        fprintf(stderr, "Can't make a temporary folder\n");
+        return 1;
+    }
+    std::string audioFolder = std::string(folder) + "/audio";
+    const char *files[] = {"/audio/speech.wav", "/audio/speech_22k_mono.wav", "/audio/short.wav"};
+    bool written = mkdir(audioFolder.c_str(), 0755) == 0 && writeWav(folder + std::string(files[0]), stereo, 2, SAMPLE_RATE) &&
+                   writeWav(folder + std::string(files[1]), mono22k, 1, SAMPLE_RATE / 2) &&
+                   writeWav(folder + std::string(files[2]), shortStereo, 2, SAMPLE_RATE);
+    HostFileSystem fileSystem(folder);
+
+    // The speech file is a skit, once without a .jaw envelope and once with one
+    std::vector<ParsedSkit> skits = {makeSkit(files[0])};
+    std::vector<ParsedSkit> envelopeSkits = skits;
+    std::vector<uint8_t> levels(SKIT_LENGTH_MS / JawEnvelope::FRAME_DURATION_MS);
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        levels[i] = static_cast<uint8_t>((i * 13) % 256);
+    }
+    std::vector<uint8_t> envelopeFile = JawEnvelope::serialize(levels);
+    std::shared_ptr<JawEnvelope> envelope = std::make_shared<JawEnvelope>();
+    envelope->parse(envelopeFile.data(), envelopeFile.size());
+    envelopeSkits[0].jawEnvelope = envelope;
+
+    // An IMA-ADPCM block. The decoder does the same work whatever the nibbles are, so a pattern stands in for audio.
+    static constexpr uint16_t ADPCM_BLOCK_ALIGN = 1024;
+    std::vector<uint8_t> adpcmBlock(ADPCM_BLOCK_ALIGN);
+    for (size_t i = 4; i < adpcmBlock.size(); i++)
+    {
+        adpcmBlock[i] = static_cast<uint8_t>(i * 37 + 11);
+    }
+    uint32_t adpcmFramesPerBlock = ImaAdpcmDecoder::samplesPerBlock(ADPCM_BLOCK_ALIGN, 1);
+    std::vector<int16_t> adpcmOutput(adpcmFramesPerBlock);
+    std::vector<int16_t> output(2048 * 2);
+
+    if (!written)
+    {
+        fprintf(stderr, "Can't write the audio files to %s\n", folder);
+    }
+
+    printf("label,benchmark,frames,calls,ns_per_call,ns_per_frame,budget_percent\n");
+    for (int32_t frames : REQUEST_SIZES)
+    {
+        if (!written)
+        {
+            break;
+        }
+
+        // Player
+        if (isSelected("provide_frames") || isSelected("fill_buffer"))
+        {
+            PlayerTimes times = runPlayer(fileSystem, skits, {files[0]}, frames);
+            warnOfUnderruns("provide_frames", frames, times);
+            if (isSelected("provide_frames"))
+            {
+                report("provide_frames", frames, times.requests);
+            }
+            if (isSelected("fill_buffer"))
+            {
+                report("fill_buffer", frames, times.producerPasses);
+            }
+        }
+        if (isSelected("provide_frames_lookback"))
+        {
+            PlayerRun lookback = {files[0]};
+            lookback.bufferSize = LOOKBACK_BUFFER_SIZE;
+            lookback.lookaheadMs = LOOKBACK_MS;
+            PlayerTimes times = runPlayer(fileSystem, skits, lookback, frames);
+            warnOfUnderruns("provide_frames_lookback", frames, times);
+            report("provide_frames_lookback", frames, times.requests);
+        }
+        if (isSelected("provide_frames_transition"))
+        {
+            PlayerTimes times = runPlayer(fileSystem, skits, {files[2]}, frames);
+            warnOfUnderruns("provide_frames_transition", frames, times);
+            report("provide_frames_transition", frames, times.transitionRequests);
+        }
+        if (isSelected("fill_buffer_22k_mono"))
+        {
+            PlayerTimes times = runPlayer(fileSystem, skits, {files[1]}, frames);
+            warnOfUnderruns("fill_buffer_22k_mono", frames, times);
+            report("fill_buffer_22k_mono", frames, times.producerPasses);
+        }
+
+        // Animator
+        if (isSelected("animator_skit"))
+        {
+            std::vector<int64_t> nanos = runAnimator(fileSystem, skits, stereo, frames, false);
+            report("animator_skit", frames, nanos);
+        }
+        if (isSelected("animator_envelope"))
+        {
+            std::vector<int64_t> nanos = runAnimator(fileSystem, envelopeSkits, stereo, frames, false);
+            report("animator_envelope", frames, nanos);
+        }
+        if (isSelected("animator_seek"))
+        {
+            std::vector<int64_t> nanos = runAnimator(fileSystem, skits, stereo, frames, true);
+            report("animator_seek", frames, nanos);
+        }
+
+        // The whole callback
+        if (isSelected("callback"))
+        {
+            PlayerRun callback = {files[0]};
+            callback.withAnimator = true;
+            PlayerTimes times = runPlayer(fileSystem, skits, callback, frames);
+            warnOfUnderruns("callback", frames, times);
+            report("callback", frames, times.requests);
+        }
+
+        // Modules: a request's worth of source audio converted or decoded, and the RMS
+        AudioFormatConverter converter;
+        size_t inputFrames = converter.configure(SAMPLE_RATE / 2, 1, SAMPLE_RATE) ? converter.maxInputFrames(frames) : 0;
+        size_t inputOffset = 0;
+        run("convert_22k_mono", frames, [&]()
+            { converter.configure(SAMPLE_RATE / 2, 1, SAMPLE_RATE); inputOffset = 0; }, [&]()
+            {
+                sink += converter.convert(mono22k.data() + inputOffset, inputFrames, output.data(), output.size() / 2);
+                inputOffset = (inputOffset + inputFrames) % (mono22k.size() - inputFrames); });
+
+        double blocksPerRequest = frames / 2.0 / adpcmFramesPerBlock; // Mono 22.05kHz: half as many source frames
+        double blockDebt = 0;
+        run("adpcm_decode", frames, [&]()
+            { blockDebt = 0; }, [&]()
+            {
+                for (blockDebt += blocksPerRequest; blockDebt >= 1; blockDebt--)
+                {
+                    sink += ImaAdpcmDecoder::decodeBlock(adpcmBlock.data(), adpcmBlock.size(), 1, adpcmOutput.data());
+                } });
+
+        size_t frameOffset = 0;
+        run("rms", frames, [&]()
+            { frameOffset = 0; }, [&]()
+            {
+                sink += AudioLevel::rms(reinterpret_cast<const Frame *>(stereo.data()) + frameOffset, frames);
+                frameOffset = (frameOffset + frames) % (stereo.size() / 2 - frames); });
+        run("rms_double", frames, [&]()
+            { frameOffset = 0; }, [&]()
+            {
+                sink += static_cast<uint64_t>(doubleRms(stereo.data() + frameOffset * 2, frames));
+                frameOffset = (frameOffset + frames) % (stereo.size() / 2 - frames); });
+    }
+
+    for (const char *file : files)
+    {
+        unlink((folder + std::string(file)).c_str());
+    }
+    rmdir(audioFolder.c_str());
+    rmdir(folder);
+    return written ? 0 : 1;
+}
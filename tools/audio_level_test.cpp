@@ -0,0 +1,171 @@
+/*
+    Audio Level Test (host-side tool)
+
+    Checks AudioLevel's integer arithmetic is exact:
+      - integerSqrt() is the floor of the square root for every value below 2^24, around perfect squares (k^2 - 1,
+        k^2, k^2 + 1) of random 32-bit roots and of the largest ones, and for random 64-bit values.
+      - sumOfSquares() matches a plain 64-bit sum for every count up to 1030 (so every remainder of the unrolled loop)
+        of random and full-scale samples.
+      - rms() is exactly the floor of the true RMS, and within 1 of the double RMS SkullAudioAnimator used before
+        AudioLevel, for A2DP request sizes of random, quiet and full-scale audio.
+      - rms() of Frames, read from an odd address as A2DP can hand them over, matches rms() of the same samples.
+    Prints each check that failed, then a summary, and exits non-zero if any failed. tools/audio_benchmark.cpp times
+    rms() against that double RMS (the rms and rms_double benchmarks).
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. -Itools/host tools/audio_level_test.cpp audio_level.cpp -o audio_level_test
+
+    Usage:
+        ./audio_level_test
+*/
+
+#include "audio_level.h"
+#include "SoundData.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Whether root is the floor of value's square root, worked out without overflowing
+static bool isFloorSqrt(uint64_t value, uint64_t root)
+{
+    if (root > 0xFFFFFFFFull)
+    {
+        return false;
+    }
+    bool notAbove = root * root <= value;
+    bool nextAbove = root == 0xFFFFFFFFull || (root + 1) * (root + 1) > value; // Only 2^64 is above 2^64 - 1
+    return notAbove && nextAbove;
+}
+
+static void checkIntegerSqrt()
+{
+    bool exhaustive = true;
+    for (uint64_t value = 0; value < (1u << 24); value++)
+    {
+        exhaustive = exhaustive && isFloorSqrt(value, AudioLevel::integerSqrt(value));
+    }
+    check(exhaustive, "integerSqrt() below 2^24", "not the floor of the square root");
+
+    Random random(1);
+    bool squares = true;
+    bool randomValues = true;
+    std::vector<uint64_t> roots = {1, 2, 3, 0xFFFFu, 0x10000u, 0xB504F333u, 0xFFFFFFFEu, 0xFFFFFFFFu};
+    for (int i = 0; i < 1000000; i++)
+    {
+        uint64_t root = random.next() >> (32 + random.next() % 32);
+        roots.push_back(root > 0 ? root : 1);
+    }
+    for (uint64_t root : roots)
+    {
+        uint64_t square = root * root;
+        squares = squares && AudioLevel::integerSqrt(square) == root && isFloorSqrt(square - 1, AudioLevel::integerSqrt(square - 1));
+        if (root < 0xFFFFFFFFull)
+        {
+            squares = squares && AudioLevel::integerSqrt(square + 1) == root;
+        }
+        uint64_t value = random.next() >> (random.next() % 64);
+        randomValues = randomValues && isFloorSqrt(value, AudioLevel::integerSqrt(value));
+    }
+    check(squares, "integerSqrt() around perfect squares", "not the floor of the square root");
+    check(randomValues, "integerSqrt() of random 64-bit values", "not the floor of the square root");
+    check(AudioLevel::integerSqrt(~0ull) == 0xFFFFFFFFu, "integerSqrt(2^64 - 1)", "not 2^32 - 1");
+}
+
+static void checkSumOfSquares()
+{
+    Random random(2);
+    bool randomSums = true;
+    bool fullScaleSums = true;
+    for (size_t count = 0; count <= 1030; count++)
+    {
+        std::vector<int16_t> samples(count);
+        uint64_t expected = 0;
+        for (int16_t &sample : samples)
+        {
+            sample = static_cast<int16_t>(random.next() >> 48);
+            expected += static_cast<uint64_t>(static_cast<int64_t>(sample) * sample);
+        }
+        randomSums = randomSums && AudioLevel::sumOfSquares(samples.data(), count) == expected;
+
+        // -32768 squared is 2^30, the largest square: two of them must still fit the kernel's 32-bit pair sum
+        std::vector<int16_t> fullScale(count, -32768);
+        fullScaleSums = fullScaleSums && AudioLevel::sumOfSquares(fullScale.data(), count) == (static_cast<uint64_t>(count) << 30);
+    }
+    check(randomSums, "sumOfSquares() of random samples, counts 0-1030", "differs from a plain 64-bit sum");
+    check(fullScaleSums, "sumOfSquares() at full scale, counts 0-1030", "differs from count * 2^30");
+}
+
+// The RMS as SkullAudioAnimator::calculateRMSFromFrames() calculated it before AudioLevel
+static double doubleRms(const int16_t *stereo, size_t frameCount)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < frameCount; i++)
+    {
+        int32_t sample1 = stereo[2 * i];
+        int32_t sample2 = stereo[2 * i + 1];
+        sum += sample1 * sample1;
+        sum += sample2 * sample2;
+    }
+    return sqrt(sum / (frameCount * 2));
+}
+
+static void checkRms()
+{
+    const size_t frameCounts[] = {1, 2, 3, 127, 128, 256, 512, 1024};
+    const int amplitudeBits[] = {4, 10, 16}; // Quiet, talking, full scale
+    Random random(3);
+    for (size_t frames : frameCounts)
+    {
+        for (int bits : amplitudeBits)
+        {
+            std::string name = "rms() of " + std::to_string(frames) + " frames, " + std::to_string(bits) + "-bit audio";
+            bool exact = true;
+            bool closeToDouble = true;
+            bool framesMatch = true;
+            for (int trial = 0; trial < 200; trial++)
+            {
+                std::vector<int16_t> stereo(frames * 2);
+                for (int16_t &sample : stereo)
+                {
+                    sample = static_cast<int16_t>(static_cast<int64_t>(random.next() >> 48) - 32768) >> (16 - bits);
+                }
+                uint32_t rms = AudioLevel::rms(stereo.data(), stereo.size());
+
+                // floor(sqrt(sum / n)) is floor(sqrt(floor(sum / n))), so the floored mean square is exact
+                uint64_t sum = 0;
+                for (int16_t sample : stereo)
+                {
+                    sum += static_cast<uint64_t>(static_cast<int64_t>(sample) * sample);
+                }
+                uint64_t meanSquare = sum / stereo.size();
+                exact = exact && isFloorSqrt(meanSquare, rms);
+                closeToDouble = closeToDouble && fabs(doubleRms(stereo.data(), frames) - rms) < 1.0;
+
+                // Frame is packed, so frames one byte into a buffer are as valid as aligned ones
+                std::vector<uint8_t> bytes(1 + frames * sizeof(Frame));
+                memcpy(bytes.data() + 1, stereo.data(), frames * sizeof(Frame));
+                framesMatch = framesMatch && AudioLevel::rms(reinterpret_cast<const Frame *>(bytes.data() + 1), frames) == rms;
+            }
+            check(exact, name, "not the floor of the RMS");
+            check(closeToDouble, name, "1 or more away from the double RMS");
+            check(framesMatch, name, "rms() of the Frames isn't rms() of their samples");
+        }
+    }
+
+    std::vector<int16_t> fullScale(2048, -32768);
+    check(AudioLevel::rms(fullScale.data(), fullScale.size()) == 32768, "rms() at full scale", "not 32768");
+    check(AudioLevel::rms(fullScale.data(), 0) == 0, "rms() of no samples", "not 0");
+    check(AudioLevel::rms(reinterpret_cast<const Frame *>(fullScale.data()), fullScale.size() / 2) == 32768, "rms() of Frames at full scale", "not 32768");
+    check(AudioLevel::rms(reinterpret_cast<const Frame *>(fullScale.data()), 0) == 0, "rms() of no Frames", "not 0");
+}
+
+int main()
+{
+    checkIntegerSqrt();
+    checkSumOfSquares();
+    checkRms();
+    return checkSummary();
+}
@@ -0,0 +1,385 @@
+/*
+    Audio Player Test (host-side tool)
+
+    Runs the skulls' own AudioPlayer, SDCardManager and SkullAudioAnimator on the host platform (tools/host) against a
+    copy of the SD card, with the producer and band analysis tasks on threads:
+      - SDCardManager finds the init files and every skit with a script, with the lines the script gives.
+      - The card's 44.1kHz 16-bit stereo PCM files, played back to back through AudioPlayer for a consumer asking for
+        random A2DP request sizes (128 - 1024 frames), come out exactly as they are in the files, with nothing between
+        them, no underruns, and each file's start and end callbacks in order. (Other formats go through the ADPCM
+        decoder and format converter, which have their own tests.)
+      - A Primary and a Secondary SkullAudioAnimator, driven from the player's callbacks as TwoSkulls.ino drives them,
+        speak exactly while one of their own skit lines plays and all through other files, keep the jaw within its
+        range, and dim the eyes once playback ends.
+    The consumer waits for the producer to buffer each request before asking for it, as A2DP's pace leaves it time
+    to, so the results don't depend on how the host schedules the threads.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -pthread -I. -Itools/host tools/audio_player_test.cpp tools/host/host_platform.cpp \
+            audio_player.cpp sd_card_manager.cpp skull_audio_animator.cpp band_energy_analyzer.cpp \
+            audio_ring_buffer.cpp wav_header_parser.cpp ima_adpcm_decoder.cpp audio_format_converter.cpp \
+            latency_histogram.cpp audio_level.cpp jaw_envelope.cpp skit_script_parser.cpp \
+            skit_line_index.cpp -o audio_player_test
+
+    Usage:
+        ./audio_player_test [SD card folder]     (default: sd_card_files)
+*/
+
+#include "host_platform.h"
+#include "audio_player.h"
+#include "sd_card_manager.h"
+#include "skull_audio_animator.h"
+#include "skit_script_parser.h"
+#include "wav_header_parser.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static constexpr int SERVO_MIN_DEGREES = 0; // TwoSkulls.ino's defaults
+static constexpr int SERVO_MAX_DEGREES = 80;
+static constexpr int64_t PRODUCER_TIMEOUT_MICROS = 5000000;
+
+// Records what the animator asks of the jaw
+class RecordingJaw : public JawServo
+{
+public:
+    void setPosition(int degrees) override { record(degrees); }
+    void followPosition(int degrees) override { record(degrees); }
+
+    int minPosition = SERVO_MAX_DEGREES + 1;
+    int maxPosition = SERVO_MIN_DEGREES - 1;
+
+private:
+    void record(int degrees)
+    {
+        minPosition = std::min(minPosition, degrees);
+        maxPosition = std::max(maxPosition, degrees);
+    }
+};
+
+// Records what the animator asks of the eyes
+class RecordingEyes : public EyeLights
+{
+public:
+    void fadeEyeBrightness(uint8_t brightness, uint16_t durationMs) override
+    {
+        (void)durationMs;
+        minBrightness = std::min(minBrightness, brightness);
+        lastBrightness = brightness;
+    }
+
+    uint8_t minBrightness = BRIGHTNESS_MAX;
+    uint8_t lastBrightness = BRIGHTNESS_OFF;
+};
+
+// A 44.1kHz stereo PCM file from the card, and what it should sound like
+struct Track
+{
+    std::string path;
+    std::vector<uint8_t> data;             // The file's audio
+    std::vector<ParsedSkitLine> lines;     // Its skit's lines, if it's a skit
+    bool isSkit = false;
+    uint32_t trackId = AudioPlayer::NO_TRACK;
+    size_t speakingMismatches[2] = {0, 0}; // Callbacks where the Primary, Secondary spoke when it shouldn't or vice versa
+};
+
+// What the player's callbacks saw
+struct Event
+{
+    bool isStart;
+    uint32_t trackId;
+    std::string path;
+};
+
+static AudioPlayer *s_player = nullptr;
+static SkullAudioAnimator *s_animators[2] = {nullptr, nullptr}; // Primary, Secondary
+static std::vector<Track> s_tracks;
+static std::vector<Event> s_events;
+
+// The track a callback's track ID is, or nullptr
+static Track *findTrack(uint32_t trackId)
+{
+    for (Track &track : s_tracks)
+    {
+        if (track.trackId == trackId && trackId != AudioPlayer::NO_TRACK)
+        {
+            return &track;
+        }
+    }
+    return nullptr;
+}
+
+// Whether a skull should be speaking at a playback time of a track
+static bool shouldSpeak(const Track *track, char speaker, unsigned long playbackTime)
+{
+    if (track == nullptr)
+    {
+        return false;
+    }
+    if (!track->isSkit)
+    {
+        return true;
+    }
+    for (const ParsedSkitLine &line : track->lines)
+    {
+        if (line.speaker == speaker && line.timestamp <= playbackTime && playbackTime < line.timestamp + line.duration)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The callbacks, wired as TwoSkulls.ino wires them (for both skulls at once)
+static void onPlaybackStart(uint32_t trackId, const String &filePath)
+{
+    s_events.push_back({true, trackId, filePath});
+    for (SkullAudioAnimator *animator : s_animators)
+    {
+        animator->setPlaybackStarted(trackId, filePath);
+    }
+}
+
+static void onPlaybackEnd(uint32_t trackId, const String &filePath)
+{
+    s_events.push_back({false, trackId, filePath});
+    for (SkullAudioAnimator *animator : s_animators)
+    {
+        animator->setPlaybackEnded(filePath);
+    }
+}
+
+static void onFramesProvided(uint32_t trackId, const Frame *frames, int32_t frameCount)
+{
+    unsigned long playbackTime = s_player->getPlaybackTime();
+    Track *track = findTrack(trackId);
+    for (int skull = 0; skull < 2; skull++)
+    {
+        s_animators[skull]->processAudioFrames(frames, frameCount, trackId, playbackTime);
+        if (track != nullptr && s_animators[skull]->isCurrentlySpeaking() != shouldSpeak(track, skull == 0 ? 'A' : 'B', playbackTime))
+        {
+            track->speakingMismatches[skull]++;
+        }
+    }
+}
+
+// Read the audio of every 44.1kHz 16-bit stereo PCM file on the card, in path order
+static void loadTracks(FileSystem &fileSystem, const SDCardContent &content)
+{
+    std::vector<std::string> names;
+    fileSystem.listFiles("/audio", names);
+    std::sort(names.begin(), names.end());
+    for (const std::string &name : names)
+    {
+        if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".wav") != 0)
+        {
+            continue;
+        }
+
+        Track track;
+        track.path = "/audio/" + name;
+        std::unique_ptr<PlatformFile> file = fileSystem.open(track.path.c_str());
+        std::vector<uint8_t> bytes(file->size());
+        bytes.resize(file->read(bytes.data(), bytes.size()));
+
+        struct MemorySource : public WavByteSource
+        {
+            const std::vector<uint8_t> &bytes;
+            size_t position = 0;
+            explicit MemorySource(const std::vector<uint8_t> &source) : bytes(source) {}
+            size_t read(uint8_t *buffer, size_t size) override
+            {
+                size = std::min(size, bytes.size() - position);
+                memcpy(buffer, bytes.data() + position, size);
+                position += size;
+                return size;
+            }
+            bool skip(uint32_t size) override
+            {
+                position = std::min(bytes.size(), position + size);
+                return position < bytes.size();
+            }
+        } source(bytes);
+        WavFormat format;
+        if (WavHeaderParser::parse(source, static_cast<uint32_t>(bytes.size()), format) != WavParseResult::OK ||
+            format.audioFormat != WavHeaderParser::FORMAT_PCM || format.sampleRate != AudioPlayer::AUDIO_SAMPLE_RATE ||
+            format.numChannels != AudioPlayer::AUDIO_NUM_CHANNELS || format.bitsPerSample != AudioPlayer::AUDIO_BIT_DEPTH)
+        {
+            continue;
+        }
+        track.data.assign(bytes.begin() + format.dataOffset, bytes.begin() + format.dataOffset + format.dataSize);
+
+        for (const ParsedSkit &skit : content.skits)
+        {
+            if (track.path == skit.audioFile)
+            {
+                track.isSkit = true;
+                track.lines = skit.lines;
+            }
+        }
+        s_tracks.push_back(track);
+    }
+}
+
+static void checkContent(FileSystem &fileSystem, const SDCardContent &content)
+{
+    check(content.primaryInitAudio == "/audio/Initialized - Primary.wav" && content.secondaryInitAudio == "/audio/Initialized - Secondary.wav",
+          "loadContent()", "didn't find the init files");
+
+    // Every Skit*.wav is an audio file, and a skit if it has a script
+    std::vector<std::string> names;
+    fileSystem.listFiles("/audio", names);
+    size_t skitFiles = 0;
+    size_t scripts = 0;
+    for (const std::string &name : names)
+    {
+        if (name.compare(0, 4, "Skit") != 0 || name.size() <= 4 || name.compare(name.size() - 4, 4, ".wav") != 0)
+        {
+            continue;
+        }
+        skitFiles++;
+        std::string base = "/audio/" + name.substr(0, name.size() - 4);
+        std::unique_ptr<PlatformFile> script = fileSystem.open((base + ".txt").c_str());
+        if (script == nullptr)
+        {
+            continue;
+        }
+        scripts++;
+        std::string text(script->size(), '\0');
+        text.resize(script->read(reinterpret_cast<uint8_t *>(&text[0]), text.size()));
+        std::vector<ParsedSkitLine> expected = SkitScriptParser::parse(text);
+
+        const ParsedSkit *found = nullptr;
+        for (const ParsedSkit &skit : content.skits)
+        {
+            found = skit.audioFile == base + ".wav" ? &skit : found;
+        }
+        check(found != nullptr && found->txtFile == base + ".txt", name, "skit not loaded");
+        if (found != nullptr)
+        {
+            bool same = found->lines.size() == expected.size();
+            for (size_t i = 0; same && i < expected.size(); i++)
+            {
+                same = found->lines[i].speaker == expected[i].speaker && found->lines[i].timestamp == expected[i].timestamp &&
+                       found->lines[i].duration == expected[i].duration;
+            }
+            check(same, name, "skit lines differ from its script");
+        }
+    }
+    check(content.audioFiles.size() == skitFiles, "loadContent()", "audio files aren't the card's Skit*.wav files");
+    check(content.skits.size() == scripts, "loadContent()", "skits aren't the Skit*.wav files with a script");
+}
+
+// Play every track back to back, pulling random request sizes as soon as the producer has buffered them
+static void checkPlayback(HostClock &clock)
+{
+    size_t totalBytes = 0;
+    for (const Track &track : s_tracks)
+    {
+        totalBytes += track.data.size();
+    }
+
+    Random random(1);
+    std::vector<uint8_t> output;
+    std::vector<Frame> request(1024);
+    bool stalled = false;
+    bool paddedWithSilence = true;
+    size_t queued = 0;
+    while ((output.size() < totalBytes || s_events.size() < 2 * s_tracks.size()) && !stalled)
+    {
+        // Queue the next file once the one before starts, as the skit task does
+        if (queued < s_tracks.size() && s_events.size() >= 2 * queued - (queued > 0 ? 1 : 0))
+        {
+            s_tracks[queued].trackId = s_player->playNext(s_tracks[queued].path.c_str());
+            queued++;
+        }
+
+        int32_t frames = 128 + static_cast<int32_t>(random.below(897));
+        size_t needed = std::min(frames * sizeof(Frame), totalBytes - output.size());
+        int64_t waitStart = clock.micros();
+        while (s_player->getBufferStats().currentFill < needed && !stalled)
+        {
+            stalled = clock.micros() - waitStart > PRODUCER_TIMEOUT_MICROS;
+        }
+        if (needed == 0 && clock.micros() - waitStart > PRODUCER_TIMEOUT_MICROS)
+        {
+            stalled = true;
+        }
+
+        int32_t provided = s_player->provideAudioFrames(request.data(), frames);
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(request.data());
+        size_t providedBytes = static_cast<size_t>(provided) * sizeof(Frame);
+        size_t audioBytes = std::min(providedBytes, totalBytes - output.size());
+        output.insert(output.end(), bytes, bytes + audioBytes);
+        paddedWithSilence = paddedWithSilence && std::all_of(bytes + audioBytes, bytes + providedBytes, [](uint8_t b)
+                                                             { return b == 0; });
+    }
+    check(!stalled, "playback", "producer stopped buffering");
+    check(paddedWithSilence, "playback", "didn't pad past the last file with silence");
+    check(s_player->getBufferStats().underrunCount == 0, "playback", "underran");
+
+    size_t offset = 0;
+    for (size_t i = 0; i < s_tracks.size(); i++)
+    {
+        const Track &track = s_tracks[i];
+        bool same = offset + track.data.size() <= output.size() &&
+                    std::equal(track.data.begin(), track.data.end(), output.begin() + offset);
+        check(same, track.path, "didn't play exactly as in the file");
+        offset += track.data.size();
+
+        bool callbacks = s_events.size() >= 2 * (i + 1) && s_events[2 * i].isStart && !s_events[2 * i + 1].isStart;
+        for (size_t e = 2 * i; callbacks && e < 2 * i + 2; e++)
+        {
+            callbacks = s_events[e].trackId == track.trackId && s_events[e].path == track.path;
+        }
+        check(callbacks, track.path, "start and end callbacks out of order or for the wrong track");
+        check(track.speakingMismatches[0] == 0, track.path, "Primary didn't speak exactly during its lines");
+        check(track.speakingMismatches[1] == 0, track.path, "Secondary didn't speak exactly during its lines");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    HostFileSystem fileSystem(argc > 1 ? argv[1] : "sd_card_files");
+    HostClock clock;
+    HostTasks tasks(clock);
+
+    SDCardManager sdCardManager(fileSystem);
+    check(sdCardManager.begin(), "SD card folder", "can't open it");
+    SDCardContent content = sdCardManager.loadContent();
+    checkContent(fileSystem, content);
+    loadTracks(fileSystem, content);
+    check(!s_tracks.empty(), "SD card folder", "no 44.1kHz 16-bit stereo PCM files in /audio");
+
+    AudioPlayer player(sdCardManager, clock, tasks);
+    RecordingJaw jaws[2];
+    RecordingEyes eyes[2];
+    SkullAudioAnimator primary(true, jaws[0], eyes[0], content.skits, sdCardManager, clock, tasks, SERVO_MIN_DEGREES, SERVO_MAX_DEGREES);
+    SkullAudioAnimator secondary(false, jaws[1], eyes[1], content.skits, sdCardManager, clock, tasks, SERVO_MIN_DEGREES, SERVO_MAX_DEGREES);
+    s_player = &player;
+    s_animators[0] = &primary;
+    s_animators[1] = &secondary;
+    player.setPlaybackStartCallback(onPlaybackStart);
+    player.setPlaybackEndCallback(onPlaybackEnd);
+    player.setAudioFramesProvidedCallback(onFramesProvided);
+    player.begin();
+    primary.begin();
+    secondary.begin();
+
+    checkPlayback(clock);
+    for (int skull = 0; skull < 2; skull++)
+    {
+        std::string name = skull == 0 ? "Primary" : "Secondary";
+        check(jaws[skull].minPosition >= SERVO_MIN_DEGREES && jaws[skull].maxPosition <= SERVO_MAX_DEGREES, name, "jaw left its range");
+        check(jaws[skull].maxPosition > SERVO_MIN_DEGREES, name, "jaw never opened");
+        check(eyes[skull].minBrightness >= EyeLights::BRIGHTNESS_DIM, name, "eyes went below dim");
+        check(eyes[skull].lastBrightness == EyeLights::BRIGHTNESS_DIM, name, "eyes not dimmed after playback");
+    }
+
+    tasks.stop(); // Before the player and animators the tasks run on go
+    return checkSummary();
+}
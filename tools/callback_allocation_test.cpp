@@ -0,0 +1,262 @@
+/*
+    Callback Allocation Test (host-side tool)
+
+    Counts the heap allocations the A2DP callback makes. Plays the SD card's init file and skits through the skulls' own
+    AudioPlayer and SkullAudioAnimator on the host platform (tools/host), wired up as TwoSkulls.ino wires them (the start
+    and end callbacks queueing the audio and tracks for the animation task, the ended skits handed to the skit task's
+    play counts, and the speaking state muting the player), and counts every operator new on the thread calling
+    provideAudioFrames(): the copy out of the ring buffer, the file transitions, the queueing, and Serial's formatting
+    (which tools/host does as the ESP32 does, on the heap past 64 bytes).
+    Runs as the Primary and the Secondary, with and without a jaw lookahead. The producer, animation and band analysis
+    tasks run on their own threads and aren't counted.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -pthread -I. -Itools/host tools/callback_allocation_test.cpp tools/host/host_platform.cpp \
+            audio_player.cpp sd_card_manager.cpp skull_audio_animator.cpp band_energy_analyzer.cpp skit_selector.cpp \
+            audio_ring_buffer.cpp wav_header_parser.cpp ima_adpcm_decoder.cpp audio_format_converter.cpp \
+            latency_histogram.cpp audio_level.cpp jaw_envelope.cpp skit_script_parser.cpp \
+            skit_line_index.cpp -o callback_allocation_test
+
+    Usage:
+        ./callback_allocation_test [SD card folder]     (default: sd_card_files)
+*/
+
+#include "host_platform.h"
+#include "audio_player.h"
+#include "sd_card_manager.h"
+#include "skull_audio_animator.h"
+#include "skit_selector.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <string>
+#include <vector>
+
+static constexpr int SERVO_MIN_DEGREES = 0; // TwoSkulls.ino's defaults
+static constexpr int SERVO_MAX_DEGREES = 80;
+static constexpr long JAW_LOOKAHEAD_MS = 150;
+static constexpr int64_t PRODUCER_TIMEOUT_MICROS = 5000000;
+
+// Allocations on this thread while counting
+static thread_local bool t_counting = false;
+static thread_local size_t t_allocations = 0;
+
+void *operator new(size_t size)
+{
+    if (t_counting)
+    {
+        t_allocations++;
+    }
+    void *memory = malloc(size != 0 ? size : 1);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    if (t_counting)
+    {
+        t_allocations++;
+    }
+    return malloc(size != 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// Not inlined, or GCC warns that what operator new returned is passed to free()
+__attribute__((noinline)) void operator delete(void *memory) noexcept { free(memory); }
+__attribute__((noinline)) void operator delete[](void *memory) noexcept { free(memory); }
+__attribute__((noinline)) void operator delete(void *memory, size_t) noexcept { free(memory); }
+__attribute__((noinline)) void operator delete[](void *memory, size_t) noexcept { free(memory); }
+
+// The jaw and eyes, doing nothing
+class IdleJaw : public JawServo
+{
+public:
+    void setPosition(int degrees) override { (void)degrees; }
+    void followPosition(int degrees) override { (void)degrees; }
+};
+
+class IdleEyes : public EyeLights
+{
+public:
+    void fadeEyeBrightness(uint8_t brightness, uint16_t durationMs) override
+    {
+        (void)brightness;
+        (void)durationMs;
+    }
+};
+
+// What one run saw
+struct RunResult
+{
+    size_t callbacks = 0;
+    size_t allocations = 0;
+    size_t allocatingCallbacks = 0;
+    size_t fileEnds = 0;
+    size_t speakingStarts = 0;
+    bool stalled = false;
+};
+
+// The skull's objects, for the callbacks (as TwoSkulls.ino's globals)
+static AudioPlayer *s_player = nullptr;
+static SkullAudioAnimator *s_animator = nullptr;
+static const std::vector<ParsedSkit> *s_skits = nullptr;
+static RunResult *s_result = nullptr;
+
+// The skit whose audio just ended, for the main thread to count (TwoSkulls.ino's PLAYBACK_ENDED skit event)
+static constexpr size_t NO_SKIT = static_cast<size_t>(-1);
+static size_t s_endedSkitIndex = NO_SKIT;
+
+static void onPlaybackStart(uint32_t trackId, const String &filePath)
+{
+    s_animator->queuePlaybackStarted(trackId, filePath);
+}
+
+static void onPlaybackEnd(uint32_t trackId, const String &filePath)
+{
+    s_result->fileEnds++;
+    s_animator->queuePlaybackEnded(trackId);
+    for (size_t i = 0; i < s_skits->size(); i++)
+    {
+        if ((*s_skits)[i].audioFile == filePath)
+        {
+            s_endedSkitIndex = i;
+            break;
+        }
+    }
+}
+
+static void onFramesProvided(uint32_t trackId, const Frame *frames, int32_t frameCount)
+{
+    unsigned long playbackTime = s_player->getPlaybackTime();
+    s_animator->queueAudioFrames(frames, frameCount, trackId, playbackTime);
+}
+
+// On the animation task
+static void onSpeakingStateChange(bool isSpeaking)
+{
+    s_result->speakingStarts += isSpeaking ? 1 : 0;
+    s_player->setMuted(!isSpeaking);
+}
+
+// Play the files through one skull, counting the allocations in each A2DP request
+static RunResult run(bool isPrimary, long jawLookaheadMs, FileSystem &fileSystem, const std::vector<String> &files)
+{
+    RunResult result;
+    HostClock clock;
+    HostTasks tasks(clock);
+    SDCardManager sdCardManager(fileSystem);
+    sdCardManager.begin();
+    SDCardContent content = sdCardManager.loadContent();
+    std::vector<std::string> skitAudioFiles;
+    for (const ParsedSkit &skit : content.skits)
+    {
+        skitAudioFiles.push_back(skit.audioFile);
+    }
+    SkitSelector skitSelector(skitAudioFiles);
+
+    AudioPlayer player(sdCardManager, clock, tasks);
+    player.setAnalysisLookahead(jawLookaheadMs);
+    IdleJaw jaw;
+    IdleEyes eyes;
+    SkullAudioAnimator animator(isPrimary, jaw, eyes, content.skits, sdCardManager, clock, tasks, SERVO_MIN_DEGREES, SERVO_MAX_DEGREES);
+    s_player = &player;
+    s_animator = &animator;
+    s_skits = &content.skits;
+    s_result = &result;
+    player.setPlaybackStartCallback(onPlaybackStart);
+    player.setPlaybackEndCallback(onPlaybackEnd);
+    player.setAudioFramesProvidedCallback(onFramesProvided);
+    animator.setSpeakingStateCallback(onSpeakingStateChange);
+    animator.setJawLookahead(jawLookaheadMs);
+    player.begin();
+    animator.begin();
+    for (const String &file : files)
+    {
+        player.playNext(file);
+    }
+
+    // Ask for random A2DP request sizes once the producer has buffered them, until every file has ended
+    Random random(isPrimary ? 1 : 2);
+    std::vector<Frame> request(1024);
+    while (result.fileEnds < files.size() && !result.stalled)
+    {
+        int32_t frames = 128 + static_cast<int32_t>(random.below(897));
+        int64_t waitStart = clock.micros();
+        while (player.getBufferStats().currentFill < frames * sizeof(Frame) && !result.stalled)
+        {
+            // The end of the last file never fills a request
+            if (clock.micros() - waitStart > PRODUCER_TIMEOUT_MICROS / 10 && player.getBufferStats().currentFill > 0)
+            {
+                break;
+            }
+            result.stalled = clock.micros() - waitStart > PRODUCER_TIMEOUT_MICROS;
+        }
+
+        t_allocations = 0;
+        t_counting = true;
+        player.provideAudioFrames(request.data(), frames);
+        t_counting = false;
+        result.callbacks++;
+        result.allocations += t_allocations;
+        result.allocatingCallbacks += t_allocations > 0 ? 1 : 0;
+
+        // The skit task's side of the skit event
+        if (s_endedSkitIndex != NO_SKIT)
+        {
+            skitSelector.updateSkitPlayCount(content.skits[s_endedSkitIndex].audioFile.c_str(), clock.millis());
+            s_endedSkitIndex = NO_SKIT;
+        }
+    }
+
+    tasks.stop(); // Before the player and animator the tasks run on go
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    HostFileSystem fileSystem(argc > 1 ? argv[1] : "sd_card_files");
+    SDCardManager sdCardManager(fileSystem);
+    check(sdCardManager.begin(), "SD card folder", "can't open it");
+    SDCardContent content = sdCardManager.loadContent();
+    check(!content.skits.empty(), "SD card folder", "no skits");
+
+    for (int skull = 0; skull < 2; skull++)
+    {
+        bool isPrimary = skull == 0;
+        std::vector<String> files;
+        files.push_back(isPrimary ? content.primaryInitAudio : content.secondaryInitAudio);
+        for (const ParsedSkit &skit : content.skits)
+        {
+            files.push_back(skit.audioFile);
+        }
+
+        for (long jawLookaheadMs : {0L, JAW_LOOKAHEAD_MS})
+        {
+            RunResult result = run(isPrimary, jawLookaheadMs, fileSystem, files);
+            std::string name = std::string(isPrimary ? "Primary" : "Secondary") + ", jaw lookahead " + std::to_string(jawLookaheadMs) + " ms";
+            printf("%s: %zu callbacks, started speaking %zu times, %zu allocations in %zu callbacks\n", name.c_str(),
+                   result.callbacks, result.speakingStarts, result.allocations, result.allocatingCallbacks);
+            check(!result.stalled, name, "producer stopped buffering");
+            check(result.fileEnds == files.size(), name, "not every file ended");
+            check(result.speakingStarts > 1, name, "didn't speak through the init file and skit lines");
+            check(result.allocations == 0, name, "the A2DP callback allocated");
+        }
+    }
+
+    return checkSummary();
+}
@@ -0,0 +1,178 @@
+/*
+    Clock Sync Test (host-side tool)
+
+    Runs ClockSyncEstimator against simulated BLE links and checks it the way the Secondary uses it: after every
+    exchange, and every 100ms in between, the estimate of the Primary's clock must be within the uncertainty it
+    reports, and the measured drift within MAX_DRIFT_ERROR_PPM of the true one.
+
+    The links are built like the real one. The Secondary pings from its 10ms BLE task; the ping leaves at the next
+    connection event. The Primary stamps its arrival in the notify callback, answers from its own 10ms task, and the
+    pong leaves at the next connection event after that. Each packet is resent at the following event while it's
+    lost, and each callback stamps its packet up to STAMP_LATENCY_MICROS late. The clocks run from different boot
+    times with their own crystal errors. Every combination of connection interval, drift and seed is run, with the
+    connection interval given to the estimator as the Secondary does. Prints one line per link, then each that failed
+    and a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/clock_sync_test.cpp clock_sync_estimator.cpp -o clock_sync_test
+
+    Usage:
+        ./clock_sync_test
+*/
+
+#include "clock_sync_estimator.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+static constexpr int64_t DURATION_MICROS = 600000000;       // Each link runs for 10 minutes
+static constexpr int64_t TASK_INTERVAL_MICROS = 10000;      // BLE task period on both skulls
+static constexpr int64_t PING_FAST_INTERVAL_MICROS = 200000; // bluetooth_controller::CLOCK_SYNC_FAST_INTERVAL
+static constexpr int64_t PING_INTERVAL_MICROS = 1000000;     // bluetooth_controller::CLOCK_SYNC_INTERVAL
+static constexpr int64_t CHECK_INTERVAL_MICROS = 100000;
+static constexpr int64_t STAMP_LATENCY_MICROS = 500;
+static constexpr double LOSS_RATE = 0.15;
+static constexpr double MAX_DRIFT_ERROR_PPM = 5.0;
+
+// A skull's esp_timer clock: a boot time and a crystal error against true time
+struct Clock
+{
+    int64_t bootMicros;
+    double ppm;
+
+    int64_t at(int64_t trueMicros) const
+    {
+        return static_cast<int64_t>(llround((trueMicros - bootMicros) * (1.0 + ppm * 1e-6)));
+    }
+};
+
+// The BLE link: connection events every interval from phase, in true time
+struct Link
+{
+    int64_t intervalMicros;
+    int64_t phaseMicros;
+
+    // When a packet queued at trueMicros reaches the other side: the next connection event, one more per loss
+    int64_t deliver(int64_t trueMicros, Random &random) const
+    {
+        int64_t events = (trueMicros - phaseMicros) / intervalMicros + 1;
+        int64_t deliveryMicros = phaseMicros + events * intervalMicros;
+        while (random.uniform() < LOSS_RATE)
+        {
+            deliveryMicros += intervalMicros;
+        }
+        return deliveryMicros;
+    }
+};
+
+// The next tick of a task that runs every TASK_INTERVAL_MICROS from phase, at or after trueMicros
+static int64_t nextTaskTick(int64_t trueMicros, int64_t phaseMicros)
+{
+    int64_t ticks = (trueMicros - phaseMicros + TASK_INTERVAL_MICROS - 1) / TASK_INTERVAL_MICROS;
+    return phaseMicros + ticks * TASK_INTERVAL_MICROS;
+}
+
+struct LinkResult
+{
+    bool passed;
+    double rmsErrorMicros;
+    int64_t maxErrorMicros;
+    double worstErrorRatio; // Largest error / uncertainty
+    int64_t finalUncertaintyMicros;
+    double driftPpm;
+    double trueDriftPpm;
+};
+
+// Run one link and check the estimate throughout
+static LinkResult runLink(int64_t intervalMicros, double secondaryPpm, uint64_t seed)
+{
+    Random random(seed);
+    Clock primary = {-static_cast<int64_t>(random.below(5000000)), random.uniform() * 20.0 - 10.0};
+    Clock secondary = {-static_cast<int64_t>(random.below(5000000)), primary.ppm + secondaryPpm};
+    Link link = {intervalMicros, random.below(intervalMicros)};
+    int64_t primaryTaskPhase = random.below(TASK_INTERVAL_MICROS);
+    int64_t secondaryTaskPhase = random.below(TASK_INTERVAL_MICROS);
+
+    ClockSyncEstimator estimator;
+    estimator.setConnectionInterval(intervalMicros);
+
+    LinkResult result = {true, 0.0, 0, 0.0, 0, 0.0, 0.0};
+    double sumSquares = 0.0;
+    size_t checks = 0;
+    int64_t nextPing = nextTaskTick(0, secondaryTaskPhase);
+    int64_t nextCheck = 0;
+    while (nextPing < DURATION_MICROS)
+    {
+        // One exchange, in true time
+        int64_t pingSent = nextPing;
+        int64_t pingArrived = link.deliver(pingSent, random);
+        int64_t pingStamped = pingArrived + random.below(STAMP_LATENCY_MICROS);
+        int64_t pongSent = nextTaskTick(pingStamped, primaryTaskPhase);
+        int64_t pongArrived = link.deliver(std::max(pongSent, pingArrived), random);
+        int64_t pongStamped = pongArrived + random.below(STAMP_LATENCY_MICROS);
+
+        // Check the estimate up to the pong, then add the exchange and check it again
+        for (; nextCheck < pongStamped; nextCheck += CHECK_INTERVAL_MICROS)
+        {
+            if (!estimator.isSynchronized())
+            {
+                continue;
+            }
+            int64_t local = secondary.at(nextCheck);
+            int64_t error = estimator.toRemote(local) - primary.at(nextCheck);
+            int64_t uncertainty = estimator.uncertaintyMicros(local);
+            sumSquares += static_cast<double>(error) * static_cast<double>(error);
+            checks++;
+            result.maxErrorMicros = std::max<int64_t>(result.maxErrorMicros, llabs(error));
+            result.worstErrorRatio = std::max(result.worstErrorRatio, static_cast<double>(llabs(error)) / static_cast<double>(uncertainty));
+            if (llabs(error) > uncertainty)
+            {
+                result.passed = false;
+            }
+        }
+        estimator.addSample(secondary.at(pingSent), primary.at(pingStamped), primary.at(pongSent), secondary.at(pongStamped));
+
+        int64_t interval = estimator.isSynchronized() ? PING_INTERVAL_MICROS : PING_FAST_INTERVAL_MICROS;
+        nextPing = nextTaskTick(std::max(pingSent + interval, pongStamped), secondaryTaskPhase);
+    }
+
+    result.rmsErrorMicros = checks > 0 ? sqrt(sumSquares / checks) : 0.0;
+    result.finalUncertaintyMicros = estimator.uncertaintyMicros(secondary.at(DURATION_MICROS));
+    result.driftPpm = estimator.driftPpm();
+    result.trueDriftPpm = ((1.0 + primary.ppm * 1e-6) / (1.0 + secondary.ppm * 1e-6) - 1.0) * 1e6;
+    if (checks == 0 || fabs(result.driftPpm - result.trueDriftPpm) > MAX_DRIFT_ERROR_PPM)
+    {
+        result.passed = false;
+    }
+    return result;
+}
+
+int main()
+{
+    const int64_t intervals[] = {7500, 15000, 30000, 50000};
+    const double drifts[] = {-40.0, -25.0, 0.0, 25.0, 40.0};
+    const uint64_t seeds[] = {1, 2, 3};
+
+    printf("interval_ms,drift_ppm,seed,rms_error_us,max_error_us,worst_error_to_uncertainty,final_uncertainty_us,"
+           "measured_drift_ppm,true_drift_ppm,result\n");
+    for (int64_t interval : intervals)
+    {
+        for (double drift : drifts)
+        {
+            for (uint64_t seed : seeds)
+            {
+                LinkResult result = runLink(interval, drift, seed);
+                printf("%.1f,%.0f,%llu,%.0f,%lld,%.2f,%lld,%.1f,%.1f,%s\n", interval / 1000.0, drift,
+                       static_cast<unsigned long long>(seed), result.rmsErrorMicros, static_cast<long long>(result.maxErrorMicros),
+                       result.worstErrorRatio, static_cast<long long>(result.finalUncertaintyMicros), result.driftPpm,
+                       result.trueDriftPpm, result.passed ? "ok" : "FAILED");
+                check(result.passed, std::to_string(interval) + " us link, " + std::to_string(static_cast<int>(drift)) +
+                                         " ppm, seed " + std::to_string(seed),
+                      "error outside the uncertainty or drift off");
+            }
+        }
+    }
+    return checkSummary();
+}
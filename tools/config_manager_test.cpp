@@ -0,0 +1,200 @@
+/*
+    Config Manager Test (host-side tool)
+
+    Loads config.txt files through ConfigManager as the skulls do at startup, from a file system in memory:
+      - The SD card folder's config_primary.txt and config_secondary.txt, whose settings must come back as written.
+      - Hand-written files: every setting in range, every setting out of range (each falls back to its default),
+        none at all (all defaults), Windows line endings, and a missing file (refused).
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. -Itools/host tools/config_manager_test.cpp config_manager.cpp config_parser.cpp \
+            -o config_manager_test
+
+    Usage:
+        ./config_manager_test [SD card folder]     (default: sd_card_files)
+*/
+
+#include "config_manager.h"
+#include "config_parser.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+// A file in memory
+class MemoryFile : public PlatformFile
+{
+public:
+    explicit MemoryFile(const std::string &text) : m_text(text), m_position(0) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        size_t count = std::min(size, m_text.size() - m_position);
+        memcpy(buffer, m_text.data() + m_position, count);
+        m_position += count;
+        return count;
+    }
+
+    bool seek(uint32_t position) override
+    {
+        if (position > m_text.size())
+        {
+            return false;
+        }
+        m_position = position;
+        return true;
+    }
+
+    uint32_t position() override { return static_cast<uint32_t>(m_position); }
+    uint32_t size() override { return static_cast<uint32_t>(m_text.size()); }
+
+private:
+    std::string m_text;
+    size_t m_position;
+};
+
+// A card holding only /config.txt, if it has any text
+class ConfigCard : public FileSystem
+{
+public:
+    explicit ConfigCard(const std::string &configText, bool hasConfig = true)
+        : m_configText(configText), m_hasConfig(hasConfig) {}
+
+    bool begin() override { return true; }
+
+    std::unique_ptr<PlatformFile> open(const char *path) override
+    {
+        if (!m_hasConfig || strcmp(path, "/config.txt") != 0)
+        {
+            return nullptr;
+        }
+        return std::unique_ptr<PlatformFile>(new MemoryFile(m_configText));
+    }
+
+    bool listFiles(const char *directory, std::vector<std::string> &names) override
+    {
+        (void)directory;
+        names.clear();
+        if (m_hasConfig)
+        {
+            names.push_back("config.txt");
+        }
+        return true;
+    }
+
+private:
+    std::string m_configText;
+    bool m_hasConfig;
+};
+
+// Reads a whole file. Returns false if it can't be opened.
+static bool readFile(const std::string &path, std::string &text)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    text.clear();
+    char buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        text.append(buffer, bytesRead);
+    }
+    fclose(file);
+    return true;
+}
+
+// Every setting of the card's config files must come back from getValue() as ConfigParser reads it
+static void checkCard(const std::string &root)
+{
+    const char *names[] = {"config_primary.txt", "config_secondary.txt"};
+    for (const char *name : names)
+    {
+        std::string text;
+        if (!readFile(root + "/" + name, text))
+        {
+            check(false, name, "can't read it");
+            continue;
+        }
+
+        ConfigManager &config = ConfigManager::getInstance();
+        ConfigCard card(text);
+        check(config.loadConfig(card), name, "not loaded");
+
+        size_t settings = 0;
+        size_t lineStart = 0;
+        while (lineStart < text.size())
+        {
+            size_t lineEnd = std::min(text.find('\n', lineStart), text.size());
+            std::string key;
+            std::string value;
+            if (ConfigParser::parseLine(text.substr(lineStart, lineEnd - lineStart), key, value))
+            {
+                check(config.getValue(key.c_str(), "(missing)") == value.c_str(), name + (": " + key), "value differs");
+                settings++;
+            }
+            lineStart = lineEnd + 1;
+        }
+        check(settings > 0, name, "no settings");
+        check(config.getRole() == (strstr(name, "primary") != nullptr ? "primary" : "secondary"), name, "wrong role");
+    }
+}
+
+// Settings in range are used, settings out of range fall back to their defaults
+static void checkValidation()
+{
+    ConfigManager &config = ConfigManager::getInstance();
+
+    ConfigCard inRange("role = primary\n"
+                       "speaker_name = Test Speaker\n"
+                       "speaker_volume = 40\n"
+                       "audio_buffer_size = 16384\n"
+                       "audio_buffer_psram = Yes\n"
+                       "jaw_lookahead_ms = -120\n"
+                       "jaw_max_velocity = 600\n"
+                       "jaw_max_acceleration = 20000\n");
+    check(config.loadConfig(inRange), "in range", "not loaded");
+    check(config.getRole() == "primary" && config.getBluetoothSpeakerName() == "Test Speaker", "in range", "wrong names");
+    check(config.getSpeakerVolume() == 40, "in range", "wrong speaker volume");
+    check(config.getAudioBufferSize() == 16384 && config.getAudioBufferUsePsram(), "in range", "wrong audio buffer");
+    check(config.getJawLookaheadMs() == -120, "in range", "wrong jaw lookahead");
+    check(config.getJawMaxVelocity() == 600.0f && config.getJawMaxAcceleration() == 20000.0f, "in range", "wrong jaw limits");
+
+    ConfigCard outOfRange("speaker_volume = 101\n"
+                          "audio_buffer_size = 4095\n"
+                          "audio_buffer_psram = maybe\n"
+                          "jaw_lookahead_ms = 1001\n"
+                          "jaw_max_velocity = -1\n"
+                          "jaw_max_acceleration = 1000001\n");
+    check(config.loadConfig(outOfRange), "out of range", "not loaded");
+    check(config.getRole() == "unknown", "out of range", "role left over from the last file");
+    check(config.getSpeakerVolume() == 100, "out of range", "speaker volume not defaulted");
+    check(config.getAudioBufferSize() == 8192 && !config.getAudioBufferUsePsram(), "out of range", "audio buffer not defaulted");
+    check(config.getJawLookaheadMs() == 0, "out of range", "jaw lookahead not defaulted");
+    check(config.getJawMaxVelocity() == 1000.0f && config.getJawMaxAcceleration() == 40000.0f, "out of range",
+          "jaw limits not defaulted");
+
+    ConfigCard empty("");
+    check(config.loadConfig(empty), "empty file", "not loaded");
+    check(config.getBluetoothSpeakerName() == "Unknown Speaker" && config.getSpeakerVolume() == 100 &&
+              config.getAudioBufferSize() == 8192 && config.getJawLookaheadMs() == 0,
+          "empty file", "not all defaults");
+
+    ConfigCard windows("role=secondary\r\nspeaker_volume=75\r\n");
+    check(config.loadConfig(windows), "Windows line endings", "not loaded");
+    check(config.getRole() == "secondary" && config.getSpeakerVolume() == 75, "Windows line endings", "wrong settings");
+
+    ConfigCard missing("", false);
+    check(!config.loadConfig(missing), "missing file", "loaded");
+}
+
+int main(int argc, char *argv[])
+{
+    checkCard(argc > 1 ? argv[1] : "sd_card_files");
+    checkValidation();
+    return checkSummary();
+}
@@ -0,0 +1,176 @@
+/*
+    Format Converter Test (host-side tool)
+
+    Checks AudioFormatConverter bit for bit:
+      - Hand-worked vectors: mono 22.05kHz to 44.1kHz through full-scale steps (the interpolation must not overflow),
+        upmixing, and passthrough.
+      - Every supported source rate, mono and stereo, against a reference written straight from the definition:
+        output frame k sits at source position k * step - 1 in 16.16 fixed point (one frame behind, easing in from
+        silence), and is the previous frame plus (next - previous) * the top 15 bits of the fraction, shifted down
+        15. The converter is fed random audio, with full-scale swings, in chunks sized by maxInputFrames() for the
+        output buffer AudioPlayer uses and for an A2DP request, so carrying state across calls and never overrunning
+        the output are checked too.
+      - The formats configure() must refuse.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/format_converter_test.cpp audio_format_converter.cpp -o format_converter_test
+
+    Usage:
+        ./format_converter_test
+*/
+
+#include "audio_format_converter.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t OUTPUT_SAMPLE_RATE = 44100; // AudioPlayer::AUDIO_SAMPLE_RATE
+
+// A sample: mostly anywhere, sometimes full scale either way
+static int16_t randomSample(Random &random)
+{
+    uint64_t value = random.next();
+    if ((value & 7) == 0)
+    {
+        return (value & 8) ? 32767 : -32768;
+    }
+    return static_cast<int16_t>(value >> 48);
+}
+
+// Convert a whole source, input chunks sized with maxInputFrames() for outputFrames at a time
+static std::vector<int16_t> convertAll(AudioFormatConverter &converter, const std::vector<int16_t> &input, uint16_t channels,
+                                       size_t outputFrames, bool &overran)
+{
+    std::vector<int16_t> output;
+    std::vector<int16_t> block(outputFrames * 2);
+    size_t inputFrames = input.size() / channels;
+    size_t position = 0;
+    overran = false;
+    while (position < inputFrames)
+    {
+        size_t frames = converter.maxInputFrames(outputFrames);
+        frames = frames < inputFrames - position ? frames : inputFrames - position;
+        // Input a full output block left unconverted would be lost; the reference comparison shows if any was
+        size_t produced = converter.convert(input.data() + position * channels, frames, block.data(), outputFrames);
+        overran = overran || produced > outputFrames;
+        output.insert(output.end(), block.begin(), block.begin() + produced * 2);
+        position += frames;
+    }
+    return output;
+}
+
+// Reference: output frame k from the definition, for as many frames as the source covers
+static std::vector<int16_t> reference(const std::vector<int16_t> &input, uint16_t channels, uint32_t sourceRate)
+{
+    int64_t step = static_cast<int64_t>((static_cast<uint64_t>(sourceRate) << 16) / OUTPUT_SAMPLE_RATE);
+    int64_t inputFrames = static_cast<int64_t>(input.size() / channels);
+    auto at = [&](int64_t frame, int channel) -> int32_t
+    {
+        return frame < 0 ? 0 : input[frame * channels + (channels == 2 ? channel : 0)];
+    };
+
+    std::vector<int16_t> output;
+    if (sourceRate == OUTPUT_SAMPLE_RATE)
+    {
+        for (int64_t frame = 0; frame < inputFrames; frame++)
+        {
+            output.push_back(static_cast<int16_t>(at(frame, 0)));
+            output.push_back(static_cast<int16_t>(at(frame, 1)));
+        }
+        return output;
+    }
+    for (int64_t k = 0;; k++)
+    {
+        int64_t position = k * step - 65536;
+        int64_t previous = position >> 16; // Floor, also below zero
+        if (previous + 1 >= inputFrames)
+        {
+            break;
+        }
+        int32_t fraction = static_cast<int32_t>((position & 0xFFFF) >> 1);
+        for (int channel = 0; channel < 2; channel++)
+        {
+            int32_t a = at(previous, channel);
+            int32_t b = at(previous + 1, channel);
+            output.push_back(static_cast<int16_t>(a + (((b - a) * fraction) >> 15)));
+        }
+    }
+    return output;
+}
+
+// A hand-worked vector: convert input in one go into a roomy buffer and compare
+static void expectVector(const std::string &name, uint32_t sourceRate, uint16_t channels, const std::vector<int16_t> &input,
+                         const std::vector<int16_t> &expected)
+{
+    AudioFormatConverter converter;
+    check(converter.configure(sourceRate, channels, OUTPUT_SAMPLE_RATE), name, "configure() refused");
+    std::vector<int16_t> output(expected.size() + 64);
+    size_t frames = converter.convert(input.data(), input.size() / channels, output.data(), output.size() / 2);
+    output.resize(frames * 2);
+    check(output == expected, name, "output differs");
+}
+
+static void checkVectors()
+{
+    // Step 0.5: every other output frame lands on a source frame, the rest halfway. The halfway point of 32767
+    // and -32768 is -0.5, which the arithmetic shift floors to -1. The last source frame is only the far end of a
+    // span until the next one arrives, so it isn't output yet.
+    expectVector("mono 22.05kHz, full-scale steps", 22050, 1, {1000, -1000, 32767, -32768},
+                 {0, 0, 500, 500, 1000, 1000, 0, 0, -1000, -1000, 15883, 15883, 32767, 32767, -1, -1});
+    expectVector("stereo 22.05kHz, channels independent", 22050, 2, {100, -100, 300, -300},
+                 {0, 0, 50, -50, 100, -100, 200, -200});
+    expectVector("mono 44.1kHz upmix", 44100, 1, {1, -2, 32767, -32768}, {1, 1, -2, -2, 32767, 32767, -32768, -32768});
+    expectVector("stereo 44.1kHz passthrough", 44100, 2, {1, 2, -3, -4, 32767, -32768}, {1, 2, -3, -4, 32767, -32768});
+}
+
+static void checkAgainstReference()
+{
+    const uint32_t sourceRates[] = {8000, 11025, 16000, 22050, 24000, 32000, 44100, 48000};
+    const size_t outputFrameCounts[] = {128, 512}; // An A2DP request; AudioPlayer::CONVERT_BUFFER_FRAMES
+    uint64_t seed = 1;
+    for (uint32_t sourceRate : sourceRates)
+    {
+        for (uint16_t channels = 1; channels <= 2; channels++)
+        {
+            for (size_t outputFrames : outputFrameCounts)
+            {
+                std::string name = std::to_string(sourceRate) + " Hz, " + std::to_string(channels) + " channel(s), " +
+                                   std::to_string(outputFrames) + "-frame output";
+                Random random(seed++);
+                std::vector<int16_t> input(static_cast<size_t>(sourceRate) * channels); // One second
+                for (int16_t &sample : input)
+                {
+                    sample = randomSample(random);
+                }
+
+                AudioFormatConverter converter;
+                check(converter.configure(sourceRate, channels, OUTPUT_SAMPLE_RATE), name, "configure() refused");
+                check(converter.isPassthrough() == (sourceRate == OUTPUT_SAMPLE_RATE && channels == 2), name, "wrong passthrough");
+                bool overran;
+                std::vector<int16_t> output = convertAll(converter, input, channels, outputFrames, overran);
+                check(!overran, name, "wrote more frames than the output holds");
+                check(output == reference(input, channels, sourceRate), name, "output differs from the reference");
+            }
+        }
+    }
+}
+
+static void checkRefusals()
+{
+    AudioFormatConverter converter;
+    check(!converter.configure(7999, 1, OUTPUT_SAMPLE_RATE), "7999 Hz", "configure() accepted a rate below the minimum");
+    check(!converter.configure(48001, 1, OUTPUT_SAMPLE_RATE), "48001 Hz", "configure() accepted a rate above the maximum");
+    check(!converter.configure(22050, 0, OUTPUT_SAMPLE_RATE), "0 channels", "configure() accepted no channels");
+    check(!converter.configure(22050, 3, OUTPUT_SAMPLE_RATE), "3 channels", "configure() accepted 3 channels");
+    check(!converter.configure(22050, 1, 0), "0 Hz output", "configure() accepted a 0 Hz output");
+}
+
+int main()
+{
+    checkVectors();
+    checkAgainstReference();
+    checkRefusals();
+    return checkSummary();
+}
@@ -0,0 +1,125 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+    The parts of Arduino.h the audio path and ConfigManager still use, for host builds (see tools/host/host_platform.h):
+    String and Serial. Everything else they need from the platform goes through platform.h.
+
+    Serial discards what's printed until Serial.begin() is called, so the tools only show the skulls' log if they ask.
+*/
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Arduino's String, on std::string
+class String : public std::string
+{
+public:
+    String() {}
+    String(const char *text) : std::string(text != nullptr ? text : "") {}
+    String(const std::string &text) : std::string(text) {}
+    explicit String(char c) : std::string(1, c) {}
+    explicit String(int value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned int value) : std::string(std::to_string(value)) {}
+    explicit String(long value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned long value) : std::string(std::to_string(value)) {}
+    explicit String(long long value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned long long value) : std::string(std::to_string(value)) {}
+
+    unsigned int length() const { return static_cast<unsigned int>(size()); }
+    char charAt(unsigned int index) const { return index < size() ? (*this)[index] : '\0'; }
+    bool startsWith(const String &prefix) const { return compare(0, prefix.size(), prefix) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return size() >= suffix.size() && compare(size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    String substring(unsigned int from) const { return from < size() ? String(substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        return from < to && from < size() ? String(substr(from, to - from)) : String();
+    }
+    int indexOf(char c) const { return toIndex(find(c)); }
+    int lastIndexOf(char c) const { return toIndex(rfind(c)); }
+    bool equals(const String &other) const { return *this == other; }
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return static_cast<float>(atof(c_str())); }
+    void toLowerCase()
+    {
+        for (char &c : *this)
+        {
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+    }
+
+private:
+    static int toIndex(size_t position) { return position == npos ? -1 : static_cast<int>(position); }
+};
+
+// Arduino's Serial, writing to stdout once begin() is called. printf() formats whether or not it prints, as the ESP32's
+// Print::printf() does: on the stack up to 64 bytes and on the heap beyond, so the host sees the allocations the skulls
+// would make. print() and println() write straight out, as Print's do.
+class HostSerial
+{
+public:
+    static constexpr size_t PRINTF_STACK_BUFFER_SIZE = 64;
+
+    void begin(unsigned long baud)
+    {
+        (void)baud;
+        m_enabled = true;
+    }
+
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char stackBuffer[PRINTF_STACK_BUFFER_SIZE];
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, copy);
+        va_end(copy);
+        char *text = stackBuffer;
+        if (length >= static_cast<int>(sizeof(stackBuffer)))
+        {
+            text = new char[length + 1];
+            vsnprintf(text, length + 1, format, args);
+        }
+        va_end(args);
+        if (length > 0)
+        {
+            print(text);
+        }
+        if (text != stackBuffer)
+        {
+            delete[] text;
+        }
+        return length;
+    }
+
+    void print(const char *text)
+    {
+        if (m_enabled)
+        {
+            fputs(text, stdout);
+        }
+    }
+    void println(const char *text)
+    {
+        print(text);
+        print("\n");
+    }
+    void print(const String &text) { print(text.c_str()); }
+    void println(const String &text) { println(text.c_str()); }
+    void println() { print("\n"); }
+
+private:
+    bool m_enabled = false;
+};
+
+inline HostSerial Serial;
+
+#endif // HOST_ARDUINO_H
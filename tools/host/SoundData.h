@@ -0,0 +1,27 @@
+#ifndef HOST_SOUND_DATA_H
+#define HOST_SOUND_DATA_H
+
+/*
+    Frame as ESP32-A2DP's SoundData.h defines it, for host builds (see tools/host/host_platform.h)
+*/
+
+#include <stdint.h>
+
+struct __attribute__((packed)) Frame
+{
+    int16_t channel1;
+    int16_t channel2;
+
+    Frame(int v = 0)
+    {
+        channel1 = channel2 = v;
+    }
+
+    Frame(int ch1, int ch2)
+    {
+        channel1 = ch1;
+        channel2 = ch2;
+    }
+};
+
+#endif // HOST_SOUND_DATA_H
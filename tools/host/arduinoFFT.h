@@ -0,0 +1,110 @@
+#ifndef HOST_ARDUINO_FFT_H
+#define HOST_ARDUINO_FFT_H
+
+/*
+    The part of the arduinoFFT library (1.x) BandEnergyAnalyzer uses, for host builds (see tools/host/host_platform.h):
+    a Hann window and an in-place radix-2 FFT over the caller's arrays.
+*/
+
+#include <math.h>
+#include <stdint.h>
+
+#define FFT_FORWARD 0x01
+#define FFT_REVERSE 0x00
+#define FFT_WIN_TYP_RECTANGLE 0x00
+#define FFT_WIN_TYP_HAMMING 0x01
+#define FFT_WIN_TYP_HANN 0x02
+
+class arduinoFFT
+{
+public:
+    // samples must be a power of two
+    arduinoFFT(double *vReal, double *vImag, uint16_t samples, double samplingFrequency)
+        : m_vReal(vReal), m_vImag(vImag), m_samples(samples), m_samplingFrequency(samplingFrequency)
+    {
+    }
+
+    // Weigh the real samples by a window (forward), or undo it (reverse)
+    void Windowing(uint8_t windowType, uint8_t dir)
+    {
+        for (uint16_t i = 0; i < m_samples; i++)
+        {
+            double ratio = static_cast<double>(i) / (m_samples - 1);
+            double weight = 1.0;
+            if (windowType == FFT_WIN_TYP_HANN)
+            {
+                weight = 0.5 * (1.0 - cos(2.0 * M_PI * ratio));
+            }
+            else if (windowType == FFT_WIN_TYP_HAMMING)
+            {
+                weight = 0.54 - 0.46 * cos(2.0 * M_PI * ratio);
+            }
+            if (dir == FFT_FORWARD)
+            {
+                m_vReal[i] *= weight;
+            }
+            else if (weight != 0.0)
+            {
+                m_vReal[i] /= weight;
+            }
+        }
+    }
+
+    // Transform in place (reverse leaves the result unscaled, as the library does)
+    void Compute(uint8_t dir)
+    {
+        // Bit-reverse the order
+        for (uint16_t i = 1, j = 0; i < m_samples; i++)
+        {
+            uint16_t bit = m_samples >> 1;
+            for (; j & bit; bit >>= 1)
+            {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j)
+            {
+                swap(m_vReal[i], m_vReal[j]);
+                swap(m_vImag[i], m_vImag[j]);
+            }
+        }
+
+        // Butterflies
+        double sign = dir == FFT_FORWARD ? -1.0 : 1.0;
+        for (uint16_t length = 2; length <= m_samples; length <<= 1)
+        {
+            double angle = sign * 2.0 * M_PI / length;
+            for (uint16_t start = 0; start < m_samples; start += length)
+            {
+                for (uint16_t k = 0; k < length / 2; k++)
+                {
+                    double wReal = cos(angle * k);
+                    double wImag = sin(angle * k);
+                    uint16_t even = start + k;
+                    uint16_t odd = even + length / 2;
+                    double oddReal = m_vReal[odd] * wReal - m_vImag[odd] * wImag;
+                    double oddImag = m_vReal[odd] * wImag + m_vImag[odd] * wReal;
+                    m_vReal[odd] = m_vReal[even] - oddReal;
+                    m_vImag[odd] = m_vImag[even] - oddImag;
+                    m_vReal[even] += oddReal;
+                    m_vImag[even] += oddImag;
+                }
+            }
+        }
+    }
+
+private:
+    static void swap(double &a, double &b)
+    {
+        double t = a;
+        a = b;
+        b = t;
+    }
+
+    double *m_vReal;
+    double *m_vImag;
+    uint16_t m_samples;
+    double m_samplingFrequency;
+};
+
+#endif // HOST_ARDUINO_FFT_H
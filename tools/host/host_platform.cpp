@@ -0,0 +1,193 @@
+/*
+    The platform interfaces on a host machine. See host_platform.h.
+*/
+
+#include "host_platform.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+// A file opened with stdio
+class HostFile : public PlatformFile
+{
+public:
+    HostFile(FILE *file, uint32_t size) : m_file(file), m_size(size) {}
+    ~HostFile() override { fclose(m_file); }
+
+    size_t read(uint8_t *buffer, size_t size) override { return fread(buffer, 1, size, m_file); }
+    bool seek(uint32_t position) override { return position <= m_size && fseek(m_file, position, SEEK_SET) == 0; }
+    uint32_t position() override { return static_cast<uint32_t>(ftell(m_file)); }
+    uint32_t size() override { return m_size; }
+
+private:
+    FILE *m_file;
+    uint32_t m_size;
+};
+
+HostFileSystem::HostFileSystem(const std::string &root) : m_root(root) {}
+
+// The folder is there or it isn't
+bool HostFileSystem::begin()
+{
+    struct stat info;
+    return stat(m_root.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// Open a file in the folder for reading
+std::unique_ptr<PlatformFile> HostFileSystem::open(const char *path)
+{
+    std::string fullPath = m_root + path;
+    struct stat info;
+    if (stat(fullPath.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        return nullptr;
+    }
+    FILE *file = fopen(fullPath.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return nullptr;
+    }
+    return std::unique_ptr<PlatformFile>(new HostFile(file, static_cast<uint32_t>(info.st_size)));
+}
+
+// List the regular files in a directory of the folder
+bool HostFileSystem::listFiles(const char *directory, std::vector<std::string> &names)
+{
+    std::string fullPath = m_root + directory;
+    DIR *dir = opendir(fullPath.c_str());
+    if (dir == nullptr)
+    {
+        return false;
+    }
+    while (struct dirent *entry = readdir(dir))
+    {
+        struct stat info;
+        if (stat((fullPath + "/" + entry->d_name).c_str(), &info) == 0 && S_ISREG(info.st_mode))
+        {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+HostClock::HostClock() : m_start(std::chrono::steady_clock::now()) {}
+
+int64_t HostClock::micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+unsigned long HostClock::millis()
+{
+    return static_cast<unsigned long>(micros() / 1000);
+}
+
+uint32_t HostClock::cycleCount()
+{
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count());
+}
+
+uint32_t HostClock::cyclesPerMicro()
+{
+    return 1000;
+}
+
+// Thrown out of a task's wait to end it
+struct TaskStopped
+{
+};
+
+// The task the calling thread runs, if it's one of ours
+static thread_local void *t_currentTask = nullptr;
+
+HostTasks::HostTasks(Clock &clock) : m_clock(clock) {}
+
+HostTasks::~HostTasks()
+{
+    stop();
+}
+
+// Start a thread running entry(param) until stop()
+Tasks::Handle HostTasks::start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core)
+{
+    (void)name;
+    (void)stackSize;
+    (void)priority;
+    (void)core;
+
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    m_tasks.emplace_back(new Task());
+    Task *task = m_tasks.back().get();
+    task->thread = std::thread([task, entry, param]()
+                               {
+                                   t_currentTask = task;
+                                   try
+                                   {
+                                       entry(param);
+                                   }
+                                   catch (const TaskStopped &)
+                                   {
+                                   } });
+    return task;
+}
+
+void HostTasks::notify(Handle handle)
+{
+    Task *task = static_cast<Task *>(handle);
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notified = true;
+    task->wake.notify_one();
+}
+
+void HostTasks::waitForNotification(uint32_t timeoutMs)
+{
+    sleep(std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs), true);
+}
+
+// Sleep until the next period
+void HostTasks::delayUntil(unsigned long &wakeMs, uint32_t periodMs)
+{
+    wakeMs += periodMs;
+    long remainingMs = static_cast<long>(wakeMs - m_clock.millis());
+    sleep(std::chrono::steady_clock::now() + std::chrono::milliseconds(remainingMs > 0 ? remainingMs : 0), false);
+}
+
+// Sleep the calling task
+void HostTasks::sleep(std::chrono::steady_clock::time_point deadline, bool wakeOnNotify)
+{
+    Task *task = static_cast<Task *>(t_currentTask);
+    std::unique_lock<std::mutex> lock(task->mutex);
+    task->wake.wait_until(lock, deadline, [task, wakeOnNotify]()
+                          { return task->stopping || (wakeOnNotify && task->notified); });
+    if (task->stopping)
+    {
+        throw TaskStopped();
+    }
+    if (wakeOnNotify)
+    {
+        task->notified = false;
+    }
+}
+
+// End every task and wait for them
+void HostTasks::stop()
+{
+    std::lock_guard<std::mutex> lock(m_tasksMutex);
+    for (std::unique_ptr<Task> &task : m_tasks)
+    {
+        {
+            std::lock_guard<std::mutex> taskLock(task->mutex);
+            task->stopping = true;
+        }
+        task->wake.notify_one();
+    }
+    for (std::unique_ptr<Task> &task : m_tasks)
+    {
+        if (task->thread.joinable())
+        {
+            task->thread.join();
+        }
+    }
+    m_tasks.clear();
+}
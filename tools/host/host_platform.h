@@ -0,0 +1,86 @@
+#ifndef HOST_PLATFORM_H
+#define HOST_PLATFORM_H
+
+/*
+    The platform interfaces (platform.h) on a host machine, so the host tools can run the skulls' own AudioPlayer,
+    SDCardManager, SkullAudioAnimator and BandEnergyAnalyzer: a folder standing in for the SD card, std::chrono for
+    the clock and std::thread for the tasks. With tools/host on the include path, its Arduino.h, SoundData.h and
+    arduinoFFT.h stand in for the few library headers those still include.
+
+    Build a tool against it with (from the repository root):
+        g++ -std=c++17 -O2 -pthread -I. -Itools/host <tool>.cpp tools/host/host_platform.cpp <the modules it uses>
+*/
+
+#include "platform.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// A folder on the host standing in for the SD card: "/audio/x.wav" is <root>/audio/x.wav
+class HostFileSystem : public FileSystem
+{
+public:
+    explicit HostFileSystem(const std::string &root);
+
+    bool begin() override;
+    std::unique_ptr<PlatformFile> open(const char *path) override;
+    bool listFiles(const char *directory, std::vector<std::string> &names) override;
+
+private:
+    std::string m_root;
+};
+
+// Time since the clock was made, on std::chrono::steady_clock. The cycle counter counts nanoseconds.
+class HostClock : public Clock
+{
+public:
+    HostClock();
+
+    int64_t micros() override;
+    unsigned long millis() override;
+    uint32_t cycleCount() override;
+    uint32_t cyclesPerMicro() override;
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Each task is a std::thread (priority and core are ignored). The threads run until stop().
+class HostTasks : public Tasks
+{
+public:
+    // delayUntil() periods are on clock
+    explicit HostTasks(Clock &clock);
+    ~HostTasks();
+
+    Handle start(Entry entry, void *param, const char *name, uint32_t stackSize, uint32_t priority, int core) override;
+    void notify(Handle task) override;
+    void waitForNotification(uint32_t timeoutMs) override;
+    void delayUntil(unsigned long &wakeMs, uint32_t periodMs) override;
+
+    // End every task at its next wait, and wait for them all to end. Tasks never return on their own, so call this
+    // before destroying anything they use (the destructor calls it too, which is only soon enough if the tasks'
+    // objects are destroyed after this).
+    void stop();
+
+private:
+    struct Task
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool notified = false;
+        bool stopping = false;
+    };
+
+    // Sleep the calling task until deadline, or until it's notified if wakeOnNotify (which clears the notification).
+    // Ends the task if it's stopped.
+    void sleep(std::chrono::steady_clock::time_point deadline, bool wakeOnNotify);
+
+    Clock &m_clock;
+    std::mutex m_tasksMutex;
+    std::vector<std::unique_ptr<Task>> m_tasks;
+};
+
+#endif // HOST_PLATFORM_H
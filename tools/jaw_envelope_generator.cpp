@@ -0,0 +1,184 @@
+/*
+    Jaw Envelope Generator (host-side tool)
+
+    Reads skit WAV files and writes a precomputed jaw envelope ("Skit - name.jaw") next to each one.
+    Copy the .jaw files to the SD card's /audio folder alongside the wav and txt files; SkullAudioAnimator
+    will then drive the jaw from the envelope instead of analyzing audio on the device.
+
+    The audio goes through the same decode/convert path as AudioPlayer (so it's analyzed at 44.1kHz stereo,
+    exactly as the animator would see it) and the same RMS, smoothing, gain and threshold steps as
+    SkullAudioAnimator, using the constants in jaw_envelope.h.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. -Itools/host tools/jaw_envelope_generator.cpp jaw_envelope.cpp wav_header_parser.cpp \
+            ima_adpcm_decoder.cpp audio_format_converter.cpp audio_level.cpp -o jaw_envelope_generator
+
+    Usage:
+        ./jaw_envelope_generator "sd_card_files/audio/Skit - "*.wav
+*/
+
+#include "jaw_envelope.h"
+#include "wav_header_parser.h"
+#include "ima_adpcm_decoder.h"
+#include "audio_format_converter.h"
+#include "audio_level.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Reads a WAV header from a stdio file
+class StdioByteSource : public WavByteSource
+{
+public:
+    StdioByteSource(FILE *file) : m_file(file) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return fread(buffer, 1, size, m_file);
+    }
+
+    bool skip(uint32_t size) override
+    {
+        return fseek(m_file, size, SEEK_CUR) == 0;
+    }
+
+private:
+    FILE *m_file;
+};
+
+// Decode a whole WAV file to 44.1kHz stereo samples
+static bool decodeToOutputFormat(const char *path, std::vector<int16_t> &output)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "%s: can't open file\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    uint32_t fileSize = static_cast<uint32_t>(ftell(file));
+    fseek(file, 0, SEEK_SET);
+
+    WavFormat format;
+    StdioByteSource source(file);
+    WavParseResult result = WavHeaderParser::parse(source, fileSize, format);
+    if (result != WavParseResult::OK)
+    {
+        fprintf(stderr, "%s: %s\n", path, WavHeaderParser::resultToString(result));
+        fclose(file);
+        return false;
+    }
+
+    bool isAdpcm = (format.audioFormat == ImaAdpcmDecoder::FORMAT_IMA_ADPCM);
+    bool isPcm16 = (format.audioFormat == WavHeaderParser::FORMAT_PCM && format.bitsPerSample == 16);
+    AudioFormatConverter converter;
+    if ((!isAdpcm && !isPcm16) || !converter.configure(format.sampleRate, format.numChannels, JawEnvelope::ANALYSIS_SAMPLE_RATE))
+    {
+        fprintf(stderr, "%s: unsupported format %u, %u Hz, %u-bit, %u channel(s)\n", path,
+                format.audioFormat, format.sampleRate, format.bitsPerSample, format.numChannels);
+        fclose(file);
+        return false;
+    }
+
+    // Decode the data chunk to 16-bit PCM
+    std::vector<uint8_t> data(format.dataSize);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+
+    std::vector<int16_t> decoded;
+    if (isAdpcm)
+    {
+        std::vector<int16_t> block(ImaAdpcmDecoder::samplesPerBlock(format.blockAlign, format.numChannels) * format.numChannels);
+        for (size_t offset = 0; offset < data.size(); offset += format.blockAlign)
+        {
+            size_t blockSize = std::min(static_cast<size_t>(format.blockAlign), data.size() - offset);
+            size_t frames = ImaAdpcmDecoder::decodeBlock(data.data() + offset, blockSize, format.numChannels, block.data());
+            decoded.insert(decoded.end(), block.begin(), block.begin() + frames * format.numChannels);
+        }
+    }
+    else
+    {
+        decoded.resize(data.size() / 2);
+        for (size_t i = 0; i < decoded.size(); i++)
+        {
+            decoded[i] = static_cast<int16_t>(data[2 * i] | (data[2 * i + 1] << 8));
+        }
+    }
+
+    // Convert to the output format
+    size_t inputFrames = decoded.size() / format.numChannels;
+    output.resize((static_cast<uint64_t>(inputFrames) * JawEnvelope::ANALYSIS_SAMPLE_RATE / format.sampleRate + 16) * 2);
+    size_t outputFrames = converter.convert(decoded.data(), inputFrames, output.data(), output.size() / 2);
+    output.resize(outputFrames * 2);
+    return true;
+}
+
+// Run the animator's amplitude analysis over the audio, one envelope byte per FRAME_DURATION_MS
+static std::vector<uint8_t> generateEnvelope(const std::vector<int16_t> &samples)
+{
+    std::vector<uint8_t> levels;
+    size_t totalFrames = samples.size() / 2;
+    double smoothedAmplitude = 0.0;
+
+    for (size_t blockStart = 0; blockStart < totalFrames; blockStart += JawEnvelope::ANALYSIS_BLOCK_FRAMES)
+    {
+        size_t blockFrames = std::min(static_cast<size_t>(JawEnvelope::ANALYSIS_BLOCK_FRAMES), totalFrames - blockStart);
+
+        // Same RMS as SkullAudioAnimator::calculateRMSFromFrames(): both channels
+        double rmsAmplitude = AudioLevel::rms(samples.data() + blockStart * 2, blockFrames * 2);
+
+        smoothedAmplitude = JawEnvelope::smoothAmplitude(smoothedAmplitude, rmsAmplitude);
+        uint8_t level = JawEnvelope::amplitudeToLevel(JawEnvelope::adjustAmplitude(smoothedAmplitude));
+
+        // Like the animator, the block's result applies from the playback time at the end of the block
+        uint64_t blockEndMs = static_cast<uint64_t>(blockStart + blockFrames) * 1000 / JawEnvelope::ANALYSIS_SAMPLE_RATE;
+        while (static_cast<uint64_t>(levels.size()) * JawEnvelope::FRAME_DURATION_MS <= blockEndMs)
+        {
+            levels.push_back(level);
+        }
+    }
+    return levels;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <skit wav file>...\n", argv[0]);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string wavPath = argv[i];
+        size_t extension = wavPath.rfind('.');
+        std::string envelopePath = (extension == std::string::npos ? wavPath : wavPath.substr(0, extension)) + JawEnvelope::FILE_EXTENSION;
+
+        std::vector<int16_t> samples;
+        if (!decodeToOutputFormat(wavPath.c_str(), samples))
+        {
+            failures++;
+            continue;
+        }
+
+        std::vector<uint8_t> levels = generateEnvelope(samples);
+        std::vector<uint8_t> file = JawEnvelope::serialize(levels);
+        FILE *out = fopen(envelopePath.c_str(), "wb");
+        if (!out || fwrite(file.data(), 1, file.size(), out) != file.size())
+        {
+            fprintf(stderr, "%s: can't write file\n", envelopePath.c_str());
+            if (out)
+            {
+                fclose(out);
+            }
+            failures++;
+            continue;
+        }
+        fclose(out);
+        printf("%s: %zu frames (%zu bytes)\n", envelopePath.c_str(), levels.size(), file.size());
+    }
+    return failures == 0 ? 0 : 1;
+}
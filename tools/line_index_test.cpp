@@ -0,0 +1,198 @@
+/*
+    Line Index Test (host-side tool)
+
+    Checks SkitLineIndex against the linear scan SkullAudioAnimator::updateSkit() used to do: the first line, in time
+    order, whose [start, end) holds the playback time. Random skits of 1 - 2000 lines, overlapping, back to back, with
+    gaps and empty lines, given in shuffled order, are looked up along random playback: small steps forward as A2DP
+    callbacks make, steps that jump a few lines ahead, big jumps forward and seeks backwards. Checks that:
+      - find() returns the same line as the scan (or nullptr between lines), at every lookup, and so does lineAt()
+        at the same time shifted by a random lookahead, without changing find()'s answers.
+      - nextTransition() is the next time the scan's answer changes, so nothing changes before it (every 8th lookup,
+        as working that out with the scan is slow).
+    Also checks rewind(), clear(), an empty index and lookups past the last line.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/line_index_test.cpp skit_line_index.cpp -o line_index_test
+
+    Usage:
+        ./line_index_test
+*/
+
+#include "skit_line_index.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// The line the old linear scan picks at a playback time: the first, in time order, that holds it. -1 if none.
+static long scan(const std::vector<SkitLineIndex::Segment> &sortedLines, unsigned long time)
+{
+    for (const SkitLineIndex::Segment &line : sortedLines)
+    {
+        if (line.start <= time && time < line.end)
+        {
+            return static_cast<long>(line.lineNumber);
+        }
+    }
+    return -1;
+}
+
+// The next time after a playback time that the scan's answer changes
+static unsigned long scanTransition(const std::vector<SkitLineIndex::Segment> &sortedLines, unsigned long time)
+{
+    long current = scan(sortedLines, time);
+    unsigned long next = SkitLineIndex::NO_TRANSITION;
+    for (const SkitLineIndex::Segment &line : sortedLines)
+    {
+        // The answer can only change where some line starts or ends
+        for (unsigned long edge : {line.start, line.end})
+        {
+            if (edge > time && edge < next && scan(sortedLines, edge) != current)
+            {
+                next = edge;
+            }
+        }
+    }
+    return next;
+}
+
+// A random skit: mostly back to back or with pauses, sometimes overlapping or empty
+static std::vector<SkitLineIndex::Segment> makeSkit(Random &random, size_t lineCount)
+{
+    std::vector<SkitLineIndex::Segment> lines;
+    unsigned long time = random.below(3000);
+    for (size_t line = 0; line < lineCount; line++)
+    {
+        unsigned long duration = random.below(8) == 0 ? 0 : 1 + random.below(4000);
+        lines.push_back({time, time + duration, line});
+        unsigned long kind = random.below(4);
+        if (kind == 0)
+        {
+            time += duration; // Back to back
+        }
+        else if (kind == 1)
+        {
+            time += duration / 2; // Overlapping the next line
+        }
+        else
+        {
+            time += duration + random.below(3000); // A pause
+        }
+    }
+    return lines;
+}
+
+static void checkRandomSkits()
+{
+    const size_t lineCounts[] = {1, 2, 5, 20, 200, 2000};
+    Random random(1);
+    for (size_t lineCount : lineCounts)
+    {
+        for (int skit = 0; skit < 20; skit++)
+        {
+            std::string name = std::to_string(lineCount) + " lines, skit " + std::to_string(skit);
+            std::vector<SkitLineIndex::Segment> lines = makeSkit(random, lineCount);
+            std::vector<SkitLineIndex::Segment> sorted = lines;
+            std::stable_sort(sorted.begin(), sorted.end(), [](const SkitLineIndex::Segment &a, const SkitLineIndex::Segment &b)
+                             { return a.start < b.start; });
+            unsigned long skitEnd = 0;
+            for (const SkitLineIndex::Segment &line : lines)
+            {
+                skitEnd = std::max(skitEnd, line.end);
+            }
+
+            // Lines as the skit file lists them needn't be in time order
+            for (size_t i = lines.size(); i > 1; i--)
+            {
+                std::swap(lines[i - 1], lines[random.below(i)]);
+            }
+            SkitLineIndex index;
+            index.assign(lines);
+
+            size_t wrongLines = 0;
+            size_t wrongTransitions = 0;
+            size_t wrongLookaheadLines = 0;
+            unsigned long time = 0;
+            for (int lookup = 0; lookup < 4000; lookup++)
+            {
+                unsigned long move = random.below(100);
+                if (move == 0)
+                {
+                    time = random.below(skitEnd + 5000); // Seek anywhere, backwards or forwards
+                }
+                else if (move < 5)
+                {
+                    time += random.below(20000); // Jump a few lines ahead
+                }
+                else
+                {
+                    time += random.below(30); // An A2DP callback's worth of playback
+                }
+
+                const SkitLineIndex::Segment *found = index.find(time);
+                long expected = scan(sorted, time);
+                if ((found == nullptr ? -1 : static_cast<long>(found->lineNumber)) != expected)
+                {
+                    wrongLines++;
+                }
+                if (lookup % 8 == 0 && index.nextTransition() != scanTransition(sorted, time))
+                {
+                    wrongTransitions++;
+                }
+
+                // The jaw looks up the same skit up to a few hundred ms ahead of (or behind) the playback time
+                unsigned long lookaheadTime = time + random.below(600) - 300;
+                const SkitLineIndex::Segment *ahead = index.lineAt(lookaheadTime);
+                if ((ahead == nullptr ? -1 : static_cast<long>(ahead->lineNumber)) != scan(sorted, lookaheadTime))
+                {
+                    wrongLookaheadLines++;
+                }
+            }
+            check(wrongLines == 0, name, "find() differs from the linear scan");
+            check(wrongTransitions == 0, name, "nextTransition() isn't where the linear scan's answer changes");
+            check(wrongLookaheadLines == 0, name, "lineAt() differs from the linear scan");
+
+            // A new playback of the same skit starts from the top again
+            index.rewind();
+            const SkitLineIndex::Segment *first = index.find(sorted.front().start);
+            check((first == nullptr ? -1 : static_cast<long>(first->lineNumber)) == scan(sorted, sorted.front().start), name,
+                  "wrong line after rewind()");
+        }
+    }
+}
+
+static void checkEdges()
+{
+    SkitLineIndex index;
+    check(index.isEmpty() && index.find(0) == nullptr && index.find(12345) == nullptr, "empty index", "found a line");
+    check(index.lineAt(0) == nullptr && index.lineAt(12345) == nullptr, "empty index lineAt()", "found a line");
+    check(index.nextTransition() == SkitLineIndex::NO_TRANSITION, "empty index", "a transition is scheduled");
+
+    // Empty lines are dropped; a line contained in an earlier one never shows
+    index.assign({{1000, 2000, 0}, {1500, 1800, 1}, {3000, 3000, 2}, {4000, 5000, 3}});
+    check(index.size() == 2, "contained and empty lines", "not dropped");
+    check(index.find(999) == nullptr && index.nextTransition() == 1000, "before the first line", "wrong result");
+    check(index.find(1000) != nullptr && index.find(1000)->lineNumber == 0 && index.nextTransition() == 2000, "first line's start",
+          "wrong result");
+    check(index.find(1999)->lineNumber == 0 && index.find(2000) == nullptr, "first line's end", "wrong result");
+    check(index.find(4999)->lineNumber == 3 && index.find(5000) == nullptr, "last line's end", "wrong result");
+    check(index.nextTransition() == SkitLineIndex::NO_TRANSITION, "after the last line", "a transition is scheduled");
+    check(index.find(1500) != nullptr && index.find(1500)->lineNumber == 0, "seek back into the first line", "wrong result");
+
+    // Lines ending at the largest playback time still end
+    index.assign({{0, SkitLineIndex::NO_TRANSITION - 1, 7}});
+    check(index.find(SkitLineIndex::NO_TRANSITION - 2) != nullptr && index.find(SkitLineIndex::NO_TRANSITION - 1) == nullptr,
+          "line ending at the largest time", "wrong result");
+
+    index.clear();
+    check(index.isEmpty() && index.find(0) == nullptr, "clear()", "lines left");
+}
+
+int main()
+{
+    checkRandomSkits();
+    checkEdges();
+    return checkSummary();
+}
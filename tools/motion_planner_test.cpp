@@ -0,0 +1,206 @@
+/*
+    Motion Planner Test (host-side tool)
+
+    Checks ServoMotionPlanner's trajectory math:
+      - Each easing curve runs from 0 to 1, never goes backwards, stays within [0, 1] and is symmetric about its
+        halfway point (ease(1 - t) = 1 - ease(t)), so a move up and the same move down mirror each other.
+      - The breathing sequence TwoSkulls.ino queues (open 30 degrees over 2s, hold 100ms, close over 2s), sampled
+        every ServoController::MOTION_STEP_MS: exact positions at the key times, opening and closing monotonically,
+        and done after exactly 4.1s.
+      - The plan keeps to its schedule however it's sampled: a sampler that runs late or irregularly lands on the
+        same positions at the same times as one sampling every millisecond.
+      - Plans across the millis() wraparound, queuing onto a running plan, the queue limit, zero-length moves and
+        cancel() for the audio-driven jaw to take over.
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/motion_planner_test.cpp servo_motion_planner.cpp -o motion_planner_test
+
+    Usage:
+        ./motion_planner_test
+*/
+
+#include "servo_motion_planner.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using Easing = ServoMotionPlanner::Easing;
+
+static constexpr uint32_t MOTION_STEP_MS = 20; // ServoController::MOTION_STEP_MS
+static constexpr int BREATHING_JAW_ANGLE = 30; // TwoSkulls.ino
+static constexpr uint32_t BREATHING_MOVEMENT_DURATION = 2000;
+static constexpr uint32_t BREATHING_PAUSE_DURATION = 100;
+
+static void checkEasing()
+{
+    const Easing easings[] = {Easing::LINEAR, Easing::EASE_IN_OUT_SINE, Easing::EASE_IN_OUT_CUBIC};
+    const char *names[] = {"linear", "sine", "cubic"};
+    for (int i = 0; i < 3; i++)
+    {
+        std::string name = std::string(names[i]) + " easing";
+        Easing easing = easings[i];
+        check(ServoMotionPlanner::ease(easing, 0.0f) == 0.0f && ServoMotionPlanner::ease(easing, 1.0f) == 1.0f, name,
+              "doesn't run from 0 to 1");
+        check(ServoMotionPlanner::ease(easing, -0.5f) == 0.0f && ServoMotionPlanner::ease(easing, 1.5f) == 1.0f, name,
+              "not clamped outside [0, 1]");
+
+        bool monotonic = true;
+        bool bounded = true;
+        bool symmetric = true;
+        float previous = 0.0f;
+        for (int step = 1; step <= 10000; step++)
+        {
+            float t = step / 10000.0f;
+            float value = ServoMotionPlanner::ease(easing, t);
+            monotonic = monotonic && value >= previous;
+            bounded = bounded && value >= 0.0f && value <= 1.0f;
+            symmetric = symmetric && fabsf(ServoMotionPlanner::ease(easing, 1.0f - t) - (1.0f - value)) < 1e-5f;
+            previous = value;
+        }
+        check(monotonic, name, "goes backwards");
+        check(bounded, name, "leaves [0, 1]");
+        check(symmetric, name, "not symmetric about its halfway point");
+    }
+
+    // The eased curves start and end slower than linear
+    check(ServoMotionPlanner::ease(Easing::EASE_IN_OUT_SINE, 0.1f) < 0.1f && ServoMotionPlanner::ease(Easing::EASE_IN_OUT_SINE, 0.9f) > 0.9f,
+          "sine easing", "doesn't ease in and out");
+    check(ServoMotionPlanner::ease(Easing::EASE_IN_OUT_CUBIC, 0.1f) < ServoMotionPlanner::ease(Easing::EASE_IN_OUT_SINE, 0.1f),
+          "cubic easing", "doesn't start slower than sine");
+}
+
+// Queue the breathing sequence as breathingJawMovement() does, each call a little later as loop() would make them
+static void queueBreathing(ServoMotionPlanner &planner, uint32_t nowMs)
+{
+    planner.moveTo(BREATHING_JAW_ANGLE, BREATHING_MOVEMENT_DURATION, Easing::EASE_IN_OUT_SINE, nowMs, 0);
+    planner.hold(BREATHING_PAUSE_DURATION, nowMs + 1, 0);
+    planner.moveTo(0, BREATHING_MOVEMENT_DURATION, Easing::EASE_IN_OUT_SINE, nowMs + 2, 0);
+}
+
+static void checkBreathing(uint32_t startMs, const std::string &name)
+{
+    ServoMotionPlanner planner;
+    queueBreathing(planner, startMs);
+
+    bool openingMonotonic = true;
+    bool closingMonotonic = true;
+    bool inRange = true;
+    int previous = 0;
+    uint32_t doneAtMs = 0;
+    for (uint32_t elapsedMs = 0; elapsedMs <= 5000 && doneAtMs == 0; elapsedMs += MOTION_STEP_MS)
+    {
+        int position = planner.positionAt(startMs + elapsedMs);
+        inRange = inRange && position >= 0 && position <= BREATHING_JAW_ANGLE;
+        if (elapsedMs <= BREATHING_MOVEMENT_DURATION)
+        {
+            openingMonotonic = openingMonotonic && position >= previous;
+        }
+        else if (elapsedMs >= BREATHING_MOVEMENT_DURATION + BREATHING_PAUSE_DURATION)
+        {
+            closingMonotonic = closingMonotonic && position <= previous;
+        }
+        if (elapsedMs == 1000 || elapsedMs == 3100)
+        {
+            check(position == BREATHING_JAW_ANGLE / 2, name, "not halfway at the middle of a move");
+        }
+        if (elapsedMs == BREATHING_MOVEMENT_DURATION || elapsedMs == BREATHING_MOVEMENT_DURATION + BREATHING_PAUSE_DURATION)
+        {
+            check(position == BREATHING_JAW_ANGLE, name, "not open through the pause");
+        }
+        if (!planner.isActive())
+        {
+            doneAtMs = elapsedMs;
+        }
+        previous = position;
+    }
+    check(openingMonotonic, name, "closes while opening");
+    check(closingMonotonic, name, "opens while closing");
+    check(inRange, name, "leaves 0 - 30 degrees");
+    check(doneAtMs == 2 * BREATHING_MOVEMENT_DURATION + BREATHING_PAUSE_DURATION, name, "not done after exactly 4.1s");
+    check(planner.positionAt(startMs + 10000) == 0, name, "doesn't stay closed");
+}
+
+// A sampler that runs late or irregularly must agree with one sampling every millisecond
+static void checkSampling()
+{
+    Random random(1);
+    for (int plan = 0; plan < 200; plan++)
+    {
+        std::string name = "irregular sampling, plan " + std::to_string(plan);
+        uint32_t startMs = static_cast<uint32_t>(random.next());
+        ServoMotionPlanner reference;
+        ServoMotionPlanner sampled;
+        int start = static_cast<int>(random.below(181));
+        for (size_t move = 0; move < ServoMotionPlanner::MAX_MOVES; move++)
+        {
+            int target = static_cast<int>(random.below(181));
+            uint32_t durationMs = random.below(1500);
+            Easing easing = static_cast<Easing>(random.below(3));
+            reference.moveTo(target, durationMs, easing, startMs, start);
+            sampled.moveTo(target, durationMs, easing, startMs, start);
+        }
+
+        bool same = true;
+        uint32_t sampledAtMs = 0;
+        for (uint32_t elapsedMs = 0; elapsedMs < 7000; elapsedMs++)
+        {
+            int expected = reference.positionAt(startMs + elapsedMs);
+            if (elapsedMs == sampledAtMs)
+            {
+                same = same && sampled.positionAt(startMs + elapsedMs) == expected && sampled.isActive() == reference.isActive();
+                sampledAtMs += 1 + random.below(random.below(4) == 0 ? 400 : MOTION_STEP_MS * 2);
+            }
+        }
+        check(same, name, "differs from sampling every millisecond");
+    }
+}
+
+static void checkPlans()
+{
+    checkBreathing(1000, "breathing");
+    checkBreathing(0xFFFFFFFFu - 1500, "breathing across the millis() wraparound");
+
+    // Moves queued on a running plan start when it ends, not when they're queued
+    ServoMotionPlanner planner;
+    planner.moveTo(100, 1000, Easing::LINEAR, 0, 0);
+    planner.positionAt(500);
+    planner.moveTo(0, 1000, Easing::LINEAR, 500, 50);
+    check(planner.positionAt(1500) == 50, "move queued on a running plan", "didn't start when the plan's move ended");
+
+    // A move queued on an idle plan starts now, from where the servo is
+    planner.cancel();
+    check(!planner.isActive(), "cancel()", "plan still active");
+    planner.moveTo(40, 100, Easing::LINEAR, 100, 7);
+    check(planner.positionAt(100) == 7 && planner.positionAt(150) == 24, "move after cancel()", "didn't start from the servo's position");
+
+    // The queue holds MAX_MOVES
+    planner.cancel();
+    bool queued = true;
+    for (size_t move = 0; move < ServoMotionPlanner::MAX_MOVES; move++)
+    {
+        queued = queued && planner.moveTo(static_cast<int>(move), 10, Easing::LINEAR, 0, 0);
+    }
+    check(queued, "full queue", "refused a move before it was full");
+    check(!planner.moveTo(99, 10, Easing::LINEAR, 0, 0) && !planner.hold(10, 0, 0), "full queue", "took a move past MAX_MOVES");
+
+    // A zero-length move lands at once
+    planner.cancel();
+    planner.moveTo(12, 0, Easing::EASE_IN_OUT_CUBIC, 5, 0);
+    check(planner.positionAt(5) == 12 && !planner.isActive(), "zero-length move", "didn't land at once");
+
+    // Hold on an idle plan keeps the servo where it is
+    planner.hold(50, 10, 33);
+    check(planner.positionAt(30) == 33 && planner.isActive() && planner.positionAt(60) == 33 && !planner.isActive(),
+          "hold on an idle plan", "didn't hold the servo's position");
+}
+
+int main()
+{
+    checkEasing();
+    checkPlans();
+    checkSampling();
+    return checkSummary();
+}
@@ -0,0 +1,130 @@
+/*
+    Playback Drift Test (host-side tool)
+
+    Runs PlaybackDriftCorrector against simulated skits and checks it the way the Secondary uses it. The Secondary
+    plays drift ppm faster than the Primary from a start gap, and gets a gap measurement every second with the
+    measurement noise given. Corrections are spliced in as AudioPlayer does: one frame at most every
+    DRIFT_CORRECTION_SPACING_FRAMES. For every combination of drift, noise, start gap and seed it checks that:
+      - without drift, nothing is corrected
+      - with drift, frames are only ever spliced against it (inserted when the Secondary runs fast, dropped when slow)
+      - the true gap stays within MAX_GAP_MICROS once the drift has been measured (about 30s in with the most noise)
+      - the measured drift ends within MAX_DRIFT_ERROR_PPM of the true one
+    Prints one line per skit, then each that failed and a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/playback_drift_test.cpp playback_drift_corrector.cpp -o playback_drift_test
+
+    Usage:
+        ./playback_drift_test
+*/
+
+#include "playback_drift_corrector.h"
+#include "test_support.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+static constexpr uint32_t SAMPLE_RATE = 44100;                   // AudioPlayer::AUDIO_SAMPLE_RATE
+static constexpr int32_t DRIFT_CORRECTION_SPACING_FRAMES = 882;  // AudioPlayer
+static constexpr int64_t REPORT_INTERVAL_MICROS = 1000000;       // TwoSkulls.ino PLAYBACK_POSITION_REPORT_INTERVAL
+static constexpr int64_t SKIT_MICROS = 180000000;                // Each skit plays for 3 minutes
+static constexpr int64_t SETTLE_MICROS = 40000000;               // The true gap is checked from here on
+static constexpr int64_t MAX_GAP_MICROS = 1200;
+static constexpr double MAX_DRIFT_ERROR_PPM = 5.0;
+
+struct SkitResult
+{
+    bool passed;
+    int64_t maxGapMicros;     // Largest true gap after SETTLE_MICROS
+    int64_t finalGapMicros;
+    double driftPpm;
+    double driftUncertaintyPpm;
+    uint32_t insertedFrames;
+    uint32_t droppedFrames;
+};
+
+// Play one skit and check the corrector throughout
+static SkitResult runSkit(double driftPpm, double noiseMicros, int64_t startGapMicros, uint64_t seed)
+{
+    Random random(seed);
+    PlaybackDriftCorrector corrector(SAMPLE_RATE);
+    SkitResult result = {true, 0, 0, 0.0, 0.0, 0, 0};
+
+    int32_t pendingFrames = 0;
+    int32_t correctionFrames = 0; // Net frames inserted, as PlaybackPosition::correctionFrames
+    int64_t spliceMicros = static_cast<int64_t>(DRIFT_CORRECTION_SPACING_FRAMES) * 1000000 / SAMPLE_RATE;
+    for (int64_t elapsed = 0; elapsed <= SKIT_MICROS; elapsed += spliceMicros)
+    {
+        // Splice at most one frame per spacing, as AudioPlayer::takeDriftCorrection()
+        if (pendingFrames != 0)
+        {
+            int32_t frame = pendingFrames > 0 ? 1 : -1;
+            pendingFrames -= frame;
+            correctionFrames += frame;
+            (frame > 0 ? result.insertedFrames : result.droppedFrames)++;
+        }
+
+        int64_t trueGap = startGapMicros + llround(driftPpm * static_cast<double>(elapsed) / 1e6) -
+                          static_cast<int64_t>(correctionFrames) * 1000000 / SAMPLE_RATE;
+        result.finalGapMicros = trueGap;
+        if (elapsed >= SETTLE_MICROS)
+        {
+            result.maxGapMicros = std::max<int64_t>(result.maxGapMicros, llabs(trueGap));
+        }
+
+        if (elapsed % REPORT_INTERVAL_MICROS < spliceMicros)
+        {
+            int64_t measuredGap = trueGap + llround(noiseMicros * random.normal());
+            pendingFrames = corrector.update(elapsed, measuredGap, correctionFrames);
+        }
+    }
+
+    result.driftPpm = corrector.driftPpm();
+    result.driftUncertaintyPpm = corrector.driftUncertaintyPpm();
+    if (driftPpm == 0.0 && (result.insertedFrames > 0 || result.droppedFrames > 0))
+    {
+        result.passed = false;
+    }
+    if ((driftPpm > 0.0 && result.droppedFrames > 0) || (driftPpm < 0.0 && result.insertedFrames > 0))
+    {
+        result.passed = false;
+    }
+    if (result.maxGapMicros > MAX_GAP_MICROS || fabs(result.driftPpm - driftPpm) > MAX_DRIFT_ERROR_PPM)
+    {
+        result.passed = false;
+    }
+    return result;
+}
+
+int main()
+{
+    const double drifts[] = {-40.0, -25.0, -10.0, 0.0, 10.0, 25.0, 40.0};
+    const double noises[] = {0.0, 100.0, 300.0};
+    const int64_t startGaps[] = {-400, 0, 400};
+    const uint64_t seeds[] = {1, 2, 3};
+
+    printf("drift_ppm,noise_us,start_gap_us,seed,max_gap_us,final_gap_us,measured_drift_ppm,drift_uncertainty_ppm,"
+           "inserted,dropped,result\n");
+    for (double drift : drifts)
+    {
+        for (double noise : noises)
+        {
+            for (int64_t startGap : startGaps)
+            {
+                for (uint64_t seed : seeds)
+                {
+                    SkitResult result = runSkit(drift, noise, startGap, seed);
+                    printf("%.0f,%.0f,%lld,%llu,%lld,%lld,%.1f,%.1f,%u,%u,%s\n", drift, noise, static_cast<long long>(startGap),
+                           static_cast<unsigned long long>(seed), static_cast<long long>(result.maxGapMicros),
+                           static_cast<long long>(result.finalGapMicros), result.driftPpm, result.driftUncertaintyPpm,
+                           result.insertedFrames, result.droppedFrames, result.passed ? "ok" : "FAILED");
+                    check(result.passed, std::to_string(static_cast<int>(drift)) + " ppm, " + std::to_string(static_cast<int>(noise)) + " us noise, " +
+                                             std::to_string(startGap) + " us start gap, seed " + std::to_string(seed),
+                          "gap too large, drift off or frames corrected the wrong way");
+                }
+            }
+        }
+    }
+    return checkSummary();
+}
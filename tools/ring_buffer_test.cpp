@@ -0,0 +1,216 @@
+/*
+    Ring Buffer Test (host-side tool)
+
+    Stress-tests AudioRingBuffer and SpscQueue with a real producer thread and consumer thread, the way AudioPlayer
+    uses them: the producer writes chunks of a known byte stream and queues a marker at some chunk boundaries; the
+    consumer reads, skips and peeks in sizes of its own and pops the markers as it passes them. Every byte the consumer
+    sees is checked against the stream, every marker against the position it was queued at, and with a retained size
+    every peek back into audio already read must still find it there. Chunk sizes are random, so the threads keep
+    meeting at different points of the buffer and of its wrap-around.
+
+    Each configuration (capacity, retained size) streams STREAM_BYTES. Prints one line per configuration, then each
+    that failed and a summary, and exits non-zero if any failed. Building with -fsanitize=thread as well also checks
+    the memory ordering.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -pthread -I. tools/ring_buffer_test.cpp audio_ring_buffer.cpp -o ring_buffer_test
+
+    Usage:
+        ./ring_buffer_test
+*/
+
+#include "audio_ring_buffer.h"
+#include "test_support.h"
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+static constexpr size_t STREAM_BYTES = 64 * 1024 * 1024;
+static constexpr size_t MAX_CHUNK = 1024;
+static constexpr size_t MARKER_QUEUE_SIZE = 8; // AudioPlayer::FILE_MARKER_QUEUE_SIZE
+
+// The byte at a position of the stream
+static uint8_t streamByte(size_t position)
+{
+    return static_cast<uint8_t>((position * 2654435761u) >> 13);
+}
+
+// Marker queued by the producer: the stream position it was queued at
+struct Marker
+{
+    size_t position;
+    size_t index;
+};
+
+struct StressResult
+{
+    bool passed;
+    size_t badBytes;
+    size_t badPeeks;
+    size_t badMarkers;
+    size_t markers;
+    size_t peeks;
+};
+
+// Stream STREAM_BYTES through a buffer of the given capacity and retained size
+static StressResult runStress(size_t capacity, size_t retainedSize, uint64_t seed)
+{
+    AudioRingBuffer buffer(capacity);
+    buffer.setRetainedSize(retainedSize);
+    SpscQueue<Marker, MARKER_QUEUE_SIZE> markers;
+    StressResult result = {true, 0, 0, 0, 0, 0};
+    std::atomic<size_t> markersQueued(0);
+
+    std::thread producer([&]()
+                         {
+        Random random(seed);
+        uint8_t chunk[MAX_CHUNK];
+        size_t position = 0;
+        size_t markerIndex = 0;
+        while (position < STREAM_BYTES)
+        {
+            size_t size = std::min<size_t>(1 + random.below(MAX_CHUNK), STREAM_BYTES - position);
+            for (size_t i = 0; i < size; i++)
+            {
+                chunk[i] = streamByte(position + i);
+            }
+            size_t written = 0;
+            while (written < size)
+            {
+                size_t count = buffer.write(chunk + written, size - written);
+                if (count == 0)
+                {
+                    std::this_thread::yield(); // Full: let the consumer run, as the producer task sleeps
+                }
+                written += count;
+            }
+            position += size;
+
+            // As AudioPlayer queues a file transition at the buffer position where it occurs
+            if (random.below(16) == 0 && markers.freeSlots() > 0)
+            {
+                markers.push({position, markerIndex++});
+            }
+        }
+        markersQueued.store(markerIndex, std::memory_order_release); });
+
+    std::thread consumer([&]()
+                         {
+        Random random(seed ^ 0x5555);
+        uint8_t data[MAX_CHUNK];
+        size_t position = 0;
+        size_t nextMarker = 0;
+        while (position < STREAM_BYTES)
+        {
+            // The audio before a marker is in the buffer by the time the marker can be seen. Markers at or before the
+            // read position have been passed.
+            const Marker *next = markers.front();
+            if (next != nullptr && next->position > position + buffer.available())
+            {
+                result.badMarkers++;
+            }
+            for (const Marker *marker = next; marker != nullptr && marker->position <= position; marker = markers.front())
+            {
+                if (marker->index != nextMarker)
+                {
+                    result.badMarkers++;
+                }
+                nextMarker = marker->index + 1;
+                markers.pop();
+            }
+
+            if (buffer.available() == 0)
+            {
+                std::this_thread::yield(); // Empty: let the producer run, as the A2DP callback returns
+                continue;
+            }
+
+            size_t operation = 1 + random.below(8);
+            size_t size = 1 + random.below(MAX_CHUNK);
+            if (operation == 1)
+            {
+                size_t skipped = buffer.skip(size);
+                position += skipped;
+                continue;
+            }
+            if (operation == 2)
+            {
+                // Peek ahead into what's there, or back into what's retained
+                size_t ahead = buffer.available();
+                ptrdiff_t offset;
+                if (retainedSize > 0 && position > 0 && random.below(2) == 0)
+                {
+                    offset = -static_cast<ptrdiff_t>(1 + random.below(std::min(retainedSize, position)));
+                }
+                else
+                {
+                    offset = ahead > 0 ? static_cast<ptrdiff_t>(random.below(ahead)) : 0;
+                }
+                size_t peeked = buffer.peek(offset, data, size);
+                result.peeks++;
+                for (size_t i = 0; i < peeked; i++)
+                {
+                    if (data[i] != streamByte(position + offset + i))
+                    {
+                        result.badPeeks++;
+                        break;
+                    }
+                }
+                if (offset < 0 && peeked == 0)
+                {
+                    result.badPeeks++; // Retained audio must always be there to look back at
+                }
+                continue;
+            }
+
+            size_t read = buffer.read(data, size);
+            for (size_t i = 0; i < read; i++)
+            {
+                if (data[i] != streamByte(position + i))
+                {
+                    result.badBytes++;
+                }
+            }
+            position += read;
+        }
+        result.markers = nextMarker; });
+
+    producer.join();
+    consumer.join();
+    size_t queued = markersQueued.load(std::memory_order_acquire);
+    while (markers.front() != nullptr)
+    {
+        result.markers = markers.front()->index + 1; // Queued at the very end of the stream
+        markers.pop();
+    }
+    if (result.markers != queued)
+    {
+        result.badMarkers++;
+    }
+    result.passed = result.badBytes == 0 && result.badPeeks == 0 && result.badMarkers == 0;
+    return result;
+}
+
+int main()
+{
+    // Capacities as AudioPlayer gets them: the default, one that's rounded up, and the smallest the config allows,
+    // with and without the look-back a negative jaw lookahead needs
+    const size_t capacities[] = {4096, 8000, 8192};
+    const size_t retainedSizes[] = {0, 2048};
+
+    printf("capacity,retained,megabytes,markers,peeks,bad_bytes,bad_peeks,bad_markers,result\n");
+    uint64_t seed = 1;
+    for (size_t capacity : capacities)
+    {
+        for (size_t retainedSize : retainedSizes)
+        {
+            StressResult result = runStress(capacity, retainedSize, seed++);
+            printf("%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%s\n", capacity, retainedSize, STREAM_BYTES / (1024 * 1024), result.markers,
+                   result.peeks, result.badBytes, result.badPeeks, result.badMarkers, result.passed ? "ok" : "FAILED");
+            check(result.passed, std::to_string(capacity) + "-byte capacity, " + std::to_string(retainedSize) + " retained",
+                  "bytes, peeks or markers came out wrong");
+        }
+    }
+    return checkSummary();
+}
@@ -0,0 +1,140 @@
+/*
+    SD Card Checker (host-side tool)
+
+    Reads a copy of a skull's SD card the way the skull does at startup: config.txt, and every "/audio/Skit*.wav"
+    with its txt script. Prints the settings, each skit's catalog ID and line count, and the skit catalog hash.
+    The two skulls only start skits together if their hashes match (the Primary logs "skit catalogs differ"
+    otherwise), so run it on both cards before putting them in.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/sd_card_checker.cpp config_parser.cpp skit_script_parser.cpp skit_catalog.cpp \
+            -o sd_card_checker
+
+    Usage:
+        ./sd_card_checker <SD card folder> [config file name, default config.txt]
+    e.g.
+        ./sd_card_checker sd_card_files config_primary.txt
+*/
+
+#include "config_parser.h"
+#include "skit_script_parser.h"
+#include "skit_catalog.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reads a whole file. Returns false if it can't be opened.
+static bool readFile(const std::string &path, std::string &text)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    text.clear();
+    char buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        text.append(buffer, bytesRead);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool endsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <SD card folder> [config file name]\n", argv[0]);
+        return 1;
+    }
+    std::string root = argv[1];
+    std::string configName = argc > 2 ? argv[2] : "config.txt";
+
+    // Settings, as ConfigManager reads them
+    std::string configText;
+    if (readFile(root + "/" + configName, configText))
+    {
+        printf("%s:\n", configName.c_str());
+        size_t lineStart = 0;
+        while (lineStart < configText.size())
+        {
+            size_t lineEnd = configText.find('\n', lineStart);
+            if (lineEnd == std::string::npos)
+            {
+                lineEnd = configText.size();
+            }
+            std::string key;
+            std::string value;
+            if (ConfigParser::parseLine(configText.substr(lineStart, lineEnd - lineStart), key, value))
+            {
+                printf("  %s: %s\n", key.c_str(), value.c_str());
+            }
+            lineStart = lineEnd + 1;
+        }
+    }
+    else
+    {
+        printf("%s: missing (the skull retries until it can load it)\n", configName.c_str());
+    }
+
+    // Skits, as SDCardManager finds them: a "Skit*.wav" with a txt script of the same name
+    DIR *audioDirectory = opendir((root + "/audio").c_str());
+    if (audioDirectory == nullptr)
+    {
+        fprintf(stderr, "Can't open %s/audio\n", root.c_str());
+        return 1;
+    }
+    std::vector<std::string> fileNames;
+    while (dirent *entry = readdir(audioDirectory))
+    {
+        std::string fileName = entry->d_name;
+        if (fileName.compare(0, 4, "Skit") == 0 && endsWith(fileName, ".wav"))
+        {
+            fileNames.push_back(fileName);
+        }
+    }
+    closedir(audioDirectory);
+
+    SkitCatalog catalog;
+    std::map<std::string, size_t> lineCounts;
+    for (const std::string &fileName : fileNames)
+    {
+        std::string baseName = fileName.substr(0, fileName.rfind('.'));
+        std::string audio;
+        std::string script;
+        if (!readFile(root + "/audio/" + baseName + ".txt", script))
+        {
+            printf("WARNING: %s has no txt file; the skulls won't play it\n", fileName.c_str());
+            continue;
+        }
+        if (!readFile(root + "/audio/" + fileName, audio))
+        {
+            printf("WARNING: can't read %s\n", fileName.c_str());
+            continue;
+        }
+
+        std::vector<ParsedSkitLine> lines = SkitScriptParser::parse(script);
+        std::string audioFile = "/audio/" + fileName; // The path on the card, as the skulls name it
+        catalog.add(audioFile, SkitCatalog::fingerprint(static_cast<uint32_t>(audio.size()), lines));
+        lineCounts[audioFile] = lines.size();
+    }
+    catalog.finalize();
+
+    printf("Skits:\n");
+    for (uint16_t id = 1; id <= catalog.size(); id++)
+    {
+        const std::string *audioFile = catalog.audioFileOf(id);
+        printf("  %3u  %s (%u lines)\n", id, audioFile->c_str(), static_cast<unsigned>(lineCounts[*audioFile]));
+    }
+    printf("Skit catalog: %u skits, hash %08lx\n", static_cast<unsigned>(catalog.size()), static_cast<unsigned long>(catalog.hash()));
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+/*
+    What the host-side tests share: named pass/fail checks with a summary for main() to return, and random numbers
+    that are the same on every machine. Each test is a single translation unit, so everything here is defined in the
+    header with internal linkage.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+// Checks run and failed so far
+static int s_checks = 0;
+static int s_failures = 0;
+
+// Count a check, and print its name and what went wrong if it failed
+static inline void check(bool passed, const std::string &name, const char *what)
+{
+    s_checks++;
+    if (!passed)
+    {
+        s_failures++;
+        printf("FAILED: %s: %s\n", name.c_str(), what);
+    }
+}
+
+// Print how many checks failed, if any. Returns main()'s exit code: non-zero if any failed.
+static inline int checkSummary()
+{
+    if (s_failures > 0)
+    {
+        printf("%d of %d checks FAILED\n", s_failures, s_checks);
+        return 1;
+    }
+    printf("All %d checks passed\n", s_checks);
+    return 0;
+}
+
+// splitmix64, so a run is the same on every machine
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : m_state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, limit)
+    uint32_t below(uint32_t limit) { return static_cast<uint32_t>(next() % limit); }
+
+    // Uniform in [0, 1)
+    double uniform() { return static_cast<double>(next() >> 11) / 9007199254740992.0; }
+
+    // Normal with mean 0 and standard deviation 1 (Box-Muller, on uniforms in (0, 1) so the log is finite)
+    double normal()
+    {
+        double radius = sqrt(-2.0 * log((static_cast<double>(next() >> 11) + 0.5) / 9007199254740992.0));
+        return radius * cos(6.283185307179586 * ((static_cast<double>(next() >> 11) + 0.5) / 9007199254740992.0));
+    }
+
+private:
+    uint64_t m_state;
+};
+
+#endif // TEST_SUPPORT_H
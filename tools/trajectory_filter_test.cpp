@@ -0,0 +1,267 @@
+/*
+    Trajectory Filter Test (host-side tool)
+
+    Checks ServoTrajectoryFilter with its default limits:
+      - On recorded traces: the jaw target SkullAudioAnimator::updateJawPosition() computes from each .wav file in an
+        SD card folder's audio directory (RMS of each 128-frame A2DP request, smoothed, gained, thresholded, mapped
+        to the default 0 - 80 degrees and smoothed again), filtered one request at a time as ServoController's
+        followPosition() does. The filtered jaw must never exceed the velocity or acceleration limit, must track the
+        target within MAX_TRACKING_ERROR_RMS, and no servo write (a change of the rounded position; the others are
+        suppressed) may move it further than the velocity limit allows in one request. It makes a few more writes
+        than writing the target straight through, as it passes through the positions in between, but much smaller
+        ones.
+      - Step responses: a held target is reached without overshoot, settles exactly on it, and takes no longer than
+        the trapezoidal velocity profile the limits allow, plus up to three steps for working in whole steps.
+      - A target reversing mid-move brakes within the acceleration limit; no limits means a jump to the target; a
+        zero-length step changes nothing.
+    Prints one line per trace and each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. -Itools/host tools/trajectory_filter_test.cpp servo_trajectory_filter.cpp wav_header_parser.cpp \
+            audio_level.cpp jaw_envelope.cpp -o trajectory_filter_test
+
+    Usage:
+        ./trajectory_filter_test [SD card folder]     (default: sd_card_files)
+*/
+
+#include "servo_trajectory_filter.h"
+#include "wav_header_parser.h"
+#include "audio_level.h"
+#include "jaw_envelope.h"
+#include "test_support.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static constexpr int SERVO_MIN_DEGREES = 0; // ConfigManager's defaults
+static constexpr int SERVO_MAX_DEGREES = 80;
+static constexpr double JAW_POSITION_SMOOTHING_FACTOR = 0.2; // SkullAudioAnimator::JAW_POSITION_SMOOTHING_FACTOR
+static constexpr float REQUEST_SECONDS = static_cast<float>(JawEnvelope::ANALYSIS_BLOCK_FRAMES) / JawEnvelope::ANALYSIS_SAMPLE_RATE;
+static constexpr float MAX_TRACKING_ERROR_RMS = 9.0f; // The jaw lags fast onsets; see servo_trajectory_filter.h
+static constexpr float TOLERANCE = 1.001f; // Float rounding on the limits
+
+// Reads a WAV header from a stdio file
+class StdioByteSource : public WavByteSource
+{
+public:
+    StdioByteSource(FILE *file) : m_file(file) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return fread(buffer, 1, size, m_file);
+    }
+
+    bool skip(uint32_t size) override
+    {
+        return fseek(m_file, size, SEEK_CUR) == 0;
+    }
+
+private:
+    FILE *m_file;
+};
+
+// The jaw target for each A2DP request of a 44.1kHz stereo PCM file, as updateJawPosition() works it out from the
+// audio. Empty if the file isn't in that format.
+static std::vector<int> jawTrace(const std::string &path)
+{
+    std::vector<int> targets;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return targets;
+    }
+    fseek(file, 0, SEEK_END);
+    uint32_t fileSize = static_cast<uint32_t>(ftell(file));
+    rewind(file);
+
+    WavFormat format;
+    StdioByteSource source(file);
+    if (WavHeaderParser::parse(source, fileSize, format) != WavParseResult::OK || format.audioFormat != WavHeaderParser::FORMAT_PCM ||
+        format.numChannels != 2 || format.sampleRate != JawEnvelope::ANALYSIS_SAMPLE_RATE || format.bitsPerSample != 16)
+    {
+        fclose(file);
+        return targets;
+    }
+
+    std::vector<int16_t> request(JawEnvelope::ANALYSIS_BLOCK_FRAMES * 2);
+    double smoothedAmplitude = 0;
+    int previousJawPosition = 0;
+    for (uint32_t remaining = format.dataSize / 4; remaining >= JawEnvelope::ANALYSIS_BLOCK_FRAMES; remaining -= JawEnvelope::ANALYSIS_BLOCK_FRAMES)
+    {
+        if (fread(request.data(), 4, JawEnvelope::ANALYSIS_BLOCK_FRAMES, file) != JawEnvelope::ANALYSIS_BLOCK_FRAMES)
+        {
+            break;
+        }
+        smoothedAmplitude = JawEnvelope::smoothAmplitude(smoothedAmplitude, AudioLevel::rms(request.data(), request.size()));
+        double adjustedAmplitude = JawEnvelope::adjustAmplitude(smoothedAmplitude);
+        int targetJawPosition = static_cast<int>(adjustedAmplitude * (SERVO_MAX_DEGREES - SERVO_MIN_DEGREES) / JawEnvelope::MAX_EXPECTED_AMPLITUDE + SERVO_MIN_DEGREES);
+        int jawPosition = static_cast<int>(JAW_POSITION_SMOOTHING_FACTOR * targetJawPosition + (1 - JAW_POSITION_SMOOTHING_FACTOR) * previousJawPosition);
+        targets.push_back(jawPosition);
+        previousJawPosition = jawPosition;
+    }
+    fclose(file);
+    return targets;
+}
+
+// Filter a trace one request at a time and check the limits, the tracking and the writes
+static void checkTrace(const std::string &path)
+{
+    std::vector<int> targets = jawTrace(path);
+    check(!targets.empty(), path, "not a 44.1kHz stereo 16-bit PCM file");
+    if (targets.empty())
+    {
+        return;
+    }
+
+    ServoTrajectoryFilter filter;
+    filter.reset(0);
+    float previousVelocity = 0;
+    float maxSpeed = 0;
+    float maxAcceleration = 0;
+    double squaredError = 0;
+    int filteredPosition = -1;
+    int directPosition = -1;
+    size_t filteredWrites = 0;
+    size_t directWrites = 0;
+    int maxDirectJump = 0;
+    int maxFilteredJump = 0;
+    for (int target : targets)
+    {
+        float position = filter.update(static_cast<float>(target), REQUEST_SECONDS);
+        maxSpeed = std::max(maxSpeed, fabsf(filter.velocity()));
+        maxAcceleration = std::max(maxAcceleration, fabsf(filter.velocity() - previousVelocity) / REQUEST_SECONDS);
+        previousVelocity = filter.velocity();
+        squaredError += (position - target) * (position - target);
+
+        // ServoController writes only when the rounded position changes
+        int rounded = static_cast<int>(lroundf(position));
+        if (rounded != filteredPosition)
+        {
+            maxFilteredJump = filteredPosition < 0 ? 0 : std::max(maxFilteredJump, abs(rounded - filteredPosition));
+            filteredPosition = rounded;
+            filteredWrites++;
+        }
+        if (target != directPosition)
+        {
+            maxDirectJump = directPosition < 0 ? 0 : std::max(maxDirectJump, abs(target - directPosition));
+            directPosition = target;
+            directWrites++;
+        }
+    }
+    float errorRms = static_cast<float>(sqrt(squaredError / targets.size()));
+
+    printf("%s: %zu requests, tracking error %.2f deg RMS, max %.0f deg/s and %.0f deg/s^2, %zu writes (%zu suppressed), "
+           "largest write %d deg; direct: %zu writes, largest %d deg\n",
+           path.c_str(), targets.size(), errorRms, maxSpeed, maxAcceleration, filteredWrites, targets.size() - filteredWrites,
+           maxFilteredJump, directWrites, maxDirectJump);
+    check(maxSpeed <= ServoTrajectoryFilter::DEFAULT_MAX_VELOCITY * TOLERANCE, path, "over the velocity limit");
+    check(maxAcceleration <= ServoTrajectoryFilter::DEFAULT_MAX_ACCELERATION * TOLERANCE, path, "over the acceleration limit");
+    check(errorRms <= MAX_TRACKING_ERROR_RMS, path, "doesn't track the target within MAX_TRACKING_ERROR_RMS");
+    check(maxFilteredJump <= ceilf(ServoTrajectoryFilter::DEFAULT_MAX_VELOCITY * REQUEST_SECONDS) + 1, path,
+          "a servo write moves it further than the velocity limit allows");
+}
+
+static void checkCard(const std::string &root)
+{
+    std::string audio = root + "/audio";
+    DIR *directory = opendir(audio.c_str());
+    if (directory == nullptr)
+    {
+        check(false, audio, "can't open directory");
+        return;
+    }
+    std::vector<std::string> paths;
+    while (dirent *entry = readdir(directory))
+    {
+        std::string fileName = entry->d_name;
+        if (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".wav") == 0)
+        {
+            paths.push_back(audio + "/" + fileName);
+        }
+    }
+    closedir(directory);
+    std::sort(paths.begin(), paths.end());
+    check(!paths.empty(), audio, "no .wav files");
+    for (const std::string &path : paths)
+    {
+        checkTrace(path);
+    }
+}
+
+// Time a trapezoidal (or triangular) velocity profile takes to cover a distance from rest to rest
+static float profileSeconds(float distance, float maxVelocity, float maxAcceleration)
+{
+    float rampDistance = maxVelocity * maxVelocity / maxAcceleration; // Up to full speed and back down
+    if (distance <= rampDistance)
+    {
+        return 2.0f * sqrtf(distance / maxAcceleration);
+    }
+    return 2.0f * maxVelocity / maxAcceleration + (distance - rampDistance) / maxVelocity;
+}
+
+static void checkSteps()
+{
+    const float distances[] = {0.5f, 3.0f, 10.0f, 25.0f, 80.0f, -40.0f};
+    const float stepSeconds[] = {0.0005f, REQUEST_SECONDS, 0.02f};
+    for (float distance : distances)
+    {
+        for (float dt : stepSeconds)
+        {
+            std::string name = "step of " + std::to_string(distance) + " deg, " + std::to_string(dt * 1000) + " ms steps";
+            ServoTrajectoryFilter filter;
+            filter.reset(10);
+            float target = 10 + distance;
+            bool overshot = false;
+            bool settled = false;
+            int steps = 0;
+            for (; steps < 10000 && !settled; steps++)
+            {
+                float position = filter.update(target, dt);
+                overshot = overshot || (distance > 0 ? position > target : position < target);
+                settled = position == target && filter.velocity() == 0.0f;
+            }
+            float limitSeconds = profileSeconds(fabsf(distance), ServoTrajectoryFilter::DEFAULT_MAX_VELOCITY,
+                                                ServoTrajectoryFilter::DEFAULT_MAX_ACCELERATION);
+            check(!overshot, name, "overshoots the target");
+            check(settled, name, "never settles on the target");
+            check(steps * dt <= limitSeconds + 3 * dt, name, "slower than the limits allow");
+        }
+    }
+
+    // Reversing the target mid-move: the filter has to brake, within the acceleration limit
+    ServoTrajectoryFilter filter;
+    filter.reset(0);
+    for (int i = 0; i < 20; i++)
+    {
+        filter.update(80, REQUEST_SECONDS);
+    }
+    bool withinLimit = true;
+    for (int i = 0; i < 200; i++)
+    {
+        float velocity = filter.velocity();
+        filter.update(0, REQUEST_SECONDS);
+        withinLimit = withinLimit && fabsf(filter.velocity() - velocity) <= ServoTrajectoryFilter::DEFAULT_MAX_ACCELERATION * REQUEST_SECONDS * TOLERANCE;
+    }
+    check(withinLimit, "target reversed mid-move", "over the acceleration limit");
+    check(filter.position() == 0.0f && filter.velocity() == 0.0f, "target reversed mid-move", "never settles on the target");
+
+    // No limits: straight to the target
+    filter.setLimits(0, 0);
+    filter.reset(5);
+    check(filter.update(70, REQUEST_SECONDS) == 70.0f, "no limits", "doesn't jump to the target");
+
+    // A zero-length step changes nothing
+    filter.setLimits(ServoTrajectoryFilter::DEFAULT_MAX_VELOCITY, ServoTrajectoryFilter::DEFAULT_MAX_ACCELERATION);
+    filter.reset(20);
+    check(filter.update(60, 0.0f) == 20.0f && filter.velocity() == 0.0f, "zero-length step", "moved");
+}
+
+int main(int argc, char *argv[])
+{
+    checkCard(argc > 1 ? argv[1] : "sd_card_files");
+    checkSteps();
+    return checkSummary();
+}
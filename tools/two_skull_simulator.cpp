@@ -0,0 +1,1481 @@
+/*
+    Two Skull Simulator (host-side tool)
+
+    Runs a Primary and a Secondary skull against each other on a virtual clock, so timing problems seen in the field
+    can be reproduced, and changes to the sync code checked, without two ESP32s and two speakers.
+
+    Each skull has its own crystal (a ppm error and a boot time), its own A2DP sink pulling 128 frame requests at
+    44.1kHz on that crystal, and its own SD card. The skulls talk over a simulated BLE link: a packet waits for the
+    next connection event, plus an optional fixed latency, and each time it's lost it's resent at the event after.
+    Matter triggers fire on a schedule. Everything else is the skulls' own code where it can run on a host: the clock
+    sync (ClockSyncEstimator), the start commands (SkitStartProtocol, SkitCatalog), the skit choice (SkitSelector),
+    the playback drift correction (PlaybackDriftCorrector) and the jaw (AudioLevel, JawEnvelope, SkitLineIndex,
+    ServoTrajectoryFilter). The parts that need the hardware are modelled after it: the skit and BLE task logic of
+    TwoSkulls.ino and bluetooth_controller, and AudioPlayer's ring buffer, scheduled start and frame splicing.
+
+    For each skit it reports the handshake latency, the start skew (the true one, and what the skulls measure), how
+    far apart the skulls' playback got, the drift correction and any dropouts (A2DP requests the SD producer couldn't
+    fill). It finishes with a summary. --jaw-csv writes both skulls' jaw angles at every callback.
+
+    A run depends only on its options: the same seed gives the same output.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. -Itools/host tools/two_skull_simulator.cpp clock_sync_estimator.cpp playback_drift_corrector.cpp \
+            skit_start_protocol.cpp skit_catalog.cpp skit_script_parser.cpp skit_selector.cpp skit_line_index.cpp \
+            audio_ring_buffer.cpp audio_level.cpp jaw_envelope.cpp servo_trajectory_filter.cpp latency_histogram.cpp \
+            wav_header_parser.cpp ima_adpcm_decoder.cpp audio_format_converter.cpp -o two_skull_simulator
+
+    Usage:
+        ./two_skull_simulator [options] <SD card folder>
+    e.g.
+        ./two_skull_simulator --loss 0.3 --secondary-ppm -40 sd_card_files
+    Run it without arguments for the options.
+*/
+
+#include "clock_sync_estimator.h"
+#include "playback_drift_corrector.h"
+#include "skit_start_protocol.h"
+#include "skit_catalog.h"
+#include "skit_script_parser.h"
+#include "skit_selector.h"
+#include "skit_line_index.h"
+#include "audio_ring_buffer.h"
+#include "audio_level.h"
+#include "jaw_envelope.h"
+#include "servo_trajectory_filter.h"
+#include "latency_histogram.h"
+#include "wav_header_parser.h"
+#include "ima_adpcm_decoder.h"
+#include "audio_format_converter.h"
+#include "test_support.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+// Device constants this models, as set in the sketch and the classes that can't be built here
+static constexpr uint32_t SAMPLE_RATE = JawEnvelope::ANALYSIS_SAMPLE_RATE;        // AudioPlayer::AUDIO_SAMPLE_RATE
+static constexpr int32_t CALLBACK_FRAMES = JawEnvelope::ANALYSIS_BLOCK_FRAMES;    // A2DP request size
+static constexpr size_t AUDIO_BUFFER_SIZE = 8192;                                 // AudioPlayer::DEFAULT_AUDIO_BUFFER_SIZE
+static constexpr size_t FILE_READ_CHUNK_SIZE = 512;                               // AudioPlayer::FILE_READ_CHUNK_SIZE
+static constexpr int32_t DRIFT_CORRECTION_SPACING_FRAMES = 882;                   // AudioPlayer
+static constexpr int64_t PLAYBACK_POSITION_WINDOW_MICROS = 500000;                // AudioPlayer
+static constexpr int64_t TASK_INTERVAL_MICROS = 10000;                            // BLE and skit task periods
+static constexpr int64_t SKIT_START_LEAD_MS = 500;                                // TwoSkulls.ino
+static constexpr int64_t SKIT_START_REPORT_TIMEOUT = 5000;                        // TwoSkulls.ino
+static constexpr int64_t PLAYBACK_POSITION_REPORT_INTERVAL = 1000;                // TwoSkulls.ino
+static constexpr int64_t AUDIO_COOLDOWN_TIME = 10000;                             // TwoSkulls.ino
+static constexpr int64_t CLOCK_SYNC_FAST_INTERVAL = 200;                          // bluetooth_controller
+static constexpr int64_t CLOCK_SYNC_INTERVAL = 1000;                              // bluetooth_controller
+static constexpr int64_t COMMAND_TIMEOUT = 5000;                                  // bluetooth_controller
+static constexpr double JAW_POSITION_SMOOTHING_FACTOR = 0.2;                      // SkullAudioAnimator
+static constexpr int SERVO_MIN_DEGREES = 0;                                       // ConfigManager defaults
+static constexpr int SERVO_MAX_DEGREES = 80;
+
+static constexpr uint32_t NO_TRACK = 0;
+
+struct SimulationConfig
+{
+    uint64_t seed = 1;
+    double durationSeconds = 300;
+    double connectionIntervalMs = 30;  // BLE connection interval
+    double latencyMs = 0;              // Added to every BLE packet's delay
+    double lossRate = 0.1;             // Chance a BLE packet is lost and resent at the next connection event
+    double primaryPpm = 10;            // Crystal errors
+    double secondaryPpm = -15;
+    double callbackJitterMicros = 500; // A2DP requests come up to this late
+    double firstTriggerSeconds = 5;
+    double triggerIntervalSeconds = 45;
+    double sdStallsPerSecond = 0;      // SD card reads that stall the producer
+    double sdStallMs = 50;
+    std::string primaryCard;
+    std::string secondaryCard;         // Defaults to the Primary's
+    std::string jawCsvPath;
+};
+
+// Runs actions in order of true (real world) time; actions at the same time run in the order they were scheduled
+class Scheduler
+{
+public:
+    void at(int64_t trueMicros, std::function<void()> action)
+    {
+        m_events.push({std::max(trueMicros, m_now), m_order++, std::move(action)});
+    }
+
+    // Run everything due up to endMicros
+    void runUntil(int64_t endMicros)
+    {
+        while (!m_events.empty() && m_events.top().atMicros <= endMicros)
+        {
+            Event event = m_events.top();
+            m_events.pop();
+            m_now = event.atMicros;
+            event.action();
+        }
+        m_now = endMicros;
+    }
+
+    int64_t now() const { return m_now; }
+
+private:
+    struct Event
+    {
+        int64_t atMicros;
+        uint64_t order;
+        std::function<void()> action;
+        bool operator<(const Event &other) const
+        {
+            return atMicros != other.atMicros ? atMicros > other.atMicros : order > other.order;
+        }
+    };
+
+    std::priority_queue<Event> m_events;
+    uint64_t m_order = 0;
+    int64_t m_now = 0;
+};
+
+// A skull's esp_timer_get_time(): it booted bootMicros before the simulation started and runs ppm fast
+struct SkullClock
+{
+    int64_t bootMicros;
+    double ppm;
+
+    int64_t localMicros(int64_t trueMicros) const
+    {
+        return bootMicros + trueMicros + static_cast<int64_t>(floor(trueMicros * ppm * 1e-6));
+    }
+
+    // The first true time the local clock reads at least localMicros
+    int64_t trueMicros(int64_t localMicros) const
+    {
+        int64_t trueMicros = static_cast<int64_t>(ceil((localMicros - bootMicros) / (1.0 + ppm * 1e-6)));
+        while (this->localMicros(trueMicros) < localMicros)
+        {
+            trueMicros++;
+        }
+        return trueMicros;
+    }
+};
+
+// BLE link between the skulls. Packets go out at connection events, in order, and a lost packet is resent at the next.
+class SimulatedLink
+{
+public:
+    enum Direction
+    {
+        TO_SECONDARY,
+        TO_PRIMARY
+    };
+
+    SimulatedLink(const SimulationConfig &config, Random &random, Scheduler &scheduler)
+        : m_intervalMicros(static_cast<int64_t>(config.connectionIntervalMs * 1000)),
+          m_latencyMicros(static_cast<int64_t>(config.latencyMs * 1000)), m_lossRate(config.lossRate), m_random(random),
+          m_scheduler(scheduler), m_phaseMicros(static_cast<int64_t>(random.uniform() * m_intervalMicros))
+    {
+        m_lastDeliveryMicros[TO_SECONDARY] = 0;
+        m_lastDeliveryMicros[TO_PRIMARY] = 0;
+    }
+
+    // Deliver a packet sent now
+    void send(Direction direction, std::function<void()> onDelivered)
+    {
+        int64_t readyMicros = m_scheduler.now() + m_latencyMicros;
+        int64_t events = (readyMicros - m_phaseMicros + m_intervalMicros - 1) / m_intervalMicros;
+        int64_t deliveryMicros = m_phaseMicros + std::max<int64_t>(events, 0) * m_intervalMicros;
+        while (m_random.uniform() < m_lossRate)
+        {
+            deliveryMicros += m_intervalMicros;
+            m_resentPackets++;
+        }
+        deliveryMicros = std::max(deliveryMicros, m_lastDeliveryMicros[direction]);
+        m_lastDeliveryMicros[direction] = deliveryMicros;
+        m_packets++;
+        m_scheduler.at(deliveryMicros, std::move(onDelivered));
+    }
+
+    uint32_t packets() const { return m_packets; }
+    uint32_t resentPackets() const { return m_resentPackets; }
+
+private:
+    int64_t m_intervalMicros;
+    int64_t m_latencyMicros;
+    double m_lossRate;
+    Random &m_random;
+    Scheduler &m_scheduler;
+    int64_t m_phaseMicros; // When the connection events fall
+    int64_t m_lastDeliveryMicros[2];
+    uint32_t m_packets = 0;
+    uint32_t m_resentPackets = 0;
+};
+
+// A skit on a simulated SD card, decoded to the A2DP output format
+struct SimulatedSkit
+{
+    std::string audioFile; // Path on the card
+    std::vector<ParsedSkitLine> lines;
+    std::vector<int16_t> samples; // 44.1kHz stereo
+};
+
+struct SimulatedCard
+{
+    std::vector<SimulatedSkit> skits;
+    SkitCatalog catalog;
+
+    const SimulatedSkit *find(const std::string &audioFile) const
+    {
+        for (const SimulatedSkit &skit : skits)
+        {
+            if (skit.audioFile == audioFile)
+            {
+                return &skit;
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Reads a WAV header from a stdio file
+class StdioByteSource : public WavByteSource
+{
+public:
+    StdioByteSource(FILE *file) : m_file(file) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return fread(buffer, 1, size, m_file);
+    }
+
+    bool skip(uint32_t size) override
+    {
+        return fseek(m_file, size, SEEK_CUR) == 0;
+    }
+
+private:
+    FILE *m_file;
+};
+
+// Decode a whole WAV file to 44.1kHz stereo samples, as AudioPlayer would play it
+static bool decodeToOutputFormat(const std::string &path, std::vector<int16_t> &output, uint32_t &fileSize)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    fileSize = static_cast<uint32_t>(ftell(file));
+    fseek(file, 0, SEEK_SET);
+
+    WavFormat format;
+    StdioByteSource source(file);
+    WavParseResult result = WavHeaderParser::parse(source, fileSize, format);
+    bool isAdpcm = (format.audioFormat == ImaAdpcmDecoder::FORMAT_IMA_ADPCM);
+    bool isPcm16 = (format.audioFormat == WavHeaderParser::FORMAT_PCM && format.bitsPerSample == 16);
+    AudioFormatConverter converter;
+    if (result != WavParseResult::OK || (!isAdpcm && !isPcm16) || !converter.configure(format.sampleRate, format.numChannels, SAMPLE_RATE))
+    {
+        fprintf(stderr, "%s: can't be played (%s)\n", path.c_str(), WavHeaderParser::resultToString(result));
+        fclose(file);
+        return false;
+    }
+
+    std::vector<uint8_t> data(format.dataSize);
+    data.resize(fread(data.data(), 1, data.size(), file));
+    fclose(file);
+
+    std::vector<int16_t> decoded;
+    if (isAdpcm)
+    {
+        std::vector<int16_t> block(ImaAdpcmDecoder::samplesPerBlock(format.blockAlign, format.numChannels) * format.numChannels);
+        for (size_t offset = 0; offset < data.size(); offset += format.blockAlign)
+        {
+            size_t blockSize = std::min(static_cast<size_t>(format.blockAlign), data.size() - offset);
+            size_t frames = ImaAdpcmDecoder::decodeBlock(data.data() + offset, blockSize, format.numChannels, block.data());
+            decoded.insert(decoded.end(), block.begin(), block.begin() + frames * format.numChannels);
+        }
+    }
+    else
+    {
+        decoded.resize(data.size() / 2);
+        for (size_t i = 0; i < decoded.size(); i++)
+        {
+            decoded[i] = static_cast<int16_t>(data[2 * i] | (data[2 * i + 1] << 8));
+        }
+    }
+
+    size_t inputFrames = decoded.size() / format.numChannels;
+    output.resize((static_cast<uint64_t>(inputFrames) * SAMPLE_RATE / format.sampleRate + 16) * 2);
+    size_t outputFrames = converter.convert(decoded.data(), inputFrames, output.data(), output.size() / 2);
+    output.resize(outputFrames * 2);
+    return true;
+}
+
+// Load the skits from a copy of an SD card, as SDCardManager finds them, and number them like the skulls do
+static bool loadCard(const std::string &root, SimulatedCard &card)
+{
+    DIR *audioDirectory = opendir((root + "/audio").c_str());
+    if (audioDirectory == nullptr)
+    {
+        fprintf(stderr, "Can't open %s/audio\n", root.c_str());
+        return false;
+    }
+    std::vector<std::string> fileNames;
+    while (dirent *entry = readdir(audioDirectory))
+    {
+        std::string fileName = entry->d_name;
+        if (fileName.compare(0, 4, "Skit") == 0 && fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".wav") == 0)
+        {
+            fileNames.push_back(fileName);
+        }
+    }
+    closedir(audioDirectory);
+    std::sort(fileNames.begin(), fileNames.end());
+
+    for (const std::string &fileName : fileNames)
+    {
+        std::string scriptPath = root + "/audio/" + fileName.substr(0, fileName.size() - 4) + ".txt";
+        FILE *scriptFile = fopen(scriptPath.c_str(), "rb");
+        if (scriptFile == nullptr)
+        {
+            continue;
+        }
+        std::string script;
+        char buffer[1024];
+        size_t bytesRead;
+        while ((bytesRead = fread(buffer, 1, sizeof(buffer), scriptFile)) > 0)
+        {
+            script.append(buffer, bytesRead);
+        }
+        fclose(scriptFile);
+
+        SimulatedSkit skit;
+        uint32_t fileSize;
+        if (!decodeToOutputFormat(root + "/audio/" + fileName, skit.samples, fileSize))
+        {
+            continue;
+        }
+        skit.audioFile = "/audio/" + fileName;
+        skit.lines = SkitScriptParser::parse(script);
+        card.catalog.add(skit.audioFile, SkitCatalog::fingerprint(fileSize, skit.lines));
+        card.skits.push_back(std::move(skit));
+    }
+    card.catalog.finalize();
+    return !card.skits.empty();
+}
+
+// One skull's audio path for a skit started with playAt(): AudioPlayer's SD producer, ring buffer and A2DP callback
+// (scheduled start, drift correction splices, playback position), and SkullAudioAnimator's jaw driven through
+// ServoController's follow filter
+class SkullAudio
+{
+public:
+    struct PlaybackPosition
+    {
+        uint32_t trackId;
+        int64_t atMicros;
+        int64_t positionMicros;
+        int32_t correctionFrames;
+    };
+
+    SkullAudio(bool isPrimary) : m_isPrimary(isPrimary), m_ringBuffer(AUDIO_BUFFER_SIZE)
+    {
+        m_jaw.reset(SERVO_MIN_DEGREES);
+    }
+
+    // Queue a skit to start at startMicros (local clock); it buffers right away
+    uint32_t playAt(const SimulatedSkit &skit, int64_t startMicros)
+    {
+        m_skit = &skit;
+        m_trackId = ++m_lastTrackId;
+        m_startMicros = startMicros;
+        m_isHeld = true;
+        m_producedFrames = 0;
+        m_playedFrames = 0;
+        m_pendingCorrectionFrames = 0;
+        m_trackCorrectionFrames = 0;
+        m_positionSamples = 0;
+
+        std::vector<SkitLineIndex::Segment> segments;
+        for (const ParsedSkitLine &line : skit.lines)
+        {
+            if ((line.speaker == 'A') == m_isPrimary && (line.speaker == 'A' || line.speaker == 'B') && line.duration > 0)
+            {
+                segments.push_back({line.timestamp, line.timestamp + line.duration, line.lineNumber});
+            }
+        }
+        m_lineIndex.assign(std::move(segments));
+        produce();
+        return m_trackId;
+    }
+
+    bool isAudioPlaying() const { return m_skit != nullptr && !m_isHeld; }
+    uint32_t currentlyPlayingTrackId() const { return isAudioPlaying() ? m_trackId : NO_TRACK; }
+
+    // Local time the last scheduled skit's first sample went out
+    int64_t firstSampleMicros() const { return m_startMicros + m_lastScheduledStartLateMicros; }
+
+    bool getStartLateness(uint32_t trackId, int32_t &lateMicros) const
+    {
+        if (trackId == NO_TRACK || trackId != m_lastScheduledStartTrackId)
+        {
+            return false;
+        }
+        lateMicros = m_lastScheduledStartLateMicros;
+        return true;
+    }
+
+    bool getPlaybackPosition(PlaybackPosition &position) const
+    {
+        position = m_position;
+        return m_position.trackId != NO_TRACK;
+    }
+
+    void setDriftCorrection(int32_t frames) { m_pendingCorrectionFrames = frames; }
+
+    // Producer: refill the ring buffer from the SD card, a chunk at a time. The consumer wakes it after each request.
+    void produce()
+    {
+        while (m_skit != nullptr && m_ringBuffer.freeSpace() >= FILE_READ_CHUNK_SIZE && m_producedFrames < totalFrames())
+        {
+            size_t frames = std::min(FILE_READ_CHUNK_SIZE / 4, totalFrames() - m_producedFrames);
+            m_ringBuffer.write(reinterpret_cast<const uint8_t *>(&m_skit->samples[m_producedFrames * 2]), frames * 4);
+            m_producedFrames += frames;
+        }
+    }
+
+    // A2DP data callback at nowMicros (local clock). Returns the file frame the request started at, or -1 if no
+    // skit audio went out.
+    int64_t provideAudioFrames(int64_t nowMicros, int32_t frameCount)
+    {
+        double dtSeconds = m_lastCallbackMicros == 0 ? 0.0 : (nowMicros - m_lastCallbackMicros) / 1000000.0;
+        m_lastCallbackMicros = nowMicros;
+        if (m_skit == nullptr)
+        {
+            closeJaw();
+            return -1;
+        }
+
+        // A held skit plays silence until its start time, then lines its first sample up with it
+        int32_t silentFrames = 0;
+        if (m_isHeld)
+        {
+            int64_t waitFrames = m_startMicros > nowMicros ? ((m_startMicros - nowMicros) * SAMPLE_RATE + 999999) / 1000000 : 0;
+            if (waitFrames >= frameCount)
+            {
+                closeJaw();
+                return -1;
+            }
+            int64_t firstSampleMicros = nowMicros + waitFrames * 1000000 / SAMPLE_RATE;
+            m_lastScheduledStartLateMicros = static_cast<int32_t>(firstSampleMicros - m_startMicros);
+            m_lastScheduledStartTrackId = m_trackId;
+            m_isHeld = false;
+            silentFrames = static_cast<int32_t>(waitFrames);
+        }
+        int32_t fileFrames = frameCount - silentFrames;
+        int64_t playedPos = static_cast<int64_t>(m_playedFrames);
+        if (silentFrames == 0)
+        {
+            recordPlaybackPosition(nowMicros, playedPos);
+        }
+
+        // Splice in or out one frame if a drift correction is due
+        int32_t correction = takeDriftCorrection(fileFrames);
+        m_frames.resize(static_cast<size_t>(fileFrames + 1) * 2);
+        size_t bytesRead = m_ringBuffer.read(reinterpret_cast<uint8_t *>(m_frames.data()), (fileFrames - correction) * 4);
+        size_t framesRead = bytesRead / 4;
+        m_playedFrames += framesRead;
+        if (static_cast<int32_t>(framesRead) < fileFrames - correction && m_playedFrames < totalFrames())
+        {
+            m_underrunCount++;
+        }
+
+        // The animator's jaw: follow the audio while this skull speaks, closed while it's muted
+        bool isSpeaking = m_lineIndex.find(static_cast<unsigned long>(playedPos * 1000 / SAMPLE_RATE)) != nullptr;
+        double rmsAmplitude = isSpeaking && framesRead > 0 ? AudioLevel::rms(m_frames.data(), framesRead * 2) : 0.0;
+        m_smoothedAmplitude = JawEnvelope::smoothAmplitude(m_smoothedAmplitude, rmsAmplitude);
+        double adjustedAmplitude = JawEnvelope::adjustAmplitude(m_smoothedAmplitude);
+        int targetJawPosition = static_cast<int>(adjustedAmplitude * (SERVO_MAX_DEGREES - SERVO_MIN_DEGREES) /
+                                                     JawEnvelope::MAX_EXPECTED_AMPLITUDE +
+                                                 SERVO_MIN_DEGREES);
+        int jawPosition = static_cast<int>(JAW_POSITION_SMOOTHING_FACTOR * targetJawPosition +
+                                           (1 - JAW_POSITION_SMOOTHING_FACTOR) * m_previousJawPosition);
+        m_previousJawPosition = jawPosition;
+        m_jawTarget = jawPosition;
+        m_jaw.update(static_cast<float>(jawPosition), static_cast<float>(dtSeconds));
+
+        if (m_playedFrames >= totalFrames())
+        {
+            m_skit = nullptr; // Finished
+            m_position.trackId = NO_TRACK;
+        }
+        return playedPos;
+    }
+
+    float jawDegrees() const { return m_jaw.position(); }
+    int jawTargetDegrees() const { return m_jawTarget; }
+    float jawSpeed() const { return fabsf(m_jaw.velocity()); }
+    unsigned long playbackMillis() const { return static_cast<unsigned long>(m_playedFrames * 1000 / SAMPLE_RATE); }
+
+    uint32_t underrunCount() const { return m_underrunCount; }
+    uint32_t insertedFrames() const { return m_insertedFrames; }
+    uint32_t droppedFrames() const { return m_droppedFrames; }
+
+private:
+    size_t totalFrames() const { return m_skit->samples.size() / 2; }
+
+    // As AudioPlayer::takeDriftCorrection(): at most one frame per spacing, and only with the whole request buffered
+    // inside the file
+    int32_t takeDriftCorrection(int32_t frameCount)
+    {
+        m_framesSinceCorrection += frameCount;
+        if (m_pendingCorrectionFrames == 0 || m_framesSinceCorrection < DRIFT_CORRECTION_SPACING_FRAMES || frameCount < 3 ||
+            m_ringBuffer.available() < static_cast<size_t>(frameCount + 1) * 4 ||
+            totalFrames() - m_playedFrames <= static_cast<size_t>(frameCount + 1))
+        {
+            return 0;
+        }
+        int32_t correction = m_pendingCorrectionFrames > 0 ? 1 : -1;
+        m_pendingCorrectionFrames -= correction;
+        m_framesSinceCorrection = 0;
+        m_trackCorrectionFrames += correction;
+        (correction > 0 ? m_insertedFrames : m_droppedFrames)++;
+        return correction;
+    }
+
+    // As AudioPlayer::recordPlaybackPosition(): publish the average over each window
+    void recordPlaybackPosition(int64_t atMicros, int64_t frame)
+    {
+        if (m_positionSamples == 0)
+        {
+            m_positionBaseMicros = atMicros;
+            m_positionBaseFrame = frame;
+            m_positionSumMicros = 0;
+            m_positionSumFrames = 0;
+        }
+        m_positionSumMicros += atMicros - m_positionBaseMicros;
+        m_positionSumFrames += frame - m_positionBaseFrame;
+        m_positionSamples++;
+        if (atMicros - m_positionBaseMicros < PLAYBACK_POSITION_WINDOW_MICROS)
+        {
+            return;
+        }
+        m_position.trackId = m_trackId;
+        m_position.atMicros = m_positionBaseMicros + m_positionSumMicros / m_positionSamples;
+        m_position.positionMicros = (m_positionBaseFrame + m_positionSumFrames / m_positionSamples) * 1000000 / SAMPLE_RATE;
+        m_position.correctionFrames = m_trackCorrectionFrames;
+        m_positionSamples = 0;
+    }
+
+    void closeJaw()
+    {
+        m_jaw.reset(SERVO_MIN_DEGREES);
+        m_previousJawPosition = SERVO_MIN_DEGREES;
+        m_jawTarget = SERVO_MIN_DEGREES;
+        m_smoothedAmplitude = 0.0;
+    }
+
+    bool m_isPrimary;
+    AudioRingBuffer m_ringBuffer;
+    std::vector<int16_t> m_frames;
+
+    const SimulatedSkit *m_skit = nullptr; // Held or playing
+    SkitLineIndex m_lineIndex;             // This skull's lines
+    uint32_t m_trackId = NO_TRACK;
+    uint32_t m_lastTrackId = NO_TRACK;
+    int64_t m_startMicros = 0;
+    bool m_isHeld = false;
+    size_t m_producedFrames = 0;
+    size_t m_playedFrames = 0;
+    uint32_t m_lastScheduledStartTrackId = NO_TRACK;
+    int32_t m_lastScheduledStartLateMicros = 0;
+
+    int32_t m_pendingCorrectionFrames = 0;
+    int32_t m_framesSinceCorrection = 0;
+    int32_t m_trackCorrectionFrames = 0;
+    uint32_t m_insertedFrames = 0;
+    uint32_t m_droppedFrames = 0;
+    uint32_t m_underrunCount = 0;
+
+    PlaybackPosition m_position = {NO_TRACK, 0, 0, 0};
+    int64_t m_positionBaseMicros = 0;
+    int64_t m_positionBaseFrame = 0;
+    int64_t m_positionSumMicros = 0;
+    int64_t m_positionSumFrames = 0;
+    int64_t m_positionSamples = 0;
+
+    int64_t m_lastCallbackMicros = 0;
+    double m_smoothedAmplitude = 0.0;
+    int m_previousJawPosition = SERVO_MIN_DEGREES;
+    int m_jawTarget = SERVO_MIN_DEGREES;
+    ServoTrajectoryFilter m_jaw;
+};
+
+// A skull: its clock, audio, and the state TwoSkulls.ino and bluetooth_controller keep for the skit sync
+struct Skull
+{
+    Skull(const char *name, bool isPrimary, const SimulatedCard &card, SkullClock clock)
+        : name(name), isPrimary(isPrimary), card(card), clock(clock), audio(isPrimary), driftCorrector(SAMPLE_RATE)
+    {
+    }
+
+    const char *name;
+    bool isPrimary;
+    const SimulatedCard &card;
+    SkullClock clock;
+    SkullAudio audio;
+
+    // Clock sync, Secondary side
+    ClockSyncEstimator clockSync;
+    uint32_t pingSequence = 0;
+    int64_t pingSentMicros = 0;
+    int64_t lastPingMillis = -CLOCK_SYNC_INTERVAL;
+
+    // Clock sync, Primary side
+    bool isPongPending = false;
+    uint32_t pingToAnswer = 0;
+    int64_t pingReceivedMicros = 0;
+    int32_t peerClockUncertaintyMicros = -1;
+
+    // Playback position, Secondary side
+    bool hasPeerPlaybackPosition = false;
+    int64_t peerPlaybackSkitStartMillis = 0;
+    int32_t peerPlaybackLeadMicros = 0;
+
+    // Skit start command, Primary side
+    bool isCommandPending = false;
+    SkitStartCommand command = {};
+    int64_t commandSentMicros = 0;
+    bool hasReply = false;
+    bool isAccepted = false;
+    std::string reply;
+    int64_t replyMicros = 0;
+    uint16_t commandSequence = 0;
+
+    // Skit start sync
+    uint32_t startTrackId = NO_TRACK;
+    int64_t startAtMillis = 0;
+    int64_t startMicros = 0;
+    int64_t skitStartAtMillis = 0;
+    uint16_t startSequence = 0;
+    bool isStartClockSynchronized = false;
+    bool hasLocalLateness = false;
+    int32_t localLateMicros = 0;
+    bool isSecondaryStartReported = false;
+    int32_t secondaryLateMicros = 0;
+    int32_t secondaryClockUncertaintyMicros = -1;
+
+    // Playback drift sync
+    uint32_t driftTrackId = NO_TRACK;
+    int64_t driftSkitStartAtMillis = 0;
+    int64_t driftStartAtMillis = 0;
+    bool hasDriftStarted = false;
+    int64_t lastReportMillis = 0;
+    int64_t lastReportedPositionMicros = 0;
+    PlaybackDriftCorrector driftCorrector;
+
+    int64_t lastTimeAudioPlayed = -AUDIO_COOLDOWN_TIME;
+    int64_t lastCallbackTrueMicros = 0;
+    int64_t lastCallbackFrame = -1;
+
+    int64_t localMicros(int64_t trueMicros) const { return clock.localMicros(trueMicros); }
+};
+
+// What happened to one Matter trigger that got as far as a start command
+struct SkitRun
+{
+    int64_t triggerMicros = 0; // True time
+    std::string audioFile;
+    bool isReplied = false;
+    bool isAccepted = false;
+    std::string outcome;
+    int64_t handshakeMicros = 0;
+    bool isClockSynchronized = false;
+    int64_t clockErrorMicros = 0; // Secondary's scheduled start minus the Primary's, in true time
+    bool hasStarted[2] = {false, false};
+    int64_t firstSampleMicros[2] = {0, 0}; // True time each skull's first sample went out
+    bool hasReportedSkew = false;
+    int64_t reportedSkewMicros = 0;
+    int64_t reportedUncertaintyMicros = -1; // Of reportedSkewMicros: -1 if it isn't on the shared clock
+    int64_t maxGapMicros = 0;
+    int64_t lastGapMicros = 0;
+    uint32_t gapSamples = 0;
+    uint32_t underruns[2] = {0, 0};
+    uint32_t insertedFrames = 0;
+    uint32_t droppedFrames = 0;
+    double driftPpm = 0;
+    double correctionPpm = 0;
+};
+
+class Simulation
+{
+public:
+    Simulation(const SimulationConfig &config, const SimulatedCard &primaryCard, const SimulatedCard &secondaryCard)
+        : m_config(config), m_random(config.seed), m_link(config, m_random, m_scheduler),
+          m_primary("Primary", true, primaryCard, {1000000 + static_cast<int64_t>(m_random.uniform() * 1000000), config.primaryPpm}),
+          m_secondary("Secondary", false, secondaryCard, {1000000 + static_cast<int64_t>(m_random.uniform() * 10000000), config.secondaryPpm}),
+          m_selector(audioFiles(primaryCard))
+    {
+        // The Secondary learns the connection interval when the Primary connects
+        m_secondary.clockSync.setConnectionInterval(static_cast<int64_t>(config.connectionIntervalMs * 1000));
+
+        if (!config.jawCsvPath.empty())
+        {
+            m_jawCsv = fopen(config.jawCsvPath.c_str(), "w");
+            if (m_jawCsv != nullptr)
+            {
+                fprintf(m_jawCsv, "time_ms,skull,playback_ms,target_degrees,jaw_degrees\n");
+            }
+        }
+    }
+
+    ~Simulation()
+    {
+        if (m_jawCsv != nullptr)
+        {
+            fclose(m_jawCsv);
+        }
+    }
+
+    void run()
+    {
+        for (Skull *skull : {&m_primary, &m_secondary})
+        {
+            scheduleCallback(*skull, skull->localMicros(0) + static_cast<int64_t>(m_random.uniform() * 3000));
+            scheduleTask(*skull, skull->localMicros(0) + static_cast<int64_t>(m_random.uniform() * TASK_INTERVAL_MICROS), &Simulation::bleUpdate);
+            scheduleTask(*skull, skull->localMicros(0) + static_cast<int64_t>(m_random.uniform() * TASK_INTERVAL_MICROS), &Simulation::skitUpdate);
+        }
+        // Triggers up to a second after their slot, so they don't all land at the same point between connection events
+        for (double at = m_config.firstTriggerSeconds; at < m_config.durationSeconds; at += m_config.triggerIntervalSeconds)
+        {
+            m_scheduler.at(static_cast<int64_t>((at + m_random.uniform()) * 1000000), [this]()
+                           { onMatterTrigger(); });
+        }
+        scheduleSdStall(0);
+        scheduleSdStall(1);
+
+        m_scheduler.runUntil(static_cast<int64_t>(m_config.durationSeconds * 1000000));
+        finishRun();
+        printSummary();
+    }
+
+private:
+    static std::vector<std::string> audioFiles(const SimulatedCard &card)
+    {
+        std::vector<std::string> files;
+        for (const SimulatedSkit &skit : card.skits)
+        {
+            files.push_back(skit.audioFile);
+        }
+        return files;
+    }
+
+    Skull &peer(const Skull &skull) { return skull.isPrimary ? m_secondary : m_primary; }
+    int64_t now() const { return m_scheduler.now(); }
+    int64_t millis(const Skull &skull) const { return skull.localMicros(now()) / 1000; }
+
+    // Run a task function every TASK_INTERVAL_MICROS of the skull's clock
+    void scheduleTask(Skull &skull, int64_t localMicros, void (Simulation::*task)(Skull &))
+    {
+        m_scheduler.at(skull.clock.trueMicros(localMicros), [this, &skull, localMicros, task]()
+                       {
+                           (this->*task)(skull);
+                           scheduleTask(skull, localMicros + TASK_INTERVAL_MICROS, task); });
+    }
+
+    // A2DP requests every CALLBACK_FRAMES of the skull's clock, each up to the jitter late
+    void scheduleCallback(Skull &skull, int64_t nominalLocalMicros)
+    {
+        int64_t jitterMicros = static_cast<int64_t>(m_random.uniform() * m_config.callbackJitterMicros);
+        m_scheduler.at(skull.clock.trueMicros(nominalLocalMicros + jitterMicros), [this, &skull, nominalLocalMicros]()
+                       {
+                           audioCallback(skull);
+                           scheduleCallback(skull, nominalLocalMicros + static_cast<int64_t>(CALLBACK_FRAMES) * 1000000 / SAMPLE_RATE); });
+    }
+
+    // Each skull's SD card stalls at random, holding up its producer
+    void scheduleSdStall(size_t index)
+    {
+        if (m_config.sdStallsPerSecond <= 0)
+        {
+            return;
+        }
+        int64_t waitMicros = static_cast<int64_t>(-log(1.0 - m_random.uniform()) / m_config.sdStallsPerSecond * 1000000);
+        m_scheduler.at(now() + waitMicros, [this, index]()
+                       {
+                           m_sdStallEndMicros[index] = now() + static_cast<int64_t>(m_config.sdStallMs * 1000);
+                           scheduleSdStall(index); });
+    }
+
+    // ----- Shared clock (bluetooth_controller): the Primary's millis(), tracked by the Secondary -----
+
+    bool isClockSynchronized(const Skull &skull) const
+    {
+        return skull.isPrimary ? skull.peerClockUncertaintyMicros >= 0 : skull.clockSync.isSynchronized();
+    }
+
+    int64_t syncedMillis(const Skull &skull) const
+    {
+        int64_t localMicros = skull.localMicros(now());
+        return (!skull.isPrimary && skull.clockSync.isSynchronized() ? skull.clockSync.toRemote(localMicros) : localMicros) / 1000;
+    }
+
+    int64_t localMicrosAtSyncedMillis(const Skull &skull, int64_t syncedMillis) const
+    {
+        return !skull.isPrimary && skull.clockSync.isSynchronized() ? skull.clockSync.toLocal(syncedMillis * 1000) : syncedMillis * 1000;
+    }
+
+    int64_t syncedMicrosSince(const Skull &skull, int64_t syncedMillis, int64_t localMicros) const
+    {
+        int64_t sharedMicros = !skull.isPrimary && skull.clockSync.isSynchronized() ? skull.clockSync.toRemote(localMicros) : localMicros;
+        return sharedMicros - syncedMillis * 1000;
+    }
+
+    // ----- BLE control task -----
+
+    void bleUpdate(Skull &skull)
+    {
+        if (skull.isPrimary)
+        {
+            sendClockSyncPong(skull);
+            updatePendingCommand(skull);
+            return;
+        }
+
+        int64_t interval = isClockSynchronized(skull) ? CLOCK_SYNC_INTERVAL : CLOCK_SYNC_FAST_INTERVAL;
+        if (millis(skull) - skull.lastPingMillis >= interval)
+        {
+            skull.lastPingMillis = millis(skull);
+            sendClockSyncPing(skull);
+        }
+    }
+
+    // Secondary: ping the Primary with the uncertainty of our view of its clock
+    void sendClockSyncPing(Skull &secondary)
+    {
+        int64_t localMicros = secondary.localMicros(now());
+        int32_t uncertainty = secondary.clockSync.isSynchronized()
+                                  ? static_cast<int32_t>(std::min<int64_t>(secondary.clockSync.uncertaintyMicros(localMicros), INT32_MAX))
+                                  : -1;
+        uint32_t sequence = ++secondary.pingSequence;
+        secondary.pingSentMicros = localMicros;
+        m_link.send(SimulatedLink::TO_PRIMARY, [this, sequence, uncertainty]()
+                    {
+                        m_primary.pingToAnswer = sequence;
+                        m_primary.pingReceivedMicros = m_primary.localMicros(now());
+                        m_primary.peerClockUncertaintyMicros = uncertainty;
+                        m_primary.isPongPending = true; });
+    }
+
+    // Primary: answer the last ping with when it arrived and how long it waited here
+    void sendClockSyncPong(Skull &primary)
+    {
+        if (!primary.isPongPending)
+        {
+            return;
+        }
+        primary.isPongPending = false;
+        uint32_t sequence = primary.pingToAnswer;
+        int64_t receiveMicros = primary.pingReceivedMicros;
+        int64_t sendMicros = primary.localMicros(now());
+        m_link.send(SimulatedLink::TO_SECONDARY, [this, sequence, receiveMicros, sendMicros]()
+                    {
+                        if (sequence != m_secondary.pingSequence || m_secondary.pingSentMicros == 0)
+                        {
+                            return; // Answers an older ping
+                        }
+                        m_secondary.clockSync.addSample(m_secondary.pingSentMicros, receiveMicros, sendMicros, m_secondary.localMicros(now()));
+                        m_secondary.pingSentMicros = 0; });
+    }
+
+    // Primary: hand the start command's reply (or timeout) to the skit task
+    void updatePendingCommand(Skull &primary)
+    {
+        if (!primary.isCommandPending)
+        {
+            return;
+        }
+        SkitRun &run = m_runs.back();
+        if (primary.hasReply)
+        {
+            run.isReplied = true;
+            run.handshakeMicros = primary.replyMicros - primary.commandSentMicros;
+            m_handshakeLatency.record(static_cast<uint32_t>(run.handshakeMicros));
+            SkitRejectReason reason;
+            uint32_t secondaryCatalogHash;
+            if (primary.isAccepted)
+            {
+                run.isAccepted = true;
+                run.outcome = "accepted";
+            }
+            else if (SkitStartProtocol::decodeReject(primary.reply, reason, secondaryCatalogHash))
+            {
+                run.outcome = std::string("rejected: ") + SkitStartProtocol::rejectReasonToString(reason);
+            }
+            else
+            {
+                run.outcome = "rejected";
+            }
+        }
+        else if (millis(primary) - primary.commandSentMicros / 1000 < COMMAND_TIMEOUT)
+        {
+            return;
+        }
+        else
+        {
+            run.outcome = "timed out";
+        }
+
+        primary.isCommandPending = false;
+        if (run.isAccepted)
+        {
+            startAcceptedSkit(primary, primary.command, primary.commandSentMicros);
+        }
+    }
+
+    // ----- Skit task (TwoSkulls.ino) -----
+
+    void skitUpdate(Skull &skull)
+    {
+        if (skull.audio.isAudioPlaying())
+        {
+            skull.lastTimeAudioPlayed = millis(skull);
+        }
+        updateSkitStartSync(skull);
+        updatePlaybackDriftSync(skull);
+    }
+
+    // Primary: a Matter trigger; ask the Secondary to start a random skit with us
+    void onMatterTrigger()
+    {
+        Skull &primary = m_primary;
+        m_triggerCount++;
+        if (primary.audio.isAudioPlaying() || primary.isCommandPending || millis(primary) - primary.lastTimeAudioPlayed <= AUDIO_COOLDOWN_TIME)
+        {
+            m_ignoredTriggerCount++;
+            return;
+        }
+
+        finishRun();
+        m_runs.push_back(SkitRun());
+        m_insertedAtRunStart = m_secondary.audio.insertedFrames();
+        m_droppedAtRunStart = m_secondary.audio.droppedFrames();
+        SkitRun &run = m_runs.back();
+        run.triggerMicros = now();
+        run.audioFile = m_selector.selectNextSkit(static_cast<unsigned long>(millis(primary)), static_cast<uint32_t>(m_random.next()));
+
+        SkitStartCommand command = {};
+        command.sequence = ++primary.commandSequence;
+        command.skitId = primary.card.catalog.idOf(run.audioFile);
+        command.catalogHash = primary.card.catalog.hash();
+        if (isClockSynchronized(primary))
+        {
+            command.flags |= SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED;
+        }
+        command.sentAtMillis = static_cast<uint32_t>(syncedMillis(primary));
+        command.startAtMillis = command.sentAtMillis + SKIT_START_LEAD_MS;
+        run.isClockSynchronized = (command.flags & SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0;
+
+        primary.command = command;
+        primary.commandSentMicros = primary.localMicros(now());
+        primary.isCommandPending = true;
+        primary.hasReply = false;
+        primary.isSecondaryStartReported = false;
+        std::string value = SkitStartProtocol::encodeCommand(command);
+        m_link.send(SimulatedLink::TO_SECONDARY, [this, value]()
+                    { onCommandWrite(value); });
+    }
+
+    // Secondary: the start command arrives. Accept or reject it, and start the skit if accepted.
+    void onCommandWrite(const std::string &value)
+    {
+        Skull &secondary = m_secondary;
+        int64_t receivedMicros = secondary.localMicros(now());
+        std::string reply;
+        bool isAccepted = onCharacteristicChangeRequest(secondary, value, reply);
+        m_link.send(SimulatedLink::TO_PRIMARY, [this, reply, isAccepted]()
+                    {
+                        m_primary.reply = reply;
+                        m_primary.isAccepted = isAccepted;
+                        m_primary.replyMicros = m_primary.localMicros(now());
+                        m_primary.hasReply = true; });
+
+        SkitStartCommand command;
+        if (isAccepted && SkitStartProtocol::decodeCommand(value, command))
+        {
+            startCommandedSkit(secondary, command, receivedMicros);
+        }
+    }
+
+    bool onCharacteristicChangeRequest(Skull &secondary, const std::string &value, std::string &reply)
+    {
+        SkitStartCommand command;
+        SkitRejectReason reason;
+        if (!SkitStartProtocol::decodeCommand(value, command))
+        {
+            SkitMessageHeader header;
+            reply = SkitStartProtocol::encodeReject(SkitStartProtocol::decodeHeader(value, header) ? header.sequence : 0,
+                                                    SkitRejectReason::BAD_MESSAGE, secondary.card.catalog.hash());
+            return false;
+        }
+        if (command.catalogHash != secondary.card.catalog.hash())
+        {
+            reason = SkitRejectReason::CATALOG_MISMATCH;
+        }
+        else if (secondary.card.catalog.audioFileOf(command.skitId) == nullptr)
+        {
+            reason = SkitRejectReason::UNKNOWN_SKIT;
+        }
+        else if (secondary.audio.isAudioPlaying())
+        {
+            reason = SkitRejectReason::BUSY;
+        }
+        else
+        {
+            reply = SkitStartProtocol::encodeAccept(command.sequence);
+            return true;
+        }
+        reply = SkitStartProtocol::encodeReject(command.sequence, reason, secondary.card.catalog.hash());
+        return false;
+    }
+
+    // Secondary: start the commanded skit at the Primary's start time
+    void startCommandedSkit(Skull &secondary, const SkitStartCommand &command, int64_t receivedMicros)
+    {
+        const SimulatedSkit *skit = secondary.card.find(*secondary.card.catalog.audioFileOf(command.skitId));
+        secondary.startSequence = command.sequence;
+        secondary.isStartClockSynchronized = (command.flags & SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0;
+        int64_t startMicros;
+        if (secondary.isStartClockSynchronized)
+        {
+            startMicros = localMicrosAtSyncedMillis(secondary, command.startAtMillis);
+        }
+        else
+        {
+            startMicros = receivedMicros + static_cast<int64_t>(static_cast<int32_t>(command.startAtMillis - command.sentAtMillis)) * 1000;
+        }
+        beginSkitStartSync(secondary, skit, startMicros, command.startAtMillis);
+        m_secondaryStartTrueMicros = secondary.clock.trueMicros(startMicros);
+    }
+
+    // Primary: the Secondary accepted, so schedule the skit here too
+    void startAcceptedSkit(Skull &primary, const SkitStartCommand &command, int64_t sentMicros)
+    {
+        const SimulatedSkit *skit = primary.card.find(*primary.card.catalog.audioFileOf(command.skitId));
+        primary.isStartClockSynchronized = (command.flags & SkitStartProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0;
+        int64_t startMicros = localMicrosAtSyncedMillis(primary, command.startAtMillis);
+        if (!primary.isStartClockSynchronized)
+        {
+            startMicros += (primary.replyMicros - sentMicros) / 2; // The Secondary starts one BLE delay late
+        }
+        beginSkitStartSync(primary, skit, startMicros, command.startAtMillis);
+        primary.lastTimeAudioPlayed = millis(primary);
+        m_runs.back().clockErrorMicros = m_secondaryStartTrueMicros - primary.clock.trueMicros(startMicros);
+    }
+
+    void beginSkitStartSync(Skull &skull, const SimulatedSkit *skit, int64_t startMicros, int64_t skitStartAtMillis)
+    {
+        skull.startAtMillis = startMicros / 1000;
+        skull.startMicros = startMicros;
+        skull.skitStartAtMillis = skitStartAtMillis;
+        skull.hasLocalLateness = false;
+        skull.startTrackId = skull.audio.playAt(*skit, startMicros);
+        skull.driftTrackId = NO_TRACK;
+        if (skull.isStartClockSynchronized)
+        {
+            skull.driftTrackId = skull.startTrackId;
+            skull.driftSkitStartAtMillis = skitStartAtMillis;
+            skull.driftStartAtMillis = skull.startAtMillis;
+            skull.hasDriftStarted = false;
+            skull.lastReportMillis = 0;
+            skull.lastReportedPositionMicros = 0;
+        }
+    }
+
+    // As TwoSkulls.ino sharedStartLateMicros(): how late the skull's first sample played on the shared clock
+    int32_t sharedStartLateMicros(const Skull &skull) const
+    {
+        return static_cast<int32_t>(syncedMicrosSince(skull, skull.skitStartAtMillis, skull.startMicros + skull.localLateMicros));
+    }
+
+    // The Secondary reports how late its first sample was; the Primary works out the skew it can see
+    void updateSkitStartSync(Skull &skull)
+    {
+        if (skull.startTrackId == NO_TRACK)
+        {
+            return;
+        }
+
+        if (!skull.hasLocalLateness && skull.audio.getStartLateness(skull.startTrackId, skull.localLateMicros))
+        {
+            skull.hasLocalLateness = true;
+            if (!skull.isPrimary)
+            {
+                int32_t lateMicros = skull.localLateMicros;
+                int32_t clockUncertaintyMicros = -1;
+                if (skull.isStartClockSynchronized && skull.clockSync.isSynchronized())
+                {
+                    clockUncertaintyMicros = static_cast<int32_t>(skull.clockSync.uncertaintyMicros(skull.localMicros(now())));
+                    lateMicros = sharedStartLateMicros(skull);
+                }
+                m_link.send(SimulatedLink::TO_PRIMARY, [this, lateMicros, clockUncertaintyMicros]()
+                            {
+                                m_primary.secondaryLateMicros = lateMicros;
+                                m_primary.secondaryClockUncertaintyMicros = clockUncertaintyMicros;
+                                m_primary.isSecondaryStartReported = true; });
+                skull.startTrackId = NO_TRACK;
+                return;
+            }
+        }
+
+        if (skull.isPrimary && skull.hasLocalLateness && skull.isSecondaryStartReported)
+        {
+            SkitRun &run = m_runs.back();
+            run.hasReportedSkew = true;
+            run.reportedUncertaintyMicros = skull.secondaryClockUncertaintyMicros;
+            int32_t primaryLateMicros = run.reportedUncertaintyMicros >= 0 ? sharedStartLateMicros(skull) : skull.localLateMicros;
+            run.reportedSkewMicros = skull.secondaryLateMicros - primaryLateMicros;
+            skull.startTrackId = NO_TRACK;
+        }
+        else if (millis(skull) - skull.startAtMillis > SKIT_START_REPORT_TIMEOUT)
+        {
+            skull.startTrackId = NO_TRACK;
+        }
+    }
+
+    // The Primary reports how far its playback is ahead of schedule; the Secondary corrects the difference from its own
+    void updatePlaybackDriftSync(Skull &skull)
+    {
+        if (skull.driftTrackId == NO_TRACK)
+        {
+            return;
+        }
+
+        uint32_t playingTrackId = skull.audio.currentlyPlayingTrackId();
+        if (!skull.hasDriftStarted)
+        {
+            if (playingTrackId == skull.driftTrackId)
+            {
+                skull.hasDriftStarted = true;
+                skull.driftCorrector.reset();
+            }
+            else if (millis(skull) - skull.driftStartAtMillis > SKIT_START_REPORT_TIMEOUT)
+            {
+                skull.driftTrackId = NO_TRACK;
+            }
+            return;
+        }
+
+        if (playingTrackId != skull.driftTrackId)
+        {
+            if (!skull.isPrimary && !m_runs.empty())
+            {
+                m_runs.back().driftPpm = skull.driftCorrector.driftPpm();
+                m_runs.back().correctionPpm = skull.driftCorrector.correctionPpm();
+            }
+            skull.driftTrackId = NO_TRACK;
+            return;
+        }
+
+        SkullAudio::PlaybackPosition position;
+        if (skull.isPrimary)
+        {
+            if (millis(skull) - skull.lastReportMillis >= PLAYBACK_POSITION_REPORT_INTERVAL && skull.audio.getPlaybackPosition(position) &&
+                position.trackId == skull.driftTrackId && position.atMicros != skull.lastReportedPositionMicros)
+            {
+                int64_t skitStartMillis = skull.driftSkitStartAtMillis;
+                int32_t leadMicros = static_cast<int32_t>(position.positionMicros - syncedMicrosSince(skull, skitStartMillis, position.atMicros));
+                m_link.send(SimulatedLink::TO_SECONDARY, [this, skitStartMillis, leadMicros]()
+                            {
+                                m_secondary.peerPlaybackSkitStartMillis = skitStartMillis;
+                                m_secondary.peerPlaybackLeadMicros = leadMicros;
+                                m_secondary.hasPeerPlaybackPosition = true; });
+                skull.lastReportMillis = millis(skull);
+                skull.lastReportedPositionMicros = position.atMicros;
+            }
+            return;
+        }
+
+        if (skull.hasPeerPlaybackPosition && skull.peerPlaybackSkitStartMillis == skull.driftSkitStartAtMillis &&
+            isClockSynchronized(skull) && skull.audio.getPlaybackPosition(position) && position.trackId == skull.driftTrackId)
+        {
+            skull.hasPeerPlaybackPosition = false;
+            int64_t elapsedMicros = syncedMicrosSince(skull, skull.driftSkitStartAtMillis, position.atMicros);
+            int64_t gapMicros = position.positionMicros - elapsedMicros - skull.peerPlaybackLeadMicros;
+            skull.audio.setDriftCorrection(skull.driftCorrector.update(elapsedMicros, gapMicros, position.correctionFrames));
+        }
+    }
+
+    // ----- A2DP -----
+
+    void audioCallback(Skull &skull)
+    {
+        size_t index = skull.isPrimary ? 0 : 1;
+        uint32_t underruns = skull.audio.underrunCount();
+        int64_t frame = skull.audio.provideAudioFrames(skull.localMicros(now()), CALLBACK_FRAMES);
+        if (now() >= m_sdStallEndMicros[index])
+        {
+            skull.audio.produce();
+        }
+        skull.lastCallbackTrueMicros = now();
+        skull.lastCallbackFrame = frame;
+        if (frame < 0 || m_runs.empty())
+        {
+            return;
+        }
+
+        SkitRun &run = m_runs.back();
+        run.underruns[index] += skull.audio.underrunCount() - underruns;
+        if (!run.hasStarted[index])
+        {
+            run.hasStarted[index] = true;
+            run.firstSampleMicros[index] = skull.clock.trueMicros(skull.audio.firstSampleMicros());
+        }
+        if (!skull.isPrimary)
+        {
+            run.insertedFrames = skull.audio.insertedFrames() - m_insertedAtRunStart;
+            run.droppedFrames = skull.audio.droppedFrames() - m_droppedAtRunStart;
+        }
+
+        // How far apart the skulls' playback is: where the Secondary is when the Primary hands over this frame.
+        // Not on either skull's first request, which starts partway through with silence.
+        Skull &secondary = m_secondary;
+        if (skull.isPrimary && frame > 0 && secondary.lastCallbackFrame > 0)
+        {
+            double secondaryFrame = secondary.lastCallbackFrame + (now() - secondary.lastCallbackTrueMicros) * 1e-6 * SAMPLE_RATE * (1.0 + secondary.clock.ppm * 1e-6);
+            int64_t gapMicros = static_cast<int64_t>((secondaryFrame - frame) * 1000000 / SAMPLE_RATE);
+            run.lastGapMicros = gapMicros;
+            run.maxGapMicros = std::max(run.maxGapMicros, std::abs(gapMicros));
+            run.gapSamples++;
+            m_playbackGap.record(static_cast<uint32_t>(std::abs(gapMicros)));
+        }
+
+        if (m_jawCsv != nullptr)
+        {
+            fprintf(m_jawCsv, "%.3f,%s,%lu,%d,%.1f\n", now() / 1000.0, skull.name, skull.audio.playbackMillis(),
+                    skull.audio.jawTargetDegrees(), skull.audio.jawDegrees());
+        }
+        m_jawPeakDegrees[index] = std::max(m_jawPeakDegrees[index], skull.audio.jawDegrees());
+        m_jawPeakSpeed[index] = std::max(m_jawPeakSpeed[index], skull.audio.jawSpeed());
+    }
+
+    // ----- Reports -----
+
+    // Print the last run, once the next trigger or the end of the simulation has given it time to play
+    void finishRun()
+    {
+        if (m_printedRunCount == m_runs.size())
+        {
+            return;
+        }
+        m_printedRunCount = m_runs.size();
+        const SkitRun &run = m_runs.back();
+        printf("%8.3f s  %s (%s): %s", run.triggerMicros / 1000000.0, run.audioFile.c_str(),
+               run.isClockSynchronized ? "clock synchronized" : "clocks not synchronized", run.outcome.empty() ? "no reply" : run.outcome.c_str());
+        if (run.isReplied)
+        {
+            printf(" after %.1f ms", run.handshakeMicros / 1000.0);
+        }
+        printf("\n");
+        if (run.hasStarted[0] && run.hasStarted[1])
+        {
+            int64_t skewMicros = run.firstSampleMicros[1] - run.firstSampleMicros[0];
+            m_startSkew.record(static_cast<uint32_t>(std::abs(skewMicros)));
+            printf("            start skew %ld us", static_cast<long>(skewMicros));
+            if (run.hasReportedSkew)
+            {
+                printf(" (skulls measured %ld us", static_cast<long>(run.reportedSkewMicros));
+                if (run.reportedUncertaintyMicros >= 0)
+                {
+                    printf(" +/- %ld us%s", static_cast<long>(run.reportedUncertaintyMicros),
+                           std::abs(run.reportedSkewMicros) > run.reportedUncertaintyMicros ? ", outside the uncertainty" : "");
+                }
+                printf(", start time error %ld us)", static_cast<long>(run.clockErrorMicros));
+            }
+            printf("\n            playback gap max %ld us, last %ld us; drift %.1f ppm, corrected %.1f ppm (%u frames inserted, %u dropped)\n",
+                   static_cast<long>(run.maxGapMicros), static_cast<long>(run.lastGapMicros), run.driftPpm, run.correctionPpm,
+                   run.insertedFrames, run.droppedFrames);
+            m_startedCount++;
+        }
+        else if (run.isAccepted)
+        {
+            printf("            didn't start on both skulls before the run ended\n");
+        }
+        if (run.underruns[0] + run.underruns[1] > 0)
+        {
+            printf("            dropouts: Primary %u, Secondary %u\n", run.underruns[0], run.underruns[1]);
+        }
+        m_underrunCount[0] += run.underruns[0];
+        m_underrunCount[1] += run.underruns[1];
+    }
+
+    static void printHistogram(const char *name, const LatencyHistogram &histogram)
+    {
+        printf("  %-18s", name);
+        if (histogram.count() == 0)
+        {
+            printf("none\n");
+            return;
+        }
+        printf("n=%u p50<=%u us p99<=%u us max %u us\n", histogram.count(), histogram.percentileMicros(50),
+               histogram.percentileMicros(99), histogram.maxMicros());
+    }
+
+    void printSummary()
+    {
+        int64_t localMicros = m_secondary.localMicros(now());
+        printf("\nSummary (%.0f s simulated, seed %llu)\n", m_config.durationSeconds, static_cast<unsigned long long>(m_config.seed));
+        printf("  Triggers: %u (%u ignored), skits started on both skulls: %u of %u commanded\n", m_triggerCount, m_ignoredTriggerCount,
+               m_startedCount, static_cast<unsigned>(m_runs.size()));
+        printf("  BLE: %u packets, %u resends\n", m_link.packets(), m_link.resentPackets());
+        if (m_secondary.clockSync.isSynchronized())
+        {
+            int64_t errorMicros = m_secondary.clockSync.toRemote(localMicros) - m_primary.localMicros(now());
+            printf("  Clock sync: error %ld us, uncertainty %ld us, drift %.1f ppm (true %.1f ppm)\n", static_cast<long>(errorMicros),
+                   static_cast<long>(m_secondary.clockSync.uncertaintyMicros(localMicros)), m_secondary.clockSync.driftPpm(),
+                   (1.0 + m_config.primaryPpm * 1e-6) / (1.0 + m_config.secondaryPpm * 1e-6) * 1e6 - 1e6);
+        }
+        else
+        {
+            printf("  Clock sync: not synchronized\n");
+        }
+        printHistogram("Handshake:", m_handshakeLatency);
+        printHistogram("Start skew:", m_startSkew);
+        printHistogram("Playback gap:", m_playbackGap);
+        printf("  Dropouts: Primary %u, Secondary %u\n", m_underrunCount[0], m_underrunCount[1]);
+        printf("  Jaw: Primary peak %.0f degrees at up to %.0f deg/s, Secondary peak %.0f degrees at up to %.0f deg/s\n",
+               m_jawPeakDegrees[0], m_jawPeakSpeed[0], m_jawPeakDegrees[1], m_jawPeakSpeed[1]);
+    }
+
+    const SimulationConfig &m_config;
+    Random m_random;
+    Scheduler m_scheduler;
+    SimulatedLink m_link;
+    Skull m_primary;
+    Skull m_secondary;
+    SkitSelector m_selector;
+    FILE *m_jawCsv = nullptr;
+    int64_t m_sdStallEndMicros[2] = {0, 0}; // Primary, Secondary
+    int64_t m_secondaryStartTrueMicros = 0;
+
+    std::vector<SkitRun> m_runs;
+    size_t m_printedRunCount = 0;
+    uint32_t m_insertedAtRunStart = 0;
+    uint32_t m_droppedAtRunStart = 0;
+    uint32_t m_triggerCount = 0;
+    uint32_t m_ignoredTriggerCount = 0;
+    uint32_t m_startedCount = 0;
+    uint32_t m_underrunCount[2] = {0, 0};
+    float m_jawPeakDegrees[2] = {0, 0};
+    float m_jawPeakSpeed[2] = {0, 0};
+    LatencyHistogram m_handshakeLatency;
+    LatencyHistogram m_startSkew;
+    LatencyHistogram m_playbackGap;
+};
+
+static void printUsage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <SD card folder>\n"
+            "  --seed N               Random seed (1)\n"
+            "  --duration S           Seconds to simulate (300)\n"
+            "  --interval-ms MS       BLE connection interval (30)\n"
+            "  --latency-ms MS        Extra one-way BLE delay (0)\n"
+            "  --loss P               Chance a BLE packet is lost and resent at the next connection event (0.1)\n"
+            "  --primary-ppm PPM      Primary crystal error (10)\n"
+            "  --secondary-ppm PPM    Secondary crystal error (-15)\n"
+            "  --jitter-us US         A2DP requests come up to this late (500)\n"
+            "  --first-trigger S      First Matter trigger (5)\n"
+            "  --trigger-every S      Matter trigger interval (45)\n"
+            "  --sd-stalls-per-s N    SD card stalls per second (0)\n"
+            "  --sd-stall-ms MS       Length of an SD card stall (50)\n"
+            "  --secondary-card DIR   The Secondary's SD card, if it differs\n"
+            "  --jaw-csv FILE         Write both skulls' jaw angles at every A2DP request\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    SimulationConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option.compare(0, 2, "--") != 0)
+        {
+            config.primaryCard = option;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (option == "--seed")
+            config.seed = strtoull(value, nullptr, 10);
+        else if (option == "--duration")
+            config.durationSeconds = atof(value);
+        else if (option == "--interval-ms")
+            config.connectionIntervalMs = atof(value);
+        else if (option == "--latency-ms")
+            config.latencyMs = atof(value);
+        else if (option == "--loss")
+            config.lossRate = atof(value);
+        else if (option == "--primary-ppm")
+            config.primaryPpm = atof(value);
+        else if (option == "--secondary-ppm")
+            config.secondaryPpm = atof(value);
+        else if (option == "--jitter-us")
+            config.callbackJitterMicros = atof(value);
+        else if (option == "--first-trigger")
+            config.firstTriggerSeconds = atof(value);
+        else if (option == "--trigger-every")
+            config.triggerIntervalSeconds = atof(value);
+        else if (option == "--sd-stalls-per-s")
+            config.sdStallsPerSecond = atof(value);
+        else if (option == "--sd-stall-ms")
+            config.sdStallMs = atof(value);
+        else if (option == "--secondary-card")
+            config.secondaryCard = value;
+        else if (option == "--jaw-csv")
+            config.jawCsvPath = value;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.primaryCard.empty() || config.connectionIntervalMs <= 0 || config.lossRate < 0 || config.lossRate >= 1 ||
+        config.triggerIntervalSeconds <= 0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    SimulatedCard primaryCard;
+    SimulatedCard secondaryCard;
+    if (!loadCard(config.primaryCard, primaryCard) ||
+        (!config.secondaryCard.empty() && !loadCard(config.secondaryCard, secondaryCard)))
+    {
+        fprintf(stderr, "No playable skits found\n");
+        return 1;
+    }
+    printf("Skit catalog: %u skits, hash %08lx", static_cast<unsigned>(primaryCard.catalog.size()),
+           static_cast<unsigned long>(primaryCard.catalog.hash()));
+    if (!config.secondaryCard.empty())
+    {
+        printf(" (Secondary: %u skits, hash %08lx)", static_cast<unsigned>(secondaryCard.catalog.size()),
+               static_cast<unsigned long>(secondaryCard.catalog.hash()));
+    }
+    printf("\n");
+
+    Simulation simulation(config, primaryCard, config.secondaryCard.empty() ? primaryCard : secondaryCard);
+    simulation.run();
+    return 0;
+}
@@ -0,0 +1,302 @@
+/*
+    WAV Header Test (host-side tool)
+
+    Checks WavHeaderParser two ways:
+      - Every .wav file in an SD card folder's audio directory must parse, with the data chunk where the file really
+        has it: the 8 bytes before dataOffset are the "data" chunk header, and dataSize is whole frames that end
+        inside the file.
+      - Built headers with a known answer: the layouts the skull files and common encoders use (extra chunks before
+        and after fmt, odd-sized chunks and their pad byte, WAVE_FORMAT_EXTENSIBLE, IMA-ADPCM), streaming encoder
+        data sizes, and the ways a header goes wrong (truncated at every byte, wrong magic, inconsistent or short fmt
+        chunks, data before fmt, no data chunk).
+    Prints each check that failed, then a summary, and exits non-zero if any failed.
+
+    Build (from the repository root):
+        g++ -std=c++17 -O2 -I. tools/wav_header_test.cpp wav_header_parser.cpp -o wav_header_test
+
+    Usage:
+        ./wav_header_test [SD card folder]     (default: sd_card_files)
+*/
+
+#include "wav_header_parser.h"
+#include "test_support.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Reads a WAV header from a stdio file
+class StdioByteSource : public WavByteSource
+{
+public:
+    StdioByteSource(FILE *file) : m_file(file) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        return fread(buffer, 1, size, m_file);
+    }
+
+    bool skip(uint32_t size) override
+    {
+        return fseek(m_file, size, SEEK_CUR) == 0;
+    }
+
+private:
+    FILE *m_file;
+};
+
+// Reads a WAV header from memory. Like an SD card File, skipping past the end fails.
+class MemoryByteSource : public WavByteSource
+{
+public:
+    MemoryByteSource(const std::vector<uint8_t> &bytes) : m_bytes(bytes), m_position(0) {}
+
+    size_t read(uint8_t *buffer, size_t size) override
+    {
+        size_t count = std::min(size, m_bytes.size() - m_position);
+        memcpy(buffer, m_bytes.data() + m_position, count);
+        m_position += count;
+        return count;
+    }
+
+    bool skip(uint32_t size) override
+    {
+        if (size > m_bytes.size() - m_position)
+        {
+            m_position = m_bytes.size();
+            return false;
+        }
+        m_position += size;
+        return true;
+    }
+
+    size_t position() const { return m_position; }
+
+private:
+    const std::vector<uint8_t> &m_bytes;
+    size_t m_position;
+};
+
+// ----- SD card files -----
+
+static void checkFile(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        check(false, path, "can't open file");
+        return;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t block[4096];
+    size_t count;
+    while ((count = fread(block, 1, sizeof(block), file)) > 0)
+    {
+        bytes.insert(bytes.end(), block, block + count);
+    }
+    rewind(file);
+
+    WavFormat format;
+    StdioByteSource source(file);
+    WavParseResult result = WavHeaderParser::parse(source, static_cast<uint32_t>(bytes.size()), format);
+    long position = ftell(file);
+    fclose(file);
+    check(result == WavParseResult::OK, path, WavHeaderParser::resultToString(result));
+    if (result != WavParseResult::OK)
+    {
+        return;
+    }
+
+    check(format.dataOffset >= 8 && memcmp(bytes.data() + format.dataOffset - 8, "data", 4) == 0, path, "dataOffset isn't after a data chunk header");
+    check(position == static_cast<long>(format.dataOffset), path, "file isn't left at the first sample");
+    check(static_cast<uint64_t>(format.dataOffset) + format.dataSize <= bytes.size(), path, "data runs past the end of the file");
+    check(format.audioFormat != WavHeaderParser::FORMAT_PCM || format.dataSize % format.blockAlign == 0, path, "data isn't whole frames");
+    printf("%s: format %u, %u channels, %u Hz, %u bits, data %u bytes at %u\n", path.c_str(), format.audioFormat,
+           format.numChannels, format.sampleRate, format.bitsPerSample, format.dataSize, format.dataOffset);
+}
+
+static void checkCard(const std::string &root)
+{
+    std::string audio = root + "/audio";
+    DIR *directory = opendir(audio.c_str());
+    if (directory == nullptr)
+    {
+        check(false, audio, "can't open directory");
+        return;
+    }
+    std::vector<std::string> paths;
+    while (dirent *entry = readdir(directory))
+    {
+        std::string fileName = entry->d_name;
+        if (fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".wav") == 0)
+        {
+            paths.push_back(audio + "/" + fileName);
+        }
+    }
+    closedir(directory);
+    std::sort(paths.begin(), paths.end());
+    check(!paths.empty(), audio, "no .wav files");
+    for (const std::string &path : paths)
+    {
+        checkFile(path);
+    }
+}
+
+// ----- Built headers -----
+
+// A WAV file built chunk by chunk
+class WavBuilder
+{
+public:
+    WavBuilder &tag(const char *fourCc)
+    {
+        m_bytes.insert(m_bytes.end(), fourCc, fourCc + 4);
+        return *this;
+    }
+
+    WavBuilder &le16(uint16_t value)
+    {
+        m_bytes.push_back(static_cast<uint8_t>(value));
+        m_bytes.push_back(static_cast<uint8_t>(value >> 8));
+        return *this;
+    }
+
+    WavBuilder &le32(uint32_t value)
+    {
+        le16(static_cast<uint16_t>(value));
+        return le16(static_cast<uint16_t>(value >> 16));
+    }
+
+    WavBuilder &fill(size_t count, uint8_t value = 0)
+    {
+        m_bytes.insert(m_bytes.end(), count, value);
+        return *this;
+    }
+
+    WavBuilder &riff(const char *formType = "WAVE") { return tag("RIFF").le32(0).tag(formType); }
+
+    // 16-byte PCM fmt chunk, with byte rate and block align worked out unless given
+    WavBuilder &fmt(uint16_t channels, uint32_t sampleRate, uint16_t bits, uint16_t blockAlign = 0, uint32_t byteRate = 0)
+    {
+        blockAlign = blockAlign != 0 ? blockAlign : static_cast<uint16_t>(channels * (bits / 8));
+        byteRate = byteRate != 0 ? byteRate : sampleRate * blockAlign;
+        return tag("fmt ").le32(16).le16(WavHeaderParser::FORMAT_PCM).le16(channels).le32(sampleRate).le32(byteRate).le16(blockAlign).le16(bits);
+    }
+
+    // Any chunk, padded to an even size
+    WavBuilder &chunk(const char *fourCc, uint32_t size)
+    {
+        return tag(fourCc).le32(size).fill(size + (size & 1), 0x55);
+    }
+
+    // data chunk header claiming size, followed by actualBytes of audio
+    WavBuilder &data(uint32_t size, size_t actualBytes)
+    {
+        return tag("data").le32(size).fill(actualBytes, 0x11);
+    }
+
+    const std::vector<uint8_t> &bytes() const { return m_bytes; }
+
+private:
+    std::vector<uint8_t> m_bytes;
+};
+
+// Parse built bytes as a file of that size, checking the result and where the source was left
+static WavParseResult parseBytes(const std::vector<uint8_t> &bytes, WavFormat &format, size_t *position = nullptr)
+{
+    MemoryByteSource source(bytes);
+    WavParseResult result = WavHeaderParser::parse(source, static_cast<uint32_t>(bytes.size()), format);
+    if (position != nullptr)
+    {
+        *position = source.position();
+    }
+    return result;
+}
+
+static void expectOk(const std::string &name, const WavBuilder &wav, uint16_t audioFormat, uint32_t dataOffset, uint32_t dataSize)
+{
+    WavFormat format;
+    size_t position;
+    WavParseResult result = parseBytes(wav.bytes(), format, &position);
+    check(result == WavParseResult::OK, name, WavHeaderParser::resultToString(result));
+    check(format.audioFormat == audioFormat, name, "wrong audio format");
+    check(format.dataOffset == dataOffset, name, "wrong data offset");
+    check(format.dataSize == dataSize, name, "wrong data size");
+    check(position == dataOffset, name, "source isn't left at the first sample");
+}
+
+static void expectResult(const std::string &name, const WavBuilder &wav, WavParseResult expected)
+{
+    WavFormat format;
+    WavParseResult result = parseBytes(wav.bytes(), format);
+    check(result == expected, name, WavHeaderParser::resultToString(result));
+}
+
+static void checkBuiltHeaders()
+{
+    // Layouts that parse
+    expectOk("canonical 44-byte header", WavBuilder().riff().fmt(2, 44100, 16).data(400, 400), WavHeaderParser::FORMAT_PCM, 44, 400);
+    expectOk("LIST chunk between fmt and data, as the skull files have",
+             WavBuilder().riff().fmt(1, 22050, 16).chunk("LIST", 26).data(100, 100), WavHeaderParser::FORMAT_PCM, 78, 100);
+    expectOk("odd-sized chunk and its pad byte", WavBuilder().riff().chunk("junk", 3).fmt(2, 44100, 16).data(8, 8),
+             WavHeaderParser::FORMAT_PCM, 56, 8);
+    expectOk("odd-sized chunk after fmt", WavBuilder().riff().fmt(2, 44100, 16).chunk("fact", 5).data(8, 8),
+             WavHeaderParser::FORMAT_PCM, 58, 8);
+    expectOk("fmt chunk longer than 16 bytes",
+             WavBuilder().riff().tag("fmt ").le32(18).le16(1).le16(2).le32(44100).le32(176400).le16(4).le16(16).le16(0).data(8, 8),
+             WavHeaderParser::FORMAT_PCM, 46, 8);
+    expectOk("WAVE_FORMAT_EXTENSIBLE PCM",
+             WavBuilder().riff().tag("fmt ").le32(40).le16(WavHeaderParser::FORMAT_EXTENSIBLE).le16(2).le32(44100).le32(176400)
+                 .le16(4).le16(16).le16(22).le16(16).le32(3).le16(WavHeaderParser::FORMAT_PCM).fill(14).data(8, 8),
+             WavHeaderParser::FORMAT_PCM, 68, 8);
+    expectOk("IMA-ADPCM, ending on a short block",
+             WavBuilder().riff().tag("fmt ").le32(20).le16(0x11).le16(1).le32(22050).le32(11100).le16(1024).le16(4).le16(2).le16(2041)
+                 .chunk("fact", 4).data(1500, 1500),
+             0x11, 60, 1500);
+
+    // Data sizes streaming encoders leave, trimmed to the file; partial frames dropped
+    expectOk("data size 0 from a streaming encoder", WavBuilder().riff().fmt(2, 44100, 16).data(0, 400), WavHeaderParser::FORMAT_PCM, 44, 400);
+    expectOk("data size 0xFFFFFFFF from a streaming encoder", WavBuilder().riff().fmt(2, 44100, 16).data(0xFFFFFFFF, 400),
+             WavHeaderParser::FORMAT_PCM, 44, 400);
+    expectOk("file truncated inside the data", WavBuilder().riff().fmt(2, 44100, 16).data(4000, 402), WavHeaderParser::FORMAT_PCM, 44, 400);
+    expectOk("data size not whole frames", WavBuilder().riff().fmt(2, 44100, 16).data(7, 8), WavHeaderParser::FORMAT_PCM, 44, 4);
+
+    // Headers that don't parse
+    expectResult("empty file", WavBuilder(), WavParseResult::READ_ERROR);
+    expectResult("not RIFF", WavBuilder().tag("RIFX").le32(0).tag("WAVE").fmt(2, 44100, 16).data(8, 8), WavParseResult::NOT_RIFF);
+    expectResult("RIFF but not WAVE", WavBuilder().riff("AVI ").fmt(2, 44100, 16).data(8, 8), WavParseResult::NOT_WAVE);
+    expectResult("fmt chunk too short", WavBuilder().riff().tag("fmt ").le32(14).le16(1).le16(2).le32(44100).le32(176400).le16(4).data(8, 8),
+                 WavParseResult::BAD_FMT);
+    expectResult("block align wrong for PCM", WavBuilder().riff().fmt(2, 44100, 16, 3).data(8, 8), WavParseResult::BAD_FMT);
+    expectResult("byte rate wrong for PCM", WavBuilder().riff().fmt(2, 44100, 16, 4, 44100).data(8, 8), WavParseResult::BAD_FMT);
+    expectResult("no channels", WavBuilder().riff().fmt(0, 44100, 16, 4).data(8, 8), WavParseResult::BAD_FMT);
+    expectResult("sample rate 0", WavBuilder().riff().fmt(2, 0, 16).data(8, 8), WavParseResult::BAD_FMT);
+    expectResult("WAVE_FORMAT_EXTENSIBLE without its sub-format",
+                 WavBuilder().riff().tag("fmt ").le32(18).le16(WavHeaderParser::FORMAT_EXTENSIBLE).le16(2).le32(44100).le32(176400)
+                     .le16(4).le16(16).le16(0).data(8, 8),
+                 WavParseResult::BAD_FMT);
+    expectResult("data before fmt", WavBuilder().riff().data(8, 8).fmt(2, 44100, 16), WavParseResult::MISSING_FMT);
+    expectResult("no data chunk", WavBuilder().riff().fmt(2, 44100, 16).chunk("LIST", 26), WavParseResult::MISSING_DATA);
+    expectResult("chunk running past the end", WavBuilder().riff().fmt(2, 44100, 16).tag("LIST").le32(1000).fill(10),
+                 WavParseResult::MISSING_DATA);
+
+    // Truncated at every byte of the header: never OK, never a crash
+    WavBuilder full = WavBuilder().riff().fmt(2, 44100, 16).chunk("LIST", 26).data(8, 8);
+    for (size_t size = 0; size < 78 + 8; size++)
+    {
+        std::vector<uint8_t> truncated(full.bytes().begin(), full.bytes().begin() + size);
+        WavFormat format;
+        WavParseResult result = parseBytes(truncated, format);
+        bool expected = size < 12 ? result == WavParseResult::READ_ERROR : size < 78 ? result != WavParseResult::OK : result == WavParseResult::OK;
+        check(expected, "header truncated to " + std::to_string(size) + " bytes", WavHeaderParser::resultToString(result));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    checkCard(argc > 1 ? argv[1] : "sd_card_files");
+    checkBuiltHeaders();
+    return checkSummary();
+}
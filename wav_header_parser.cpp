@@ -0,0 +1,193 @@
+/*
+    Streaming RIFF/WAV header parser.
+
+    A WAV file is a RIFF container:
+
+        "RIFF" <riff size> "WAVE"
+        <chunk id> <chunk size> <chunk data> [pad byte if chunk size is odd]
+        ...
+
+    The chunks we need are "fmt " (audio format) and "data" (the samples). Files written by different
+    tools put other chunks around them; the skull audio files, for example, have a LIST/INFO chunk
+    between fmt and data, which is why the data offset varies from file to file (44 to 106 bytes).
+    All multi-byte values are little-endian.
+*/
+
+#include "wav_header_parser.h"
+#include <string.h>
+
+// Size of the fmt chunk fields we read (up to and including the WAVE_FORMAT_EXTENSIBLE sub-format GUID)
+static constexpr uint32_t FMT_MIN_SIZE = 16;
+static constexpr uint32_t FMT_EXTENSIBLE_SIZE = 40;
+
+static uint16_t readLe16(const uint8_t *bytes)
+{
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t readLe32(const uint8_t *bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// Read exactly size bytes, or fail
+static bool readExactly(WavByteSource &source, uint8_t *buffer, size_t size)
+{
+    return source.read(buffer, size) == size;
+}
+
+// Parse the contents of a fmt chunk into format. Returns false if the format is unusable.
+static bool parseFmtChunk(const uint8_t *fmt, uint32_t fmtSize, WavFormat &format)
+{
+    format.audioFormat = readLe16(fmt + 0);
+    format.numChannels = readLe16(fmt + 2);
+    format.sampleRate = readLe32(fmt + 4);
+    format.byteRate = readLe32(fmt + 8);
+    format.blockAlign = readLe16(fmt + 12);
+    format.bitsPerSample = readLe16(fmt + 14);
+
+    // WAVE_FORMAT_EXTENSIBLE stores the real format code in the first two bytes of the sub-format GUID
+    if (format.audioFormat == WavHeaderParser::FORMAT_EXTENSIBLE)
+    {
+        if (fmtSize < FMT_EXTENSIBLE_SIZE)
+        {
+            return false;
+        }
+        format.audioFormat = readLe16(fmt + 24);
+    }
+
+    if (format.numChannels == 0 || format.sampleRate == 0 || format.blockAlign == 0)
+    {
+        return false;
+    }
+
+    // For PCM the frame size and byte rate are fully determined by the other fields
+    if (format.audioFormat == WavHeaderParser::FORMAT_PCM)
+    {
+        uint32_t expectedBlockAlign = format.numChannels * ((format.bitsPerSample + 7) / 8);
+        if (format.bitsPerSample == 0 || format.blockAlign != expectedBlockAlign ||
+            format.byteRate != format.sampleRate * format.blockAlign)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+WavParseResult WavHeaderParser::parse(WavByteSource &source, uint32_t fileSize, WavFormat &format)
+{
+    memset(&format, 0, sizeof(format));
+
+    // RIFF header
+    uint8_t header[12];
+    if (!readExactly(source, header, sizeof(header)))
+    {
+        return WavParseResult::READ_ERROR;
+    }
+    if (memcmp(header, "RIFF", 4) != 0)
+    {
+        return WavParseResult::NOT_RIFF;
+    }
+    if (memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        return WavParseResult::NOT_WAVE;
+    }
+
+    uint32_t position = sizeof(header);
+    bool foundFmt = false;
+
+    // Walk the chunk list until we reach the data chunk
+    uint8_t chunkHeader[8];
+    while (readExactly(source, chunkHeader, sizeof(chunkHeader)))
+    {
+        position += sizeof(chunkHeader);
+        uint32_t chunkSize = readLe32(chunkHeader + 4);
+
+        if (memcmp(chunkHeader, "data", 4) == 0)
+        {
+            if (!foundFmt)
+            {
+                return WavParseResult::MISSING_FMT;
+            }
+
+            format.dataOffset = position;
+            format.dataSize = chunkSize;
+
+            // Streaming encoders may not know the final size; trust the file size instead
+            if (fileSize > 0)
+            {
+                uint32_t bytesInFile = fileSize > position ? fileSize - position : 0;
+                if (chunkSize == 0 || chunkSize > bytesInFile)
+                {
+                    format.dataSize = bytesInFile;
+                }
+            }
+
+            // Never hand out a partial PCM frame (compressed formats may legitimately end on a short block)
+            if (format.audioFormat == FORMAT_PCM)
+            {
+                format.dataSize -= format.dataSize % format.blockAlign;
+            }
+            return WavParseResult::OK;
+        }
+
+        // Chunks are padded to an even number of bytes
+        uint32_t paddedSize = chunkSize + (chunkSize & 1);
+
+        if (memcmp(chunkHeader, "fmt ", 4) == 0)
+        {
+            if (chunkSize < FMT_MIN_SIZE)
+            {
+                return WavParseResult::BAD_FMT;
+            }
+
+            uint8_t fmt[FMT_EXTENSIBLE_SIZE];
+            uint32_t bytesToRead = chunkSize < sizeof(fmt) ? chunkSize : sizeof(fmt);
+            if (!readExactly(source, fmt, bytesToRead))
+            {
+                return WavParseResult::BAD_FMT;
+            }
+            if (!parseFmtChunk(fmt, bytesToRead, format))
+            {
+                return WavParseResult::BAD_FMT;
+            }
+            foundFmt = true;
+
+            if (paddedSize > bytesToRead && !source.skip(paddedSize - bytesToRead))
+            {
+                return WavParseResult::MISSING_DATA;
+            }
+        }
+        else if (!source.skip(paddedSize))
+        {
+            return WavParseResult::MISSING_DATA;
+        }
+        position += paddedSize;
+    }
+
+    return WavParseResult::MISSING_DATA;
+}
+
+const char *WavHeaderParser::resultToString(WavParseResult result)
+{
+    switch (result)
+    {
+    case WavParseResult::OK:
+        return "OK";
+    case WavParseResult::READ_ERROR:
+        return "file too short for a RIFF header";
+    case WavParseResult::NOT_RIFF:
+        return "not a RIFF file";
+    case WavParseResult::NOT_WAVE:
+        return "RIFF file is not WAVE";
+    case WavParseResult::BAD_FMT:
+        return "invalid fmt chunk";
+    case WavParseResult::MISSING_FMT:
+        return "no fmt chunk before data";
+    case WavParseResult::MISSING_DATA:
+        return "no data chunk";
+    default:
+        return "unknown error";
+    }
+}
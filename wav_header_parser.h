@@ -0,0 +1,62 @@
+#ifndef WAV_HEADER_PARSER_H
+#define WAV_HEADER_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Forward-only byte source the parser reads the WAV header from.
+// Implemented over an SD card File on the device, and over a memory buffer or stdio FILE on a host.
+class WavByteSource
+{
+public:
+    virtual ~WavByteSource() {}
+
+    // Read up to size bytes. Returns the number of bytes actually read (0 at end of file).
+    virtual size_t read(uint8_t *buffer, size_t size) = 0;
+
+    // Skip forward size bytes. Returns false if that runs past the end of the file.
+    virtual bool skip(uint32_t size) = 0;
+};
+
+// Audio format and data location of a WAV file, as described by its fmt and data chunks
+struct WavFormat
+{
+    uint16_t audioFormat;   // 1 = PCM, 0x11 = IMA-ADPCM (WAVE_FORMAT_EXTENSIBLE is reported as its sub-format)
+    uint16_t numChannels;
+    uint32_t sampleRate;
+    uint32_t byteRate;
+    uint16_t blockAlign;    // Bytes per frame (all channels) for PCM, bytes per block for compressed formats
+    uint16_t bitsPerSample;
+    uint32_t dataOffset;    // Byte offset of the first audio sample in the file
+    uint32_t dataSize;      // Bytes of audio, trimmed to the end of the file (and to whole frames for PCM)
+};
+
+enum class WavParseResult
+{
+    OK,
+    READ_ERROR,      // File ended inside the RIFF header
+    NOT_RIFF,        // Doesn't start with "RIFF"
+    NOT_WAVE,        // RIFF form type isn't "WAVE"
+    BAD_FMT,         // fmt chunk is too short or internally inconsistent
+    MISSING_FMT,     // data chunk found before any fmt chunk
+    MISSING_DATA     // File ended before a data chunk was found
+};
+
+// WavHeaderParser walks the RIFF chunk list of a WAV file to find its fmt and data chunks.
+// It reads the header in a single forward pass, skipping any other chunks (LIST, fact, etc.),
+// and leaves the source positioned at the first audio sample.
+class WavHeaderParser
+{
+public:
+    static constexpr uint16_t FORMAT_PCM = 0x0001;
+    static constexpr uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+    // Parse the header. fileSize is the total size of the file (0 if unknown) and is used to clamp
+    // the data chunk size written by streaming encoders (which often leave it as 0 or 0xFFFFFFFF).
+    static WavParseResult parse(WavByteSource &source, uint32_t fileSize, WavFormat &format);
+
+    // Human readable description of a parse result, for logging
+    static const char *resultToString(WavParseResult result);
+};
+
+#endif // WAV_HEADER_PARSER_H